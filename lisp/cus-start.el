@@ -260,6 +260,11 @@ Leaving \"Default\" unchecked is equivalent with specifying a default of
 	     ;; fileio.c
 	     (delete-by-moving-to-trash auto-save boolean "23.1")
 	     (auto-save-visited-file-name auto-save boolean)
+	     (write-region-async files
+				 (choice (const :tag "Never" nil)
+					 (const :tag "Always" t)
+					 (integer :tag "For at least this many bytes"))
+				 "28.1")
 	     ;; filelock.c
 	     (create-lockfiles files boolean "24.3")
 	     (temporary-file-directory
@@ -557,6 +562,8 @@ Leaving \"Default\" unchecked is equivalent with specifying a default of
              (ns-use-srgb-colorspace ns boolean "24.4")
 	     ;; process.c
 	     (delete-exited-processes processes-basics boolean)
+	     ;; search.c
+	     (regexp-cache-size matching integer "28.1")
 	     ;; syntax.c
 	     (parse-sexp-ignore-comments editing-basics boolean)
 	     (words-include-escapes editing-basics boolean)
@@ -623,6 +630,10 @@ since it could result in memory overflow and make Emacs crash."
              (maximum-scroll-margin windows float "26.1")
 	     (hscroll-margin windows integer "22.1")
 	     (hscroll-step windows number "22.1")
+	     (long-line-threshold display
+				  (choice (const :tag "Never" nil)
+					  (integer :tag "Line length"))
+				  "28.1")
 	     (truncate-partial-width-windows
 	      display
 	      (choice (integer :tag "Truncate if narrower than")
@@ -64,7 +64,7 @@
     (buffer atom) (char-table array sequence atom)
     (bool-vector array sequence atom)
     (frame atom) (hash-table atom) (terminal atom)
-    (thread atom) (mutex atom) (condvar atom)
+    (thread atom) (mutex atom) (condvar atom) (regexp-set atom)
     (font-spec atom) (font-entity atom) (font-object atom)
     (vector array sequence atom)
     (user-ptr atom)
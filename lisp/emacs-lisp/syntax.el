@@ -69,6 +69,12 @@ position and later modify the buffer on some earlier position.")
 
 (defvar syntax-propertize-chunk-size 500)
 
+(defvar syntax-propertize-max-chunk-size 20000
+  "Largest region that `syntax-propertize-function' is called on at once.
+When more text needs propertizing, `syntax-propertize' works in
+chunks this large, so that the chunks done are kept when it is
+interrupted.")
+
 (defvar syntax-propertize-extend-region-functions
   '(syntax-propertize-wholelines)
   "Special hook run just before proceeding to propertize a region.
@@ -340,40 +346,56 @@ END) suitable for `syntax-propertize-function'."
         (with-silent-modifications
           (with-syntax-table (or syntax-ppss-table (syntax-table))
             (make-local-variable 'syntax-propertize--done) ;Just in case!
-            (let* ((start (max (min syntax-propertize--done (point-max))
-                               (point-min)))
-                   (end (max pos
-                             (min (point-max)
-                                  (+ start syntax-propertize-chunk-size))))
-                   (funs syntax-propertize-extend-region-functions))
-              (while funs
-                (let ((new (funcall (pop funs) start end))
+            (let ((target
+                   (max pos
+                        (min (point-max)
+                             (+ (max (min syntax-propertize--done (point-max))
+                                     (point-min))
+                                syntax-propertize-chunk-size)))))
+              ;; Go in chunks of at most `syntax-propertize-max-chunk-size',
+              ;; and only move the limit past a chunk once it is done,
+              ;; so that a quit or a throw keeps the chunks done so far
+              ;; and doesn't leave text marked as done that isn't.
+              (while (< syntax-propertize--done target)
+                (let* ((start (max (min syntax-propertize--done (point-max))
+                                   (point-min)))
+                       (end (min target
+                                 (max (+ start syntax-propertize-max-chunk-size)
+                                      (min (point-max)
+                                           (+ start
+                                              syntax-propertize-chunk-size)))))
+                       (funs syntax-propertize-extend-region-functions))
+                  (while funs
+                    (let ((new (funcall (pop funs) start end))
+                          ;; Avoid recursion!
+                          (syntax-propertize--done most-positive-fixnum))
+                      (if (or (null new)
+                              (and (>= (car new) start) (<= (cdr new) end)))
+                          nil
+                        (setq start (car new))
+                        (setq end (cdr new))
+                        ;; If there's been a change, we should go through the
+                        ;; list again since this new position may
+                        ;; warrant a different answer from one of the funs we've
+                        ;; already seen.
+                        (unless (eq funs
+                                    (cdr syntax-propertize-extend-region-functions))
+                          (setq funs syntax-propertize-extend-region-functions)))))
+                  ;; Flush ppss cache between the original value of `start' and that
+                  ;; set above by syntax-propertize-extend-region-functions.
+                  (syntax-ppss-flush-cache start)
+                  ;; (message "syntax-propertizing from %s to %s" start end)
+                  (remove-text-properties start end
+                                          '(syntax-table nil syntax-multiline nil))
+                  (condition-case err
                       ;; Avoid recursion!
-                      (syntax-propertize--done most-positive-fixnum))
-                  (if (or (null new)
-                          (and (>= (car new) start) (<= (cdr new) end)))
-                      nil
-                    (setq start (car new))
-                    (setq end (cdr new))
-                    ;; If there's been a change, we should go through the
-                    ;; list again since this new position may
-                    ;; warrant a different answer from one of the funs we've
-                    ;; already seen.
-                    (unless (eq funs
-                                (cdr syntax-propertize-extend-region-functions))
-                      (setq funs syntax-propertize-extend-region-functions)))))
-              ;; Flush ppss cache between the original value of `start' and that
-              ;; set above by syntax-propertize-extend-region-functions.
-              (syntax-ppss-flush-cache start)
-              ;; Move the limit before calling the function, so the function
-              ;; can use syntax-ppss.
-              (setq syntax-propertize--done end)
-              ;; (message "syntax-propertizing from %s to %s" start end)
-              (remove-text-properties start end
-                                      '(syntax-table nil syntax-multiline nil))
-              ;; Avoid recursion!
-              (let ((syntax-propertize--done most-positive-fixnum))
-                (funcall syntax-propertize-function start end)))))))))
+                      (let ((syntax-propertize--done most-positive-fixnum))
+                        (funcall syntax-propertize-function start end))
+                    ((debug error)
+                     ;; Don't try this chunk again and again.
+                     (setq syntax-propertize--done end)
+                     (signal (car err) (cdr err))))
+                  (setq syntax-propertize--done end))))))))))
 
 ;;; Link syntax-propertize with syntax.c.
 
@@ -452,6 +474,7 @@ These are valid when the buffer has no restriction.")
   "Flush the cache of `syntax-ppss' starting at position BEG."
   ;; Set syntax-propertize to refontify anything past beg.
   (setq syntax-propertize--done (min beg syntax-propertize--done))
+  (internal--syntax-ppss-flush-cache beg)
   ;; Flush invalid cache entries.
   (dolist (cell (list syntax-ppss-wide syntax-ppss-narrow))
     (pcase cell
@@ -510,14 +533,20 @@ run from `point-min' to POS except that values at positions 2 and 6
 in the returned list (counting from 0) cannot be relied upon.
 Point is at POS when this function returns.
 
-It is necessary to call `syntax-ppss-flush-cache' explicitly if
+If `syntax-ppss-use-native-cache' is non-nil, the cache is kept in
+C and follows the changes to the buffer text by itself.  Otherwise,
+it is necessary to call `syntax-ppss-flush-cache' explicitly if
 this function is called while `before-change-functions' is
 temporarily let-bound, or if the buffer is modified without
 running the hook."
   ;; Default values.
   (unless pos (setq pos (point)))
   (syntax-propertize pos)
-  ;;
+  (if (and syntax-ppss-use-native-cache (not syntax-begin-function))
+      (if syntax-ppss-table
+          (with-syntax-table syntax-ppss-table
+            (internal--syntax-ppss pos))
+        (internal--syntax-ppss pos))
   (with-syntax-table (or syntax-ppss-table (syntax-table))
   (let* ((cell (syntax-ppss--data))
          (ppss-last (car cell))
@@ -660,7 +689,7 @@ running the hook."
        ;; we may end up calling parse-partial-sexp with a position before
        ;; point-min.  In that case, just parse from point-min assuming
        ;; a nil state.
-       (parse-partial-sexp (point-min) pos))))))
+       (parse-partial-sexp (point-min) pos)))))))
 
 ;; Debugging functions
 
@@ -2091,6 +2091,43 @@ When nil, never request confirmation."
   :version "22.1"
   :type '(choice integer (const :tag "Never request confirmation" nil)))
 
+;; We cannot map a file straight into a buffer's text, because buffer
+;; text lives in a gap buffer in Emacs's internal representation.
+;; What we can do is read and decode only as much of a huge file as
+;; is actually looked at, a chunk at a time.
+(defcustom large-file-lazy-threshold nil
+  "Size of file above which it is visited lazily, or nil for never.
+Such a file is read into its buffer a chunk of
+`large-file-lazy-chunk-size' bytes at a time, as redisplay and
+forward incremental search approach the end of the text read so far.
+Other commands, such as `end-of-buffer' and `re-search-forward', only
+see the text read so far; \\[find-file-lazy-load-rest] reads the rest.
+The buffer is read-only while the file is only partly read, and the
+variable `buffer-file-lazy' is non-nil in it.  Files handled by a file
+name handler, and files visited literally, are always read in their
+entirety."
+  :group 'files
+  :group 'find-file
+  :version "28.1"
+  :type '(choice integer (const :tag "Never visit lazily" nil)))
+
+(defcustom large-file-lazy-chunk-size (* 1024 1024)
+  "Number of bytes to read at a time from a file visited lazily.
+See `large-file-lazy-threshold'."
+  :group 'files
+  :group 'find-file
+  :version "28.1"
+  :type 'integer)
+
+(defvar buffer-file-lazy nil
+  "Non-nil if only part of the visited file has been read into this buffer.
+The value is then the number of bytes of the file read so far; the
+rest of the file is read as needed.  See `large-file-lazy-threshold'.
+This has the `permanent-local' property, which takes effect if you
+make the variable buffer-local.")
+(make-variable-buffer-local 'buffer-file-lazy)
+(put 'buffer-file-lazy 'permanent-local t)
+
 (defcustom out-of-memory-warning-percentage nil
   "Warn if file size exceeds this percentage of available free memory.
 When nil, never issue warning.  Beware: This probably doesn't do what you
@@ -2220,7 +2257,10 @@ the various files."
 	      (if (or find-file-existing-other-name find-file-visit-truename)
 		  (setq buf other))))
 	;; Check to see if the file looks uncommonly large.
-	(when (not (or buf nowarn))
+	(when (not (or buf nowarn
+                       (files--visit-lazily-p filename rawfile
+                                              (file-attribute-size
+                                               attributes))))
           (when (eq (abort-if-file-too-large
                      (file-attribute-size attributes) "open" filename t)
                     'raw)
@@ -2376,7 +2416,11 @@ Do you want to revisit the file normally now? ")
 	     (setq error t)))
 	(condition-case ()
 	    (let ((inhibit-read-only t))
-	      (insert-file-contents filename t))
+	      (if (files--visit-lazily-p filename nil
+                                         (file-attribute-size
+                                          (file-attributes filename)))
+                  (files--lazy-visit filename)
+                (insert-file-contents filename t)))
 	  (file-error
 	   (when (and (file-exists-p filename)
 		      (not (file-readable-p filename)))
@@ -2411,7 +2455,149 @@ Do you want to revisit the file normally now? ")
 	    (set-buffer-major-mode buf)
 	    (setq-local find-file-literally t))
 	(after-find-file error (not nowarn)))
+      (when buffer-file-lazy
+        (add-function :around (local 'isearch-search-fun-function)
+                      #'files--lazy-isearch-search-fun))
       (current-buffer))))
+
+(defun files--visit-lazily-p (filename rawfile size)
+  "Return non-nil if FILENAME of SIZE bytes should be visited lazily.
+RAWFILE non-nil means the file is to be visited literally."
+  (and large-file-lazy-threshold
+       (not rawfile)
+       (natnump size)
+       (> size large-file-lazy-threshold)
+       (not (find-file-name-handler filename 'insert-file-contents))))
+
+(defun files--lazy-read-chunk ()
+  "Read the next chunk of the visited file at the end of the buffer.
+Return non-nil if the whole file has now been read."
+  (let* ((beg buffer-file-lazy)
+         (end (+ beg large-file-lazy-chunk-size))
+         (size (file-attribute-size (file-attributes buffer-file-name)))
+         (buffer-undo-list t)
+         (inhibit-read-only t)
+         (coding-system-for-read (if (zerop beg)
+                                     coding-system-for-read
+                                   buffer-file-coding-system)))
+    (unless (or (zerop beg) (verify-visited-file-modtime))
+      (error "File %s changed on disk; revert the buffer to reread it"
+             (file-name-nondirectory buffer-file-name)))
+    (save-excursion
+      (save-restriction
+        (widen)
+        (goto-char (point-max))
+        (let ((start (point)))
+          (with-silent-modifications
+            (insert-file-contents buffer-file-name nil beg end))
+          (when (zerop beg)
+            (setq buffer-file-coding-system last-coding-system-used))
+          (if (>= end size)
+              (setq end size)
+            ;; Don't leave a partial line at the end of the buffer,
+            ;; it could end in the middle of a multibyte sequence.
+            ;; Give back the text following the last newline, and
+            ;; read it again with the next chunk.
+            (goto-char (point-max))
+            (if (search-backward "\n" start t)
+                (forward-char 1)
+              ;; A chunk without a newline can still end in the
+              ;; middle of a multibyte sequence, whose bytes were
+              ;; decoded as raw bytes.  Give those back instead.
+              (while (and (> (point) start)
+                          (> (point) (- (point-max) 4))
+                          (eq (char-charset (char-before)) 'eight-bit))
+                (backward-char 1))
+              (when (= (point) start)
+                (goto-char (point-max))))
+            (setq end (- end (length (encode-coding-string
+                                      (buffer-substring (point)
+                                                        (point-max))
+                                      buffer-file-coding-system))))
+            (with-silent-modifications
+              (delete-region (point) (point-max)))))))
+    (setq buffer-file-lazy end)
+    (when (>= end size)
+      (files--lazy-done)
+      (setq buffer-read-only (not (file-writable-p buffer-file-name)))
+      t)))
+
+(defun files--lazy-done ()
+  "Stop reading the visited file of the current buffer lazily."
+  (kill-local-variable 'buffer-file-lazy)
+  (remove-function (local 'isearch-search-fun-function)
+                   #'files--lazy-isearch-search-fun)
+  (remove-hook 'kill-buffer-hook #'files--lazy-done t)
+  (files--lazy-update-hook))
+
+(defun files--lazy-update-hook ()
+  "Run `files--lazy-load-for-window' before redisplay only when needed.
+That is, only while some buffer is visited lazily."
+  (if (catch 'lazy
+        (dolist (buffer (buffer-list))
+          (when (buffer-local-value 'buffer-file-lazy buffer)
+            (throw 'lazy t))))
+      (add-hook 'pre-redisplay-functions #'files--lazy-load-for-window)
+    (remove-hook 'pre-redisplay-functions #'files--lazy-load-for-window)))
+
+(defun files--lazy-visit (filename)
+  "Visit FILENAME in the current buffer, reading only its first chunk.
+Subsequent chunks are read by `files--lazy-load-for-window' and
+`files--lazy-isearch-search-fun'."
+  (setq buffer-file-name (expand-file-name filename))
+  (setq buffer-file-lazy 0)
+  (unless (files--lazy-read-chunk)
+    ;; Chunks are cut at newlines, which is only safe when newline is
+    ;; a single ASCII byte in the file's encoding.
+    (if (coding-system-get buffer-file-coding-system :ascii-compatible-p)
+        (progn
+          (add-hook 'kill-buffer-hook #'files--lazy-done nil t)
+          (files--lazy-update-hook))
+      (find-file-lazy-load-rest)))
+  (set-visited-file-modtime)
+  (set-buffer-modified-p nil)
+  (setq buffer-saved-size (buffer-size)))
+
+(defun files--lazy-load-for-window (window)
+  "Read more of a lazily visited file if WINDOW nears the end of its text.
+This is run from `pre-redisplay-functions'."
+  (let ((buffer (window-buffer window)))
+    (when (buffer-local-value 'buffer-file-lazy buffer)
+      (with-current-buffer buffer
+        (while (and buffer-file-lazy
+                    (> (max (window-point window) (window-start window))
+                       (- (point-max) (/ large-file-lazy-chunk-size 4)))
+                    (not (files--lazy-read-chunk))))))))
+
+(defvar isearch-forward)
+
+(defun files--lazy-isearch-search-fun (orig-fun)
+  "Make the search function of ORIG-FUN read more of a lazy file on failure.
+Only forward searches without a bound read more of the file."
+  (let ((search-fun (funcall orig-fun)))
+    (lambda (string bound noerror)
+      (let ((from (point))
+            found)
+        (while (and (not (setq found (funcall search-fun
+                                              string bound noerror)))
+                    isearch-forward (not bound) buffer-file-lazy)
+          ;; Matches wholly within the text read so far have been
+          ;; ruled out, so resume from the start of its last line.
+          (goto-char (max from (save-excursion
+                                 (goto-char (point-max))
+                                 (line-beginning-position 0))))
+          (files--lazy-read-chunk))
+        found))))
+
+(defun find-file-lazy-load-rest ()
+  "Read the rest of the file visited lazily in the current buffer.
+See `large-file-lazy-threshold'."
+  (interactive)
+  (unless buffer-file-lazy
+    (user-error "The visited file has already been read in full"))
+  (let ((modified (buffer-modified-p)))
+    (while (not (files--lazy-read-chunk)))
+    (set-buffer-modified-p modified)))
 
 (defun insert-file-contents-literally (filename &optional visit beg end replace)
   "Like `insert-file-contents', but only reads in the file literally.
@@ -2554,7 +2740,8 @@ unless NOMODES is non-nil."
   ;; When a file is marked read-only,
   ;; make the buffer read-only even if root is looking at it.
   (unless buffer-read-only
-    (when (or (backup-file-name-p buffer-file-name)
+    (when (or buffer-file-lazy
+              (backup-file-name-p buffer-file-name)
 	      (let ((modes (file-modes (buffer-file-name))))
 		(and modes (zerop (logand modes #o222)))))
       (setq buffer-read-only t)))
@@ -5232,6 +5419,9 @@ Before and after saving the buffer, this function runs
 		"%s has changed since visited or saved.  Save anyway? "
 		(file-name-nondirectory buffer-file-name)))
 	      (user-error "Save not confirmed"))
+          ;; Don't truncate a file that has been read only partially.
+          (when buffer-file-lazy
+            (find-file-lazy-load-rest))
 	  (save-restriction
 	    (widen)
 	    (save-excursion
@@ -6207,6 +6397,8 @@ an auto-save file."
       ;; (called from insert-file-contents) to set
       ;; buffer-file-coding-system to a proper value.
       (kill-local-variable 'buffer-file-coding-system)
+      (when buffer-file-lazy
+        (files--lazy-done))
 
       ;; Note that this preserves point in an intelligent way.
       (if revert-buffer-preserve-modes
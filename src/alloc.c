@@ -3100,6 +3100,8 @@ cleanup_vector (struct Lisp_Vector *vector)
       /* sweep_buffer should already have unchained this from its buffer.  */
       eassert (! PSEUDOVEC_STRUCT (vector, Lisp_Marker)->buffer);
     }
+  else if (PSEUDOVECTOR_TYPEP (&vector->header, PVEC_REGEXP_SET))
+    free_regexp_set (PSEUDOVEC_STRUCT (vector, Lisp_Regexp_Set));
   else if (PSEUDOVECTOR_TYPEP (&vector->header, PVEC_USER_PTR))
     {
       struct Lisp_User_Ptr *uptr = PSEUDOVEC_STRUCT (vector, Lisp_User_Ptr);
@@ -6019,6 +6021,8 @@ garbage_collect (void)
   mark_terminals ();
   mark_kboards ();
   mark_threads ();
+  mark_regexp_cache ();
+  mark_glyph_row_cache ();
 #ifdef HAVE_PGTK
   mark_pgtkterm();
 #endif
@@ -6044,8 +6048,10 @@ garbage_collect (void)
   FOR_EACH_LIVE_BUFFER (tail, buffer)
     {
       struct buffer *nextb = XBUFFER (buffer);
+      /* Don't use bset_undo_list here, as that would discard the
+	 buffer's compact undo log, which holds no Lisp objects.  */
       if (!EQ (BVAR (nextb, undo_list), Qt))
-	bset_undo_list (nextb, compact_undo_list (BVAR (nextb, undo_list)));
+	nextb->undo_list_ = compact_undo_list (BVAR (nextb, undo_list));
       /* Now that we have stripped the elements that need not be
 	 in the undo_list any more, we can finally mark the list.  */
       mark_object (BVAR (nextb, undo_list));
@@ -6317,6 +6323,8 @@ mark_buffer (struct buffer *buffer)
 
   mark_overlay (buffer->overlays_before);
   mark_overlay (buffer->overlays_after);
+  mark_syntax_ppss_cache (buffer);
+  mark_syntax_run_cache (buffer);
 
   /* If this is an indirect buffer, mark its base buffer.  */
   if (buffer->base_buffer &&
@@ -6346,6 +6354,13 @@ mark_face_cache (struct face_cache *c)
 		mark_object (face->lface[j]);
 	    }
 	}
+
+      if (c->merged_faces)
+	for (i = 0; i < MERGED_FACES_SIZE; ++i)
+	  {
+	    mark_object (c->merged_faces[i].prop);
+	    mark_object (c->merged_faces[i].remapping);
+	  }
     }
 }
 
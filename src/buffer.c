@@ -588,6 +588,9 @@ even if it is dead.  The return value is never nil.  */)
   b->newline_cache = 0;
   b->width_run_cache = 0;
   b->bidi_paragraph_cache = 0;
+  b->ppss_cache = NULL;
+  b->syntax_run_cache = NULL;
+  b->undo_log = NULL;
   bset_width_table (b, Qnil);
   b->prevent_redisplay_optimizations_p = 1;
 
@@ -825,6 +828,9 @@ CLONE nil means the indirect buffer's state is reset to default values.  */)
   b->newline_cache = 0;
   b->width_run_cache = 0;
   b->bidi_paragraph_cache = 0;
+  b->ppss_cache = NULL;
+  b->syntax_run_cache = NULL;
+  b->undo_log = NULL;
   bset_width_table (b, Qnil);
 
   name = Fcopy_sequence (name);
@@ -832,7 +838,7 @@ CLONE nil means the indirect buffer's state is reset to default values.  */)
   bset_name (b, name);
 
   /* An indirect buffer shares undo list of its base (Bug#18180).  */
-  bset_undo_list (b, BVAR (b->base_buffer, undo_list));
+  bset_undo_list (b, buffer_undo_list (b->base_buffer));
 
   reset_buffer (b);
   reset_buffer_local_variables (b, 1);
@@ -960,6 +966,7 @@ reset_buffer (register struct buffer *b)
   /* It is more conservative to start out "changed" than "unchanged".  */
   b->clip_changed = 0;
   b->prevent_redisplay_optimizations_p = 1;
+  b->long_line_optimizations_p = 0;
   bset_backed_up (b, Qnil);
   BUF_AUTOSAVE_MODIFF (b) = 0;
   b->auto_save_failure_time = 0;
@@ -1333,6 +1340,17 @@ No argument or nil as argument means use current buffer as BUFFER.  */)
   return result;
 }
 
+DEFUN ("long-line-optimizations-p", Flong_line_optimizations_p,
+       Slong_line_optimizations_p, 0, 1, 0,
+       doc: /* Return non-nil if long-line optimizations are in effect in BUFFER.
+BUFFER defaults to the current buffer.  Redisplay turns them on when it
+finds a line longer than `long-line-threshold', and they stay on until
+the buffer is erased.  */)
+  (Lisp_Object buffer)
+{
+  return decode_buffer (buffer)->long_line_optimizations_p ? Qt : Qnil;
+}
+
 DEFUN ("buffer-modified-p", Fbuffer_modified_p, Sbuffer_modified_p,
        0, 1, 0,
        doc: /* Return t if BUFFER was modified since its file was last read or saved.
@@ -1955,6 +1973,9 @@ cleaning up all windows currently displaying the buffer to be killed. */)
       free_region_cache (b->bidi_paragraph_cache);
       b->bidi_paragraph_cache = 0;
     }
+  free_syntax_ppss_cache (b);
+  free_syntax_run_cache (b);
+  clear_glyph_row_cache (NULL, b);
   bset_width_table (b, Qnil);
   unblock_input ();
 
@@ -2135,7 +2156,7 @@ void set_buffer_internal_2 (register struct buffer *b)
       /* Put the undo list back in the base buffer, so that it appears
 	 that an indirect buffer shares the undo list of its base.  */
       if (old_buf->base_buffer)
-	bset_undo_list (old_buf->base_buffer, BVAR (old_buf, undo_list));
+	bset_undo_list (old_buf->base_buffer, buffer_undo_list (old_buf));
 
       /* If the old current buffer has markers to record PT, BEGV and ZV
 	 when it is not current, update them now.  */
@@ -2145,7 +2166,7 @@ void set_buffer_internal_2 (register struct buffer *b)
   /* Get the undo list from the base buffer, so that it appears
      that an indirect buffer shares the undo list of its base.  */
   if (b->base_buffer)
-    bset_undo_list (b, BVAR (b->base_buffer, undo_list));
+    bset_undo_list (b, buffer_undo_list (b->base_buffer));
 
   /* If the new current buffer has markers to record PT, BEGV and ZV
      when it is not current, fetch them now.  */
@@ -2259,6 +2280,7 @@ so the buffer is truly empty after this.  */)
   del_range (BEG, Z);
 
   current_buffer->last_window_start = 1;
+  current_buffer->long_line_optimizations_p = 0;
   /* Prevent warnings, or suspension of auto saving, that would happen
      if future size is less than past size.  Use of erase-buffer
      implies that the future text is not really related to the past text.  */
@@ -2387,6 +2409,9 @@ results, see Info node `(elisp)Swapping Text'.  */)
   swapfield (newline_cache, struct region_cache *);
   swapfield (width_run_cache, struct region_cache *);
   swapfield (bidi_paragraph_cache, struct region_cache *);
+  swapfield (ppss_cache, struct syntax_ppss_cache *);
+  swapfield (syntax_run_cache, struct syntax_run_cache *);
+  swapfield (undo_log, struct undo_log *);
   current_buffer->prevent_redisplay_optimizations_p = 1;
   other_buffer->prevent_redisplay_optimizations_p = 1;
   swapfield (overlays_before, struct Lisp_Overlay *);
@@ -2499,7 +2524,7 @@ current buffer is cleared.  */)
   ptrdiff_t begv, zv;
   bool narrowed = (BEG != BEGV || Z != ZV);
   bool modified_p = !NILP (Fbuffer_modified_p (Qnil));
-  Lisp_Object old_undo = BVAR (current_buffer, undo_list);
+  Lisp_Object old_undo = buffer_undo_list (current_buffer);
 
   if (current_buffer->base_buffer)
     error ("Cannot do `set-buffer-multibyte' on an indirect buffer");
@@ -6318,6 +6343,7 @@ since either may lead to infinite recursion.  */);
   defsubr (&Sbuffer_base_buffer);
   defsubr (&Sbuffer_local_value);
   defsubr (&Sbuffer_local_variables);
+  defsubr (&Slong_line_optimizations_p);
   defsubr (&Sbuffer_modified_p);
   defsubr (&Sforce_mode_line_update);
   defsubr (&Sset_buffer_modified_p);
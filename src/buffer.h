@@ -659,6 +659,20 @@ struct buffer
   struct region_cache *width_run_cache;
   struct region_cache *bidi_paragraph_cache;
 
+  /* The parse states that `syntax-ppss' computed, or null.  Only
+     base buffers have one.  See syntax.c.  */
+  struct syntax_ppss_cache *ppss_cache;
+
+  /* The runs of equal `syntax-table' properties in the text, or null.
+     Only base buffers have one.  See syntax.c.  */
+  struct syntax_run_cache *syntax_run_cache;
+
+  /* If `undo-compact-log' is non-nil, the most recent changes are
+     recorded here rather than in undo_list, and only moved onto
+     undo_list when something looks at it.  Null if there are no
+     such changes.  See undo.c.  */
+  struct undo_log *undo_log;
+
   /* Non-zero means disable redisplay optimizations when rebuilding the glyph
      matrices (but not when redrawing).  */
   bool_bf prevent_redisplay_optimizations_p : 1;
@@ -673,6 +687,11 @@ struct buffer
      defined.  */
   bool_bf inhibit_buffer_hooks : 1;
 
+  /* Non-zero when the buffer has lines so long that redisplay should
+     only look at the text near the positions it displays.  See
+     `long-line-threshold'.  */
+  bool_bf long_line_optimizations_p : 1;
+
   /* List of overlays that end at or before the current center,
      in order of end-position.  */
   struct Lisp_Overlay *overlays_before;
@@ -812,8 +831,22 @@ bset_truncate_lines (struct buffer *b, Lisp_Object val)
 INLINE void
 bset_undo_list (struct buffer *b, Lisp_Object val)
 {
+  /* Setting the undo list replaces the whole undo history, including
+     whatever is still in the compact undo log.  */
+  if (b->undo_log)
+    discard_undo_log (b);
   b->undo_list_ = val;
 }
+/* Return B's undo list, after moving onto it the changes that are
+   still in B's compact undo log.  Use this rather than BVAR whenever
+   the list is going to be examined or extended.  */
+INLINE Lisp_Object
+buffer_undo_list (struct buffer *b)
+{
+  if (b->undo_log)
+    flush_undo_log (b);
+  return BVAR (b, undo_list);
+}
 INLINE void
 bset_upcase_table (struct buffer *b, Lisp_Object val)
 {
@@ -1482,13 +1515,18 @@ set_per_buffer_default (int offset, Lisp_Object value)
 INLINE Lisp_Object
 per_buffer_value (struct buffer *b, int offset)
 {
+  if (offset == PER_BUFFER_VAR_OFFSET (undo_list))
+    return buffer_undo_list (b);
   return *(Lisp_Object *)(offset + (char *) b);
 }
 
 INLINE void
 set_per_buffer_value (struct buffer *b, int offset, Lisp_Object value)
 {
-  *(Lisp_Object *)(offset + (char *) b) = value;
+  if (offset == PER_BUFFER_VAR_OFFSET (undo_list))
+    bset_undo_list (b, value);
+  else
+    *(Lisp_Object *)(offset + (char *) b) = value;
 }
 
 /* Downcase a character C, or make no change if that cannot be done.  */
@@ -494,7 +494,8 @@ casify_region (enum case_action flag, Lisp_Object b, Lisp_Object e)
   prepare_casing_context (&ctx, flag, true);
 
   ptrdiff_t orig_end = end;
-  record_delete (start, make_buffer_string (start, end, true), false);
+  record_delete_text (start, CHAR_TO_BYTE (start), end, CHAR_TO_BYTE (end),
+		      false);
   if (NILP (BVAR (current_buffer, enable_multibyte_characters)))
     {
       record_insert (start, end - start);
@@ -34,6 +34,7 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "character.h"
 #include "buffer.h"
 #include "category.h"
+#include "regex-emacs.h"
 
 /* This setter is used only in this file, so it can be private.  */
 static void
@@ -369,6 +370,8 @@ then delete CATEGORY from the category set instead of adding it.  */)
       start = to + 1;
     }
 
+  /* Regexp automata may have cached what \cX matched.  */
+  re_flush_dfa_caches ();
   return Qnil;
 }
 
@@ -96,6 +96,21 @@ set_char_table_parent (Lisp_Object table, Lisp_Object val)
 {
   XCHAR_TABLE (table)->parent = val;
 }
+
+/* Incremented whenever Lisp changes a display table or the value of
+   'glyphless-char-display', so that redisplay can tell whether glyphs
+   it produced earlier are still valid.  */
+EMACS_INT display_char_table_tick;
+
+/* Note that Lisp changed TABLE.  */
+void
+note_char_table_change (Lisp_Object table)
+{
+  Lisp_Object purpose = XCHAR_TABLE (table)->purpose;
+
+  if (EQ (purpose, Qdisplay_table) || EQ (purpose, Qglyphless_char_display))
+    display_char_table_tick++;
+}
 
 DEFUN ("make-char-table", Fmake_char_table, Smake_char_table, 1, 2, 0,
        doc: /* Return a newly created char-table, with purpose PURPOSE.
@@ -558,6 +573,7 @@ Return PARENT.  PARENT must be either nil or another char-table.  */)
     }
 
   set_char_table_parent (char_table, parent);
+  note_char_table_change (char_table);
 
   return parent;
 }
@@ -589,6 +605,7 @@ DEFUN ("set-char-table-extra-slot", Fset_char_table_extra_slot,
     args_out_of_range (char_table, n);
 
   set_char_table_extras (char_table, XFIXNUM (n), value);
+  note_char_table_change (char_table);
   return value;
 }
 
@@ -652,6 +669,7 @@ or a character code.  Return VALUE.  */)
     }
   else
     error ("Invalid RANGE argument to `set-char-table-range'");
+  note_char_table_change (char_table);
 
   return value;
 }
@@ -1114,6 +1114,15 @@ alloc_destination (struct coding_system *coding, ptrdiff_t nbytes,
 #define UTF_8_4_OCTET_LEADING_P(c) (((c) & 0xF8) == 0xF0)
 #define UTF_8_5_OCTET_LEADING_P(c) (((c) & 0xFC) == 0xF8)
 
+/* Text can be checked a word at a time: a word of ASCII characters
+   other than control characters can be skipped over as a whole.  */
+#define WORD_ONES (SIZE_MAX / UCHAR_MAX)
+#define WORD_HIGH_BITS (WORD_ONES * 0x80)
+#define WORD_HAS_CONTROL_P(w) \
+  (((w) - WORD_ONES * 0x20) & ~(w) & WORD_HIGH_BITS)
+#define WORD_PLAIN_ASCII_P(w) (! ((w) & WORD_HIGH_BITS \
+				  || WORD_HAS_CONTROL_P (w)))
+
 #define UTF_8_BOM_1 0xEF
 #define UTF_8_BOM_2 0xBB
 #define UTF_8_BOM_3 0xBF
@@ -1152,6 +1161,18 @@ detect_coding_utf_8 (struct coding_system *coding,
     {
       int c, c1, c2, c3, c4;
 
+      if (! multibytep && src_end - src >= sizeof (size_t))
+	{
+	  size_t w;
+
+	  memcpy (&w, src, sizeof w);
+	  if (WORD_PLAIN_ASCII_P (w))
+	    {
+	      src += sizeof w;
+	      nchars += sizeof w;
+	      continue;
+	    }
+	}
       src_base = src;
       ONE_MORE_BYTE (c);
       if (c < 0 || UTF_8_1_OCTET_P (c))
@@ -5702,6 +5723,7 @@ setup_coding_system (Lisp_Object coding_system, struct coding_system *coding)
   coding->default_char = XFIXNUM (CODING_ATTR_DEFAULT_CHAR (attrs));
   coding->carryover_bytes = 0;
   coding->raw_destination = 0;
+  memset (&coding->prescan, 0, sizeof coding->prescan);
 
   coding_type = CODING_ATTR_TYPE (attrs);
   if (EQ (coding_type, Qundecided))
@@ -6160,6 +6182,84 @@ static Lisp_Object adjust_coding_eol_type (struct coding_system *coding,
 					   int eol_seen);
 
 
+/* Continue the prescan PS of the SIZE bytes at TEXT, from where it
+   stopped last time.  Scan up to the first NUL, ESC, SI or SO byte,
+   but don't end the scan on CR, as we don't know yet whether LF
+   follows it.  Record in PS how far the scan got, where the first
+   byte with its high bit set is, and the EOL formats seen before it
+   and before the end of the scan.  detect_coding and check_ascii
+   would otherwise find all of this out a byte at a time.
+
+   This goes a word at a time where it can.  It is meant to be called
+   on each block of a file as soon as it is read, while the block is
+   still in the cache; see insert-file-contents.  */
+
+void
+prescan_coding (struct coding_prescan *ps, const unsigned char *text,
+		ptrdiff_t size)
+{
+  const unsigned char *p = text + ps->bytes, *end = text + size;
+  bool eight_bit_found = ps->ascii < ps->bytes;
+  int eol = ps->eol;
+
+  while (! ps->done && p < end)
+    {
+      if (end - p >= sizeof (size_t))
+	{
+	  size_t w;
+
+	  memcpy (&w, p, sizeof w);
+	  /* Skip words with no control characters, and, until the
+	     first one is found, no bytes with their high bit set.  */
+	  if (eight_bit_found
+	      ? ! WORD_HAS_CONTROL_P (w)
+	      : WORD_PLAIN_ASCII_P (w))
+	    {
+	      p += sizeof w;
+	      continue;
+	    }
+	}
+
+      int c = *p;
+
+      if (c & 0x80)
+	{
+	  if (! eight_bit_found)
+	    {
+	      eight_bit_found = true;
+	      ps->ascii = p - text;
+	      ps->ascii_eol = eol;
+	    }
+	}
+      else if (c == 0 || c == ISO_CODE_ESC || c == ISO_CODE_SI
+	       || c == ISO_CODE_SO)
+	ps->done = true;
+      else if (c == '\r')
+	{
+	  if (p + 1 == end)
+	    break;
+	  if (p[1] == '\n')
+	    {
+	      eol |= EOL_SEEN_CRLF;
+	      p++;
+	    }
+	  else
+	    eol |= EOL_SEEN_CR;
+	}
+      else if (c == '\n')
+	eol |= EOL_SEEN_LF;
+      if (! ps->done)
+	p++;
+    }
+  ps->bytes = p - text;
+  ps->eol = eol;
+  if (! eight_bit_found)
+    {
+      ps->ascii = ps->bytes;
+      ps->ascii_eol = eol;
+    }
+}
+
 /* Return the number of ASCII characters at the head of the source.
    By side effects, set coding->head_ascii and update
    coding->eol_seen.  The value of coding->eol_seen is "logical or" of
@@ -6174,12 +6274,13 @@ check_ascii (struct coding_system *coding)
   int eol_seen = coding->eol_seen;
 
   coding_set_source (coding);
-  src = coding->source;
-  end = src + coding->src_bytes;
+  src = coding->source + coding->prescan.ascii;
+  end = coding->source + coding->src_bytes;
 
   if (inhibit_eol_conversion
       || SYMBOLP (eol_type))
     {
+      eol_seen |= coding->prescan.ascii_eol & EOL_SEEN_LF;
       /* We don't have to check EOL format.  */
       while (src < end && !( *src & 0x80))
 	{
@@ -6189,6 +6290,7 @@ check_ascii (struct coding_system *coding)
     }
   else
     {
+      eol_seen |= coding->prescan.ascii_eol;
       end--;		    /* We look ahead one byte for "CR LF".  */
       while (src < end)
 	{
@@ -6257,6 +6359,18 @@ check_utf_8 (struct coding_system *coding)
     {
       int c = *src;
 
+      if (end - src >= sizeof (size_t))
+	{
+	  size_t w;
+
+	  memcpy (&w, src, sizeof w);
+	  if (WORD_PLAIN_ASCII_P (w))
+	    {
+	      src += sizeof w;
+	      nchars += sizeof w;
+	      continue;
+	    }
+	}
       if (UTF_8_1_OCTET_P (*src))
 	{
 	  src++;
@@ -6547,9 +6661,17 @@ detect_coding (struct coding_system *coding)
 				       inhibit_iso_escape_detection);
       bool prefer_utf_8 = coding->spec.undecided.prefer_utf_8;
 
-      coding->head_ascii = 0;
+      /* Start after the bytes the caller has prescanned, if any.
+	 There is no NUL, ESC, SI or SO among them, so all the loop
+	 below would do with them is count the ones at the head and
+	 note the EOL formats.  */
+      coding->head_ascii = coding->prescan.ascii;
+      eight_bit_found = coding->prescan.ascii < coding->prescan.bytes;
+      if (! disable_ascii_optimization && ! inhibit_eol_conversion)
+	coding->eol_seen = coding->prescan.eol;
       detect_info.checked = detect_info.found = detect_info.rejected = 0;
-      for (src = coding->source; src < src_end; src++)
+      for (src = coding->source + coding->prescan.bytes;
+	   src < src_end; src++)
 	{
 	  c = *src;
 	  if (c & 0x80)
@@ -7382,7 +7504,7 @@ decode_coding (struct coding_system *coding)
       if (MODIFF <= SAVE_MODIFF)
 	record_first_change ();
 
-      undo_list = BVAR (current_buffer, undo_list);
+      undo_list = buffer_undo_list (current_buffer);
       bset_undo_list (current_buffer, Qt);
     }
 
@@ -8017,7 +8139,7 @@ decode_coding_gap (struct coding_system *coding, ptrdiff_t bytes)
     {
       ptrdiff_t prev_Z = Z, prev_Z_BYTE = Z_BYTE;
       Lisp_Object val;
-      Lisp_Object undo_list = BVAR (current_buffer, undo_list);
+      Lisp_Object undo_list = buffer_undo_list (current_buffer);
 
       record_unwind_protect (coding_restore_undo_list,
 			     Fcons (undo_list, Fcurrent_buffer ()));
@@ -8168,7 +8290,7 @@ decode_coding_object (struct coding_system *coding,
     {
       ptrdiff_t prev_Z = Z, prev_Z_BYTE = Z_BYTE;
       Lisp_Object val;
-      Lisp_Object undo_list = BVAR (current_buffer, undo_list);
+      Lisp_Object undo_list = buffer_undo_list (current_buffer);
       ptrdiff_t count1 = SPECPDL_INDEX ();
 
       record_unwind_protect (coding_restore_undo_list,
@@ -384,6 +384,25 @@ struct utf_16_spec
   int surrogate;
 };
 
+/* What prescan_coding found out about the head of a text.  */
+struct coding_prescan
+{
+  /* How many bytes at the head have been scanned.  There is no NUL,
+     ESC, SI or SO among them.  */
+  ptrdiff_t bytes;
+
+  /* How many of those come before the first byte with its high bit
+     set.  */
+  ptrdiff_t ascii;
+
+  /* The "logical or" of the EOL_SEEN_XXX formats seen in the first
+     ASCII bytes, and in all of the scanned bytes.  */
+  int ascii_eol, eol;
+
+  /* True if a NUL, ESC, SI or SO byte ended the scan.  */
+  bool done;
+};
+
 struct coding_detection_info
 {
   /* Values of these members are bitwise-OR of CATEGORY_MASK_XXXs.  */
@@ -463,6 +482,11 @@ struct coding_system
      sequence.  Set by detect_coding_utf_8.  */
   ptrdiff_t detected_utf8_bytes, detected_utf8_chars;
 
+  /* What the caller of decode_coding_gap has already found out about
+     the head of the source, see prescan_coding.  This is cleared in
+     setup_coding_system.  */
+  struct coding_prescan prescan;
+
   /* The following members are set by encoding/decoding routine.  */
   ptrdiff_t produced, produced_char, consumed, consumed_char;
 
@@ -702,6 +726,8 @@ extern Lisp_Object coding_inherit_eol_type (Lisp_Object, Lisp_Object);
 extern Lisp_Object complement_process_encoding_system (Lisp_Object);
 extern Lisp_Object make_string_from_utf8 (const char *, ptrdiff_t);
 
+extern void prescan_coding (struct coding_prescan *, const unsigned char *,
+			    ptrdiff_t);
 extern void decode_coding_gap (struct coding_system *, ptrdiff_t);
 extern void decode_coding_object (struct coding_system *,
                                   Lisp_Object, ptrdiff_t, ptrdiff_t,
@@ -24,6 +24,8 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 
 #include <config.h>
 
+#include <stdlib.h>
+
 #include "lisp.h"
 #include "character.h"
 #include "composite.h"
@@ -638,6 +640,41 @@ compose_text (ptrdiff_t start, ptrdiff_t end, Lisp_Object components,
 
 static Lisp_Object gstring_hash_table;
 
+/* When each glyph-string in gstring_hash_table was last used, indexed
+   by its ID, in units of gstring_use_tick, for evicting the least
+   recently used ones.  gstring_uses_size is the number of elements
+   allocated.  */
+
+static EMACS_UINT *gstring_uses;
+static ptrdiff_t gstring_uses_size;
+static EMACS_UINT gstring_use_tick;
+
+/* Make gstring_uses have at least SIZE elements.  */
+
+static void
+grow_gstring_uses (ptrdiff_t size)
+{
+  ptrdiff_t old_size = gstring_uses_size;
+
+  if (size <= old_size)
+    return;
+  gstring_uses = xpalloc (gstring_uses, &gstring_uses_size,
+			  size - old_size, -1, sizeof *gstring_uses);
+  memset (gstring_uses + old_size, 0,
+	  (gstring_uses_size - old_size) * sizeof *gstring_uses);
+}
+
+/* Record a use of the glyph-string whose ID is ID.  */
+
+static void
+note_gstring_use (ptrdiff_t id)
+{
+  if (id >= gstring_uses_size)
+    grow_gstring_uses (max (id + 1, HASH_TABLE_SIZE (XHASH_TABLE
+						      (gstring_hash_table))));
+  gstring_uses[id] = ++gstring_use_tick;
+}
+
 static Lisp_Object gstring_lookup_cache (Lisp_Object);
 
 static Lisp_Object
@@ -646,7 +683,11 @@ gstring_lookup_cache (Lisp_Object header)
   struct Lisp_Hash_Table *h = XHASH_TABLE (gstring_hash_table);
   ptrdiff_t i = hash_lookup (h, header, NULL);
 
-  return (i >= 0 ? HASH_VALUE (h, i) : Qnil);
+  note_gstring_lookup (i >= 0);
+  if (i < 0)
+    return Qnil;
+  note_gstring_use (i);
+  return HASH_VALUE (h, i);
 }
 
 Lisp_Object
@@ -670,6 +711,7 @@ composition_gstring_put_cache (Lisp_Object gstring, ptrdiff_t len)
     LGSTRING_SET_GLYPH (copy, i, Fcopy_sequence (LGSTRING_GLYPH (gstring, i)));
   ptrdiff_t id = hash_put (h, LGSTRING_HEADER (copy), copy, hash);
   LGSTRING_SET_ID (copy, make_fixnum (id));
+  note_gstring_use (id);
   return copy;
 }
 
@@ -678,9 +720,66 @@ composition_gstring_from_id (ptrdiff_t id)
 {
   struct Lisp_Hash_Table *h = XHASH_TABLE (gstring_hash_table);
 
+  note_gstring_use (id);
   return HASH_VALUE (h, id);
 }
 
+static int
+compare_gstring_uses (void const *a, void const *b)
+{
+  EMACS_UINT use_a = gstring_uses[*(ptrdiff_t const *) a];
+  EMACS_UINT use_b = gstring_uses[*(ptrdiff_t const *) b];
+
+  return use_a < use_b ? -1 : use_a > use_b;
+}
+
+/* If gstring_hash_table holds more glyph-strings than
+   `composition-cache-limit', evict the least recently used ones, and
+   return true.  Otherwise return false.
+
+   Evicting a glyph-string makes its ID available to new ones, so the
+   caller must make sure that no glyph still refers to it.  To do that
+   less often, an eighth of the limit more is evicted than needed.  */
+
+bool
+composition_evict_gstrings (void)
+{
+  struct Lisp_Hash_Table *h = XHASH_TABLE (gstring_hash_table);
+
+  if (! FIXNATP (Vcomposition_cache_limit)
+      || h->count <= XFIXNAT (Vcomposition_cache_limit))
+    return false;
+
+  EMACS_INT limit = XFIXNAT (Vcomposition_cache_limit);
+  ptrdiff_t nevict = h->count - (limit - limit / 8);
+  ptrdiff_t size = HASH_TABLE_SIZE (h), n = 0;
+  USE_SAFE_ALLOCA;
+  ptrdiff_t *ids;
+  SAFE_NALLOCA (ids, 1, h->count);
+
+  /* Glyph-strings that were never used since Emacs started, such as
+     those in the dumped table, have no recorded use yet.  */
+  grow_gstring_uses (size);
+  for (ptrdiff_t i = 0; i < size; i++)
+    if (! EQ (HASH_KEY (h, i), Qunbound))
+      ids[n++] = i;
+  qsort (ids, n, sizeof *ids, compare_gstring_uses);
+  for (ptrdiff_t i = 0; i < nevict && i < n; i++)
+    hash_remove_from_table (h, HASH_KEY (h, ids[i]));
+  note_gstring_evictions (min (nevict, n));
+
+  SAFE_FREE ();
+  return true;
+}
+
+/* Return the number of glyph-strings in gstring_hash_table.  */
+
+ptrdiff_t
+composition_cached_gstrings (void)
+{
+  return XHASH_TABLE (gstring_hash_table)->count;
+}
+
 DEFUN ("clear-composition-cache", Fclear_composition_cache,
        Sclear_composition_cache, 0, 0, 0,
        doc: /* Internal use only.
@@ -689,6 +788,8 @@ Clear composition cache.  */)
 {
   Lisp_Object args[] = {QCtest, Qequal, QCsize, make_fixnum (311)};
   gstring_hash_table = CALLMANY (Fmake_hash_table, args);
+  if (gstring_uses)
+    memset (gstring_uses, 0, gstring_uses_size * sizeof *gstring_uses);
   /* Fixme: We call Fclear_face_cache to force complete re-building of
      display glyphs.  But, it may be better to call this function from
      Fclear_face_cache instead.  */
@@ -2017,6 +2118,15 @@ GSTRING, or modify GSTRING itself and return it.
 See also the documentation of `auto-composition-mode'.  */);
   Vcomposition_function_table = Fmake_char_table (Qnil, Qnil);
 
+  DEFVAR_LISP ("composition-cache-limit", Vcomposition_cache_limit,
+	       doc: /* Maximum number of glyph-strings to keep for automatic composition.
+Shaping text for automatic composition gives glyph-strings, which are
+cached so that the same text needn't be shaped again.  When the cache
+holds more than this many glyph-strings, redisplay evicts the least
+recently used ones, and redraws all frames.  If nil, the cache grows
+without limit.  */);
+  Vcomposition_cache_limit = make_fixnum (20000);
+
   defsubr (&Scompose_region_internal);
   defsubr (&Scompose_string_internal);
   defsubr (&Sfind_composition_internal);
@@ -259,6 +259,8 @@ for example, (type-of 1) returns `integer'.  */)
           }
         case PVEC_MODULE_FUNCTION:
           return Qmodule_function;
+        case PVEC_REGEXP_SET:
+          return Qregexp_set;
         case PVEC_XWIDGET:
           return Qxwidget;
         case PVEC_XWIDGET_VIEW:
@@ -2278,6 +2280,7 @@ bool-vector.  IDX starts at 0.  */)
     {
       CHECK_CHARACTER (idx);
       CHAR_TABLE_SET (array, idxval, newelt);
+      note_char_table_change (array);
     }
   else if (RECORDP (array))
     {
@@ -3862,6 +3865,7 @@ syms_of_data (void)
   DEFSYM (Qthread, "thread");
   DEFSYM (Qmutex, "mutex");
   DEFSYM (Qcondition_variable, "condition-variable");
+  DEFSYM (Qregexp_set, "regexp-set");
   DEFSYM (Qfont_spec, "font-spec");
   DEFSYM (Qfont_entity, "font-entity");
   DEFSYM (Qfont_object, "font-object");
@@ -207,6 +207,77 @@ enum window_part
 #else
 #define IF_DEBUG(X)	((void) 0)
 #endif
+
+/* The methods by which a window can be redisplayed, as counted by
+   `redisplay-statistics'.  */
+
+enum redisplay_method
+{
+  /* redisplay_internal redisplayed only the line of point.  */
+  REDISPLAY_CURRENT_LINE,
+  /* Only the cursor had to move, found by redisplay_internal or by
+     try_cursor_movement.  */
+  REDISPLAY_CURSOR_MOVEMENT,
+  /* The window start was forced.  */
+  REDISPLAY_FORCED_START,
+  /* try_window_id reused the unchanged rows.  */
+  REDISPLAY_WINDOW_ID,
+  /* try_window_reusing_current_matrix kept the window start.  */
+  REDISPLAY_REUSE_MATRIX,
+  /* try_window redisplayed from the same window start.  */
+  REDISPLAY_SAME_START,
+  /* try_scrolling scrolled the window.  */
+  REDISPLAY_SCROLLING,
+  /* A new window start was chosen around point.  */
+  REDISPLAY_RECENTER,
+  REDISPLAY_METHODS
+};
+
+/* What `redisplay-statistics' reports about a window, a frame, or
+   all of redisplay.  */
+
+struct redisplay_stats
+{
+  /* How many times each method was used.  */
+  intmax_t methods[REDISPLAY_METHODS];
+
+  /* Number of glyph rows produced by display_line, and how many of
+     them were copied from the glyph row cache.  */
+  intmax_t rows;
+  intmax_t reused_rows;
+
+  /* Number of times a face property was merged into a realized face
+     to find the face of some text, and how many of them found the
+     face in the cache of merged faces.  */
+  intmax_t face_merges;
+  intmax_t reused_face_merges;
+
+  /* Number of glyph codes and glyph metrics that font backends had to
+     ask the font for, because they weren't in the font's caches yet.
+     This is zero for windows and frames.  */
+  intmax_t font_glyph_misses;
+
+  /* Number of times the cache of glyph-strings for automatic
+     composition was looked up, how many of them found the text
+     already shaped, and how many glyph-strings were evicted from it.
+     These are zero for windows and frames.  */
+  intmax_t gstring_lookups;
+  intmax_t reused_gstrings;
+  intmax_t evicted_gstrings;
+
+  /* Time spent in redisplay_window.  */
+  struct timespec window_time;
+
+  /* Number of times `fontification-functions' were run, and the time
+     they took.  */
+  intmax_t fontifications;
+  struct timespec fontification_time;
+
+  /* Number of calls to update_frame, and the time they took.  These
+     are zero for windows.  */
+  intmax_t updates;
+  struct timespec update_time;
+};
 
 /***********************************************************************
 			    Text positions
@@ -1658,6 +1729,14 @@ enum face_underline_type
    faces and text properties/overlays by merging faces and adding
    unspecified attributes from the `default' face.  */
 
+/* The number of bits and words in the sets of named faces that
+   realized faces depend on.  Named faces are mapped to bits by a hash
+   of their names, so a set can contain faces that weren't used, which
+   only makes freeing faces less selective.  */
+
+enum { NAMED_FACE_BITS = 512 };
+enum { NAMED_FACE_WORDS = NAMED_FACE_BITS / BITS_PER_BITS_WORD };
+
 struct face
 {
   /* The Lisp face attributes this face realizes.  All attributes
@@ -1782,6 +1861,23 @@ struct face
      attributes except the font.  */
   struct face *ascii_face;
 
+  /* The named faces whose definitions this face was made from, as a
+     set of bits; see named_face_bit in xfaces.c.  */
+  bits_word named_faces[NAMED_FACE_WORDS];
+
+#ifdef HAVE_WINDOW_SYSTEM
+  /* For an ASCII face, the IDs plus one of the faces that
+     face_for_char chose for non-ASCII characters, in blocks of
+     consecutive characters, and the number of blocks allocated.
+     Zero means not known yet.  See fontset.c.  */
+  int **char_faces;
+  ptrdiff_t char_faces_nblocks;
+
+  /* The fontset state that the IDs in char_faces were chosen in.  */
+  EMACS_UINT char_faces_tick;
+  bool_bf char_faces_symbols : 1;
+#endif
+
 #if defined HAVE_XFT || defined HAVE_FREETYPE
 /* Extra member that a font-driver uses privately.  */
   void *extra;
@@ -1846,6 +1942,33 @@ enum face_id
 /* A cache of realized faces.  Each frame has its own cache because
    Emacs allows different frame-local face definitions.  */
 
+/* An entry of the cache of merged faces of a frame.  It records the
+   realized face that merging the face property PROP into the realized
+   face BASE_FACE_ID for window WINDOW gave, while the buffer-local
+   value of `face-remapping-alist' was REMAPPING.  */
+
+struct merged_face
+{
+  /* A face name, or a copy of a list of face names and keywords.  */
+  Lisp_Object prop;
+  Lisp_Object remapping;
+
+  /* The sequence number of the window.  */
+  EMACS_INT window;
+
+  /* The generation of merged faces the entry belongs to; entries of
+     older generations are unused.  */
+  unsigned generation;
+
+  int base_face_id;
+  int attr_filter;
+  int face_id;
+};
+
+/* Number of entries in the cache of merged faces of a frame.  */
+
+enum { MERGED_FACES_SIZE = 256 };
+
 struct face_cache
 {
   /* Hash table of cached realized faces.  */
@@ -1861,6 +1984,15 @@ struct face_cache
   ptrdiff_t size;
   int used;
 
+  /* Cache of merged faces, or null if it hasn't been used yet.  */
+  struct merged_face *merged_faces;
+
+  /* The union of the named faces the faces in this cache depend on,
+     and the named faces whose definitions changed since the faces
+     were last freed.  */
+  bits_word named_faces[NAMED_FACE_WORDS];
+  bits_word changed_named_faces[NAMED_FACE_WORDS];
+
   /* Flag indicating that attributes of the `menu' face have been
      changed.  */
   bool_bf menu_face_changed_p : 1;
@@ -3354,6 +3486,8 @@ struct glyph_row *row_containing_pos (struct window *, ptrdiff_t,
                                       struct glyph_row *,
                                       struct glyph_row *, int);
 int line_bottom_y (struct it *);
+ptrdiff_t find_display_line_start (struct window *, ptrdiff_t, ptrdiff_t,
+				   ptrdiff_t *);
 int default_line_pixel_height (struct window *);
 bool display_prop_intangible_p (Lisp_Object, Lisp_Object, ptrdiff_t, ptrdiff_t);
 void resize_echo_area_exactly (void);
@@ -3392,6 +3526,12 @@ void move_it_in_display_line (struct it *it,
 int partial_line_height (struct it *it_origin);
 bool in_display_vector_p (struct it *);
 int frame_mode_line_height (struct frame *);
+extern void note_frame_update (struct frame *, struct timespec);
+extern void clear_glyph_row_cache (struct frame *, struct buffer *);
+extern void note_face_merge (struct window *, bool);
+extern void note_font_glyph_miss (void);
+extern void note_gstring_lookup (bool);
+extern void note_gstring_evictions (ptrdiff_t);
 extern bool redisplaying_p;
 extern bool help_echo_showing_p;
 extern Lisp_Object help_echo_string, help_echo_window;
@@ -3583,6 +3723,9 @@ int face_at_string_position (struct window *, Lisp_Object, ptrdiff_t, ptrdiff_t,
 int merge_faces (struct window *, Lisp_Object, int, int);
 int compute_char_face (struct frame *, int, Lisp_Object);
 void free_all_realized_faces (Lisp_Object);
+void free_changed_realized_faces (struct frame *);
+void forget_merged_faces (void);
+void forget_looked_up_named_faces (void);
 extern char unspecified_fg[], unspecified_bg[];
 
 /* Defined in xfns.c.  */
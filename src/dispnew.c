@@ -3149,6 +3149,7 @@ update_frame (struct frame *f, bool force_p, bool inhibit_hairy_id_p)
   /* True means display has been paused because of pending input.  */
   bool paused_p;
   struct window *root_window = XWINDOW (f->root_window);
+  struct timespec start = current_timespec ();
 
   if (redisplay_dont_pause)
     force_p = true;
@@ -3261,6 +3262,7 @@ update_frame (struct frame *f, bool force_p, bool inhibit_hairy_id_p)
   set_window_update_flags (root_window, false);
 
   display_completed = !paused_p;
+  note_frame_update (f, start);
   return paused_p;
 }
 
@@ -1889,7 +1889,9 @@ determines whether case is significant or ignored.  */)
 static unsigned short rbc_quitcounter;
 
 #define XVECREF_YVECREF_EQUAL(ctx, xoff, yoff)  \
-  buffer_chars_equal ((ctx), (xoff), (yoff))
+  ((ctx)->hash_a					\
+   ? buffer_lines_equal ((ctx), (xoff), (yoff))		\
+   : buffer_chars_equal ((ctx), (xoff), (yoff)))
 
 #define OFFSET ptrdiff_t
 
@@ -1907,17 +1909,31 @@ static unsigned short rbc_quitcounter;
      or inserted.  */                           \
   unsigned char *deletions;                     \
   unsigned char *insertions;			\
+  /* Offsets added to the indices of those bits.  */ \
+  ptrdiff_t off_a;				\
+  ptrdiff_t off_b;				\
+  /* When comparing lines, the hash code of each line, and the	\
+     byte position where each line starts; otherwise null.  */	\
+  EMACS_UINT *hash_a;				\
+  EMACS_UINT *hash_b;				\
+  ptrdiff_t *line_byte_a;			\
+  ptrdiff_t *line_byte_b;			\
   struct timespec time_limit;			\
   unsigned int early_abort_tests;
 
-#define NOTE_DELETE(ctx, xoff) set_bit ((ctx)->deletions, (xoff))
-#define NOTE_INSERT(ctx, yoff) set_bit ((ctx)->insertions, (yoff))
+#define NOTE_DELETE(ctx, xoff) set_bit ((ctx)->deletions, (ctx)->off_a + (xoff))
+#define NOTE_INSERT(ctx, yoff) set_bit ((ctx)->insertions, (ctx)->off_b + (yoff))
 #define EARLY_ABORT(ctx) compareseq_early_abort (ctx)
 
 struct context;
 static void set_bit (unsigned char *, OFFSET);
 static bool bit_is_set (const unsigned char *, OFFSET);
 static bool buffer_chars_equal (struct context *, OFFSET, OFFSET);
+static bool buffer_lines_equal (struct context *, OFFSET, OFFSET);
+static bool compare_buffer_chars (struct context *, ptrdiff_t, ptrdiff_t,
+				  ptrdiff_t, ptrdiff_t);
+static bool compare_buffer_lines (struct context *, ptrdiff_t, ptrdiff_t,
+				  struct timespec *);
 static bool compareseq_early_abort (struct context *);
 
 #include "minmax.h"
@@ -1933,9 +1949,11 @@ As far as possible the replacement is non-destructive, i.e. existing
 buffer contents, markers, properties, and overlays in the current
 buffer stay intact.
 
-Because this function can be very slow if there is a large number of
-differences between the two buffers, there are two optional arguments
-mitigating this issue.
+The buffers are first compared a line at a time, and then a character
+at a time only within the runs of lines that differ, so the cost
+depends mostly on how much text changed.  Because this function can
+still be slow if there is a large number of differences between the
+two buffers, there are two optional arguments mitigating this issue.
 
 The MAX-SECS argument, if given, defines a hard limit on the time used
 for comparing the buffers.  If it takes longer than MAX-SECS, the
@@ -1992,16 +2010,7 @@ nil.  */)
     }
 
   ptrdiff_t count = SPECPDL_INDEX ();
-
-  /* FIXME: It is not documented how to initialize the contents of the
-     context structure.  This code cargo-cults from the existing
-     caller in src/analyze.c of GNU Diffutils, which appears to
-     work.  */
-
-  ptrdiff_t diags = size_a + size_b + 3;
-  ptrdiff_t *buffer;
   USE_SAFE_ALLOCA;
-  SAFE_NALLOCA (buffer, 2, diags);
 
   if (NILP (max_costs))
     XSETFASTINT (max_costs, 1000000);
@@ -2023,6 +2032,10 @@ nil.  */)
      code.  */
   ptrdiff_t del_bytes = (size_t) size_a / CHAR_BIT + 1;
   ptrdiff_t ins_bytes = (size_t) size_b / CHAR_BIT + 1;
+  /* FIXME: It is not documented how to initialize the contents of the
+     context structure.  This code cargo-cults from the existing
+     caller in src/analyze.c of GNU Diffutils, which appears to
+     work.  */
   struct context ctx = {
     .buffer_a = a,
     .buffer_b = b,
@@ -2032,8 +2045,6 @@ nil.  */)
     .b_unibyte = BUF_ZV (b) == BUF_ZV_BYTE (b),
     .deletions = SAFE_ALLOCA (del_bytes),
     .insertions = SAFE_ALLOCA (ins_bytes),
-    .fdiag = buffer + size_b + 1,
-    .bdiag = buffer + diags + size_b + 1,
     .heuristic = true,
     .too_expensive = XFIXNUM (max_costs),
     .time_limit = time_limit,
@@ -2042,18 +2053,31 @@ nil.  */)
   memclear (ctx.deletions, del_bytes);
   memclear (ctx.insertions, ins_bytes);
 
-  /* compareseq requires indices to be zero-based.  We add BEGV back
-     later.  */
-  bool early_abort = compareseq (0, size_a, 0, size_b, false, &ctx);
+  /* Compare lines first if their bytes can be compared directly, and
+     characters only where lines differ.  */
+  struct timespec timing[4] = { 0 };
+  bool early_abort;
+  if (NILP (BVAR (a, enable_multibyte_characters))
+      == NILP (BVAR (b, enable_multibyte_characters)))
+    early_abort = compare_buffer_lines (&ctx, size_a, size_b, timing);
+  else
+    {
+      struct timespec start = current_timespec ();
+      early_abort = compare_buffer_chars (&ctx, 0, size_a, 0, size_b);
+      timing[2] = timespec_sub (current_timespec (), start);
+    }
 
   if (early_abort)
     {
       del_range (min_a, ZV);
       Finsert_buffer_substring (source, Qnil,Qnil);
       SAFE_FREE_UNBIND_TO (count, Qnil);
+      Vreplace_buffer_contents_timing = Qnil;
       return Qnil;
     }
 
+  struct timespec edit_start = current_timespec ();
+
   rbc_quitcounter = 0;
 
   Fundo_boundary ();
@@ -2124,9 +2148,228 @@ nil.  */)
       update_compositions (BEGV, ZV, CHECK_INSIDE);
     }
 
+  timing[3] = timespec_sub (current_timespec (), edit_start);
+  Vreplace_buffer_contents_timing
+    = list4 (make_float (timespectod (timing[0])),
+	     make_float (timespectod (timing[1])),
+	     make_float (timespectod (timing[2])),
+	     make_float (timespectod (timing[3])));
+
   return Qt;
 }
 
+/* Compare the characters from XOFF to XLIM of CTX->buffer_a with those
+   from YOFF to YLIM of CTX->buffer_b, all relative to CTX->beg_a and
+   CTX->beg_b.  Record the differences in CTX->deletions and
+   CTX->insertions.  Return true if the comparison was aborted because
+   it took too long.
+
+   The diagonal vectors are sized for just these ranges, so that
+   comparing small runs of a big buffer doesn't need memory in
+   proportion to the whole buffer.  */
+
+static bool
+compare_buffer_chars (struct context *ctx, ptrdiff_t xoff, ptrdiff_t xlim,
+		      ptrdiff_t yoff, ptrdiff_t ylim)
+{
+  ptrdiff_t size_a = xlim - xoff, size_b = ylim - yoff;
+  ptrdiff_t diags = size_a + size_b + 3;
+  ptrdiff_t *buffer;
+  USE_SAFE_ALLOCA;
+  SAFE_NALLOCA (buffer, 2, diags);
+
+  /* compareseq requires indices to be zero-based.  */
+  ptrdiff_t beg_a = ctx->beg_a, beg_b = ctx->beg_b;
+  ctx->beg_a += xoff;
+  ctx->beg_b += yoff;
+  ctx->off_a = xoff;
+  ctx->off_b = yoff;
+  ctx->fdiag = buffer + size_b + 1;
+  ctx->bdiag = buffer + diags + size_b + 1;
+  bool early_abort = compareseq (0, size_a, 0, size_b, false, ctx);
+  ctx->beg_a = beg_a;
+  ctx->beg_b = beg_b;
+  ctx->off_a = ctx->off_b = 0;
+
+  SAFE_FREE ();
+  return early_abort;
+}
+
+/* Count the lines of buffer B from byte position FROM_BYTE to TO_BYTE;
+   a last line without a newline counts too.  If HASHES is non-null,
+   also store the hash code of each line in HASHES, and the character
+   and byte positions where it starts in STARTS and BYTE_STARTS.  The
+   character positions are relative to FROM_BYTE.  Both STARTS and
+   BYTE_STARTS get the end of the last line as an extra element.  */
+
+static ptrdiff_t
+scan_buffer_lines (struct buffer *b, ptrdiff_t from_byte, ptrdiff_t to_byte,
+		   EMACS_UINT *hashes, ptrdiff_t *starts,
+		   ptrdiff_t *byte_starts)
+{
+  bool multibyte = !NILP (BVAR (b, enable_multibyte_characters));
+  ptrdiff_t nlines = 0, pos = 0, pos_byte = from_byte;
+  EMACS_UINT hash = 0;
+
+  while (pos_byte < to_byte)
+    {
+      ptrdiff_t gpt_byte = BUF_GPT_BYTE (b);
+      ptrdiff_t end_byte = (pos_byte < gpt_byte ? min (gpt_byte, to_byte)
+			    : to_byte);
+      unsigned char *p = BUF_BYTE_ADDRESS (b, pos_byte);
+      unsigned char *lim = p + (end_byte - pos_byte);
+
+      if (!hashes)
+	{
+	  unsigned char *nl;
+	  while ((nl = memchr (p, '\n', lim - p)))
+	    {
+	      nlines++;
+	      p = nl + 1;
+	    }
+	}
+      else
+	for (unsigned char *start = p; p < lim; p++)
+	  {
+	    hash = sxhash_combine (hash, *p);
+	    pos += !multibyte || CHAR_HEAD_P (*p);
+	    if (*p == '\n')
+	      {
+		hashes[nlines] = hash;
+		starts[nlines + 1] = pos;
+		byte_starts[nlines + 1] = pos_byte + (p + 1 - start);
+		nlines++;
+		hash = 0;
+	      }
+	  }
+      pos_byte = end_byte;
+      rarely_quit (++rbc_quitcounter);
+    }
+
+  if (from_byte < to_byte && BUF_FETCH_BYTE (b, to_byte - 1) != '\n')
+    {
+      if (hashes)
+	{
+	  hashes[nlines] = hash;
+	  starts[nlines + 1] = pos;
+	  byte_starts[nlines + 1] = to_byte;
+	}
+      nlines++;
+    }
+  if (hashes)
+    {
+      starts[0] = 0;
+      byte_starts[0] = from_byte;
+    }
+  return nlines;
+}
+
+/* Find the next run of differing lines at or after line *I of one
+   buffer and line *J of the other, given the bit vectors DELETIONS
+   and INSERTIONS of lines that differ, and the numbers of lines
+   NLINES_A and NLINES_B.  Set *I0 and *J0 to where the run starts, and
+   *I and *J to where it ends.  Return false if there are no more
+   runs.  */
+
+static bool
+next_changed_lines (unsigned char const *deletions,
+		    unsigned char const *insertions,
+		    ptrdiff_t nlines_a, ptrdiff_t nlines_b,
+		    ptrdiff_t *i0, ptrdiff_t *j0, ptrdiff_t *i, ptrdiff_t *j)
+{
+  ptrdiff_t ii = *i, jj = *j;
+
+  while (ii < nlines_a && jj < nlines_b
+	 && !bit_is_set (deletions, ii) && !bit_is_set (insertions, jj))
+    ii++, jj++;
+  if (ii == nlines_a && jj == nlines_b)
+    return false;
+  *i0 = ii;
+  *j0 = jj;
+  while (ii < nlines_a && bit_is_set (deletions, ii))
+    ii++;
+  while (jj < nlines_b && bit_is_set (insertions, jj))
+    jj++;
+  *i = ii;
+  *j = jj;
+  return true;
+}
+
+/* Compare the accessible portions of CTX->buffer_a and CTX->buffer_b,
+   which are SIZE_A and SIZE_B characters long, first a line at a time
+   and then a character at a time within each run of lines that differ.
+   Record the differences in CTX->deletions and CTX->insertions like
+   compare_buffer_chars does, and return true if the comparison was
+   aborted.  Add the time spent hashing lines, comparing them and
+   comparing characters to the first three elements of TIMING.  */
+
+static bool
+compare_buffer_lines (struct context *ctx, ptrdiff_t size_a,
+		      ptrdiff_t size_b, struct timespec *timing)
+{
+  struct buffer *a = ctx->buffer_a, *b = ctx->buffer_b;
+  struct timespec t0 = current_timespec ();
+  ptrdiff_t beg_byte_a = buf_charpos_to_bytepos (a, ctx->beg_a);
+  ptrdiff_t beg_byte_b = buf_charpos_to_bytepos (b, ctx->beg_b);
+  ptrdiff_t nlines_a = scan_buffer_lines (a, beg_byte_a, BUF_ZV_BYTE (a),
+					  NULL, NULL, NULL);
+  ptrdiff_t nlines_b = scan_buffer_lines (b, beg_byte_b, BUF_ZV_BYTE (b),
+					  NULL, NULL, NULL);
+  ptrdiff_t *line_a, *line_b, *diag;
+  EMACS_UINT *hash_a, *hash_b;
+  unsigned char *line_deletions, *line_insertions;
+  USE_SAFE_ALLOCA;
+
+  SAFE_NALLOCA (line_a, 2, nlines_a + 1);
+  SAFE_NALLOCA (line_b, 2, nlines_b + 1);
+  SAFE_NALLOCA (hash_a, 1, nlines_a);
+  SAFE_NALLOCA (hash_b, 1, nlines_b);
+  ctx->line_byte_a = line_a + nlines_a + 1;
+  ctx->line_byte_b = line_b + nlines_b + 1;
+  scan_buffer_lines (a, beg_byte_a, BUF_ZV_BYTE (a),
+		     hash_a, line_a, ctx->line_byte_a);
+  scan_buffer_lines (b, beg_byte_b, BUF_ZV_BYTE (b),
+		     hash_b, line_b, ctx->line_byte_b);
+  struct timespec t1 = current_timespec ();
+  timing[0] = timespec_add (timing[0], timespec_sub (t1, t0));
+
+  /* Compare the lines, recording the differences in separate bit
+     vectors.  */
+  ptrdiff_t del_bytes = (size_t) nlines_a / CHAR_BIT + 1;
+  ptrdiff_t ins_bytes = (size_t) nlines_b / CHAR_BIT + 1;
+  ptrdiff_t diags = nlines_a + nlines_b + 3;
+  unsigned char *deletions = ctx->deletions, *insertions = ctx->insertions;
+  line_deletions = SAFE_ALLOCA (del_bytes);
+  line_insertions = SAFE_ALLOCA (ins_bytes);
+  memclear (line_deletions, del_bytes);
+  memclear (line_insertions, ins_bytes);
+  SAFE_NALLOCA (diag, 2, diags);
+  ctx->hash_a = hash_a;
+  ctx->hash_b = hash_b;
+  ctx->deletions = line_deletions;
+  ctx->insertions = line_insertions;
+  ctx->fdiag = diag + nlines_b + 1;
+  ctx->bdiag = diag + diags + nlines_b + 1;
+  bool early_abort = compareseq (0, nlines_a, 0, nlines_b, false, ctx);
+  ctx->hash_a = ctx->hash_b = NULL;
+  ctx->deletions = deletions;
+  ctx->insertions = insertions;
+  struct timespec t2 = current_timespec ();
+  timing[1] = timespec_add (timing[1], timespec_sub (t2, t1));
+
+  /* Compare the characters within each run of differing lines.  */
+  ptrdiff_t i = 0, j = 0, i0, j0;
+  while (!early_abort
+	 && next_changed_lines (line_deletions, line_insertions,
+				nlines_a, nlines_b, &i0, &j0, &i, &j))
+    early_abort = compare_buffer_chars (ctx, line_a[i0], line_a[i],
+					line_b[j0], line_b[j]);
+  timing[2] = timespec_add (timing[2], timespec_sub (current_timespec (), t2));
+
+  SAFE_FREE ();
+  return early_abort;
+}
+
 static void
 set_bit (unsigned char *a, ptrdiff_t i)
 {
@@ -2191,6 +2434,32 @@ buffer_chars_equal (struct context *ctx,
     == BUF_FETCH_MULTIBYTE_CHAR (ctx->buffer_b, bpos_b);
 }
 
+/* Return true if line POS_A of buffer CTX->buffer_a and line POS_B of
+   buffer CTX->buffer_b are equal.  This is called only when both
+   buffers are multibyte or both unibyte, so comparing bytes is
+   enough.  */
+
+static bool
+buffer_lines_equal (struct context *ctx,
+		    ptrdiff_t pos_a, ptrdiff_t pos_b)
+{
+  if (ctx->hash_a[pos_a] != ctx->hash_b[pos_b])
+    return false;
+
+  ptrdiff_t beg_a = ctx->line_byte_a[pos_a];
+  ptrdiff_t beg_b = ctx->line_byte_b[pos_b];
+  ptrdiff_t nbytes = ctx->line_byte_a[pos_a + 1] - beg_a;
+  if (ctx->line_byte_b[pos_b + 1] - beg_b != nbytes)
+    return false;
+
+  rarely_quit (++rbc_quitcounter);
+  for (ptrdiff_t k = 0; k < nbytes; k++)
+    if (BUF_FETCH_BYTE (ctx->buffer_a, beg_a + k)
+	!= BUF_FETCH_BYTE (ctx->buffer_b, beg_b + k))
+      return false;
+  return true;
+}
+
 static bool
 compareseq_early_abort (struct context *ctx)
 {
@@ -2283,7 +2552,7 @@ Both characters must have the same length of multi-byte form.  */)
   if (!changed && !NILP (noundo))
     {
       record_unwind_protect (subst_char_in_region_unwind,
-			     BVAR (current_buffer, undo_list));
+			     buffer_undo_list (current_buffer));
       bset_undo_list (current_buffer, Qt);
       /* Don't do file-locking.  */
       record_unwind_protect (subst_char_in_region_unwind_1,
@@ -2350,7 +2619,7 @@ Both characters must have the same length of multi-byte form.  */)
 	    {
 	      Lisp_Object tem, string;
 
-	      tem = BVAR (current_buffer, undo_list);
+	      tem = buffer_undo_list (current_buffer);
 
 	      /* Make a multibyte string containing this single character.  */
 	      string = make_multibyte_string ((char *) tostr, 1, len);
@@ -4490,6 +4759,18 @@ This variable is experimental; email 32252@debbugs.gnu.org if you need
 it to be non-nil.  */);
   binary_as_unsigned = false;
 
+  DEFVAR_LISP ("replace-buffer-contents-timing",
+	       Vreplace_buffer_contents_timing,
+	       doc: /* How long the last `replace-buffer-contents' took, by stage.
+The value is a list (HASH LINES CHARS EDIT) of times in seconds, spent
+hashing the lines of both buffers, comparing the lines, comparing the
+characters within lines that differ, and changing the buffer.  HASH and
+LINES are 0 if the buffers were compared a character at a time, which
+happens when one is multibyte and the other is not.  The value is nil
+if the comparison took too long and the buffer text was replaced as a
+whole.  */);
+  Vreplace_buffer_contents_timing = Qnil;
+
   defsubr (&Spropertize);
   defsubr (&Schar_equal);
   defsubr (&Sgoto_char);
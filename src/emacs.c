@@ -2364,6 +2364,9 @@ all of which are called before Emacs is actually killed.  */
   else
     run_hook (Qkill_emacs_hook);
 
+  /* Let writes that were started in the background finish.  */
+  finish_write_jobs (Qnil, true);
+
 #ifdef HAVE_X_WINDOWS
   /* Transfer any clipboards we own to the clipboard manager.  */
   x_clipboard_manager_save_all ();
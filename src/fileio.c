@@ -109,6 +109,16 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 
 #include "commands.h"
 
+/* Whether write-region can hand the writing off to a separate thread.
+   This needs POSIX threads, and a pipe to report back through.  */
+#ifdef HAVE_PTHREAD
+# define WRITE_REGION_ASYNC
+# include <pthread.h>
+# include <signal.h>
+# include <ignore-value.h>
+# include "process.h"
+#endif
+
 /* True during writing of auto-save files.  */
 static bool auto_saving;
 
@@ -2057,6 +2067,11 @@ permissions.  */)
 		  ok_if_already_exists, keep_time, preserve_uid_gid,
 		  preserve_permissions);
 
+  /* Don't copy a file that is still being written in the background,
+     nor over one.  */
+  finish_write_jobs (file, true);
+  finish_write_jobs (newname, true);
+
   encoded_file = ENCODE_FILE (file);
   encoded_newname = ENCODE_FILE (newname);
 
@@ -2509,6 +2524,12 @@ This is what happens in interactive use with M-x.  */)
     return call4 (handler, Qrename_file,
 		  file, newname, ok_if_already_exists);
 
+  /* Don't give a file that is still being written in the background
+     another name, as saving with 'file-precious-flag' does, before
+     it is complete.  */
+  finish_write_jobs (file, true);
+  finish_write_jobs (newname, true);
+
   encoded_file = ENCODE_FILE (file);
   encoded_newname = ENCODE_FILE (newname);
 
@@ -3382,6 +3403,8 @@ symbolic notation, like the `chmod' command from GNU Coreutils.  */)
   if (!NILP (handler))
     return call4 (handler, Qset_file_modes, absname, mode, flag);
 
+  finish_write_jobs (absname, true);
+
   char *fname = SSDATA (ENCODE_FILE (absname));
   mode_t imode = XFIXNUM (mode) & 07777;
   if (fchmodat (AT_FDCWD, fname, imode, nofollow) != 0)
@@ -3767,10 +3790,13 @@ by calling `format-decode', which see.  */)
   bool set_coding_system = false;
   Lisp_Object coding_system;
   bool read_quit = false;
+  struct coding_prescan prescan = { 0 };
+  ptrdiff_t read_bytes = 0;
+  struct timespec read_start = invalid_timespec (), decode_start;
   /* If the undo log only contains the insertion, there's no point
      keeping it.  It's typically when we first fill a file-buffer.  */
   bool empty_undo_list_p
-    = (!NILP (visit) && NILP (BVAR (current_buffer, undo_list))
+    = (!NILP (visit) && NILP (buffer_undo_list (current_buffer))
        && BEG == Z);
   Lisp_Object old_Vdeactivate_mark = Vdeactivate_mark;
   bool we_locked_file = false;
@@ -3815,6 +3841,9 @@ by calling `format-decode', which see.  */)
       goto handled;
     }
 
+  /* Don't read a file that is still being written in the background.  */
+  finish_write_jobs (filename, true);
+
   orig_filename = filename;
   filename = ENCODE_FILE (filename);
 
@@ -4444,7 +4473,17 @@ by calling `format-decode', which see.  */)
   inserted = 0;
 
   /* Here, we don't do code conversion in the loop.  It is done by
-     decode_coding_gap after all data are read into the buffer.  */
+     decode_coding_gap after all data are read into the buffer.  But
+     while each block is still in the cache, prescan it for what
+     detect_coding would otherwise look for a byte at a time.
+
+     Decoding each block as it is read would need the coding system
+     and its end-of-line format to be settled before the rest of the
+     text is seen, whereas detection may change its mind about both
+     on the last block.  Nor would it save memory: decode_coding_gap
+     decodes the text from the end of the gap into its start, in
+     place for valid UTF-8, so the file is not held twice.  */
+  read_start = current_timespec ();
   {
     ptrdiff_t gap_size = GAP_SIZE;
 
@@ -4508,8 +4547,11 @@ by calling `format-decode', which see.  */)
 	if (! not_regular)
 	  how_much += this;
 	inserted += this;
+	prescan_coding (&prescan, GPT_ADDR, inserted);
       }
   }
+  read_bytes = inserted;
+  decode_start = current_timespec ();
 
   /* Now we have either read all the file data into the gap,
      or stop reading on I/O error or quit.  If nothing was
@@ -4554,7 +4596,7 @@ by calling `format-decode', which see.  */)
             = BVAR (current_buffer, enable_multibyte_characters);
           Lisp_Object unwind_data
             = Fcons (multibyte,
-                     Fcons (BVAR (current_buffer, undo_list),
+                     Fcons (buffer_undo_list (current_buffer),
 			    Fcurrent_buffer ()));
 	  ptrdiff_t count1 = SPECPDL_INDEX ();
 
@@ -4628,6 +4670,8 @@ by calling `format-decode', which see.  */)
          but `decode_coding_gap` can't have them at the beginning of the gap,
          so we need to move them.  */
       memmove (GAP_END_ADDR - inserted, GPT_ADDR, inserted);
+      if (prescan.bytes <= inserted)
+	coding.prescan = prescan;
       decode_coding_gap (&coding, inserted);
       inserted = coding.produced_char;
       coding_system = CODING_ID_NAME (coding.id);
@@ -4643,6 +4687,16 @@ by calling `format-decode', which see.  */)
 			   inserted);
     }
 
+  if (timespec_valid_p (read_start))
+    {
+      struct timespec now = current_timespec ();
+      Vinsert_file_contents_timing
+	= list3 (make_int (read_bytes),
+		 make_float (timespectod (timespec_sub (decode_start,
+							read_start))),
+		 make_float (timespectod (timespec_sub (now, decode_start))));
+    }
+
   /* Call after-change hooks for the inserted text, aside from the case
      of normal visiting (not with REPLACE), which is done in a new buffer
      "before" the buffer is changed.  */
@@ -4713,7 +4767,7 @@ by calling `format-decode', which see.  */)
       specbind (Qinhibit_modification_hooks, Qt);
 
       /* Save old undo list and don't record undo for decoding.  */
-      old_undo = BVAR (current_buffer, undo_list);
+      old_undo = buffer_undo_list (current_buffer);
       bset_undo_list (current_buffer, Qt);
 
       if (NILP (replace))
@@ -4975,6 +5029,322 @@ choose_write_coding_system (Lisp_Object start, Lisp_Object end, Lisp_Object file
   return val;
 }
 
+#ifdef WRITE_REGION_ASYNC
+
+/* A write started by write_region and finished by a separate thread.
+   The main thread opens FD and encodes the text into DATA, then the
+   worker writes DATA, calls fsync and closes FD.  The results are
+   picked up by finish_write_jobs, back in the main thread.  */
+
+struct write_job
+{
+  struct write_job *next;
+
+  /* (BUFFER . FILENAME), where BUFFER is the buffer that visits the
+     file, or nil.  This is also on write_job_objects, for GC.  */
+  Lisp_Object objects;
+
+  int fd;
+  bool fsync_p;
+  char *data;
+  ptrdiff_t size, alloc;
+
+  /* The buffer's SAVE_MODIFF before the write, and the one the write
+     set it to.  */
+  modiff_count old_save_modiff, save_modiff;
+
+  /* Set by the worker when it is done, with write_job_mutex held.  */
+  bool done;
+  int err;
+  struct timespec modtime;
+  off_t st_size;
+};
+
+/* Jobs that have not been finished yet, most recent first.  */
+static struct write_job *write_jobs;
+static Lisp_Object write_job_objects;
+
+static pthread_mutex_t write_job_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t write_job_cond = PTHREAD_COND_INITIALIZER;
+
+/* The workers write a byte here when they are done, so that the
+   command loop calls finish_write_jobs.  */
+static int write_job_pipe[2] = { -1, -1 };
+
+/* While non-null, e_write appends the encoded text to this job
+   instead of writing it.  */
+static struct write_job *write_job_snapshot;
+
+static void
+write_job_notify (int fd, void *data)
+{
+  char buf[64];
+
+  while (0 < emacs_read (fd, buf, sizeof buf))
+    continue;
+  finish_write_jobs (Qnil, false);
+}
+
+/* Set up what write jobs need.  Return true if successful.  */
+
+static bool
+init_write_jobs (void)
+{
+  if (0 <= write_job_pipe[0])
+    return true;
+  if (emacs_pipe (write_job_pipe) != 0)
+    return false;
+  fcntl (write_job_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl (write_job_pipe[1], F_SETFL, O_NONBLOCK);
+  add_read_fd (write_job_pipe[0], write_job_notify, NULL);
+  return true;
+}
+
+/* Return true if write_region should write BYTES bytes in the
+   background.  */
+
+static bool
+write_region_async_p (ptrdiff_t bytes)
+{
+  return ((EQ (Vwrite_region_async, Qt)
+	   || (FIXNATP (Vwrite_region_async)
+	       && XFIXNAT (Vwrite_region_async) <= bytes))
+	  && init_write_jobs ());
+}
+
+/* Append NBYTES bytes at BUF to the text of the current job.  */
+
+static void
+write_job_append (char const *buf, ptrdiff_t nbytes)
+{
+  struct write_job *job = write_job_snapshot;
+
+  if (job->alloc - job->size < nbytes)
+    job->data = xpalloc (job->data, &job->alloc,
+			 nbytes - (job->alloc - job->size), -1, 1);
+  memcpy (job->data + job->size, buf, nbytes);
+  job->size += nbytes;
+}
+
+/* Write, sync and close the file of JOB.  This runs in the worker
+   thread, so it must not use any Lisp.  */
+
+static void
+write_job_run (struct write_job *job)
+{
+  int err = 0;
+  struct stat st;
+  struct timespec modtime = invalid_timespec ();
+  off_t st_size = 0;
+
+  if (emacs_write (job->fd, job->data, job->size) != job->size)
+    err = errno;
+
+  /* As in write_region, ignore EINVAL, which means fsync is not
+     supported on this file.  */
+  if (!err && job->fsync_p)
+    while (fsync (job->fd) != 0)
+      if (errno != EINTR)
+	{
+	  if (errno != EINVAL)
+	    err = errno;
+	  break;
+	}
+
+  if (fstat (job->fd, &st) == 0)
+    {
+      modtime = get_stat_mtime (&st);
+      st_size = st.st_size;
+    }
+  else if (!err)
+    err = errno;
+
+  /* NFS can report a write failure now.  */
+  if (emacs_close (job->fd) < 0 && !err)
+    err = errno;
+
+  pthread_mutex_lock (&write_job_mutex);
+  job->err = err;
+  job->modtime = modtime;
+  job->st_size = st_size;
+  job->done = true;
+  pthread_cond_broadcast (&write_job_cond);
+  pthread_mutex_unlock (&write_job_mutex);
+
+  /* If the pipe is full, the main thread has a wakeup pending anyway.  */
+  ignore_value (write (write_job_pipe[1], "", 1));
+}
+
+static void *
+write_job_thread (void *arg)
+{
+  sigset_t blocked;
+
+  /* Leave all signals to the main thread.  */
+  sigfillset (&blocked);
+  pthread_sigmask (SIG_BLOCK, &blocked, NULL);
+  write_job_run (arg);
+  return NULL;
+}
+
+/* Hand JOB, whose text is complete, over to a worker thread.  If no
+   thread can be created, do the work here; it is still finished
+   later, like any other job.  */
+
+static void
+start_write_job (struct write_job *job)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  bool started = false;
+
+  write_job_objects = Fcons (job->objects, write_job_objects);
+  job->next = write_jobs;
+  write_jobs = job;
+  if (pthread_attr_init (&attr) == 0)
+    {
+      started = (pthread_attr_setdetachstate (&attr,
+					      PTHREAD_CREATE_DETACHED) == 0
+		 && pthread_create (&thread, &attr, write_job_thread,
+				    job) == 0);
+      pthread_attr_destroy (&attr);
+    }
+  if (!started)
+    write_job_run (job);
+}
+
+static void
+discard_write_job (void *arg)
+{
+  struct write_job *job = arg;
+
+  write_job_snapshot = NULL;
+  xfree (job->data);
+  xfree (job);
+}
+
+/* Do the bookkeeping for JOB, which is done, and free it.  */
+
+static void
+finish_write_job (struct write_job *job)
+{
+  Lisp_Object buffer = XCAR (job->objects);
+  Lisp_Object filename = XCDR (job->objects);
+
+  write_job_objects = Fdelq (job->objects, write_job_objects);
+
+  /* Unless the buffer has been saved again since, record the new
+     modtime, or after a failure, mark the buffer modified again.  */
+  if (BUFFERP (buffer) && BUFFER_LIVE_P (XBUFFER (buffer))
+      && BUF_SAVE_MODIFF (XBUFFER (buffer)) == job->save_modiff)
+    {
+      struct buffer *b = XBUFFER (buffer);
+
+      if (job->err)
+	{
+	  BUF_SAVE_MODIFF (b) = job->old_save_modiff;
+	  bset_update_mode_line (b);
+	  update_mode_lines = 47;
+	}
+      else if (timespec_valid_p (job->modtime))
+	{
+	  b->modtime = job->modtime;
+	  b->modtime_size = job->st_size;
+	}
+    }
+
+  /* This can run inside a wait for process output, so leave
+     everything that can run Lisp code, even decoding the error
+     message, to the command loop.  */
+  if (job->err || !NILP (Vwrite_region_async_functions))
+    pending_funcalls
+      = Fcons (list3 (Qinternal__write_region_async_finished,
+		      filename, make_fixnum (job->err)),
+	       pending_funcalls);
+
+  xfree (job->data);
+  xfree (job);
+}
+
+#endif /* WRITE_REGION_ASYNC */
+
+/* Finish the background writes of FILENAME that are done, or of all
+   files if FILENAME is nil.  If WAIT, first wait for them to be
+   done.  */
+
+void
+finish_write_jobs (Lisp_Object filename, bool wait)
+{
+#ifdef WRITE_REGION_ASYNC
+  struct write_job **p = &write_jobs;
+
+  while (*p)
+    {
+      struct write_job *job = *p;
+      bool done;
+
+      if (!NILP (filename)
+	  && NILP (Fstring_equal (filename, XCDR (job->objects))))
+	{
+	  p = &job->next;
+	  continue;
+	}
+
+      pthread_mutex_lock (&write_job_mutex);
+      while (wait && !job->done)
+	pthread_cond_wait (&write_job_cond, &write_job_mutex);
+      done = job->done;
+      pthread_mutex_unlock (&write_job_mutex);
+
+      if (done)
+	{
+	  *p = job->next;
+	  finish_write_job (job);
+	}
+      else
+	p = &job->next;
+    }
+#endif
+}
+
+DEFUN ("internal--write-region-async-finished",
+       Finternal__write_region_async_finished,
+       Sinternal__write_region_async_finished, 2, 2, 0,
+       doc: /* Report that the background write of FILENAME is finished.
+ERRNO is 0 if the write succeeded, or the system error number if it
+failed.  Display a warning if it failed, and run
+`write-region-async-functions'.  For internal use only.  */)
+  (Lisp_Object filename, Lisp_Object errno_value)
+{
+  Lisp_Object error = Qnil;
+
+  CHECK_FIXNUM (errno_value);
+  if (XFIXNUM (errno_value))
+    {
+      error = get_file_errno_data ("Write error", filename,
+				   XFIXNUM (errno_value));
+      call3 (intern ("display-warning"), Qwrite_region,
+	     Ferror_message_string (error), QCerror);
+    }
+  if (!NILP (Vwrite_region_async_functions))
+    CALLN (Frun_hook_with_args, Qwrite_region_async_functions,
+	   filename, error);
+  return Qnil;
+}
+
+DEFUN ("write-region-async-wait", Fwrite_region_async_wait,
+       Swrite_region_async_wait, 0, 1, 0,
+       doc: /* Wait until the background writes of FILENAME are finished.
+If FILENAME is nil, wait for all background writes.
+See `write-region-async'.  Return nil.  */)
+  (Lisp_Object filename)
+{
+  if (!NILP (filename))
+    filename = Fexpand_file_name (filename, Qnil);
+  finish_write_jobs (filename, true);
+  return Qnil;
+}
+
 DEFUN ("write-region", Fwrite_region, Swrite_region, 3, 7,
        "r\nFWrite region to file: \ni\ni\ni\np",
        doc: /* Write current region into specified file.
@@ -5049,6 +5419,9 @@ write_region (Lisp_Object start, Lisp_Object end, Lisp_Object filename,
   bool file_locked = 0;
   struct buffer *given_buffer;
   struct coding_system coding;
+#ifdef WRITE_REGION_ASYNC
+  struct write_job *job = NULL;
+#endif
 
   if (current_buffer->base_buffer && visiting)
     error ("Cannot do file visiting in an indirect buffer");
@@ -5146,6 +5519,10 @@ write_region (Lisp_Object start, Lisp_Object end, Lisp_Object filename,
       file_locked = 1;
     }
 
+  /* Don't let an earlier write of this file in the background finish
+     after this one.  */
+  finish_write_jobs (filename, true);
+
   encoded_filename = ENCODE_FILE (filename);
   fn = SSDATA (encoded_filename);
   open_flags = O_WRONLY | O_CREAT;
@@ -5173,6 +5550,21 @@ write_region (Lisp_Object start, Lisp_Object end, Lisp_Object filename,
 
       count1 = SPECPDL_INDEX ();
       record_unwind_protect_int (close_file_unwind, desc);
+
+#ifdef WRITE_REGION_ASYNC
+      if (!auto_saving && NILP (append)
+	  && write_region_async_p (STRINGP (start)
+				   ? SBYTES (start)
+				   : (CHAR_TO_BYTE (XFIXNUM (end))
+				      - CHAR_TO_BYTE (XFIXNUM (start)))))
+	{
+	  /* Collect the encoded text, to be written by a worker.  */
+	  job = xzalloc (sizeof *job);
+	  job->fd = desc;
+	  record_unwind_protect_ptr (discard_write_job, job);
+	  write_job_snapshot = job;
+	}
+#endif
     }
 
   if (NUMBERP (append))
@@ -5209,6 +5601,38 @@ write_region (Lisp_Object start, Lisp_Object end, Lisp_Object filename,
       save_errno = errno;
     }
 
+#ifdef WRITE_REGION_ASYNC
+  if (job)
+    {
+      /* The text is all encoded, so later changes to the buffer don't
+	 matter.  From here on, the job owns DESC and the text, and the
+	 code below must neither sync nor close DESC.  */
+      write_job_snapshot = NULL;
+      if (ok)
+	{
+	  specpdl_ptr = specpdl + count1;
+	  job->fsync_p = !write_region_inhibit_fsync;
+	  job->objects = Fcons (visiting ? Fcurrent_buffer () : Qnil,
+				filename);
+	  if (visiting)
+	    {
+	      job->old_save_modiff = SAVE_MODIFF;
+	      job->save_modiff = MODIFF;
+	    }
+	  start_write_job (job);
+	  open_and_close_file = false;
+	  desc = -1;
+	}
+      else
+	{
+	  /* Drop the job, and let the code below close DESC and report
+	     the error.  */
+	  unbind_to (count1 + 1, Qnil);
+	  job = NULL;
+	}
+    }
+#endif
+
   /* fsync is not crucial for temporary files.  Nor for auto-save
      files, since they might lose some work anyway.  */
   if (open_and_close_file && !auto_saving && !write_region_inhibit_fsync)
@@ -5227,7 +5651,7 @@ write_region (Lisp_Object start, Lisp_Object end, Lisp_Object filename,
     }
 
   modtime = invalid_timespec ();
-  if (visiting)
+  if (visiting && 0 <= desc)
     {
       if (fstat (desc, &st) == 0)
 	modtime = get_stat_mtime (&st);
@@ -5329,6 +5753,11 @@ write_region (Lisp_Object start, Lisp_Object end, Lisp_Object filename,
       current_buffer->modtime = modtime;
       current_buffer->modtime_size = st.st_size;
     }
+#ifdef WRITE_REGION_ASYNC
+  else if (job && visiting)
+    /* The modtime is not known until the job is finished.  */
+    current_buffer->modtime = make_timespec (0, UNKNOWN_MODTIME_NSECS);
+#endif
 
   if (! ok)
     report_file_errno ("Write error", filename, save_errno);
@@ -5598,7 +6027,15 @@ e_write (int desc, Lisp_Object string, ptrdiff_t start, ptrdiff_t end,
 		       : (STRINGP (coding->dst_object)
 			  ? SSDATA (coding->dst_object)
 			  : (char *) BYTE_POS_ADDR (coding->dst_pos_byte)));
-	  coding->produced -= emacs_write_quit (desc, buf, coding->produced);
+#ifdef WRITE_REGION_ASYNC
+	  if (write_job_snapshot)
+	    {
+	      write_job_append (buf, coding->produced);
+	      coding->produced = 0;
+	    }
+	  else
+#endif
+	    coding->produced -= emacs_write_quit (desc, buf, coding->produced);
 
 	  if (coding->raw_destination)
 	    {
@@ -6422,6 +6859,49 @@ Setting this to nil may avoid data loss if the system loses power or
 the operating system crashes.  By default, it is non-nil in batch mode.  */);
   write_region_inhibit_fsync = 0; /* See also `init_fileio' above.  */
 
+  DEFVAR_LISP ("write-region-async", Vwrite_region_async,
+	       doc: /* Whether `write-region' may finish writing files in the background.
+If nil, `write-region' writes the whole text before it returns.
+If t, it only encodes the text and opens the file, and a separate thread
+writes the encoded text, calls fsync and closes the file.  If an integer,
+do that only when the text is at least that many bytes long.
+
+This applies to save commands too, but never to appending, auto-saving
+or files with a file name handler.  A buffer that visits the file counts
+as unmodified right away; its visited file modtime is recorded when the
+write is done, and if the write fails, the buffer is marked modified
+again and a warning is displayed.  Functions that read the file right
+after writing it, like some in `after-save-hook', should call
+`write-region-async-wait' first; `insert-file-contents',
+`write-region', `rename-file', `copy-file' and `set-file-modes' do
+that for themselves.  */);
+  Vwrite_region_async = Qnil;
+
+  DEFVAR_LISP ("write-region-async-functions", Vwrite_region_async_functions,
+	       doc: /* Functions to call when a background write is finished.
+Each function is called with two arguments: the name of the file, and
+nil if the write succeeded or an error object describing why it failed.
+See `write-region-async'.  */);
+  Vwrite_region_async_functions = Qnil;
+  DEFSYM (Qwrite_region_async_functions, "write-region-async-functions");
+  DEFSYM (Qinternal__write_region_async_finished,
+	  "internal--write-region-async-finished");
+  DEFSYM (QCerror, ":error");
+#ifdef WRITE_REGION_ASYNC
+  write_job_objects = Qnil;
+  staticpro (&write_job_objects);
+#endif
+
+  DEFVAR_LISP ("insert-file-contents-timing", Vinsert_file_contents_timing,
+	       doc: /* How long the last `insert-file-contents' took, by stage.
+The value is a list (BYTES READ-TIME DECODE-TIME), where BYTES is the
+number of bytes read from the file, READ-TIME is the time in seconds
+spent reading them, and DECODE-TIME is the time in seconds spent
+detecting their encoding and decoding them.  It is nil if no file has
+been read yet, and is not updated by file name handlers or by calls
+with a non-nil REPLACE argument that could reuse part of the buffer.  */);
+  Vinsert_file_contents_timing = Qnil;
+
   DEFVAR_BOOL ("delete-by-moving-to-trash", delete_by_moving_to_trash,
                doc: /* Specifies whether to use the system's trash can.
 When non-nil, certain file deletion commands use the function
@@ -6488,6 +6968,8 @@ This includes interactive calls to `delete-file' and
   defsubr (&Sfile_newer_than_file_p);
   defsubr (&Sinsert_file_contents);
   defsubr (&Swrite_region);
+  defsubr (&Sinternal__write_region_async_finished);
+  defsubr (&Swrite_region_async_wait);
   defsubr (&Scar_less_than_car);
   defsubr (&Sverify_visited_file_modtime);
   defsubr (&Svisited_file_modtime);
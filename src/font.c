@@ -4403,13 +4403,17 @@ clear_font_cache (struct frame *f)
 }
 
 DEFUN ("clear-font-cache", Fclear_font_cache, Sclear_font_cache, 0, 0, 0,
-       doc: /* Clear font cache of each frame.  */)
+       doc: /* Clear font cache of each frame.
+This also forgets the results read from `font-cache-file', if any.  */)
   (void)
 {
   Lisp_Object list, frame;
 
   FOR_EACH_FRAME (list, frame)
     clear_font_cache (XFRAME (frame));
+#ifdef HAVE_FREETYPE
+  ftfont_forget_file_cache ();
+#endif
 
   return Qnil;
 }
@@ -927,6 +927,7 @@ extern Lisp_Object ftfont_shape (Lisp_Object, Lisp_Object);
 extern unsigned ftfont_encode_char (struct font *, int);
 extern void ftfont_close (struct font *);
 extern void ftfont_filter_properties (Lisp_Object, Lisp_Object);
+extern void ftfont_forget_file_cache (void);
 extern void ftfont_text_extents (struct font *, const unsigned *, int,
 				 struct font_metrics *);
 #ifdef HAVE_HARFBUZZ
@@ -881,6 +881,67 @@ fontset_ascii (int id)
   return elt;
 }
 
+/* Number of characters in a block of the cache of faces for
+   characters of an ASCII face; see face_char_face_slot.  */
+
+#define CHAR_FACES_PER_BLOCK 256
+
+/* Incremented whenever realized fontsets may have to choose other
+   fonts than before.  */
+
+static EMACS_UINT fontset_tick;
+
+/* Free the cache of faces for characters of ASCII face FACE.  */
+
+static void
+free_face_char_faces (struct face *face)
+{
+  for (ptrdiff_t i = 0; i < face->char_faces_nblocks; i++)
+    xfree (face->char_faces[i]);
+  xfree (face->char_faces);
+  face->char_faces = NULL;
+  face->char_faces_nblocks = 0;
+}
+
+/* Return a pointer to the slot for character C in the cache of faces
+   for characters of ASCII face FACE, or NULL if C is not cached.  A
+   slot holds the ID plus one of the face to use for C, or zero if
+   that is not known yet.  Empty the cache first if the fontset or
+   charset settings changed since it was filled.  */
+
+static int *
+face_char_face_slot (struct face *face, int c)
+{
+  EMACS_UINT tick = charset_ordered_list_tick + fontset_tick;
+
+  if (c > MAX_UNICODE_CHAR)
+    return NULL;
+  if (face->char_faces_tick != tick
+      || face->char_faces_symbols != use_default_font_for_symbols)
+    {
+      free_face_char_faces (face);
+      face->char_faces_tick = tick;
+      face->char_faces_symbols = use_default_font_for_symbols;
+    }
+
+  int block = c / CHAR_FACES_PER_BLOCK;
+  if (block >= face->char_faces_nblocks)
+    {
+      ptrdiff_t nblocks = face->char_faces_nblocks;
+      face->char_faces = xpalloc (face->char_faces,
+				  &face->char_faces_nblocks,
+				  block + 1 - nblocks, -1,
+				  sizeof *face->char_faces);
+      memset (face->char_faces + nblocks, 0,
+	      ((face->char_faces_nblocks - nblocks)
+	       * sizeof *face->char_faces));
+    }
+  if (! face->char_faces[block])
+    face->char_faces[block]
+      = xzalloc (CHAR_FACES_PER_BLOCK * sizeof **face->char_faces);
+  return &face->char_faces[block][c % CHAR_FACES_PER_BLOCK];
+}
+
 /* Free fontset of FACE defined on frame F.  Called from
    free_realized_face.  */
 
@@ -889,6 +950,7 @@ free_face_fontset (struct frame *f, struct face *face)
 {
   Lisp_Object fontset;
 
+  free_face_char_faces (face);
   fontset = FONTSET_FROM_ID (face->fontset);
   if (NILP (fontset))
     return;
@@ -913,7 +975,12 @@ free_face_fontset (struct frame *f, struct face *face)
 
 /* Return ID of face suitable for displaying character C at buffer position
    POS on frame F.  FACE must be realized for ASCII characters in advance.
-   Called from the macro FACE_FOR_CHAR.  */
+   Called from the macro FACE_FOR_CHAR.
+
+   Unless a `charset' property at POS asks for a particular charset,
+   remember the face chosen for C, or the face without a font if no
+   font has C, in the ASCII face of FACE, which all faces that share
+   its fontset have in common.  */
 
 int
 face_for_char (struct frame *f, struct face *face, int c,
@@ -922,12 +989,43 @@ face_for_char (struct frame *f, struct face *face, int c,
   Lisp_Object fontset, rfont_def, charset;
   int face_id;
   int id;
+  int *slot;
 
   eassert (fontset_id_valid_p (face->fontset));
 
   if (ASCII_CHAR_P (c) || CHAR_BYTE8_P (c))
     return face->ascii_face->id;
 
+  if (pos < 0)
+    {
+      id = -1;
+      charset = Qnil;
+    }
+  else
+    {
+      charset = Fget_char_property (make_fixnum (pos), Qcharset, object);
+      if (CHARSETP (charset))
+	{
+	  Lisp_Object val;
+
+	  val = assq_no_quit (charset, Vfont_encoding_charset_alist);
+	  if (CONSP (val) && CHARSETP (XCDR (val)))
+	    charset = XCDR (val);
+	  id = XFIXNUM (CHARSET_SYMBOL_ID (charset));
+	}
+      else
+	id = -1;
+    }
+
+  slot = id < 0 ? face_char_face_slot (face->ascii_face, c) : NULL;
+  if (slot && *slot)
+    {
+      struct face *cached = FACE_FROM_ID_OR_NULL (f, *slot - 1);
+
+      if (cached && cached->ascii_face == face->ascii_face)
+	return *slot - 1;
+    }
+
   if (use_default_font_for_symbols  /* let the user disable this feature */
       && c > 0 && EQ (CHAR_TABLE_REF (Vchar_script_table, c), Qsymbol))
     {
@@ -951,7 +1049,10 @@ face_for_char (struct frame *f, struct face *face, int c,
 	{
 	  XSETFONT (font_object, face->ascii_face->font);
 	  if (font_has_char (f, font_object, c))
-	    return face->ascii_face->id;
+	    {
+	      face_id = face->ascii_face->id;
+	      goto done;
+	    }
 	}
 
 #if 0
@@ -973,27 +1074,6 @@ face_for_char (struct frame *f, struct face *face, int c,
   fontset = FONTSET_FROM_ID (face->fontset);
   eassert (!BASE_FONTSET_P (fontset));
 
-  if (pos < 0)
-    {
-      id = -1;
-      charset = Qnil;
-    }
-  else
-    {
-      charset = Fget_char_property (make_fixnum (pos), Qcharset, object);
-      if (CHARSETP (charset))
-	{
-	  Lisp_Object val;
-
-	  val = assq_no_quit (charset, Vfont_encoding_charset_alist);
-	  if (CONSP (val) && CHARSETP (XCDR (val)))
-	    charset = XCDR (val);
-	  id = XFIXNUM (CHARSET_SYMBOL_ID (charset));
-	}
-      else
-	id = -1;
-    }
-
   rfont_def = fontset_font (fontset, c, face, id);
   if (VECTORP (rfont_def))
     {
@@ -1018,7 +1098,15 @@ face_for_char (struct frame *f, struct face *face, int c,
 	  set_fontset_nofont_face (fontset, make_fixnum (face_id));
 	}
     }
+ done:
   eassert (face_id >= 0);
+  /* Look up the slot again, as finding the font may have run Lisp
+     code that changed the settings the cache depends on.  */
+  if (slot)
+    {
+      slot = face_char_face_slot (face->ascii_face, c);
+      *slot = face_id + 1;
+    }
   return face_id;
 }
 
@@ -1295,6 +1383,8 @@ free_realized_fontsets (Lisp_Object base)
 {
   int id;
 
+  fontset_tick++;
+
 #if 0
   /* For the moment, this doesn't work because free_realized_face
      doesn't remove FACE from a cache.  Until we find a solution, we
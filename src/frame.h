@@ -221,6 +221,9 @@ struct frame
   /* Cache of realized faces.  */
   struct face_cache *face_cache;
 
+  /* What `redisplay-statistics' reports for this frame.  */
+  struct redisplay_stats redisplay_stats;
+
   /* Tab-bar item index of the item on which a mouse button was pressed.  */
   int last_tab_bar_item;
 
@@ -441,6 +444,10 @@ struct frame
   /* Non-zero if this frame's faces need to be recomputed.  */
   bool_bf face_change : 1;
 
+  /* True if named faces that realized faces of this frame were made
+     from have changed, so that those faces need to be recomputed.  */
+  bool_bf named_face_change : 1;
+
   /* Non-zero if this frame's image cache cannot be freed because the
      frame is in the process of being redisplayed.  */
   bool_bf inhibit_clear_image_cache : 1;
@@ -34,55 +34,20 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "ftfont.h"
 #include "pdumper.h"
 
-#define METRICS_NCOLS_PER_ROW	(128)
-
-enum metrics_status
-  {
-    METRICS_INVALID = -1,    /* metrics entry is invalid */
-  };
-
-#define METRICS_STATUS(metrics)	((metrics)->ascent + (metrics)->descent)
-#define METRICS_SET_STATUS(metrics, status) \
-  ((metrics)->ascent = 0, (metrics)->descent = (status))
-
 static int
 ftcrfont_glyph_extents (struct font *font,
                         unsigned glyph,
                         struct font_metrics *metrics)
 {
   struct font_info *ftcrfont_info = (struct font_info *) font;
-  int row, col;
-  struct font_metrics *cache;
-
-  row = glyph / METRICS_NCOLS_PER_ROW;
-  col = glyph % METRICS_NCOLS_PER_ROW;
-  if (row >= ftcrfont_info->metrics_nrows)
-    {
-      ftcrfont_info->metrics =
-	xrealloc (ftcrfont_info->metrics,
-		  sizeof (struct font_metrics *) * (row + 1));
-      memset (ftcrfont_info->metrics + ftcrfont_info->metrics_nrows, 0,
-	      (sizeof (struct font_metrics *)
-	       * (row + 1 - ftcrfont_info->metrics_nrows)));
-      ftcrfont_info->metrics_nrows = row + 1;
-    }
-  if (ftcrfont_info->metrics[row] == NULL)
-    {
-      struct font_metrics *new;
-      int i;
-
-      new = xmalloc (sizeof (struct font_metrics) * METRICS_NCOLS_PER_ROW);
-      for (i = 0; i < METRICS_NCOLS_PER_ROW; i++)
-	METRICS_SET_STATUS (new + i, METRICS_INVALID);
-      ftcrfont_info->metrics[row] = new;
-    }
-  cache = ftcrfont_info->metrics[row] + col;
+  struct font_metrics *cache = ftfont_metrics_cache (ftcrfont_info, glyph);
 
   if (METRICS_STATUS (cache) == METRICS_INVALID)
     {
       cairo_glyph_t cr_glyph = {.index = glyph};
       cairo_text_extents_t extents;
 
+      note_font_glyph_miss ();
       cairo_scaled_font_glyph_extents (ftcrfont_info->cr_scaled_font,
 				       &cr_glyph, 1, &extents);
       cache->lbearing = floor (extents.x_bearing);
@@ -190,38 +155,45 @@ ftcrfont_open (struct frame *f, Lisp_Object entity, int pixel_size)
 
   ftcrfont_info->metrics = NULL;
   ftcrfont_info->metrics_nrows = 0;
+  ftcrfont_info->glyph_codes = NULL;
+  ftcrfont_info->glyph_codes_nrows = 0;
 
   block_input ();
-  cairo_glyph_t stack_glyph;
-  font->min_width = font->average_width = font->space_width = 0;
-  for (char c = 32; c < 127; c++)
+  if (! ftfont_cached_widths (entity, pixel_size, font))
     {
-      cairo_glyph_t *glyphs = &stack_glyph;
-      int num_glyphs = 1;
-      cairo_status_t status =
-	cairo_scaled_font_text_to_glyphs (ftcrfont_info->cr_scaled_font,
-					  0, 0, &c, 1, &glyphs, &num_glyphs,
-					  NULL, NULL, NULL);
-
-      /* In order to simulate the Xft behavior, we use metrics of
-	 glyph ID 0 if there is no glyph for an ASCII printable.  */
-      if (status != CAIRO_STATUS_SUCCESS)
-	stack_glyph.index = 0;
-      else if (glyphs != &stack_glyph)
+      cairo_glyph_t stack_glyph;
+      font->min_width = font->average_width = font->space_width = 0;
+      for (char c = 32; c < 127; c++)
 	{
-	  cairo_glyph_free (glyphs);
-	  stack_glyph.index = 0;
+	  cairo_glyph_t *glyphs = &stack_glyph;
+	  int num_glyphs = 1;
+	  cairo_status_t status =
+	    cairo_scaled_font_text_to_glyphs (ftcrfont_info->cr_scaled_font,
+					      0, 0, &c, 1, &glyphs,
+					      &num_glyphs, NULL, NULL, NULL);
+
+	  /* In order to simulate the Xft behavior, we use metrics of
+	     glyph ID 0 if there is no glyph for an ASCII printable.  */
+	  if (status != CAIRO_STATUS_SUCCESS)
+	    stack_glyph.index = 0;
+	  else if (glyphs != &stack_glyph)
+	    {
+	      cairo_glyph_free (glyphs);
+	      stack_glyph.index = 0;
+	    }
+	  int this_width = ftcrfont_glyph_extents (font, stack_glyph.index,
+						   NULL);
+	  if (this_width > 0
+	      && (! font->min_width
+		  || font->min_width > this_width))
+	    font->min_width = this_width;
+	  if (c == 32)
+	    font->space_width = this_width;
+	  font->average_width += this_width;
 	}
-      int this_width = ftcrfont_glyph_extents (font, stack_glyph.index, NULL);
-      if (this_width > 0
-	  && (! font->min_width
-	      || font->min_width > this_width))
-	font->min_width = this_width;
-      if (c == 32)
-	font->space_width = this_width;
-      font->average_width += this_width;
+      font->average_width /= 95;
+      ftfont_cache_widths (entity, pixel_size, font);
     }
-  font->average_width /= 95;
 
   cairo_scaled_font_extents (ftcrfont_info->cr_scaled_font, &extents);
   font->ascent = lround (extents.ascent);
@@ -299,11 +271,7 @@ ftcrfont_close (struct font *font)
       ftcrfont_info->hb_font = NULL;
     }
 #endif
-  for (int i = 0; i < ftcrfont_info->metrics_nrows; i++)
-    if (ftcrfont_info->metrics[i])
-      xfree (ftcrfont_info->metrics[i]);
-  if (ftcrfont_info->metrics)
-    xfree (ftcrfont_info->metrics);
+  ftfont_free_glyph_caches (ftcrfont_info);
   cairo_scaled_font_destroy (ftcrfont_info->cr_scaled_font);
   unblock_input ();
 }
@@ -332,6 +300,7 @@ static unsigned
 ftcrfont_encode_char (struct font *font, int c)
 {
   struct font_info *ftcrfont_info = (struct font_info *) font;
+  unsigned *cache = ftfont_glyph_code_cache (ftcrfont_info, c);
   unsigned code = FONT_INVALID_CODE;
   unsigned char utf8[MAX_MULTIBYTE_LENGTH];
   unsigned char *p = utf8;
@@ -339,6 +308,9 @@ ftcrfont_encode_char (struct font *font, int c)
   cairo_glyph_t *glyphs = &stack_glyph;
   int num_glyphs = 1;
 
+  if (cache && *cache)
+    return *cache;
+  note_font_glyph_miss ();
   CHAR_STRING_ADVANCE (c, p);
   if (cairo_scaled_font_text_to_glyphs (ftcrfont_info->cr_scaled_font, 0, 0,
 					(char *) utf8, p - utf8,
@@ -352,6 +324,8 @@ ftcrfont_encode_char (struct font *font, int c)
 	code = stack_glyph.index;
     }
 
+  if (cache)
+    *cache = code;
   return code;
 }
 
@@ -20,6 +20,7 @@ You should have received a copy of the GNU General Public License
 along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 
 #include <config.h>
+#include <sys/stat.h>
 #include <fontconfig/fontconfig.h>
 #include <fontconfig/fcfreetype.h>
 
@@ -37,11 +38,13 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include <c-strcase.h>
 
 #include "lisp.h"
+#include "sysstdio.h"
 #include "dispextern.h"
 #include "character.h"
 #include "charset.h"
 #include "category.h"
 #include "composite.h"
+#include "coding.h"
 #include "font.h"
 #include "ftfont.h"
 #include "pdumper.h"
@@ -174,6 +177,25 @@ get_adstyle_property (FcPattern *p)
   return adstyle;
 }
 
+/* Return a new font entity for the font KEY, a cons of its file name
+   and index, with the properties of ENTITY and the extra properties
+   EXTRA.  */
+
+static Lisp_Object
+ftfont_copy_entity (Lisp_Object entity, Lisp_Object key, Lisp_Object extra)
+{
+  Lisp_Object val = font_make_entity ();
+  int i;
+
+  for (i = 0; i < FONT_OBJLIST_INDEX; i++)
+    ASET (val, i, AREF (entity, i));
+
+  ASET (val, FONT_EXTRA_INDEX, Fcopy_sequence (extra));
+  font_put_extra (val, QCfont_entity, key);
+
+  return val;
+}
+
 static Lisp_Object
 ftfont_pattern_entity (FcPattern *p, Lisp_Object extra)
 {
@@ -195,18 +217,7 @@ ftfont_pattern_entity (FcPattern *p, Lisp_Object extra)
   cache = ftfont_lookup_cache (key, FTFONT_CACHE_FOR_ENTITY);
   entity = XCAR (cache);
   if (! NILP (entity))
-    {
-      Lisp_Object val = font_make_entity ();
-      int i;
-
-      for (i = 0; i < FONT_OBJLIST_INDEX; i++)
-	ASET (val, i, AREF (entity, i));
-
-      ASET (val, FONT_EXTRA_INDEX, Fcopy_sequence (extra));
-      font_put_extra (val, QCfont_entity, key);
-
-      return val;
-    }
+    return ftfont_copy_entity (entity, key, extra);
   entity = font_make_entity ();
   XSETCAR (cache, entity);
 
@@ -445,6 +456,396 @@ ftfont_get_fc_charset (Lisp_Object entity)
   return cache_data->fc_charset;
 }
 
+/* The persistent cache of font lists and font widths.
+
+   Listing fonts through Fontconfig, and measuring the ASCII
+   characters of a proportional font when it is opened, take a long
+   time when many fonts are installed, and give the same results in
+   every session until the installed fonts or Fontconfig's
+   configuration change.  So if `font-cache-file' names a file, these
+   results are recorded there and reused by later sessions.
+
+   The first line of the file is the stamp ftfont_config_stamp gave
+   when the file was started, and each other line is a cons (KEY
+   . VALUE) of a result appended to it since.  The file is read into
+   ftfont_file_cache when a result is first looked up, and is started
+   anew if its stamp doesn't match the current configuration.  */
+
+/* The results read from `font-cache-file' or found since, an `equal'
+   hash table, or nil if the file hasn't been read yet.  */
+static Lisp_Object ftfont_file_cache;
+
+/* The value of `font-cache-file' ftfont_file_cache was read for.  */
+static Lisp_Object ftfont_file_cache_name;
+
+/* The stamp ftfont_file_cache was read or started for, as a line of
+   `font-cache-file'.  */
+static Lisp_Object ftfont_file_cache_stamp;
+
+/* True if new results can be appended to `font-cache-file'.  */
+static bool ftfont_file_cache_writable;
+
+/* The file is not written while fonts are being listed or opened,
+   which is usually during redisplay.  Instead, the lines to append to
+   it are kept here, most recent first, and written by
+   ftfont_save_file_cache when the command loop next calls
+   `internal--save-font-cache'.  If ftfont_file_cache_restart is true,
+   the file is started anew with ftfont_file_cache_stamp first.  */
+static Lisp_Object ftfont_file_cache_lines;
+static bool ftfont_file_cache_restart;
+
+/* True if a call to `internal--save-font-cache' is pending.  */
+static bool ftfont_file_cache_save_pending;
+
+/* Return a stamp of the fonts Fontconfig knows about: its version, the
+   number of fonts, and the last time a font directory or configuration
+   file was modified.  */
+
+static Lisp_Object
+ftfont_config_stamp (void)
+{
+  FcFontSet *fonts = FcConfigGetFonts (NULL, FcSetSystem);
+  FcStrList *lists[2];
+  intmax_t newest = 0;
+
+  lists[0] = FcConfigGetFontDirs (NULL);
+  lists[1] = FcConfigGetConfigFiles (NULL);
+  for (int i = 0; i < 2; i++)
+    if (lists[i])
+      {
+	FcChar8 *name;
+	struct stat st;
+
+	while ((name = FcStrListNext (lists[i])))
+	  if (stat ((char *) name, &st) == 0 && newest < st.st_mtime)
+	    newest = st.st_mtime;
+	FcStrListDone (lists[i]);
+      }
+  return list3 (make_fixnum (FcGetVersion ()),
+		make_fixnum (fonts ? fonts->nfont : 0),
+		make_int (newest));
+}
+
+/* Return the printed representation of OBJ as a line of
+   `font-cache-file', or nil if it can't be read back from one.  */
+
+static Lisp_Object
+ftfont_print_cache_line (Lisp_Object obj)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  Lisp_Object line;
+
+  specbind (Qprint_length, Qnil);
+  specbind (Qprint_level, Qnil);
+  line = unbind_to (count, Fprin1_to_string (obj, Qnil));
+  if (memchr (SDATA (line), '\n', SBYTES (line))
+      || strstr (SSDATA (line), "#<"))
+    return Qnil;
+  return line;
+}
+
+static Lisp_Object
+ftfont_read_cache_line (Lisp_Object line)
+{
+  return XCAR (Fread_from_string (line, Qnil, Qnil));
+}
+
+static Lisp_Object
+ftfont_cache_line_error (Lisp_Object err)
+{
+  return Qnil;
+}
+
+/* Arrange for the command loop to write the pending lines of
+   `font-cache-file'.  */
+
+static void
+ftfont_schedule_file_cache_save (void)
+{
+  if (! ftfont_file_cache_save_pending)
+    {
+      ftfont_file_cache_save_pending = true;
+      pending_funcalls = Fcons (list1 (Qinternal__save_font_cache),
+				pending_funcalls);
+    }
+}
+
+/* Write the pending lines of `font-cache-file', starting the file
+   anew first if needed.  */
+
+static void
+ftfont_save_file_cache (void)
+{
+  Lisp_Object lines = Fnreverse (ftfont_file_cache_lines);
+  bool restart = ftfont_file_cache_restart;
+  FILE *fp = NULL;
+
+  ftfont_file_cache_lines = Qnil;
+  ftfont_file_cache_restart = false;
+  if (! (STRINGP (ftfont_file_cache_name) && ftfont_file_cache_writable))
+    return;
+  if (restart)
+    lines = Fcons (ftfont_file_cache_stamp, lines);
+  else if (NILP (lines))
+    return;
+  fp = emacs_fopen (SSDATA (ENCODE_FILE (Fexpand_file_name
+					 (ftfont_file_cache_name, Qnil))),
+		    restart ? "w" : "a");
+  if (! fp)
+    {
+      ftfont_file_cache_writable = false;
+      return;
+    }
+  for (; CONSP (lines); lines = XCDR (lines))
+    {
+      fwrite (SDATA (XCAR (lines)), 1, SBYTES (XCAR (lines)), fp);
+      putc ('\n', fp);
+    }
+  if (fclose (fp) != 0)
+    ftfont_file_cache_writable = false;
+}
+
+/* Forget the results recorded in ftfont_file_cache and arrange for
+   `font-cache-file' to be started anew with the stamp STAMP.  */
+
+static void
+ftfont_restart_file_cache (Lisp_Object stamp)
+{
+  Fclrhash (ftfont_file_cache);
+  ftfont_file_cache_stamp = stamp;
+  ftfont_file_cache_lines = Qnil;
+  ftfont_file_cache_restart = true;
+  ftfont_schedule_file_cache_save ();
+}
+
+/* Read the results recorded in `font-cache-file' into
+   ftfont_file_cache.  */
+
+static void
+ftfont_read_file_cache (void)
+{
+  Lisp_Object stamp;
+  FILE *fp;
+  bool valid = false;
+
+  ftfont_file_cache = CALLN (Fmake_hash_table, QCtest, Qequal);
+  ftfont_file_cache_name = Vfont_cache_file;
+  ftfont_file_cache_stamp = Qnil;
+  ftfont_file_cache_lines = Qnil;
+  ftfont_file_cache_restart = false;
+  ftfont_file_cache_writable = false;
+  if (! STRINGP (Vfont_cache_file))
+    return;
+  stamp = ftfont_print_cache_line (ftfont_config_stamp ());
+
+  fp = emacs_fopen (SSDATA (ENCODE_FILE (Fexpand_file_name (Vfont_cache_file,
+							    Qnil))),
+		    "r");
+  if (fp)
+    {
+      char *buf = NULL;
+      ptrdiff_t size = 0, nbytes = 0;
+
+      for (;;)
+	{
+	  if (nbytes == size)
+	    buf = xpalloc (buf, &size, 4096, -1, 1);
+	  size_t n = fread (buf + nbytes, 1, size - nbytes, fp);
+	  if (n == 0)
+	    break;
+	  nbytes += n;
+	}
+      fclose (fp);
+
+      for (char *p = buf, *end = buf + nbytes, *eol;
+	   p < end && (eol = memchr (p, '\n', end - p)); p = eol + 1)
+	{
+	  Lisp_Object line = make_string (p, eol - p);
+
+	  if (! valid)
+	    {
+	      /* The first line must be the current stamp.  */
+	      if (NILP (Fstring_equal (line, stamp)))
+		break;
+	      valid = true;
+	    }
+	  else
+	    {
+	      Lisp_Object entry
+		= internal_condition_case_1 (ftfont_read_cache_line, line,
+					     Qerror, ftfont_cache_line_error);
+	      if (CONSP (entry))
+		Fputhash (XCAR (entry), XCDR (entry), ftfont_file_cache);
+	    }
+	}
+      xfree (buf);
+    }
+
+  ftfont_file_cache_writable = true;
+  if (valid)
+    ftfont_file_cache_stamp = stamp;
+  else
+    ftfont_restart_file_cache (stamp);
+}
+
+/* Return ftfont_file_cache, reading `font-cache-file' into it first
+   if that hasn't been done since the variable was last set.  */
+
+static Lisp_Object
+ftfont_file_cache_table (void)
+{
+  if (NILP (ftfont_file_cache)
+      || ! EQ (ftfont_file_cache_name, Vfont_cache_file))
+    ftfont_read_file_cache ();
+  return ftfont_file_cache;
+}
+
+/* Forget the results in ftfont_file_cache if the installed fonts or
+   Fontconfig's configuration changed since it was read.  */
+
+static void
+ftfont_check_file_cache (void)
+{
+  if (NILP (ftfont_file_cache)
+      || ! EQ (ftfont_file_cache_name, Vfont_cache_file))
+    return;
+
+  Lisp_Object stamp = ftfont_print_cache_line (ftfont_config_stamp ());
+
+  if (NILP (Fstring_equal (stamp, ftfont_file_cache_stamp)))
+    ftfont_restart_file_cache (stamp);
+}
+
+/* Write what is pending of `font-cache-file' and forget the results
+   read from it, so that it is read again when next needed.  This is
+   called by `clear-font-cache'.  */
+
+void
+ftfont_forget_file_cache (void)
+{
+  ftfont_save_file_cache ();
+  ftfont_file_cache = Qnil;
+}
+
+/* Return the value recorded for KEY in the persistent cache, or nil if
+   there is none.  */
+
+static Lisp_Object
+ftfont_get_file_cache (Lisp_Object key)
+{
+  if (NILP (Vfont_cache_file))
+    return Qnil;
+  return Fgethash (key, ftfont_file_cache_table (), Qnil);
+}
+
+/* Record VAL for KEY in the persistent cache.  */
+
+static void
+ftfont_put_file_cache (Lisp_Object key, Lisp_Object val)
+{
+  Lisp_Object line;
+
+  if (NILP (Vfont_cache_file))
+    return;
+  Fputhash (key, val, ftfont_file_cache_table ());
+  if (! ftfont_file_cache_writable)
+    return;
+  line = ftfont_print_cache_line (Fcons (key, val));
+  if (NILP (line))
+    return;
+  ftfont_file_cache_lines = Fcons (line, ftfont_file_cache_lines);
+  ftfont_schedule_file_cache_save ();
+}
+
+DEFUN ("internal--save-font-cache", Finternal__save_font_cache,
+       Sinternal__save_font_cache, 0, 0, 0,
+       doc: /* Write the results pending for `font-cache-file'.
+This is called from the command loop after fonts were listed or opened,
+so that the file is not written during redisplay.  */)
+  (void)
+{
+  ftfont_file_cache_save_pending = false;
+  ftfont_save_file_cache ();
+  return Qnil;
+}
+
+/* Return the rendering parameters among the extra properties of
+   ENTITY, which can change the widths of its glyphs.  */
+
+static Lisp_Object
+ftfont_rendering_parameters (Lisp_Object entity)
+{
+  Lisp_Object params = Qnil;
+
+  for (Lisp_Object tail = AREF (entity, FONT_EXTRA_INDEX);
+       CONSP (tail); tail = XCDR (tail))
+    if (CONSP (XCAR (tail)))
+      {
+	Lisp_Object key = XCAR (XCAR (tail));
+
+	if (EQ (key, QCantialias) || EQ (key, QChinting)
+	    || EQ (key, QCautohint) || EQ (key, QChintstyle)
+	    || EQ (key, QCrgba) || EQ (key, QCembolden)
+	    || EQ (key, QClcdfilter))
+	  params = Fcons (XCAR (tail), params);
+      }
+  return Fnreverse (params);
+}
+
+static Lisp_Object
+ftfont_widths_key (Lisp_Object entity, int pixel_size)
+{
+  Lisp_Object val = assq_no_quit (QCfont_entity,
+				  AREF (entity, FONT_EXTRA_INDEX));
+
+  if (! CONSP (val))
+    return Qnil;
+  return list5 (QCwidth, AREF (entity, FONT_TYPE_INDEX), XCDR (val),
+		make_fixnum (pixel_size),
+		ftfont_rendering_parameters (entity));
+}
+
+/* If the persistent cache records the widths of the font ENTITY opened
+   at PIXEL_SIZE, set those of FONT and return true.  Otherwise return
+   false.  */
+
+bool
+ftfont_cached_widths (Lisp_Object entity, int pixel_size, struct font *font)
+{
+  if (NILP (Vfont_cache_file))
+    return false;
+
+  Lisp_Object key = ftfont_widths_key (entity, pixel_size);
+  Lisp_Object val = NILP (key) ? Qnil : ftfont_get_file_cache (key);
+
+  if (! (VECTORP (val) && ASIZE (val) == 3
+	 && FIXNUMP (AREF (val, 0)) && FIXNUMP (AREF (val, 1))
+	 && FIXNUMP (AREF (val, 2))))
+    return false;
+  font->min_width = XFIXNUM (AREF (val, 0));
+  font->average_width = XFIXNUM (AREF (val, 1));
+  font->space_width = XFIXNUM (AREF (val, 2));
+  return true;
+}
+
+/* Record the widths of FONT, which is the font ENTITY opened at
+   PIXEL_SIZE, in the persistent cache.  */
+
+void
+ftfont_cache_widths (Lisp_Object entity, int pixel_size, struct font *font)
+{
+  if (NILP (Vfont_cache_file))
+    return;
+
+  Lisp_Object key = ftfont_widths_key (entity, pixel_size);
+
+  if (! NILP (key))
+    ftfont_put_file_cache (key, CALLN (Fvector,
+				       make_fixnum (font->min_width),
+				       make_fixnum (font->average_width),
+				       make_fixnum (font->space_width)));
+}
+
 #ifdef HAVE_LIBOTF
 static OTF *
 ftfont_get_otf (struct font_info *ftfont_info)
@@ -802,6 +1203,87 @@ ftfont_spec_pattern (Lisp_Object spec, char *otlayout, struct OpenTypeSpec **ots
   return pattern;
 }
 
+/* Return the key under which the persistent cache records the fonts
+   ftfont_list finds for SPEC.  */
+
+static Lisp_Object
+ftfont_list_key (Lisp_Object spec)
+{
+  Lisp_Object script = assq_no_quit (QCscript, AREF (spec, FONT_EXTRA_INDEX));
+
+  if (CONSP (script))
+    script = assq_no_quit (XCDR (script), Vscript_representative_chars);
+  return list4 (Qlist, Fvector (FONT_SPEC_MAX, XVECTOR (spec)->contents),
+		script, Vxft_ignore_color_fonts ? Qt : Qnil);
+}
+
+/* Return how the persistent cache records the list of font entities
+   LIST: a vector of conses (KEY . PROPS), where KEY identifies a font
+   as in ft_face_cache, and PROPS is a vector of its properties.  */
+
+static Lisp_Object
+ftfont_list_to_cache (Lisp_Object list)
+{
+  Lisp_Object val = make_nil_vector (list_length (list));
+  ptrdiff_t i = 0;
+
+  for (Lisp_Object tail = list; CONSP (tail); tail = XCDR (tail), i++)
+    {
+      Lisp_Object entity = XCAR (tail);
+      Lisp_Object key = assq_no_quit (QCfont_entity,
+				      AREF (entity, FONT_EXTRA_INDEX));
+
+      ASET (val, i, Fcons (XCDR (key),
+			   Fvector (FONT_EXTRA_INDEX,
+				    XVECTOR (entity)->contents)));
+    }
+  return val;
+}
+
+/* Return the list of font entities that CACHED, a value made by
+   ftfont_list_to_cache, records, with the extra properties EXTRA.
+   Return Qt if CACHED is malformed.  */
+
+static Lisp_Object
+ftfont_list_from_cache (Lisp_Object cached, Lisp_Object extra)
+{
+  Lisp_Object val = Qnil;
+  ptrdiff_t i;
+
+  if (! VECTORP (cached))
+    return Qt;
+  for (i = 0; i < ASIZE (cached); i++)
+    {
+      Lisp_Object entry = AREF (cached, i);
+
+      if (! (CONSP (entry) && CONSP (XCAR (entry))
+	     && STRINGP (XCAR (XCAR (entry)))
+	     && FIXNUMP (XCDR (XCAR (entry)))
+	     && VECTORP (XCDR (entry))
+	     && ASIZE (XCDR (entry)) == FONT_EXTRA_INDEX))
+	return Qt;
+    }
+  for (i = ASIZE (cached) - 1; i >= 0; i--)
+    {
+      Lisp_Object key = XCAR (AREF (cached, i));
+      Lisp_Object props = XCDR (AREF (cached, i));
+      Lisp_Object cache = ftfont_lookup_cache (key, FTFONT_CACHE_FOR_ENTITY);
+      Lisp_Object entity = XCAR (cache);
+
+      if (NILP (entity))
+	{
+	  entity = font_make_entity ();
+	  for (int j = 0; j < FONT_EXTRA_INDEX; j++)
+	    ASET (entity, j, AREF (props, j));
+	  ASET (entity, FONT_EXTRA_INDEX,
+		list1 (Fcons (QCfont_entity, key)));
+	  XSETCAR (cache, entity);
+	}
+      val = Fcons (ftfont_copy_entity (entity, key, extra), val);
+    }
+  return val;
+}
+
 static Lisp_Object
 ftfont_list (struct frame *f, Lisp_Object spec)
 {
@@ -816,6 +1298,7 @@ ftfont_list (struct frame *f, Lisp_Object spec)
   struct OpenTypeSpec *otspec = NULL;
   int spacing = -1;
   const char *langname = NULL;
+  Lisp_Object cache_key = Qnil;
 
   if (! fc_initialized)
     {
@@ -823,6 +1306,20 @@ ftfont_list (struct frame *f, Lisp_Object spec)
       fc_initialized = 1;
     }
 
+  if (! NILP (Vfont_cache_file))
+    {
+      ftfont_check_file_cache ();
+      cache_key = ftfont_list_key (spec);
+      val = ftfont_list_from_cache (ftfont_get_file_cache (cache_key),
+				    AREF (spec, FONT_EXTRA_INDEX));
+      if (! EQ (val, Qt))
+	{
+	  FONT_ADD_LOG ("ftfont-list", spec, val);
+	  return val;
+	}
+      val = Qnil;
+    }
+
   pattern = ftfont_spec_pattern (spec, otlayout, &otspec, &langname);
   if (! pattern)
     return Qnil;
@@ -875,7 +1372,7 @@ ftfont_list (struct frame *f, Lisp_Object spec)
     FcObjectSetAdd (objset, FC_CHARSET);
 
   fontset = FcFontList (NULL, pattern, objset);
-  if (! fontset || fontset->nfont == 0)
+  if (! fontset)
     goto finish;
 #if 0
   /* Need fix because this finds any fonts.  */
@@ -1001,6 +1498,8 @@ ftfont_list (struct frame *f, Lisp_Object spec)
 	val = Fcons (entity, val);
     }
   val = Fnreverse (val);
+  if (! NILP (cache_key))
+    ftfont_put_file_cache (cache_key, ftfont_list_to_cache (val));
   goto finish;
 
  err:
@@ -1348,6 +1847,10 @@ ftfont_open (struct frame *f, Lisp_Object entity, int pixel_size)
 #endif	/* HAVE_HARFBUZZ */
   /* This means that there's no need of transformation.  */
   ftfont_info->matrix.xx = 0;
+  ftfont_info->metrics = NULL;
+  ftfont_info->metrics_nrows = 0;
+  ftfont_info->glyph_codes = NULL;
+  ftfont_info->glyph_codes_nrows = 0;
   font->pixel_size = size;
 #ifdef HAVE_HARFBUZZ
   if (EQ (AREF (font_object, FONT_TYPE_INDEX), Qfreetypehb))
@@ -1402,7 +1905,7 @@ ftfont_open (struct frame *f, Lisp_Object entity, int pixel_size)
     font->min_width = font->average_width = font->space_width
       = (scalable ? ft_face->max_advance_width * size / upEM + 0.5
 	 : ft_face->size->metrics.max_advance >> 6);
-  else
+  else if (! ftfont_cached_widths (entity, size, font))
     {
       int n;
 
@@ -1422,6 +1925,7 @@ ftfont_open (struct frame *f, Lisp_Object entity, int pixel_size)
 	  }
       if (n > 0)
 	font->average_width /= n;
+      ftfont_cache_widths (entity, size, font);
     }
 
   font->baseline_offset = 0;
@@ -1453,6 +1957,7 @@ ftfont_close (struct font *font)
   struct font_info *ftfont_info = (struct font_info *) font;
   Lisp_Object val, cache;
 
+  ftfont_free_glyph_caches (ftfont_info);
   val = Fcons (font->props[FONT_FILE_INDEX], make_fixnum (ftfont_info->index));
   cache = ftfont_lookup_cache (val, FTFONT_CACHE_FOR_FACE);
   eassert (CONSP (cache));
@@ -1510,15 +2015,102 @@ ftfont_has_char (Lisp_Object font, int c)
 
 #ifndef USE_CAIRO
 
+/* Return where the metrics of GLYPH are cached for the font of
+   FTFONT_INFO.  Their status is METRICS_INVALID if they haven't been
+   computed yet.  */
+
+struct font_metrics *
+ftfont_metrics_cache (struct font_info *ftfont_info, unsigned glyph)
+{
+  int row, col;
+
+  row = glyph / METRICS_NCOLS_PER_ROW;
+  col = glyph % METRICS_NCOLS_PER_ROW;
+  if (row >= ftfont_info->metrics_nrows)
+    {
+      ftfont_info->metrics =
+	xrealloc (ftfont_info->metrics,
+		  sizeof (struct font_metrics *) * (row + 1));
+      memset (ftfont_info->metrics + ftfont_info->metrics_nrows, 0,
+	      (sizeof (struct font_metrics *)
+	       * (row + 1 - ftfont_info->metrics_nrows)));
+      ftfont_info->metrics_nrows = row + 1;
+    }
+  if (ftfont_info->metrics[row] == NULL)
+    {
+      struct font_metrics *new;
+      int i;
+
+      new = xmalloc (sizeof (struct font_metrics) * METRICS_NCOLS_PER_ROW);
+      for (i = 0; i < METRICS_NCOLS_PER_ROW; i++)
+	METRICS_SET_STATUS (new + i, METRICS_INVALID);
+      ftfont_info->metrics[row] = new;
+    }
+  return ftfont_info->metrics[row] + col;
+}
+
+/* Return where the glyph code of character C is cached for the font
+   of FTFONT_INFO, or NULL if C is not a Unicode character.  The code
+   there is 0 if it hasn't been looked up yet.  */
+
+unsigned *
+ftfont_glyph_code_cache (struct font_info *ftfont_info, int c)
+{
+  int row, col;
+
+  if (c > MAX_UNICODE_CHAR)
+    return NULL;
+  row = c / GLYPH_CODES_NCOLS_PER_ROW;
+  col = c % GLYPH_CODES_NCOLS_PER_ROW;
+  if (row >= ftfont_info->glyph_codes_nrows)
+    {
+      ftfont_info->glyph_codes =
+	xrealloc (ftfont_info->glyph_codes, sizeof (unsigned *) * (row + 1));
+      memset (ftfont_info->glyph_codes + ftfont_info->glyph_codes_nrows, 0,
+	      sizeof (unsigned *) * (row + 1 - ftfont_info->glyph_codes_nrows));
+      ftfont_info->glyph_codes_nrows = row + 1;
+    }
+  if (ftfont_info->glyph_codes[row] == NULL)
+    ftfont_info->glyph_codes[row]
+      = xzalloc (sizeof (unsigned) * GLYPH_CODES_NCOLS_PER_ROW);
+  return ftfont_info->glyph_codes[row] + col;
+}
+
+/* Free the caches of glyph metrics and glyph codes of FTFONT_INFO.  */
+
+void
+ftfont_free_glyph_caches (struct font_info *ftfont_info)
+{
+  for (int i = 0; i < ftfont_info->metrics_nrows; i++)
+    xfree (ftfont_info->metrics[i]);
+  xfree (ftfont_info->metrics);
+  ftfont_info->metrics = NULL;
+  ftfont_info->metrics_nrows = 0;
+  for (int i = 0; i < ftfont_info->glyph_codes_nrows; i++)
+    xfree (ftfont_info->glyph_codes[i]);
+  xfree (ftfont_info->glyph_codes);
+  ftfont_info->glyph_codes = NULL;
+  ftfont_info->glyph_codes_nrows = 0;
+}
+
 unsigned
 ftfont_encode_char (struct font *font, int c)
 {
   struct font_info *ftfont_info = (struct font_info *) font;
+  unsigned *cache = ftfont_glyph_code_cache (ftfont_info, c);
+
+  if (cache && *cache)
+    return *cache;
+  note_font_glyph_miss ();
+
   FT_Face ft_face = ftfont_info->ft_size->face;
   FT_ULong charcode = c;
   FT_UInt code = FT_Get_Char_Index (ft_face, charcode);
+  unsigned val = code > 0 ? code : FONT_INVALID_CODE;
 
-  return (code > 0 ? code : FONT_INVALID_CODE);
+  if (cache)
+    *cache = val;
+  return val;
 }
 
 static bool
@@ -1548,32 +2140,48 @@ ftfont_text_extents (struct font *font, const unsigned int *code,
   int i, width = 0;
   bool first;
 
-  if (ftfont_info->ft_size != ft_face->size)
-    FT_Activate_Size (ftfont_info->ft_size);
-
   for (i = 0, first = 1; i < nglyphs; i++)
     {
-      int advance, lbearing, rbearing, ascent, descent;
-      if (ftfont_glyph_metrics (ft_face, code[i], &advance, &lbearing,
-                                &rbearing, &ascent, &descent))
+      struct font_metrics *m = ftfont_metrics_cache (ftfont_info, code[i]);
+
+      if (METRICS_STATUS (m) == METRICS_INVALID)
+	{
+	  int advance, lbearing, rbearing, ascent, descent;
+
+	  note_font_glyph_miss ();
+	  if (ftfont_info->ft_size != ft_face->size)
+	    FT_Activate_Size (ftfont_info->ft_size);
+	  if (ftfont_glyph_metrics (ft_face, code[i], &advance, &lbearing,
+				    &rbearing, &ascent, &descent))
+	    {
+	      m->lbearing = lbearing;
+	      m->rbearing = rbearing;
+	      m->width = advance;
+	      m->ascent = ascent;
+	      m->descent = descent;
+	    }
+	  else
+	    METRICS_SET_STATUS (m, METRICS_NO_GLYPH);
+	}
+      if (METRICS_STATUS (m) != METRICS_NO_GLYPH)
 	{
 	  if (first)
 	    {
-	      metrics->lbearing = lbearing;
-	      metrics->rbearing = rbearing;
-	      metrics->ascent = ascent;
-	      metrics->descent = descent;
+	      metrics->lbearing = m->lbearing;
+	      metrics->rbearing = m->rbearing;
+	      metrics->ascent = m->ascent;
+	      metrics->descent = m->descent;
 	      first = 0;
 	    }
-	  if (metrics->lbearing > width + lbearing)
-	    metrics->lbearing = width + lbearing;
-	  if (metrics->rbearing < width + rbearing)
-	    metrics->rbearing = width + rbearing;
-	  if (metrics->ascent < ascent)
-	    metrics->ascent = ascent;
-	  if (metrics->descent > descent)
-	    metrics->descent = descent;
-	  width += advance;
+	  if (metrics->lbearing > width + m->lbearing)
+	    metrics->lbearing = width + m->lbearing;
+	  if (metrics->rbearing < width + m->rbearing)
+	    metrics->rbearing = width + m->rbearing;
+	  if (metrics->ascent < m->ascent)
+	    metrics->ascent = m->ascent;
+	  if (metrics->descent > m->descent)
+	    metrics->descent = m->descent;
+	  width += m->width;
 	}
       else
 	width += font->space_width;
@@ -3124,6 +3732,32 @@ syms_of_ftfont (void)
   staticpro (&ft_face_cache);
   ft_face_cache = Qnil;
 
+  staticpro (&ftfont_file_cache);
+  ftfont_file_cache = Qnil;
+  staticpro (&ftfont_file_cache_name);
+  ftfont_file_cache_name = Qnil;
+  staticpro (&ftfont_file_cache_stamp);
+  ftfont_file_cache_stamp = Qnil;
+  staticpro (&ftfont_file_cache_lines);
+  ftfont_file_cache_lines = Qnil;
+
+  DEFSYM (Qprint_length, "print-length");
+  DEFSYM (Qprint_level, "print-level");
+  DEFSYM (Qinternal__save_font_cache, "internal--save-font-cache");
+
+  DEFVAR_LISP ("font-cache-file", Vfont_cache_file,
+	       doc: /* File in which to record the fonts found by Fontconfig.
+If non-nil, this is the name of a file where the results of listing
+fonts, and the widths of fonts opened, are recorded for reuse by later
+sessions.  The file is started anew whenever the installed fonts or
+Fontconfig's configuration change.  If nil, nothing is recorded.
+
+To have the results reused from the start of a session, set this in
+your early init file.  */);
+  Vfont_cache_file = Qnil;
+
+  defsubr (&Sinternal__save_font_cache);
+
   pdumper_do_now_and_after_load (syms_of_ftfont_for_pdumper);
 }
 
@@ -3131,6 +3765,11 @@ static void
 syms_of_ftfont_for_pdumper (void)
 {
   PDUMPER_RESET_LV (ft_face_cache, Qnil);
+  PDUMPER_RESET_LV (ftfont_file_cache, Qnil);
+  PDUMPER_RESET_LV (ftfont_file_cache_name, Qnil);
+  PDUMPER_RESET_LV (ftfont_file_cache_stamp, Qnil);
+  PDUMPER_RESET_LV (ftfont_file_cache_lines, Qnil);
+  ftfont_file_cache_save_pending = false;
   register_font_driver (&ftfont_driver, NULL);
 #ifdef HAVE_HARFBUZZ
   fthbfont_driver = ftfont_driver;
@@ -45,10 +45,27 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 extern void ftfont_fix_match (FcPattern *, FcPattern *);
 extern void ftfont_add_rendering_parameters (FcPattern *, Lisp_Object);
 extern FcPattern *ftfont_entity_pattern (Lisp_Object, int);
+extern bool ftfont_cached_widths (Lisp_Object, int, struct font *);
+extern void ftfont_cache_widths (Lisp_Object, int, struct font *);
+
+/* The caches of glyph metrics and glyph codes in struct font_info
+   consist of rows of this many glyphs and characters.  */
+#define METRICS_NCOLS_PER_ROW	(128)
+#define GLYPH_CODES_NCOLS_PER_ROW	(256)
+
+enum metrics_status
+  {
+    METRICS_INVALID = -1,    /* metrics entry is invalid */
+    METRICS_NO_GLYPH = -2    /* the glyph couldn't be loaded */
+  };
+
+#define METRICS_STATUS(metrics)	((metrics)->ascent + (metrics)->descent)
+#define METRICS_SET_STATUS(metrics, status) \
+  ((metrics)->ascent = 0, (metrics)->descent = (status))
 
 /* This struct is shared by the XFT, Freetype, and Cairo font
-   backends.  Members up to and including 'matrix' are common, the
-   rest depend on which backend is in use.  */
+   backends.  Members up to and including 'glyph_codes_nrows' are
+   common, the rest depend on which backend is in use.  */
 struct font_info
 {
   struct font font;
@@ -59,6 +76,12 @@ struct font_info
   FT_Size ft_size;
   int index;
   FT_Matrix matrix;
+  /* Caches of glyph metrics, and of the glyph codes of characters,
+     filled in on first use.  The XFT backend doesn't use them.  */
+  struct font_metrics **metrics;
+  short metrics_nrows;
+  unsigned **glyph_codes;
+  int glyph_codes_nrows;
 #ifdef HAVE_HARFBUZZ
   hb_font_t *hb_font;
 #endif  /* HAVE_HARFBUZZ */
@@ -69,9 +92,6 @@ struct font_info
      as the hb_position_t value in HarfBuzz, to those in (scaled)
      pixels.  The value is 0 for scalable fonts.  */
   double bitmap_position_unit;
-  /* Font metrics cache.  */
-  struct font_metrics **metrics;
-  short metrics_nrows;
 #else
   /* These are used by the XFT backend.  */
   Display *display;
@@ -80,4 +100,9 @@ struct font_info
 #endif
 };
 
+extern struct font_metrics *ftfont_metrics_cache (struct font_info *,
+						  unsigned);
+extern unsigned *ftfont_glyph_code_cache (struct font_info *, int);
+extern void ftfont_free_glyph_caches (struct font_info *);
+
 #endif	/* EMACS_FTFONT_H */
@@ -1863,7 +1863,7 @@ vmotion (register ptrdiff_t from, register ptrdiff_t from_byte,
 
 	  prevline = from;
 	  DEC_BOTH (prevline, bytepos);
-	  prevline = find_newline_no_quit (prevline, bytepos, -1, &bytepos);
+	  prevline = find_display_line_start (w, prevline, bytepos, &bytepos);
 
 	  while (prevline > BEGV
 		 && ((selective > 0
@@ -1876,7 +1876,8 @@ vmotion (register ptrdiff_t from, register ptrdiff_t from_byte,
 			 TEXT_PROP_MEANS_INVISIBLE (propval))))
 	    {
 	      DEC_BOTH (prevline, bytepos);
-	      prevline = find_newline_no_quit (prevline, bytepos, -1, &bytepos);
+	      prevline = find_display_line_start (w, prevline, bytepos,
+						  &bytepos);
 	    }
 	  pos = *compute_motion (prevline, bytepos, 0, lmargin, 0, from,
 				 /* Don't care for VPOS...  */
@@ -1914,7 +1915,7 @@ vmotion (register ptrdiff_t from, register ptrdiff_t from_byte,
       ptrdiff_t bytepos;
       Lisp_Object propval;
 
-      prevline = find_newline_no_quit (from, from_byte, -1, &bytepos);
+      prevline = find_display_line_start (w, from, from_byte, &bytepos);
       while (prevline > BEGV
 	     && ((selective > 0
 		  && indented_beyond_p (prevline, bytepos, selective))
@@ -1926,7 +1927,7 @@ vmotion (register ptrdiff_t from, register ptrdiff_t from_byte,
 		     TEXT_PROP_MEANS_INVISIBLE (propval))))
 	{
 	  DEC_BOTH (prevline, bytepos);
-	  prevline = find_newline_no_quit (prevline, bytepos, -1, &bytepos);
+	  prevline = find_display_line_start (w, prevline, bytepos, &bytepos);
 	}
       pos = *compute_motion (prevline, bytepos, 0, lmargin, 0, from,
 			     /* Don't care for VPOS...  */
@@ -2105,6 +2106,7 @@ whether or not it is currently displayed in some window.  */)
 
   CHECK_FIXNUM (lines);
   w = decode_live_window (window);
+  forget_merged_faces ();
 
   if (XBUFFER (w->contents) != current_buffer)
     {
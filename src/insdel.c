@@ -1401,12 +1401,9 @@ replace_range (ptrdiff_t from, ptrdiff_t to, Lisp_Object new,
   ptrdiff_t nbytes_del, nchars_del;
   INTERVAL intervals;
   ptrdiff_t outgoing_insbytes = insbytes;
-  Lisp_Object deletion;
 
   check_markers ();
 
-  deletion = Qnil;
-
   if (prepare)
     {
       ptrdiff_t range_length = to - from;
@@ -1444,11 +1441,16 @@ replace_range (ptrdiff_t from, ptrdiff_t to, Lisp_Object new,
   if (to < GPT)
     gap_left (to, to_byte, 0);
 
-  /* Even if we don't record for undo, we must keep the original text
-     because we may have to recover it because of inappropriate byte
-     combining.  */
+  /* Record the insertion first, so that when we undo,
+     the deletion will be undone first.  Thus, undo
+     will insert before deleting, and thus will keep
+     the markers before and after this text separate.
+     Do it now, while the old text is still in the buffer.  */
   if (! EQ (BVAR (current_buffer, undo_list), Qt))
-    deletion = make_buffer_string_both (from, from_byte, to, to_byte, 1);
+    {
+      record_insert (from + nchars_del, inschars);
+      record_delete_text (from, from_byte, to, to_byte, false);
+    }
 
   GAP_SIZE += nbytes_del;
   ZV -= nchars_del;
@@ -1486,16 +1488,6 @@ replace_range (ptrdiff_t from, ptrdiff_t to, Lisp_Object new,
     emacs_abort ();
 #endif
 
-  /* Record the insertion first, so that when we undo,
-     the deletion will be undone first.  Thus, undo
-     will insert before deleting, and thus will keep
-     the markers before and after this text separate.  */
-  if (!NILP (deletion))
-    {
-      record_insert (from + SCHARS (deletion), inschars);
-      record_delete (from, deletion, false);
-    }
-
   GAP_SIZE -= outgoing_insbytes;
   GPT += inschars;
   ZV += inschars;
@@ -1840,14 +1832,18 @@ del_range_2 (ptrdiff_t from, ptrdiff_t from_byte,
     emacs_abort ();
 #endif
 
-  if (ret_string || ! EQ (BVAR (current_buffer, undo_list), Qt))
-    deletion = make_buffer_string_both (from, from_byte, to, to_byte, 1);
-  else
-    deletion = Qnil;
-
   /* Record marker adjustments, and text deletion into undo
      history.  */
-  record_delete (from, deletion, true);
+  if (ret_string)
+    {
+      deletion = make_buffer_string_both (from, from_byte, to, to_byte, 1);
+      record_delete (from, deletion, true);
+    }
+  else
+    {
+      deletion = Qnil;
+      record_delete_text (from, from_byte, to, to_byte, true);
+    }
 
   /* Relocate all markers pointing into the new, larger gap to point
      at the end of the text before the gap.  */
@@ -2071,6 +2067,9 @@ invalidate_buffer_caches (struct buffer *buf, ptrdiff_t start, ptrdiff_t end)
     invalidate_region_cache (buf,
                              buf->width_run_cache,
                              start - BUF_BEG (buf), BUF_Z (buf) - end);
+  invalidate_syntax_ppss_cache (buf, start);
+  invalidate_syntax_run_cache (buf, start);
+  invalidate_syntax_propertize (buf, start);
 }
 
 /* These macros work with an argument named `preserve_ptr'
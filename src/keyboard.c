@@ -11236,6 +11236,7 @@ The `posn-' functions access elements of such lists.  */)
     }
 
   CHECK_LIVE_FRAME (frame_or_window);
+  forget_merged_faces ();
 
   return make_lispy_position (XFRAME (frame_or_window), x, y, 0);
 }
@@ -1095,6 +1095,7 @@ enum pvec_type
   PVEC_MUTEX,
   PVEC_CONDVAR,
   PVEC_MODULE_FUNCTION,
+  PVEC_REGEXP_SET,
 
   /* These should be last, for internal_equal and sxhash_obj.  */
   PVEC_COMPILED,
@@ -2652,6 +2653,52 @@ XUSER_PTR (Lisp_Object a)
   return XUNTAG (a, Lisp_Vectorlike, struct Lisp_User_Ptr);
 }
 
+/* A set of regexps made by 'make-regexp-set'.  */
+struct Lisp_Regexp_Set
+{
+  union vectorlike_header header;
+
+  /* The regexps, a vector of strings.  */
+  Lisp_Object regexps;
+
+  /* The translate table, syntax table and whitespace regexp for which
+     the regexps were last compiled.  The syntax table is t if none of
+     the compiled regexps depends on it.  */
+  Lisp_Object translate;
+  Lisp_Object syntax_table;
+  Lisp_Object whitespace_regexp;
+
+  /* The compiled regexps, or null if they need compiling.  */
+  struct re_pattern_set *patterns;
+
+  /* The unibyte charset for which they were compiled, and the
+     generation of the regexp cache at the time.  */
+  int charset_unibyte;
+  unsigned int generation;
+
+  /* True while a search is using the compiled regexps.  */
+  bool_bf busy : 1;
+} GCALIGNED_STRUCT;
+
+INLINE bool
+REGEXP_SET_P (Lisp_Object x)
+{
+  return PSEUDOVECTORP (x, PVEC_REGEXP_SET);
+}
+
+INLINE struct Lisp_Regexp_Set *
+XREGEXP_SET (Lisp_Object a)
+{
+  eassert (REGEXP_SET_P (a));
+  return XUNTAG (a, Lisp_Vectorlike, struct Lisp_Regexp_Set);
+}
+
+INLINE void
+CHECK_REGEXP_SET (Lisp_Object x)
+{
+  CHECK_TYPE (REGEXP_SET_P (x), Qregexp_set_p, x);
+}
+
 INLINE bool
 BIGNUMP (Lisp_Object x)
 {
@@ -3618,6 +3665,13 @@ extern void syms_of_charset (void);
 struct charset;
 
 /* Defined in syntax.c.  */
+extern void invalidate_syntax_ppss_cache (struct buffer *, ptrdiff_t);
+extern void mark_syntax_ppss_cache (struct buffer *);
+extern void free_syntax_ppss_cache (struct buffer *);
+extern void invalidate_syntax_run_cache (struct buffer *, ptrdiff_t);
+extern void mark_syntax_run_cache (struct buffer *);
+extern void free_syntax_run_cache (struct buffer *);
+extern void invalidate_syntax_propertize (struct buffer *, ptrdiff_t);
 extern void init_syntax_once (void);
 extern void syms_of_syntax (void);
 
@@ -3776,6 +3830,7 @@ extern void init_xdisp (void);
 extern Lisp_Object safe_eval (Lisp_Object);
 extern bool pos_visible_p (struct window *, ptrdiff_t, int *,
 			   int *, int *, int *, int *, int *);
+extern void mark_glyph_row_cache (void);
 
 /* Defined in xsettings.c.  */
 extern void syms_of_xsettings (void);
@@ -4018,6 +4073,8 @@ extern Lisp_Object copy_char_table (Lisp_Object);
 extern Lisp_Object char_table_ref_and_range (Lisp_Object, int,
                                              int *, int *);
 extern void char_table_set_range (Lisp_Object, int, int, Lisp_Object);
+extern EMACS_INT display_char_table_tick;
+extern void note_char_table_change (Lisp_Object);
 extern void map_char_table (void (*) (Lisp_Object, Lisp_Object,
                             Lisp_Object),
                             Lisp_Object, Lisp_Object, Lisp_Object);
@@ -4287,6 +4344,7 @@ extern Lisp_Object expand_and_dir_to_file (Lisp_Object);
 extern Lisp_Object write_region (Lisp_Object, Lisp_Object, Lisp_Object,
 				 Lisp_Object, Lisp_Object, Lisp_Object,
 				 Lisp_Object, int);
+extern void finish_write_jobs (Lisp_Object, bool);
 extern void close_file_unwind (int);
 extern void fclose_unwind (void *);
 extern void restore_point_unwind (Lisp_Object);
@@ -4304,7 +4362,32 @@ extern void init_fileio (void);
 extern void syms_of_fileio (void);
 
 /* Defined in search.c.  */
+
+/* A literal string to search for byte by byte.  A byte B of text
+   matches byte I of the string if (B | MASK[I]) == PAT[I].  */
+struct literal_pattern
+{
+  /* The bytes of the pattern, and the bits to ignore in each of them.
+     PAT has the bits in MASK set.  */
+  unsigned char *pat, *mask;
+  ptrdiff_t len;
+
+  /* The offsets in the pattern of its two rarest bytes.  They are the
+     same if the pattern is one byte long.  */
+  ptrdiff_t rare1, rare2;
+};
+
+extern int literal_char_bytes (int, bool, Lisp_Object,
+			       unsigned char *, unsigned char *);
+extern void literal_pattern_finish (struct literal_pattern *,
+				    unsigned char *, unsigned char *,
+				    ptrdiff_t);
+extern unsigned char const *literal_scan (struct literal_pattern const *,
+					  unsigned char const *,
+					  unsigned char const *, bool);
 extern void shrink_regexp_cache (void);
+extern void mark_regexp_cache (void);
+extern void free_regexp_set (struct Lisp_Regexp_Set *);
 extern void restore_search_regs (void);
 extern void update_search_regs (ptrdiff_t oldstart,
                                 ptrdiff_t oldend, ptrdiff_t newend);
@@ -4328,6 +4411,10 @@ extern ptrdiff_t fast_c_string_match_ignore_case (Lisp_Object, const char *,
 						  ptrdiff_t);
 extern ptrdiff_t fast_looking_at (Lisp_Object, ptrdiff_t, ptrdiff_t,
                                   ptrdiff_t, ptrdiff_t, Lisp_Object);
+extern unsigned char *skip_newlines_forward (unsigned char *, ptrdiff_t,
+					    ptrdiff_t *, ptrdiff_t);
+extern unsigned char *skip_newlines_backward (unsigned char *, ptrdiff_t,
+					     ptrdiff_t *, ptrdiff_t);
 extern ptrdiff_t find_newline (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t,
 			       ptrdiff_t, ptrdiff_t *, ptrdiff_t *, bool);
 extern void scan_newline (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t,
@@ -4534,11 +4621,15 @@ extern void syms_of_macros (void);
 extern void truncate_undo_list (struct buffer *);
 extern void record_insert (ptrdiff_t, ptrdiff_t);
 extern void record_delete (ptrdiff_t, Lisp_Object, bool);
+extern void record_delete_text (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t,
+				bool);
 extern void record_first_change (void);
 extern void record_change (ptrdiff_t, ptrdiff_t);
 extern void record_property_change (ptrdiff_t, ptrdiff_t,
 				    Lisp_Object, Lisp_Object,
                                     Lisp_Object);
+extern void flush_undo_log (struct buffer *);
+extern void discard_undo_log (struct buffer *);
 extern void syms_of_undo (void);
 
 /* Defined in textprop.c.  */
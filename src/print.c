@@ -1725,6 +1725,15 @@ print_vectorlike (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag,
       printchar ('>', printcharfun);
       break;
 
+    case PVEC_REGEXP_SET:
+      {
+	print_c_string ("#<regexp-set ", printcharfun);
+	int len = sprintf (buf, "%"pD"d", ASIZE (XREGEXP_SET (obj)->regexps));
+	strout (buf, len, len, printcharfun);
+	printchar ('>', printcharfun);
+      }
+      break;
+
     case PVEC_RECORD:
       {
 	ptrdiff_t size = PVSIZE (obj);
@@ -28,6 +28,7 @@
 #include "regex-emacs.h"
 
 #include <stdlib.h>
+#include <flexmember.h>
 
 #include "character.h"
 #include "buffer.h"
@@ -186,12 +187,33 @@ ptrdiff_t emacs_re_safe_alloca = MAX_ALLOCA;
 typedef const unsigned char re_char;
 
 static void re_compile_fastmap (struct re_pattern_buffer *);
-static ptrdiff_t re_match_2_internal (struct re_pattern_buffer *bufp,
+struct re_memo;
+static ptrdiff_t re_match_2_internal (struct re_memo *memo,
+				     struct re_pattern_buffer *bufp,
 				     re_char *string1, ptrdiff_t size1,
 				     re_char *string2, ptrdiff_t size2,
 				     ptrdiff_t pos,
 				     struct re_registers *regs,
 				     ptrdiff_t stop);
+static ptrdiff_t re_match_2_1 (struct re_memo *, struct re_pattern_buffer *,
+			       char const *, ptrdiff_t,
+			       char const *, ptrdiff_t,
+			       ptrdiff_t, struct re_registers *, ptrdiff_t);
+static struct re_dfa *dfa_for_search (struct re_pattern_buffer *);
+static ptrdiff_t dfa_exec (struct re_dfa *, struct re_pattern_buffer *,
+			   re_char *, ptrdiff_t, re_char *, ptrdiff_t,
+			   ptrdiff_t, ptrdiff_t, ptrdiff_t);
+static ptrdiff_t dfa_search_start (struct re_dfa *, struct re_pattern_buffer *,
+				   re_char *, ptrdiff_t, re_char *, ptrdiff_t,
+				   ptrdiff_t, ptrdiff_t, ptrdiff_t);
+struct re_prefilter;
+static void prefilter_free (struct re_prefilter *);
+static struct re_prefilter *prefilter_for_search (struct re_pattern_buffer *);
+static bool prefilter_skip (struct re_prefilter const *,
+			    struct re_pattern_buffer *,
+			    re_char *, ptrdiff_t, re_char *,
+			    ptrdiff_t *, ptrdiff_t *, ptrdiff_t *, ptrdiff_t *,
+			    ptrdiff_t);
 
 /* These are the command codes that appear in compiled regular
    expressions.  Some opcodes are followed by argument bytes.  A
@@ -1766,6 +1788,7 @@ regex_compile (re_char *pattern, ptrdiff_t size,
   /* Initialize the pattern buffer.  */
   bufp->fastmap_accurate = false;
   bufp->used_syntax = false;
+  bufp->memoize = false;
 
   /* Set 'used' to zero, so that if we return an error, the pattern
      printer (for debugging) will think there's no pattern.  We reset it
@@ -3194,13 +3217,16 @@ re_search (struct re_pattern_buffer *bufp, const char *string, ptrdiff_t size,
 
    Return either the position in the strings at which the match was
    found, -1 if no match, or -2 if error (such as failure
-   stack overflow).  */
+   stack overflow).
 
-ptrdiff_t
-re_search_2 (struct re_pattern_buffer *bufp, const char *str1, ptrdiff_t size1,
-	     const char *str2, ptrdiff_t size2,
-	     ptrdiff_t startpos, ptrdiff_t range,
-	     struct re_registers *regs, ptrdiff_t stop)
+   This is the body of 're_search_2', with MEMO for the search.  */
+
+static ptrdiff_t
+re_search_2_1 (struct re_memo *memo, struct re_pattern_buffer *bufp,
+	       const char *str1, ptrdiff_t size1,
+	       const char *str2, ptrdiff_t size2,
+	       ptrdiff_t startpos, ptrdiff_t range,
+	       struct re_registers *regs, ptrdiff_t stop)
 {
   ptrdiff_t val;
   re_char *string1 = (re_char *) str1;
@@ -3249,7 +3275,7 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, ptrdiff_t size1,
     re_compile_fastmap (bufp);
 
   /* See whether the pattern is anchored.  */
-  anchored_start = (bufp->buffer[0] == begline);
+  anchored_start = bufp->used > 0 && bufp->buffer[0] == begline;
 
   gl_state.object = re_match_object; /* Used by SYNTAX_TABLE_BYTE_TO_CHAR. */
   {
@@ -3258,9 +3284,43 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, ptrdiff_t size1,
     SETUP_SYNTAX_TABLE_FOR_OBJECT (re_match_object, charpos, 1);
   }
 
+  /* If every match contains some literal, only try where it occurs.  */
+  struct re_prefilter *prefilter = prefilter_for_search (bufp);
+  ptrdiff_t literal_lo = 0, literal_hi = -1;
+  if (prefilter
+      && !prefilter_skip (prefilter, bufp, string1, size1, string2,
+			  &startpos, &range, &literal_lo, &literal_hi, stop))
+    return -1;
+
+  /* If the pattern can be run as an automaton, let it find where the
+     match starts, and run the backtracking matcher only there, for
+     the registers.  */
+  struct re_dfa *dfa = startpos <= stop ? dfa_for_search (bufp) : NULL;
+  if (dfa)
+    {
+      val = dfa_search_start (dfa, bufp, string1, size1, string2, size2,
+			      startpos, range, stop);
+      if (val == -1)
+	return -1;
+      if (val >= 0)
+	{
+	  if (!regs)
+	    return val;
+	  startpos = val;
+	  range = 0;
+	}
+    }
+
   /* Loop through the string, looking for a place to start matching.  */
   for (;;)
     {
+      if (prefilter
+	  && ! (literal_lo <= startpos && startpos <= literal_hi)
+	  && !prefilter_skip (prefilter, bufp, string1, size1, string2,
+			      &startpos, &range, &literal_lo, &literal_hi,
+			      stop))
+	return -1;
+
       /* If the pattern is anchored,
 	 skip quickly past places we cannot match.
 	 Don't bother to treat startpos == 0 specially
@@ -3362,7 +3422,7 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, ptrdiff_t size1,
 		  if (translated != ch
 		      && (ch = RE_CHAR_TO_UNIBYTE (translated)) >= 0)
 		    buf_ch = ch;
-		  if (! fastmap[TRANSLATE (buf_ch)])
+		  if (! fastmap[buf_ch])
 		    goto advance;
 		}
 	    }
@@ -3373,7 +3433,7 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, ptrdiff_t size1,
 	  && !bufp->can_be_null)
 	return -1;
 
-      val = re_match_2_internal (bufp, string1, size1, string2, size2,
+      val = re_match_2_internal (memo, bufp, string1, size1, string2, size2,
 				 startpos, regs, stop);
 
       if (val >= 0)
@@ -3762,64 +3822,2045 @@ mutually_exclusive_p (struct re_pattern_buffer *bufp, re_char *p1,
 			   && ((p2[2 + idx] & ~ p1[2 + idx]) == 0))))
 		  break;
 
-	      if (idx == p2[1])
-		{
-		  DEBUG_PRINT ("	 No match => fast loop.\n");
-		  return true;
-		}
-	      }
-	  }
-      }
-      break;
+	      if (idx == p2[1])
+		{
+		  DEBUG_PRINT ("	 No match => fast loop.\n");
+		  return true;
+		}
+	      }
+	  }
+      }
+      break;
+
+    case charset_not:
+      switch (*p1)
+	{
+	case exactn:
+	case charset:
+	  /* Reuse the code above.  */
+	  return mutually_exclusive_p (bufp, p2, p1);
+	case charset_not:
+	  /* When we have two charset_not, it's very unlikely that
+	     they don't overlap.  The union of the two sets of excluded
+	     chars should cover all possible chars, which, as a matter of
+	     fact, is virtually impossible in multibyte buffers.  */
+	  break;
+	}
+      break;
+
+    case wordend:
+      return ((re_opcode_t) *p1 == syntaxspec && p1[1] == Sword);
+    case symend:
+      return ((re_opcode_t) *p1 == syntaxspec
+              && (p1[1] == Ssymbol || p1[1] == Sword));
+    case notsyntaxspec:
+      return ((re_opcode_t) *p1 == syntaxspec && p1[1] == p2[1]);
+
+    case wordbeg:
+      return ((re_opcode_t) *p1 == notsyntaxspec && p1[1] == Sword);
+    case symbeg:
+      return ((re_opcode_t) *p1 == notsyntaxspec
+              && (p1[1] == Ssymbol || p1[1] == Sword));
+    case syntaxspec:
+      return ((re_opcode_t) *p1 == notsyntaxspec && p1[1] == p2[1]);
+
+    case wordbound:
+      return (((re_opcode_t) *p1 == notsyntaxspec
+	       || (re_opcode_t) *p1 == syntaxspec)
+	      && p1[1] == Sword);
+
+    case categoryspec:
+      return ((re_opcode_t) *p1 == notcategoryspec && p1[1] == p2[1]);
+    case notcategoryspec:
+      return ((re_opcode_t) *p1 == categoryspec && p1[1] == p2[1]);
+
+    default:
+      ;
+    }
+
+  /* Safe default.  */
+  return false;
+}
+
+
+/* Lazy DFA.
+
+   A pattern without back references, counted repetitions or '\='
+   can also be run as a deterministic automaton whose states are sets
+   of positions in the compiled pattern.  The states are built only as
+   the text reaches them, and their transitions on the characters 0
+   to 255 are remembered, so that scanning the text costs about one
+   table lookup per character however much backtracking the pattern
+   would need.
+
+   The automaton only tells whether and where a match ends; it does
+   not know which of the possible matches the backtracking matcher
+   prefers, nor what the groups match.  So 're_search_2' uses it to
+   skip the text where nothing can match and the starting positions
+   from which the match would fail, and still calls
+   're_match_2_internal' where the match is known to succeed.
+
+   The characters are tested exactly as 're_match_2_internal' tests
+   them, so the result depends on the translate table, and, for some
+   patterns, on the syntax, category and case tables: the cached
+   states are dropped whenever one of these is not the one they were
+   computed for.  Syntax-table text properties make the syntax of a
+   character depend on its position, so patterns that look at the
+   syntax are left to the backtracking matcher when
+   'parse-sexp-lookup-properties' is non-nil.  */
+
+/* The kinds of nodes in the graph of a pattern.  */
+enum dfa_node_type
+{
+  DFA_MATCH,			/* The end of the pattern.  */
+  DFA_EPSILON,			/* Go on to NEXT.  */
+  DFA_SPLIT,			/* Go on to both NEXT and ALT.  */
+
+  /* Nodes that consume a character.  */
+  DFA_CHAR,
+  DFA_ANYCHAR,
+  DFA_CHARSET,
+  DFA_SYNTAX,
+  DFA_CATEGORY,
+
+  /* Zero-width assertions.  They are tested when the character that
+     follows is known.  */
+  DFA_BEGLINE,
+  DFA_ENDLINE,
+  DFA_BEGBUF,
+  DFA_ENDBUF,
+  DFA_WORDBEG,
+  DFA_WORDEND,
+  DFA_WORDBOUND,
+  DFA_SYMBEG,
+  DFA_SYMEND
+};
+
+struct dfa_node
+{
+  unsigned char type;
+
+  /* True for notsyntaxspec, notcategoryspec and notwordbound.  */
+  bool_bf not : 1;
+
+  /* For DFA_CHAR, the character to match as 're_match_2_internal'
+     sees it in multibyte and in unibyte text.  For DFA_CHARSET, the
+     offset of the charset in the compiled pattern.  For DFA_SYNTAX
+     and DFA_CATEGORY, the syntax code or category.  */
+  int arg, arg2;
+
+  /* The nodes that follow.  */
+  int next, alt;
+};
+
+/* What a state knows about the text before its position.  */
+enum
+{
+  DFA_AT_BEG = 1,		/* At the start of the text.  */
+  DFA_AFTER_NEWLINE = 2,
+  DFA_AFTER_WORD = 4,		/* After a word constituent.  */
+  DFA_AFTER_SYMBOL = 8,		/* After a symbol constituent.  */
+  DFA_SEARCHING = 16,		/* A match can also start at the next
+				   position.  */
+  DFA_CONTEXTS = 32
+};
+
+struct dfa_state
+{
+  struct dfa_state *hash_next;
+
+  /* The states reached on the characters 0 to 255, or null if not
+     computed yet.  */
+  struct dfa_state **trans;
+
+  unsigned int hash;
+
+  /* DFA_AT_BEG etc.  */
+  int context;
+
+  /* The character before the position, if it is a multibyte word
+     constituent and the pattern tests word boundaries; otherwise -1.
+     Whether there is a word boundary between two word constituents
+     depends on the characters themselves.  */
+  int prev_char;
+
+  /* The sorted nodes that consume a character, test an assertion or
+     end the pattern.  */
+  int nnodes;
+  int nodes[FLEXIBLE_ARRAY_MEMBER];
+};
+
+struct re_dfa
+{
+  /* The graph of the pattern, or null if the pattern cannot be run as
+     an automaton.  */
+  struct dfa_node *nodes;
+  int nnodes, start;
+
+  /* The context bits that the assertions of the pattern look at.  */
+  int context_mask;
+
+  /* Whether the pattern depends on the syntax, category or case
+     tables, and whether it looks for word boundaries.  */
+  bool_bf syntax_p : 1;
+  bool_bf category_p : 1;
+  bool_bf case_p : 1;
+  bool_bf word_boundary_p : 1;
+
+  /* What the cached states were computed for.  */
+  bool_bf target_multibyte : 1;
+  Lisp_Object translate, syntax_table, category_table, case_table;
+  unsigned int tick;
+
+  /* The states, hashed.  */
+  struct dfa_state **table;
+
+  /* The states where nothing has been matched yet, by context, if
+     their 'prev_char' is -1.  */
+  struct dfa_state *initial[DFA_CONTEXTS];
+  ptrdiff_t table_size, nstates;
+
+  /* Memory used by the states, and how many times they were all
+     discarded because it grew too large.  */
+  ptrdiff_t memory;
+  unsigned int flushes;
+
+  /* Scratch space for computing states.  */
+  int *set, *work, *walk, *resolved;
+  unsigned int *mark;
+  unsigned int mark_gen;
+
+  /* The literal that every match contains, built lazily from the
+     graph by 'prefilter_get'.  */
+  struct re_prefilter *prefilter;
+};
+
+/* The largest pattern graph, and the most memory that the states of
+   one automaton can use before they are discarded.  */
+enum { DFA_MAX_NODES = 1 << 14, DFA_MAX_MEMORY = 1 << 20 };
+
+/* The most memory an automaton can use and still be kept by
+   're_shrink_dfa'.  */
+enum { DFA_KEEP_MEMORY = 1 << 16 };
+
+/* Pseudo-states returned by a transition to say that a match ends
+   before the character, or that the automaton cannot tell.  */
+static struct dfa_state dfa_match_state, dfa_undecided_state;
+
+/* Incremented by re_flush_dfa_caches.  */
+static unsigned int dfa_tick;
+
+static int
+dfa_compare_nodes (void const *a, void const *b)
+{
+  int x = *(int const *) a, y = *(int const *) b;
+  return (x > y) - (x < y);
+}
+
+/* Return the node where the jump whose offset MCNT ends at P in
+   PATTERN lands, given the first node FIRST of every instruction.
+   Return -1 if it does not land on an instruction.  */
+static int
+dfa_jump_target (re_char *pattern, ptrdiff_t used, int const *first,
+		 re_char *p, int mcnt)
+{
+  ptrdiff_t target = p - pattern + mcnt;
+
+  if (! (0 <= target && target <= used && 0 <= first[target]))
+    return -1;
+
+  /* When on_failure_jump_smart turns itself into
+     on_failure_keep_string_jump, the loop jumps back to just after it
+     and leaves through the failure point.  In the graph, the loop has
+     to go through the split instead.  */
+  if (target >= 3 && 0 <= first[target - 3]
+      && (re_opcode_t) pattern[target - 3] == on_failure_keep_string_jump)
+    target -= 3;
+  return first[target];
+}
+
+/* Build the graph of the pattern compiled in BUFP.  The result's
+   'nodes' field is null if the pattern cannot be run as an
+   automaton.  */
+static struct re_dfa *
+dfa_compile (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *dfa = xzalloc (sizeof *dfa);
+  re_char *pattern = bufp->buffer;
+  re_char *pend = pattern + bufp->used;
+  re_char *p;
+  bool multibyte = RE_MULTIBYTE_P (bufp);
+  int *first = xnmalloc (bufp->used + 1, sizeof *first);
+  int nnodes = 0;
+
+  /* First find out where the instructions start and how many nodes
+     each one needs.  */
+  for (ptrdiff_t i = 0; i <= bufp->used; i++)
+    first[i] = -1;
+  for (p = pattern; p < pend && nnodes < DFA_MAX_NODES; )
+    {
+      first[p - pattern] = nnodes;
+      switch (*p)
+	{
+	case exactn:
+	  {
+	    re_char *q = p + 2, *qend = q + p[1];
+	    for (; q < qend; nnodes++)
+	      q += multibyte ? BYTES_BY_CHAR_HEAD (*q) : 1;
+	    p = qend;
+	  }
+	  break;
+
+	case charset:
+	case charset_not:
+	  p = skip_one_char (p);
+	  nnodes++;
+	  break;
+
+	case no_op: case succeed: case anychar:
+	case begline: case endline: case begbuf: case endbuf:
+	case wordbeg: case wordend: case wordbound: case notwordbound:
+	case symbeg: case symend:
+	  p++;
+	  nnodes++;
+	  break;
+
+	case start_memory: case stop_memory:
+	case syntaxspec: case notsyntaxspec:
+	case categoryspec: case notcategoryspec:
+	  p += 2;
+	  nnodes++;
+	  break;
+
+	case jump:
+	case on_failure_jump: case on_failure_keep_string_jump:
+	case on_failure_jump_loop: case on_failure_jump_nastyloop:
+	case on_failure_jump_smart:
+	  p += 3;
+	  nnodes++;
+	  break;
+
+	default:
+	  /* Back references need the registers, counted repetitions
+	     need counters, and at_dot depends on point.  */
+	  xfree (first);
+	  return dfa;
+	}
+    }
+  if (p < pend)
+    {
+      xfree (first);
+      return dfa;
+    }
+  first[bufp->used] = nnodes++;
+
+  /* Now build the graph.  Each node goes on to the one after it
+     unless it says otherwise.  */
+  struct dfa_node *nodes = xnmalloc (nnodes, sizeof *nodes);
+  for (int i = 0; i < nnodes; i++)
+    nodes[i] = (struct dfa_node) { .type = DFA_EPSILON,
+				   .next = i + 1, .alt = -1 };
+  nodes[nnodes - 1].type = DFA_MATCH;
+
+  for (p = pattern; p < pend; )
+    {
+      struct dfa_node *n = &nodes[first[p - pattern]];
+      re_char *op = p;
+      int mcnt;
+
+      switch (*p++)
+	{
+	case exactn:
+	  {
+	    re_char *qend = p + 1 + *p;
+	    for (p++; p < qend; n++)
+	      {
+		int len, c;
+		n->type = DFA_CHAR;
+		if (multibyte)
+		  {
+		    c = STRING_CHAR_AND_LENGTH (p, len);
+		    n->arg = c;
+		    n->arg2 = RE_CHAR_TO_UNIBYTE (c);
+		  }
+		else
+		  {
+		    len = 1;
+		    n->arg = RE_CHAR_TO_MULTIBYTE (*p);
+		    n->arg2 = *p;
+		  }
+		p += len;
+	      }
+	  }
+	  break;
+
+	case succeed:
+	  n->type = DFA_MATCH;
+	  break;
+
+	case no_op:
+	  break;
+
+	case start_memory:
+	case stop_memory:
+	  p++;
+	  break;
+
+	case anychar:
+	  n->type = DFA_ANYCHAR;
+	  break;
+
+	case charset:
+	case charset_not:
+	  n->type = DFA_CHARSET;
+	  n->arg = op - pattern;
+	  if (CHARSET_RANGE_TABLE_EXISTS_P (op))
+	    {
+	      int bits = CHARSET_RANGE_TABLE_BITS (op);
+	      if (bits & (BIT_WORD | BIT_SPACE | BIT_PUNCT))
+		dfa->syntax_p = true;
+	      if (bits & (BIT_LOWER | BIT_UPPER))
+		dfa->case_p = true;
+	    }
+	  p = skip_one_char (op);
+	  break;
+
+	case syntaxspec:
+	case notsyntaxspec:
+	  n->type = DFA_SYNTAX;
+	  n->not = *op == notsyntaxspec;
+	  n->arg = *p++;
+	  dfa->syntax_p = true;
+	  break;
+
+	case categoryspec:
+	case notcategoryspec:
+	  n->type = DFA_CATEGORY;
+	  n->not = *op == notcategoryspec;
+	  n->arg = *p++;
+	  dfa->category_p = true;
+	  break;
+
+	case begline:
+	  n->type = DFA_BEGLINE;
+	  dfa->context_mask |= DFA_AT_BEG | DFA_AFTER_NEWLINE;
+	  break;
+
+	case endline:
+	  n->type = DFA_ENDLINE;
+	  break;
+
+	case begbuf:
+	  n->type = DFA_BEGBUF;
+	  dfa->context_mask |= DFA_AT_BEG;
+	  break;
+
+	case endbuf:
+	  n->type = DFA_ENDBUF;
+	  break;
+
+	case wordbeg:
+	case wordend:
+	case wordbound:
+	case notwordbound:
+	  n->type = (*op == wordbeg ? DFA_WORDBEG
+		     : *op == wordend ? DFA_WORDEND : DFA_WORDBOUND);
+	  n->not = *op == notwordbound;
+	  dfa->context_mask |= DFA_AT_BEG | DFA_AFTER_WORD;
+	  dfa->syntax_p = dfa->word_boundary_p = true;
+	  break;
+
+	case symbeg:
+	case symend:
+	  n->type = *op == symbeg ? DFA_SYMBEG : DFA_SYMEND;
+	  dfa->context_mask |= DFA_AT_BEG | DFA_AFTER_WORD | DFA_AFTER_SYMBOL;
+	  dfa->syntax_p = true;
+	  break;
+
+	case jump:
+	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
+	  n->next = dfa_jump_target (pattern, bufp->used, first, p, mcnt);
+	  if (n->next < 0)
+	    goto unsupported;
+	  break;
+
+	default:
+	  /* One of the on_failure_jump variants.  As far as whether
+	     there is a match is concerned, they all just split.  */
+	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
+	  n->type = DFA_SPLIT;
+	  n->alt = dfa_jump_target (pattern, bufp->used, first, p, mcnt);
+	  if (n->alt < 0)
+	    goto unsupported;
+	  break;
+	}
+    }
+
+  xfree (first);
+  dfa->nodes = nodes;
+  dfa->nnodes = nnodes;
+  dfa->start = 0;
+  dfa->set = xnmalloc (4 * nnodes, sizeof *dfa->set);
+  dfa->work = dfa->set + nnodes;
+  dfa->walk = dfa->work + nnodes;
+  dfa->resolved = dfa->walk + nnodes;
+  dfa->mark = xzalloc (nnodes * sizeof *dfa->mark);
+  dfa->translate = dfa->syntax_table = Qnil;
+  dfa->category_table = dfa->case_table = Qnil;
+  return dfa;
+
+ unsupported:
+  xfree (first);
+  xfree (nodes);
+  return dfa;
+}
+
+/* Discard all the states of DFA.  */
+static void
+dfa_flush (struct re_dfa *dfa)
+{
+  for (ptrdiff_t i = 0; i < dfa->table_size; i++)
+    {
+      struct dfa_state *s, *next;
+      for (s = dfa->table[i]; s; s = next)
+	{
+	  next = s->hash_next;
+	  xfree (s->trans);
+	  xfree (s);
+	}
+      dfa->table[i] = NULL;
+    }
+  memset (dfa->initial, 0, sizeof dfa->initial);
+  dfa->nstates = 0;
+  dfa->memory = 0;
+  dfa->flushes++;
+}
+
+void
+re_free_dfa (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *dfa = bufp->dfa;
+
+  if (dfa)
+    {
+      dfa_flush (dfa);
+      xfree (dfa->table);
+      xfree (dfa->nodes);
+      xfree (dfa->set);
+      xfree (dfa->mark);
+      prefilter_free (dfa->prefilter);
+      xfree (dfa);
+      bufp->dfa = NULL;
+    }
+}
+
+/* Free the automaton of BUFP if its graph and states take much memory.
+   Its states are recomputed anyway after 're_flush_dfa_caches'.  */
+void
+re_shrink_dfa (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *dfa = bufp->dfa;
+
+  if (dfa && (DFA_KEEP_MEMORY
+	      < dfa->memory + dfa->nnodes * (ptrdiff_t) sizeof *dfa->nodes))
+    re_free_dfa (bufp);
+}
+
+void
+re_flush_dfa_caches (void)
+{
+  dfa_tick++;
+}
+
+/* Start a new set of nodes in DFA.  */
+static void
+dfa_new_mark (struct re_dfa *dfa)
+{
+  if (++dfa->mark_gen == 0)
+    {
+      memset (dfa->mark, 0, dfa->nnodes * sizeof *dfa->mark);
+      dfa->mark_gen = 1;
+    }
+}
+
+/* Add to OUT, which has N elements, the nodes not in the current set
+   that consume a character, test an assertion or end the pattern,
+   and that can be reached from node I without consuming anything.
+   Return the new number of elements.  */
+static int
+dfa_closure (struct re_dfa *dfa, int i, int *out, int n)
+{
+  int *walk = dfa->walk, sp = 0;
+  unsigned int *mark = dfa->mark, gen = dfa->mark_gen;
+
+  if (mark[i] == gen)
+    return n;
+  mark[i] = gen;
+  walk[sp++] = i;
+  while (sp > 0)
+    {
+      struct dfa_node *node = &dfa->nodes[walk[--sp]];
+      switch (node->type)
+	{
+	case DFA_SPLIT:
+	  if (mark[node->alt] != gen)
+	    {
+	      mark[node->alt] = gen;
+	      walk[sp++] = node->alt;
+	    }
+	  FALLTHROUGH;
+	case DFA_EPSILON:
+	  if (mark[node->next] != gen)
+	    {
+	      mark[node->next] = gen;
+	      walk[sp++] = node->next;
+	    }
+	  break;
+
+	default:
+	  out[n++] = node - dfa->nodes;
+	}
+    }
+  return n;
+}
+
+/* Return the state of DFA with CONTEXT, PREV_CHAR and the N NODES,
+   creating it if needed.  This can discard all the other states.  */
+static struct dfa_state *
+dfa_intern (struct re_dfa *dfa, int context, int prev_char,
+	    int *nodes, int n)
+{
+  unsigned int hash = context * 31u + prev_char;
+  struct dfa_state *s;
+
+  qsort (nodes, n, sizeof *nodes, dfa_compare_nodes);
+  for (int i = 0; i < n; i++)
+    hash = hash * 33u + nodes[i];
+
+  if (dfa->table)
+    for (s = dfa->table[hash & (dfa->table_size - 1)]; s; s = s->hash_next)
+      if (s->hash == hash && s->context == context
+	  && s->prev_char == prev_char && s->nnodes == n
+	  && memcmp (s->nodes, nodes, n * sizeof *nodes) == 0)
+	return s;
+
+  if (dfa->memory > DFA_MAX_MEMORY)
+    dfa_flush (dfa);
+
+  /* Keep the table at most half full.  */
+  if (dfa->nstates >= dfa->table_size / 2)
+    {
+      ptrdiff_t size = dfa->table_size ? 2 * dfa->table_size : 64;
+      struct dfa_state **table = xzalloc (size * sizeof *table);
+      for (ptrdiff_t i = 0; i < dfa->table_size; i++)
+	{
+	  struct dfa_state *next;
+	  for (s = dfa->table[i]; s; s = next)
+	    {
+	      next = s->hash_next;
+	      s->hash_next = table[s->hash & (size - 1)];
+	      table[s->hash & (size - 1)] = s;
+	    }
+	}
+      xfree (dfa->table);
+      dfa->table = table;
+      dfa->table_size = size;
+    }
+
+  ptrdiff_t nbytes = FLEXSIZEOF (struct dfa_state, nodes, n * sizeof *nodes);
+  s = xmalloc (nbytes);
+  s->trans = NULL;
+  s->hash = hash;
+  s->context = context;
+  s->prev_char = prev_char;
+  s->nnodes = n;
+  memcpy (s->nodes, nodes, n * sizeof *nodes);
+  s->hash_next = dfa->table[hash & (dfa->table_size - 1)];
+  dfa->table[hash & (dfa->table_size - 1)] = s;
+  dfa->nstates++;
+  dfa->memory += nbytes;
+  return s;
+}
+
+/* Return the context bits of DFA for the position after the character
+   C, in its multibyte form, and set *PREV_CHAR as described in
+   struct dfa_state.  */
+static int
+dfa_context_after (struct re_dfa *dfa, int c, int *prev_char)
+{
+  int context = c == '\n' ? DFA_AFTER_NEWLINE : 0;
+
+  *prev_char = -1;
+  if (dfa->context_mask & DFA_AFTER_WORD)
+    {
+      enum syntaxcode syntax = SYNTAX (c);
+      if (syntax == Sword)
+	{
+	  context |= DFA_AFTER_WORD;
+	  if (dfa->word_boundary_p && !SINGLE_BYTE_CHAR_P (c))
+	    *prev_char = c;
+	}
+      else if (syntax == Ssymbol)
+	context |= DFA_AFTER_SYMBOL;
+    }
+  return context & dfa->context_mask;
+}
+
+/* Return 1 if there is a word boundary between the word constituents
+   C1, as recorded in a state's 'prev_char', and C2, 0 if not, and -1
+   if that cannot be told without knowing C1.  */
+static int
+dfa_word_boundary (int c1, int c2)
+{
+  if (c1 < 0)
+    return SINGLE_BYTE_CHAR_P (c2) ? 0 : -1;
+  return word_boundary_p (c1, c2);
+}
+
+/* Return 1 if the assertion NODE holds at the position of state S
+   when the character C follows it, 0 if it does not, and -1 if this
+   cannot be told.  C is -1 at the end of the text, and is as
+   RE_STRING_CHAR returns it otherwise.  AT_STOP means that C is past
+   the end of the text that can be matched.  This follows the
+   corresponding cases of re_match_2_internal.  */
+static int
+dfa_assertion (struct re_pattern_buffer *bufp, struct dfa_node *node,
+	       struct dfa_state *s, int c, bool at_stop)
+{
+  bool at_beg = s->context & DFA_AT_BEG, at_end = c < 0;
+  bool word1 = s->context & DFA_AFTER_WORD;
+  bool symbol1 = s->context & (DFA_AFTER_WORD | DFA_AFTER_SYMBOL);
+  /* The character as GET_CHAR_AFTER returns it.  */
+  int c2 = at_end || RE_TARGET_MULTIBYTE_P (bufp) ? c : RE_CHAR_TO_MULTIBYTE (c);
+  enum syntaxcode syntax;
+
+  switch (node->type)
+    {
+    case DFA_BEGLINE:
+      return at_beg || (s->context & DFA_AFTER_NEWLINE);
+
+    case DFA_ENDLINE:
+      return at_end || c == '\n';
+
+    case DFA_BEGBUF:
+      return at_beg;
+
+    case DFA_ENDBUF:
+      return at_end;
+
+    case DFA_WORDBOUND:
+      {
+	int bound;
+	if (at_beg || at_end)
+	  bound = 1;
+	else if (word1 != (SYNTAX (c2) == Sword))
+	  bound = 1;
+	else if (!word1)
+	  bound = 0;
+	else
+	  {
+	    bound = dfa_word_boundary (s->prev_char, c2);
+	    if (bound < 0)
+	      return -1;
+	  }
+	return bound != node->not;
+      }
+
+    case DFA_WORDBEG:
+      if (at_end || at_stop || SYNTAX (c2) != Sword)
+	return 0;
+      if (at_beg || !word1)
+	return 1;
+      return dfa_word_boundary (s->prev_char, c2);
+
+    case DFA_WORDEND:
+      if (at_beg || !word1)
+	return 0;
+      if (at_end || SYNTAX (c2) != Sword)
+	return 1;
+      return dfa_word_boundary (s->prev_char, c2);
+
+    case DFA_SYMBEG:
+      if (at_end || at_stop)
+	return 0;
+      syntax = SYNTAX (c);
+      if (syntax != Sword && syntax != Ssymbol)
+	return 0;
+      return at_beg || !symbol1;
+
+    case DFA_SYMEND:
+      if (at_beg || !symbol1)
+	return 0;
+      if (at_end)
+	return 1;
+      syntax = SYNTAX (c);
+      return syntax != Sword && syntax != Ssymbol;
+
+    default:
+      abort ();
+    }
+}
+
+/* Return true if NODE, which consumes a character, matches C as
+   RE_STRING_CHAR returns it.  This follows the corresponding cases of
+   re_match_2_internal.  */
+static bool
+dfa_consumes (struct re_pattern_buffer *bufp, struct dfa_node *node, int c)
+{
+  Lisp_Object translate = bufp->translate;
+  bool target_multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+
+  switch (node->type)
+    {
+    case DFA_CHAR:
+      if (target_multibyte)
+	return TRANSLATE (c) == node->arg;
+      else
+	{
+	  int buf_ch = RE_CHAR_TO_MULTIBYTE (c);
+	  if (! CHAR_BYTE8_P (buf_ch))
+	    {
+	      buf_ch = TRANSLATE (buf_ch);
+	      buf_ch = RE_CHAR_TO_UNIBYTE (buf_ch);
+	      if (buf_ch < 0)
+		buf_ch = c;
+	    }
+	  else
+	    buf_ch = c;
+	  return buf_ch == node->arg2;
+	}
+
+    case DFA_ANYCHAR:
+      return TRANSLATE (c) != '\n';
+
+    case DFA_CHARSET:
+      {
+	bool unibyte_char = false;
+	int corig = c;
+	re_char *p = bufp->buffer + node->arg;
+
+	if (target_multibyte)
+	  {
+	    int c1;
+
+	    c = TRANSLATE (c);
+	    c1 = RE_CHAR_TO_UNIBYTE (c);
+	    if (c1 >= 0)
+	      {
+		unibyte_char = true;
+		c = c1;
+	      }
+	  }
+	else
+	  {
+	    int c1 = RE_CHAR_TO_MULTIBYTE (c);
+
+	    if (! CHAR_BYTE8_P (c1))
+	      {
+		c1 = TRANSLATE (c1);
+		c1 = RE_CHAR_TO_UNIBYTE (c1);
+		if (c1 >= 0)
+		  {
+		    unibyte_char = true;
+		    c = c1;
+		  }
+	      }
+	    else
+	      unibyte_char = true;
+	  }
+	return execute_charset (&p, c, corig, unibyte_char);
+      }
+
+    case DFA_SYNTAX:
+      if (!target_multibyte)
+	c = RE_CHAR_TO_MULTIBYTE (c);
+      return (SYNTAX (c) == node->arg) != node->not;
+
+    case DFA_CATEGORY:
+      if (!target_multibyte)
+	c = RE_CHAR_TO_MULTIBYTE (c);
+      return CHAR_HAS_CATEGORY (c, node->arg) != node->not;
+
+    default:
+      abort ();
+    }
+}
+
+/* Test the assertions of state S against the character C that
+   follows, as described for dfa_assertion.  Store in DFA->resolved
+   the nodes that consume a character and that are in S or reached
+   through the assertions that hold.  Return their number, or -1 if
+   the pattern matches at the position of S, or -2 if the assertions
+   cannot be tested.  */
+static int
+dfa_resolve (struct re_dfa *dfa, struct re_pattern_buffer *bufp,
+	     struct dfa_state *s, int c, bool at_stop)
+{
+  int *work = dfa->work, nwork = 0, n = 0;
+
+  dfa_new_mark (dfa);
+  for (int i = 0; i < s->nnodes; i++)
+    {
+      dfa->mark[s->nodes[i]] = dfa->mark_gen;
+      work[nwork++] = s->nodes[i];
+    }
+
+  while (nwork > 0)
+    {
+      int i = work[--nwork];
+      struct dfa_node *node = &dfa->nodes[i];
+
+      switch (node->type)
+	{
+	case DFA_MATCH:
+	  return -1;
+
+	case DFA_CHAR: case DFA_ANYCHAR: case DFA_CHARSET:
+	case DFA_SYNTAX: case DFA_CATEGORY:
+	  dfa->resolved[n++] = i;
+	  break;
+
+	default:
+	  switch (dfa_assertion (bufp, node, s, c, at_stop))
+	    {
+	    case -1:
+	      return -2;
+	    case 1:
+	      nwork = dfa_closure (dfa, node->next, work, nwork);
+	      break;
+	    }
+	}
+    }
+  return n;
+}
+
+/* Return the state that DFA reaches from state S on the character C,
+   as RE_STRING_CHAR returns it, or one of the pseudo-states
+   dfa_match_state and dfa_undecided_state.  */
+static struct dfa_state *
+dfa_step (struct re_dfa *dfa, struct re_pattern_buffer *bufp,
+	  struct dfa_state *s, int c)
+{
+  int nresolved = dfa_resolve (dfa, bufp, s, c, false);
+  struct dfa_state *next;
+
+  if (nresolved == -1)
+    next = &dfa_match_state;
+  else if (nresolved == -2)
+    next = &dfa_undecided_state;
+  else
+    {
+      int n = 0, context, prev_char;
+      unsigned int flushes = dfa->flushes;
+
+      dfa_new_mark (dfa);
+      for (int i = 0; i < nresolved; i++)
+	{
+	  struct dfa_node *node = &dfa->nodes[dfa->resolved[i]];
+	  if (dfa_consumes (bufp, node, c))
+	    n = dfa_closure (dfa, node->next, dfa->set, n);
+	}
+      if (s->context & DFA_SEARCHING)
+	n = dfa_closure (dfa, dfa->start, dfa->set, n);
+
+      context = dfa_context_after (dfa, (RE_TARGET_MULTIBYTE_P (bufp)
+					 ? c : RE_CHAR_TO_MULTIBYTE (c)),
+				   &prev_char);
+      next = dfa_intern (dfa, context | (s->context & DFA_SEARCHING),
+			 prev_char, dfa->set, n);
+      if (dfa->flushes != flushes)
+	return next;		/* S is gone.  */
+    }
+
+  if (c < 256)
+    {
+      if (!s->trans)
+	{
+	  s->trans = xzalloc (256 * sizeof *s->trans);
+	  dfa->memory += 256 * sizeof *s->trans;
+	}
+      s->trans[c] = next;
+    }
+  return next;
+}
+
+/* Return the character at position POS of the virtual concatenation
+   of STRING1 and STRING2, as RE_STRING_CHAR returns it, and set *LEN
+   to its length.  */
+static int
+dfa_char_at (struct re_pattern_buffer *bufp, re_char *string1,
+	     ptrdiff_t size1, re_char *string2, ptrdiff_t pos, int *len)
+{
+  re_char *p = pos < size1 ? string1 + pos : string2 + (pos - size1);
+  return RE_STRING_CHAR_AND_LENGTH (p, *len, RE_TARGET_MULTIBYTE_P (bufp));
+}
+
+/* Return the state of DFA at position POS, before anything has been
+   matched.  SEARCHING says whether a match can also start after POS.  */
+static struct dfa_state *
+dfa_initial_state (struct re_dfa *dfa, struct re_pattern_buffer *bufp,
+		   re_char *string1, ptrdiff_t size1, re_char *string2,
+		   ptrdiff_t pos, bool searching)
+{
+  int context = 0, prev_char = -1, n;
+
+  if (pos == 0)
+    context = DFA_AT_BEG & dfa->context_mask;
+  else if (dfa->context_mask)
+    {
+      /* Find the character before POS, as GET_CHAR_BEFORE_2 does.  */
+      re_char *p = pos <= size1 ? string1 + pos : string2 + (pos - size1);
+      re_char *lim = pos <= size1 ? string1 : string2;
+      int c;
+
+      if (RE_TARGET_MULTIBYTE_P (bufp))
+	{
+	  p--;
+	  while (p > lim && !CHAR_HEAD_P (*p))
+	    p--;
+	  c = STRING_CHAR (p);
+	}
+      else
+	c = RE_CHAR_TO_MULTIBYTE (p[-1]);
+      context = dfa_context_after (dfa, c, &prev_char);
+    }
+  if (searching)
+    context |= DFA_SEARCHING;
+
+  if (prev_char < 0 && dfa->initial[context])
+    return dfa->initial[context];
+  dfa_new_mark (dfa);
+  n = dfa_closure (dfa, dfa->start, dfa->set, 0);
+  struct dfa_state *s = dfa_intern (dfa, context, prev_char, dfa->set, n);
+  if (prev_char < 0)
+    dfa->initial[context] = s;
+  return s;
+}
+
+/* Run DFA, the automaton of BUFP, on the virtual concatenation of
+   STRING1 and STRING2 from POS, without matching past STOP.  A match
+   can start at any character boundary from POS to LAST_START, or only
+   at POS if LAST_START is less than POS.  Return the first position
+   where a match ends, -1 if there is no match, or -2 if the automaton
+   cannot tell.  */
+static ptrdiff_t
+dfa_exec (struct re_dfa *dfa, struct re_pattern_buffer *bufp,
+	  re_char *string1, ptrdiff_t size1,
+	  re_char *string2, ptrdiff_t size2,
+	  ptrdiff_t pos, ptrdiff_t last_start, ptrdiff_t stop)
+{
+  struct dfa_state *s
+    = dfa_initial_state (dfa, bufp, string1, size1, string2, pos,
+			 pos < last_start);
+  unsigned short quit_count = 0;
+  int c, len, r;
+
+  for (ptrdiff_t d = pos; d < stop; d += len)
+    {
+      struct dfa_state *next;
+
+      c = dfa_char_at (bufp, string1, size1, string2, d, &len);
+      if ((s->context & DFA_SEARCHING) && d + len > last_start)
+	{
+	  /* No match can start after this character; forget about the
+	     new matches.  */
+	  memcpy (dfa->set, s->nodes, s->nnodes * sizeof *s->nodes);
+	  s = dfa_intern (dfa, s->context & ~DFA_SEARCHING, s->prev_char,
+			  dfa->set, s->nnodes);
+	}
+
+      next = c < 256 && s->trans ? s->trans[c] : NULL;
+      if (!next)
+	next = dfa_step (dfa, bufp, s, c);
+      if (next == &dfa_match_state)
+	return d;
+      if (next == &dfa_undecided_state)
+	return -2;
+      if (next->nnodes == 0)
+	return -1;
+      s = next;
+      rarely_quit (++quit_count);
+    }
+
+  c = (stop < size1 + size2
+       ? dfa_char_at (bufp, string1, size1, string2, stop, &len) : -1);
+  r = dfa_resolve (dfa, bufp, s, c, true);
+  return r == -1 ? stop : r == -2 ? -2 : -1;
+}
+
+/* Return where the match that 're_search_2' looks for starts in the
+   virtual concatenation of STRING1 and STRING2, running DFA, the
+   automaton of BUFP, without matching past STOP: the first start
+   from STARTPOS to STARTPOS + RANGE if RANGE is not negative, or the
+   last one from STARTPOS + RANGE to STARTPOS otherwise.  Return -1 if
+   there is no match, or -2 if the automaton cannot tell.
+
+   The automaton only tells whether a match starts in a window of
+   positions.  So look for the match in windows that double in size
+   going away from STARTPOS, since it is often near it, and then
+   narrow the window where it was found by bisection.  This runs the
+   automaton a logarithmic number of times, over about twice the text
+   between STARTPOS and the match, instead of once at every position.  */
+static ptrdiff_t
+dfa_search_start (struct re_dfa *dfa, struct re_pattern_buffer *bufp,
+		  re_char *string1, ptrdiff_t size1,
+		  re_char *string2, ptrdiff_t size2,
+		  ptrdiff_t startpos, ptrdiff_t range, ptrdiff_t stop)
+{
+  bool multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+  ptrdiff_t total_size = size1 + size2;
+  ptrdiff_t lo, hi, mid, last, val;
+
+  if (range >= 0)
+    {
+      /* Fail at once if there is no match at all.  Otherwise, the
+	 first match to end ends at VAL, so the first match starts
+	 there at the latest.  */
+      last = min (startpos + range, stop);
+      val = dfa_exec (dfa, bufp, string1, size1, string2, size2,
+		      startpos, last, stop);
+      if (val < 0)
+	return val;
+      last = min (last, val);
+
+      /* No match starts between STARTPOS and LO - 1.  */
+      lo = startpos;
+      for (ptrdiff_t width = 1; ; width *= 2)
+	{
+	  hi = min (last, lo + width - 1);
+	  val = dfa_exec (dfa, bufp, string1, size1, string2, size2,
+			  lo, hi, stop);
+	  if (val == -2)
+	    return -2;
+	  if (val >= 0)
+	    break;
+	  if (hi == last)
+	    return -1;
+	  lo = hi + 1;
+	  if (multibyte)
+	    while (lo < last && !CHAR_HEAD_P (*POS_ADDR_VSTRING (lo)))
+	      lo++;
+	}
+
+      /* A match starts between LO and HI.  */
+      while (lo < hi)
+	{
+	  mid = lo + (hi - lo) / 2;
+	  val = dfa_exec (dfa, bufp, string1, size1, string2, size2,
+			  lo, mid, stop);
+	  if (val == -2)
+	    return -2;
+	  if (val >= 0)
+	    hi = mid;
+	  else
+	    {
+	      lo = mid + 1;
+	      if (multibyte)
+		while (lo < hi && lo < total_size
+		       && !CHAR_HEAD_P (*POS_ADDR_VSTRING (lo)))
+		  lo++;
+	    }
+	}
+      return lo;
+    }
+
+  /* No match starts between HI + 1 and STARTPOS.  */
+  last = startpos + range;
+  hi = startpos;
+  for (ptrdiff_t width = 1; ; width *= 2)
+    {
+      lo = max (last, hi - width + 1);
+      if (multibyte)
+	while (lo > last && !CHAR_HEAD_P (*POS_ADDR_VSTRING (lo)))
+	  lo--;
+      val = dfa_exec (dfa, bufp, string1, size1, string2, size2,
+		      lo, hi, stop);
+      if (val == -2)
+	return -2;
+      if (val >= 0)
+	break;
+      if (lo == last)
+	return -1;
+      hi = lo - 1;
+    }
+
+  /* A match starts between LO and HI, at a character boundary.  */
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo + 1) / 2;
+      if (multibyte)
+	{
+	  while (mid > lo && mid < total_size
+		 && !CHAR_HEAD_P (*POS_ADDR_VSTRING (mid)))
+	    mid--;
+	  if (mid == lo)
+	    {
+	      mid = lo + BYTES_BY_CHAR_HEAD (*POS_ADDR_VSTRING (lo));
+	      if (mid > hi)
+		break;
+	    }
+	}
+      val = dfa_exec (dfa, bufp, string1, size1, string2, size2,
+		      mid, hi, stop);
+      if (val == -2)
+	return -2;
+      if (val >= 0)
+	lo = mid;
+      else
+	hi = mid - 1;
+    }
+  return lo;
+}
+
+/* Return the automaton for BUFP, building it if needed, or null if
+   BUFP cannot be run as an automaton here.  Call this after setting
+   up gl_state for the text to search.  */
+static struct re_dfa *
+dfa_for_search (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *dfa;
+  Lisp_Object syntax_table, category_table, case_table;
+
+  if (!regexp_use_dfa)
+    return NULL;
+  dfa = bufp->dfa;
+  if (!dfa)
+    dfa = bufp->dfa = dfa_compile (bufp);
+  if (!dfa->nodes || (dfa->syntax_p && parse_sexp_lookup_properties))
+    return NULL;
+
+  syntax_table = dfa->syntax_p ? gl_state.current_syntax_table : Qnil;
+  category_table = (dfa->category_p
+		    ? BVAR (current_buffer, category_table) : Qnil);
+  case_table = dfa->case_p ? BVAR (current_buffer, downcase_table) : Qnil;
+  if (dfa->tick != dfa_tick
+      || dfa->target_multibyte != RE_TARGET_MULTIBYTE_P (bufp)
+      || !EQ (dfa->translate, bufp->translate)
+      || !EQ (dfa->syntax_table, syntax_table)
+      || !EQ (dfa->category_table, category_table)
+      || !EQ (dfa->case_table, case_table))
+    {
+      dfa_flush (dfa);
+      dfa->tick = dfa_tick;
+      dfa->target_multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+      dfa->translate = bufp->translate;
+      dfa->syntax_table = syntax_table;
+      dfa->category_table = category_table;
+      dfa->case_table = case_table;
+    }
+  return dfa;
+}
+
+
+/* Required literals.
+
+   Every match for many patterns contains some literal string, such
+   as "(defun " for "^\\s-*(defun \\(\\sw+\\)".  Before trying to match
+   at a position, 're_search_2' makes sure that the string occurs
+   where a match from there would have it; looking for the string with
+   'literal_scan' is much faster than trying to match everywhere.  The
+   string is a run of character nodes of the graph of the automaton
+   that lie on every path from the start to a match, each of them the
+   only way into the next.  */
+
+struct re_prefilter
+{
+  /* What the prefilter was made for.  */
+  Lisp_Object translate;
+  bool_bf target_multibyte : 1;
+
+  /* The characters of the literal, as in the pattern, or null if the
+     pattern has no literal that can be searched for.  */
+  int *chars;
+  ptrdiff_t nchars;
+
+  /* The literal as bytes of the text.  */
+  struct literal_pattern lp;
+
+  /* The most characters that a match can have before the literal, or
+     -1 if there is no limit.  */
+  ptrdiff_t max_before;
+};
+
+static void
+prefilter_free (struct re_prefilter *pf)
+{
+  if (pf)
+    {
+      xfree (pf->chars);
+      xfree (pf->lp.pat);
+      xfree (pf);
+    }
+}
+
+/* Store the successors of node I of DFA in SUCC and return how many
+   there are.  Node DFA->nnodes stands for a match, and follows every
+   DFA_MATCH node.  */
+static int
+prefilter_successors (struct re_dfa const *dfa, int i, int succ[2])
+{
+  if (i == dfa->nnodes)
+    return 0;
+  switch (dfa->nodes[i].type)
+    {
+    case DFA_MATCH:
+      succ[0] = dfa->nnodes;
+      return 1;
+    case DFA_SPLIT:
+      succ[0] = dfa->nodes[i].next;
+      succ[1] = dfa->nodes[i].alt;
+      return 2;
+    default:
+      succ[0] = dfa->nodes[i].next;
+      return 1;
+    }
+}
+
+/* Return true if node N of a graph consumes a character.  */
+static bool
+prefilter_consumes (struct dfa_node const *n)
+{
+  return DFA_CHAR <= n->type && n->type <= DFA_CATEGORY;
+}
+
+/* Store in PAT and MASK the bytes of text that match the character
+   node N of BUFP, as 'literal_char_bytes' does, and return how many
+   there are, or 0 if N cannot be matched byte by byte.  INVERSE is
+   the table of case equivalences of the translation table of BUFP,
+   or t if it is not known.  */
+static int
+prefilter_char_bytes (struct re_pattern_buffer *bufp, struct dfa_node const *n,
+		      Lisp_Object inverse,
+		      unsigned char *pat, unsigned char *mask)
+{
+  Lisp_Object translate = bufp->translate;
+  bool multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+  int c = multibyte ? n->arg : n->arg2;
+
+  if (c < 0)
+    return 0;
+  if (!NILP (translate))
+    {
+      if (EQ (inverse, Qt) || TRANSLATE (n->arg) != n->arg
+	  || (!multibyte && !ASCII_CHAR_P (c)))
+	return 0;
+    }
+  return literal_char_bytes (c, multibyte, inverse, pat, mask);
+}
+
+/* Return the number of nodes on the longest path in DFA from its start
+   to node TARGET, not counting TARGET and counting only the nodes that
+   consume a character, or -1 if there are paths of any length.  PRED
+   and NPRED are the predecessors of each node, as in
+   'prefilter_compile'.  */
+static ptrdiff_t
+prefilter_max_before (struct re_dfa const *dfa, int target,
+		      int const *pred, int const *npred)
+{
+  int n = dfa->nnodes + 1;
+  ptrdiff_t result = -1;
+  /* The nodes from which TARGET can be reached without going through
+     it have MARK 1; they get 2 while they are being visited, and 3
+     once LONGEST holds the longest path from them to TARGET.  */
+  unsigned char *mark = xzalloc (n);
+  ptrdiff_t *longest = xnmalloc (n, sizeof *longest);
+  int *stack = xnmalloc (2 * n, sizeof *stack);
+  int sp = 0;
+
+  if (target == dfa->start)
+    {
+      result = 0;
+      goto done;
+    }
+
+  /* Walk back from TARGET.  */
+  stack[sp++] = target;
+  while (sp)
+    {
+      int v = stack[--sp];
+      for (int j = npred[v]; j < npred[v + 1]; j++)
+	if (pred[j] != target && !mark[pred[j]])
+	  {
+	    mark[pred[j]] = 1;
+	    stack[sp++] = pred[j];
+	  }
+    }
+  if (!mark[dfa->start])
+    goto done;
+
+  /* Then walk forward from the start, depth first.  Each stack entry
+     is a node and the index of its next successor.  */
+  mark[target] = 3;
+  longest[target] = 0;
+  stack[sp++] = dfa->start;
+  stack[sp++] = 0;
+  mark[dfa->start] = 2;
+  longest[dfa->start] = 0;
+  while (sp)
+    {
+      int v = stack[sp - 2], k = stack[sp - 1];
+      int succ[2], nsucc = prefilter_successors (dfa, v, succ);
+
+      if (k < nsucc)
+	{
+	  int w = succ[k];
+	  stack[sp - 1]++;
+	  if (mark[w] == 1)
+	    {
+	      mark[w] = 2;
+	      longest[w] = 0;
+	      stack[sp++] = w;
+	      stack[sp++] = 0;
+	    }
+	  else if (mark[w] == 2)
+	    /* A loop.  */
+	    goto done;
+	  if (mark[w] == 3)
+	    longest[v] = max (longest[v], longest[w]);
+	}
+      else
+	{
+	  longest[v] += prefilter_consumes (&dfa->nodes[v]);
+	  mark[v] = 3;
+	  sp -= 2;
+	  if (sp)
+	    {
+	      int u = stack[sp - 2];
+	      longest[u] = max (longest[u], longest[v]);
+	    }
+	}
+    }
+  result = longest[dfa->start];
+
+ done:
+  xfree (mark);
+  xfree (longest);
+  xfree (stack);
+  return result;
+}
+
+/* Find the literal that every match for BUFP contains, using its graph
+   DFA, and return a new prefilter for it.  */
+static struct re_prefilter *
+prefilter_compile (struct re_dfa *dfa, struct re_pattern_buffer *bufp)
+{
+  struct re_prefilter *pf = xzalloc (sizeof *pf);
+  int n = dfa->nnodes + 1, sink = dfa->nnodes;
+  Lisp_Object translate = bufp->translate, inverse = Qnil;
+
+  pf->translate = translate;
+  pf->target_multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+  pf->max_before = -1;
+
+  /* A case canonicalization table has the equivalences in its third
+     extra slot; see set_case_table.  */
+  if (!NILP (translate))
+    {
+      inverse = Qt;
+      if (CHAR_TABLE_P (translate)
+	  && CHAR_TABLE_EXTRA_SLOTS (XCHAR_TABLE (translate)) > 2
+	  && CHAR_TABLE_P (XCHAR_TABLE (translate)->extras[2]))
+	inverse = XCHAR_TABLE (translate)->extras[2];
+    }
+
+  /* Number the nodes in reverse postorder, and find the predecessors
+     of each one.  NPRED[V] is the index in PRED of the first
+     predecessor of V.  */
+  int *order = xnmalloc (n, sizeof *order);
+  int *number = xnmalloc (n, sizeof *number);
+  int *npred = xzalloc ((n + 1) * sizeof *npred);
+  int *pred = xnmalloc (2 * n, sizeof *pred);
+  int *idom = xnmalloc (n, sizeof *idom);
+  int *stack = xnmalloc (2 * n, sizeof *stack);
+  int sp = 0, norder = n;
+
+  for (int v = 0; v < n; v++)
+    number[v] = -1;
+  stack[sp++] = dfa->start;
+  stack[sp++] = 0;
+  number[dfa->start] = 0;
+  while (sp)
+    {
+      int v = stack[sp - 2], k = stack[sp - 1];
+      int succ[2], nsucc = prefilter_successors (dfa, v, succ);
+      if (k < nsucc)
+	{
+	  stack[sp - 1]++;
+	  npred[succ[k] + 1]++;
+	  if (number[succ[k]] < 0)
+	    {
+	      number[succ[k]] = 0;
+	      stack[sp++] = succ[k];
+	      stack[sp++] = 0;
+	    }
+	}
+      else
+	{
+	  order[--norder] = v;
+	  sp -= 2;
+	}
+    }
+  for (int i = norder; i < n; i++)
+    number[order[i]] = i;
+  for (int v = 0; v < n; v++)
+    npred[v + 1] += npred[v];
+  {
+    int *fill = idom;
+    memcpy (fill, npred, n * sizeof *fill);
+    for (int i = norder; i < n; i++)
+      {
+	int succ[2], nsucc = prefilter_successors (dfa, order[i], succ);
+	for (int k = 0; k < nsucc; k++)
+	  pred[fill[succ[k]]++] = order[i];
+      }
+  }
+
+  if (number[sink] < 0)
+    goto done;
+
+  /* Find the immediate dominators, as in Cooper, Harvey and Kennedy,
+     "A Simple, Fast Dominance Algorithm".  */
+  for (int v = 0; v < n; v++)
+    idom[v] = -1;
+  idom[dfa->start] = dfa->start;
+  for (bool changed = true; changed; )
+    {
+      changed = false;
+      for (int i = norder + 1; i < n; i++)
+	{
+	  int v = order[i], new_idom = -1;
+	  for (int j = npred[v]; j < npred[v + 1]; j++)
+	    {
+	      int p = pred[j];
+	      if (idom[p] < 0)
+		continue;
+	      if (new_idom < 0)
+		new_idom = p;
+	      else
+		while (p != new_idom)
+		  {
+		    while (number[p] > number[new_idom])
+		      p = idom[p];
+		    while (number[new_idom] > number[p])
+		      new_idom = idom[new_idom];
+		  }
+	    }
+	  if (idom[v] != new_idom)
+	    {
+	      idom[v] = new_idom;
+	      changed = true;
+	    }
+	}
+    }
+
+  /* Look at the character nodes that dominate a match, and the runs
+     they start; keep the longest run, or the first of the longest.  */
+  unsigned char *pat = NULL, *mask = NULL;
+  ptrdiff_t best_start = -1, best_nchars = 0, best_nbytes = 0;
+  for (int d = idom[sink]; ; d = idom[d])
+    {
+      ptrdiff_t nchars = 0, nbytes = 0;
+      int v = d;
+
+      while (dfa->nodes[v].type == DFA_CHAR)
+	{
+	  unsigned char bytes[MAX_MULTIBYTE_LENGTH];
+	  unsigned char masks[MAX_MULTIBYTE_LENGTH];
+	  int len = prefilter_char_bytes (bufp, &dfa->nodes[v], inverse,
+					  bytes, masks);
+	  if (!len)
+	    break;
+	  nchars++;
+	  nbytes += len;
+
+	  /* Go on to the next character node, through nodes that
+	     consume nothing, as long as there is no other way in.  */
+	  v = dfa->nodes[v].next;
+	  while (npred[v + 1] - npred[v] == 1
+		 && (dfa->nodes[v].type == DFA_EPSILON
+		     || DFA_BEGLINE <= dfa->nodes[v].type))
+	    v = dfa->nodes[v].next;
+	  if (npred[v + 1] - npred[v] != 1)
+	    break;
+	}
+      if (0 < nchars && best_nchars <= nchars)
+	{
+	  best_start = d;
+	  best_nchars = nchars;
+	  best_nbytes = nbytes;
+	}
+      if (d == dfa->start)
+	break;
+    }
+  if (!best_nchars)
+    goto done;
+
+  /* Now collect the characters of the run.  */
+  pf->chars = xnmalloc (best_nchars, sizeof *pf->chars);
+  pat = xmalloc (2 * best_nbytes);
+  mask = pat + best_nbytes;
+  for (ptrdiff_t i = 0, nbytes = 0, v = best_start; i < best_nchars; i++)
+    {
+      pf->chars[i] = dfa->nodes[v].arg;
+      nbytes += prefilter_char_bytes (bufp, &dfa->nodes[v], inverse,
+				      pat + nbytes, mask + nbytes);
+      if (i + 1 < best_nchars)
+	do
+	  v = dfa->nodes[v].next;
+	while (dfa->nodes[v].type != DFA_CHAR);
+    }
+  pf->nchars = best_nchars;
+  literal_pattern_finish (&pf->lp, pat, mask, best_nbytes);
+  pf->max_before = prefilter_max_before (dfa, best_start, pred, npred);
+
+ done:
+  xfree (order);
+  xfree (number);
+  xfree (npred);
+  xfree (pred);
+  xfree (idom);
+  xfree (stack);
+  return pf;
+}
+
+/* Return the prefilter of BUFP, making it if needed.  */
+static struct re_prefilter *
+prefilter_get (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *dfa = bufp->dfa;
+  struct re_prefilter *pf;
+
+  if (!dfa)
+    dfa = bufp->dfa = dfa_compile (bufp);
+  if (!dfa->nodes)
+    return NULL;
+  pf = dfa->prefilter;
+  if (!pf || !EQ (pf->translate, bufp->translate)
+      || pf->target_multibyte != RE_TARGET_MULTIBYTE_P (bufp))
+    {
+      prefilter_free (pf);
+      pf = dfa->prefilter = prefilter_compile (dfa, bufp);
+    }
+  return pf;
+}
+
+/* Return the prefilter that searches for BUFP should use, or null.  */
+static struct re_prefilter *
+prefilter_for_search (struct re_pattern_buffer *bufp)
+{
+  struct re_prefilter *pf = regexp_use_prefilter ? prefilter_get (bufp) : NULL;
+  return pf && pf->chars ? pf : NULL;
+}
+
+ptrdiff_t
+re_required_literal (struct re_pattern_buffer *bufp, int const **chars,
+		     ptrdiff_t *max_before)
+{
+  struct re_prefilter *pf = prefilter_get (bufp);
+
+  if (!pf || !pf->chars)
+    return 0;
+  *chars = pf->chars;
+  *max_before = pf->max_before;
+  return pf->nchars;
+}
+
+/* Return the first (if FORWARD) or last position from FROM up to but
+   not including TO in the virtual concatenation of STRING1 and
+   STRING2 where the literal of PF occurs, or -1 if there is none.
+   The whole literal must fit in the text if it starts before TO.  */
+static ptrdiff_t
+prefilter_find (struct re_prefilter const *pf,
+		re_char *string1, ptrdiff_t size1, re_char *string2,
+		ptrdiff_t from, ptrdiff_t to, bool forward)
+{
+  struct literal_pattern const *lp = &pf->lp;
+  /* Occurrences that start before STRADDLE lie in STRING1, those that
+     start from SIZE1 on lie in STRING2, and the few in between span
+     both.  */
+  ptrdiff_t straddle = max (0, size1 - lp->len + 1);
+  ptrdiff_t bounds[4] = { from, clip_to_bounds (from, straddle, to),
+			  clip_to_bounds (from, size1, to), to };
+
+  for (int k = 0; k < 3; k++)
+    {
+      int part = forward ? k : 2 - k;
+      ptrdiff_t beg = bounds[part], end = bounds[part + 1];
+
+      if (beg >= end)
+	continue;
+      if (part != 1)
+	{
+	  re_char *p = part == 0 ? string1 + beg : string2 + (beg - size1);
+	  re_char *found = literal_scan (lp, p, p + (end - beg), forward);
+	  if (found)
+	    return beg + (found - p);
+	  continue;
+	}
+      for (ptrdiff_t i = 0; i < end - beg; i++)
+	{
+	  ptrdiff_t pos = forward ? beg + i : end - 1 - i, j;
+	  for (j = 0; j < lp->len; j++)
+	    {
+	      ptrdiff_t at = pos + j;
+	      int b = at < size1 ? string1[at] : string2[at - size1];
+	      if ((b | lp->mask[j]) != lp->pat[j])
+		break;
+	    }
+	  if (j == lp->len)
+	    return pos;
+	}
+    }
+  return -1;
+}
+
+/* Move the start *STARTPOS of a search for BUFP over *RANGE, as in
+   're_search_2', past positions where no match can start because the
+   literal of PF does not occur where it should.  Set *LO and *HI to
+   the bounds of the start positions that need not be looked at again,
+   because an occurrence is where it should be.  Return false if there
+   is no match at all.  */
+static bool
+prefilter_skip (struct re_prefilter const *pf, struct re_pattern_buffer *bufp,
+		re_char *string1, ptrdiff_t size1, re_char *string2,
+		ptrdiff_t *startpos, ptrdiff_t *range, ptrdiff_t *lo,
+		ptrdiff_t *hi, ptrdiff_t stop)
+{
+  ptrdiff_t pos = *startpos, lit, newpos;
+  /* Occurrences must start before LAST to fit before STOP.  */
+  ptrdiff_t last = stop - pf->lp.len + 1;
+  /* The most bytes a match can have before the literal, or -1.  */
+  ptrdiff_t before = pf->max_before;
+  bool multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+
+  if (0 <= before && multibyte)
+    before *= MAX_MULTIBYTE_LENGTH;
+
+  if (*range >= 0)
+    {
+      /* A match from POS has an occurrence at or after POS, and the
+	 first of them is never more than BEFORE bytes away.  */
+      lit = prefilter_find (pf, string1, size1, string2, pos, last, true);
+      if (lit < 0)
+	return false;
+      newpos = pos;
+      if (0 <= before && pos < lit - before)
+	{
+	  newpos = lit - before;
+	  if (multibyte)
+	    while (! CHAR_HEAD_P (newpos < size1 ? string1[newpos]
+				  : string2[newpos - size1]))
+	      newpos++;
+	  if (*range < newpos - pos)
+	    return false;
+	}
+      *range -= newpos - pos;
+    }
+  else
+    {
+      ptrdiff_t endpos = pos + *range;
+
+      if (before < 0)
+	{
+	  /* Any position before the last occurrence will do.  */
+	  lit = prefilter_find (pf, string1, size1, string2, endpos, last,
+				false);
+	  if (lit < 0)
+	    return false;
+	  newpos = min (pos, lit);
+	}
+      else
+	{
+	  lit = prefilter_find (pf, string1, size1, string2, pos,
+				min (last, pos + before + 1), true);
+	  newpos = pos;
+	  if (lit < 0)
+	    {
+	      lit = prefilter_find (pf, string1, size1, string2, endpos,
+				    min (last, pos), false);
+	      if (lit < 0)
+		return false;
+	      newpos = lit;
+	    }
+	}
+      *range += pos - newpos;
+    }
+  *startpos = newpos;
+  *lo = before < 0 ? PTRDIFF_MIN : lit - before;
+  *hi = lit;
+  return true;
+}
+
+
+/* Remembering where matching fails.
+
+   A pattern with nested repetitions, like "\\(x+x+\\)+y", can make
+   the backtracking matcher try the same branch at the same position
+   an exponential number of times.  When one match takes many steps,
+   're_match_2_internal' starts to remember the positions where its
+   branches, the instructions that push failure points, failed to
+   match, and fails at once when it gets back to one of them.  That
+   bounds the work by the number of branches times the length of the
+   text.
+
+   This is valid only if whether matching from a branch succeeds does
+   not depend on how the matcher got there, so it is not done for
+   patterns with back references or counted repetitions, nor for
+   POSIX searches, which go on after the first match.  A branch is
+   known to fail once the matcher backtracks to a failure point pushed
+   before it got there, so the branches reached are kept on a stack
+   with the height of the failure stack at that time.  What is known
+   holds for all the matches that one search tries, as they look at
+   the same text; 're_search_2' and 're_match_2' forget it when they
+   start.  */
+
+/* The most bits of failures remembered, and how many steps one match
+   takes before it starts to remember them.  */
+enum { MEMO_MAX_BITS = 1 << 23, MEMO_MIN_STEPS = 1 << 16 };
+
+struct memo_arrival
+{
+  /* The branch reached, the position, and the height of the failure
+     stack.  */
+  int branch;
+  ptrdiff_t pos, height;
+};
+
+struct re_memo
+{
+  /* The steps the search took so far.  */
+  EMACS_INT steps;
+
+  /* The pattern whose failures are remembered, or null.  */
+  struct re_pattern_buffer *bufp;
+
+  /* For each instruction of the pattern that is a branch, its
+     number.  */
+  int *branch;
+  ptrdiff_t branch_size;
+  int nbranches;
+
+  /* Bit (POS - BASE) * NBRANCHES + B of FAILED is set if matching
+     from branch B at position POS fails.  Only positions from BASE to
+     BASE + WIDTH - 1 are remembered, and the bits are cleared lazily:
+     those of positions from BASE + CLEARED on are garbage.  STOP is
+     where matches must stop.  */
+  unsigned char *failed;
+  ptrdiff_t failed_size, base, width, cleared, stop;
+
+  /* The branches reached whose outcome is not known yet.  */
+  struct memo_arrival *arrivals;
+  ptrdiff_t narrivals, arrivals_size;
+};
+
+/* The buffers of the last search that is over, for the next search
+   to use.  Searches can nest, as matching can call Lisp code that
+   searches, so each search has its own 'struct re_memo'.  */
+static struct re_memo memo_spare;
 
-    case charset_not:
-      switch (*p1)
+/* Free the buffers of search MEMO, or keep them for the next search if
+   there are none kept.  */
+static void
+memo_release (void *ptr)
+{
+  struct re_memo *memo = ptr;
+
+  if (!memo_spare.branch && !memo_spare.failed && !memo_spare.arrivals)
+    memo_spare = *memo;
+  else
+    {
+      xfree (memo->branch);
+      xfree (memo->failed);
+      xfree (memo->arrivals);
+    }
+}
+
+/* Start a new search that uses MEMO: count its steps from zero, and
+   remember no failures.  Return the count to pass to 'memo_end'.  */
+static ptrdiff_t
+memo_begin (struct re_memo *memo)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+
+  *memo = memo_spare;
+  memo_spare = (struct re_memo) { .bufp = NULL };
+  memo->steps = 0;
+  memo->bufp = NULL;
+  memo->narrivals = 0;
+  record_unwind_protect_ptr (memo_release, memo);
+  return count;
+}
+
+/* End the search that uses MEMO and was started with COUNT.  */
+static void
+memo_end (struct re_memo *memo, ptrdiff_t count)
+{
+  regexp_search_steps = memo->steps;
+  unbind_to (count, Qnil);
+}
+
+/* Make sure that the failures at POS and after it can be remembered,
+   forgetting those at positions too far from POS.  */
+static void
+memo_move (struct re_memo *memo, ptrdiff_t pos)
+{
+  ptrdiff_t maxwidth = MEMO_MAX_BITS / memo->nbranches;
+
+  memo->narrivals = 0;
+  if (memo->base <= pos && pos <= memo->base + memo->width / 2)
+    return;
+  memo->base = pos < memo->base ? max (0, pos - maxwidth / 2) : pos;
+  memo->width = max (1, min (maxwidth, memo->stop + 1 - memo->base));
+  memo->cleared = 0;
+}
+
+/* Start remembering where matching BUFP fails, for a match from POS
+   that stops at STOP.  Return false if BUFP does not allow it.  */
+static bool
+memo_start (struct re_memo *memo, struct re_pattern_buffer *bufp,
+	    ptrdiff_t pos, ptrdiff_t stop)
+{
+  re_char *pattern = bufp->buffer, *pend = pattern + bufp->used, *p;
+  bool succeeds = false;
+  int nbranches = 0;
+
+  /* The branch numbers of the pattern remembered so far are about to
+     be overwritten.  */
+  memo->bufp = NULL;
+  if (memo->branch_size < bufp->used)
+    {
+      xfree (memo->branch);
+      memo->branch = xnmalloc (bufp->used, sizeof *memo->branch);
+      memo->branch_size = bufp->used;
+    }
+  for (p = pattern; p < pend; )
+    {
+      succeeds = false;
+      switch (*p)
 	{
 	case exactn:
+	  p += 2 + p[1];
+	  break;
+
 	case charset:
-	  /* Reuse the code above.  */
-	  return mutually_exclusive_p (bufp, p2, p1);
 	case charset_not:
-	  /* When we have two charset_not, it's very unlikely that
-	     they don't overlap.  The union of the two sets of excluded
-	     chars should cover all possible chars, which, as a matter of
-	     fact, is virtually impossible in multibyte buffers.  */
+	  p = skip_one_char (p);
+	  break;
+
+	case succeed:
+	  succeeds = true;
+	  FALLTHROUGH;
+	case no_op: case anychar: case at_dot:
+	case begline: case endline: case begbuf: case endbuf:
+	case wordbeg: case wordend: case wordbound: case notwordbound:
+	case symbeg: case symend:
+	  p++;
+	  break;
+
+	case start_memory: case stop_memory:
+	case syntaxspec: case notsyntaxspec:
+	case categoryspec: case notcategoryspec:
+	  p += 2;
+	  break;
+
+	case on_failure_jump: case on_failure_keep_string_jump:
+	case on_failure_jump_loop: case on_failure_jump_nastyloop:
+	case on_failure_jump_smart:
+	  memo->branch[p - pattern] = nbranches++;
+	  FALLTHROUGH;
+	case jump:
+	  p += 3;
 	  break;
+
+	default:
+	  /* Back references need the registers, and counted
+	     repetitions need counters.  */
+	  return false;
 	}
-      break;
+    }
 
-    case wordend:
-      return ((re_opcode_t) *p1 == syntaxspec && p1[1] == Sword);
-    case symend:
-      return ((re_opcode_t) *p1 == syntaxspec
-              && (p1[1] == Ssymbol || p1[1] == Sword));
-    case notsyntaxspec:
-      return ((re_opcode_t) *p1 == syntaxspec && p1[1] == p2[1]);
+  /* Without 'succeed' at the end, this is a POSIX pattern.  */
+  if (!succeeds || nbranches == 0 || MEMO_MAX_BITS < nbranches)
+    return false;
 
-    case wordbeg:
-      return ((re_opcode_t) *p1 == notsyntaxspec && p1[1] == Sword);
-    case symbeg:
-      return ((re_opcode_t) *p1 == notsyntaxspec
-              && (p1[1] == Ssymbol || p1[1] == Sword));
-    case syntaxspec:
-      return ((re_opcode_t) *p1 == notsyntaxspec && p1[1] == p2[1]);
+  ptrdiff_t maxwidth = MEMO_MAX_BITS / nbranches;
+  ptrdiff_t size = (nbranches * max (1, min (maxwidth, stop + 1))
+		    + CHAR_BIT - 1) / CHAR_BIT;
+  if (memo->failed_size < size)
+    {
+      xfree (memo->failed);
+      memo->failed = xmalloc (size);
+      memo->failed_size = size;
+    }
+  memo->bufp = bufp;
+  memo->nbranches = nbranches;
+  memo->stop = stop;
+  memo->base = PTRDIFF_MAX;
+  memo->width = 0;
+  memo_move (memo, pos);
+  return true;
+}
 
-    case wordbound:
-      return (((re_opcode_t) *p1 == notsyntaxspec
-	       || (re_opcode_t) *p1 == syntaxspec)
-	      && p1[1] == Sword);
+/* Return true if matching from BRANCH at POS is known to fail.  */
+static bool
+memo_failed_p (struct re_memo *memo, int branch, ptrdiff_t pos)
+{
+  ptrdiff_t i = pos - memo->base;
 
-    case categoryspec:
-      return ((re_opcode_t) *p1 == notcategoryspec && p1[1] == p2[1]);
-    case notcategoryspec:
-      return ((re_opcode_t) *p1 == categoryspec && p1[1] == p2[1]);
+  if (! (0 <= i && i < memo->cleared))
+    return false;
+  i = i * memo->nbranches + branch;
+  return (memo->failed[i / CHAR_BIT] >> (i % CHAR_BIT)) & 1;
+}
 
-    default:
-      ;
+/* Note that the matcher reached BRANCH at POS, with HEIGHT items on
+   the failure stack.  */
+static void
+memo_reach (struct re_memo *memo, int branch, ptrdiff_t pos,
+	    ptrdiff_t height)
+{
+  if (! (memo->base <= pos && pos < memo->base + memo->width))
+    return;
+  if (memo->narrivals == memo->arrivals_size)
+    {
+      if (MEMO_MAX_BITS <= memo->arrivals_size)
+	return;
+      memo->arrivals = xpalloc (memo->arrivals, &memo->arrivals_size, 1,
+			       MEMO_MAX_BITS, sizeof *memo->arrivals);
     }
+  memo->arrivals[memo->narrivals++]
+    = (struct memo_arrival) { .branch = branch, .pos = pos,
+			      .height = height };
+}
 
-  /* Safe default.  */
-  return false;
+/* Note that matching failed from the branches reached with more than
+   HEIGHT items on the failure stack.  */
+static void
+memo_fail_above (struct re_memo *memo, ptrdiff_t height)
+{
+  while (0 < memo->narrivals
+	 && height < memo->arrivals[memo->narrivals - 1].height)
+    {
+      struct memo_arrival *a = &memo->arrivals[--memo->narrivals];
+      ptrdiff_t i = a->pos - memo->base;
+      if (memo->cleared <= i)
+	{
+	  /* Clear at least twice as much as before, so that the
+	     clearing takes time linear in the positions looked at.  */
+	  ptrdiff_t cleared = min (memo->width,
+				   max (i + 1, max (64, 2 * memo->cleared)));
+	  ptrdiff_t from = memo->cleared * memo->nbranches;
+	  ptrdiff_t to = cleared * memo->nbranches;
+	  if (from % CHAR_BIT)
+	    memo->failed[from / CHAR_BIT] &= (1 << (from % CHAR_BIT)) - 1;
+	  from = (from + CHAR_BIT - 1) / CHAR_BIT;
+	  to = (to + CHAR_BIT - 1) / CHAR_BIT;
+	  memset (memo->failed + from, 0, to - from);
+	  memo->cleared = cleared;
+	}
+      i = i * memo->nbranches + a->branch;
+      memo->failed[i / CHAR_BIT] |= 1 << (i % CHAR_BIT);
+    }
 }
 
 
@@ -3842,6 +5883,37 @@ re_match_2 (struct re_pattern_buffer *bufp,
 	    char const *string1, ptrdiff_t size1,
 	    char const *string2, ptrdiff_t size2,
 	    ptrdiff_t pos, struct re_registers *regs, ptrdiff_t stop)
+{
+  struct re_memo memo;
+  ptrdiff_t count = memo_begin (&memo);
+  ptrdiff_t val = re_match_2_1 (&memo, bufp, string1, size1, string2, size2,
+				pos, regs, stop);
+  memo_end (&memo, count);
+  return val;
+}
+
+/* Search as described for 're_search_2_1'.  */
+
+ptrdiff_t
+re_search_2 (struct re_pattern_buffer *bufp, const char *str1, ptrdiff_t size1,
+	     const char *str2, ptrdiff_t size2,
+	     ptrdiff_t startpos, ptrdiff_t range,
+	     struct re_registers *regs, ptrdiff_t stop)
+{
+  struct re_memo memo;
+  ptrdiff_t count = memo_begin (&memo);
+  ptrdiff_t val = re_search_2_1 (&memo, bufp, str1, size1, str2, size2,
+				 startpos, range, regs, stop);
+  memo_end (&memo, count);
+  return val;
+}
+
+/* Like 're_match_2', but as part of the search that uses MEMO.  */
+static ptrdiff_t
+re_match_2_1 (struct re_memo *memo, struct re_pattern_buffer *bufp,
+	      char const *string1, ptrdiff_t size1,
+	      char const *string2, ptrdiff_t size2,
+	      ptrdiff_t pos, struct re_registers *regs, ptrdiff_t stop)
 {
   ptrdiff_t result;
 
@@ -3850,17 +5922,37 @@ re_match_2 (struct re_pattern_buffer *bufp,
   charpos = SYNTAX_TABLE_BYTE_TO_CHAR (POS_AS_IN_BUFFER (pos));
   SETUP_SYNTAX_TABLE_FOR_OBJECT (re_match_object, charpos, 1);
 
-  result = re_match_2_internal (bufp, (re_char *) string1, size1,
+  struct re_dfa *dfa = 0 <= pos && pos <= stop ? dfa_for_search (bufp) : NULL;
+  if (dfa && dfa_exec (dfa, bufp, (re_char *) string1, size1,
+		       (re_char *) string2, size2, pos, -1, stop) == -1)
+    return -1;
+
+  result = re_match_2_internal (memo, bufp, (re_char *) string1, size1,
 				(re_char *) string2, size2,
 				pos, regs, stop);
   return result;
 }
 
 
+/* If matching from the branch at PAT is known to fail at the current
+   position, fail; otherwise, if failures are being remembered, note
+   that the matcher got there.  */
+#define MEMO_REACH(pat)							\
+  do {									\
+    if (memoize)							\
+      {									\
+	int branch_ = memo->branch[(pat) - bufp->buffer];		\
+	ptrdiff_t pos_ = POINTER_TO_OFFSET (d);				\
+	if (memo_failed_p (memo, branch_, pos_))			\
+	  goto fail;							\
+	memo_reach (memo, branch_, pos_, fail_stack.avail);		\
+      }									\
+  } while (false)
+
 /* This is a separate function so that we can force an alloca cleanup
    afterwards.  */
 static ptrdiff_t
-re_match_2_internal (struct re_pattern_buffer *bufp,
+re_match_2_internal (struct re_memo *memo, struct re_pattern_buffer *bufp,
 		     re_char *string1, ptrdiff_t size1,
 		     re_char *string2, ptrdiff_t size2,
 		     ptrdiff_t pos, struct re_registers *regs, ptrdiff_t stop)
@@ -3941,6 +6033,16 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
      and need to test it, it's not garbage.  */
   re_char *match_end = NULL;
 
+  /* The steps taken by the search so far, and the most it can take.  */
+  EMACS_INT steps = memo->steps;
+  EMACS_INT max_steps = (FIXNATP (Vregexp_step_limit)
+			 ? XFIXNAT (Vregexp_step_limit) : EMACS_INT_MAX);
+
+  /* Whether to remember where matching fails, and when to start
+     doing so.  */
+  bool memoize = false;
+  EMACS_INT memo_steps = steps + MEMO_MIN_STEPS;
+
 #ifdef DEBUG_COMPILES_ARGUMENTS
   /* Counts the total number of registers pushed.  */
   ptrdiff_t num_regs_pushed = 0;
@@ -4035,12 +6137,22 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
   DEBUG_PRINT_DOUBLE_STRING (d, string1, size1, string2, size2);
   DEBUG_PRINT ("\"\n");
 
+  if (memo->bufp == bufp)
+    {
+      memo_move (memo, pos);
+      memoize = true;
+    }
+  else if (EQ (Vregexp_memoize, Qalways)
+	   || (!NILP (Vregexp_memoize) && bufp->memoize))
+    memoize = memo_start (memo, bufp, pos, stop);
+
   /* This loops over pattern commands.  It exits by returning from the
      function if the match is complete, or it drops through if the match
      fails at this starting point in the input data.  */
   for (;;)
     {
       DEBUG_PRINT ("\n%p: ", p);
+      steps++;
 
       if (p == pend)
 	{
@@ -4182,6 +6294,9 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
 
 	  DEBUG_PRINT ("Returning %td from re_match_2.\n", dcnt);
 
+	  if (memoize)
+	    memo->narrivals = 0;
+	  memo->steps = steps;
 	  SAFE_FREE ();
 	  return dcnt;
 	}
@@ -4530,6 +6645,7 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
 	   'anychar's code to do something besides goto fail in this
 	   case; that seems worse than this.  */
 	case on_failure_keep_string_jump:
+	  MEMO_REACH (p - 1);
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
 	  DEBUG_PRINT ("EXECUTING on_failure_keep_string_jump %d (to %p):\n",
 		       mcnt, p + mcnt);
@@ -4552,6 +6668,7 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
 	     whether something matched between the beginning and the end of
 	     the loop.  */
 	case on_failure_jump_nastyloop:
+	  MEMO_REACH (p - 1);
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
 	  DEBUG_PRINT ("EXECUTING on_failure_jump_nastyloop %d (to %p):\n",
 		       mcnt, p + mcnt);
@@ -4572,6 +6689,7 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
 	  /* Simple loop detecting on_failure_jump:  just check on the
 	     failure stack if the same spot was already hit earlier.  */
 	case on_failure_jump_loop:
+	  MEMO_REACH (p - 1);
 	on_failure:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
 	  DEBUG_PRINT ("EXECUTING on_failure_jump_loop %d (to %p):\n",
@@ -4605,6 +6723,7 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
 	   the repetition text and either the following jump or
 	   pop_failure_jump back to this on_failure_jump.  */
 	case on_failure_jump:
+	  MEMO_REACH (p - 1);
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
 	  DEBUG_PRINT ("EXECUTING on_failure_jump %d (to %p):\n",
 		       mcnt, p + mcnt);
@@ -4983,12 +7102,27 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
     /* We goto here if a matching operation fails. */
     fail:
       maybe_quit ();
+      if (max_steps < steps)
+	{
+	  regexp_search_steps = memo->steps = steps;
+	  xsignal1 (Qregexp_step_limit_exceeded, make_int (steps));
+	}
+      if (memo_steps < steps)
+	{
+	  /* This match is taking long; try to remember where it fails
+	     from now on, and in later searches.  */
+	  memo_steps = EMACS_INT_MAX;
+	  if (!memoize && !NILP (Vregexp_memoize))
+	    memoize = bufp->memoize = memo_start (memo, bufp, pos, stop);
+	}
       if (!FAIL_STACK_EMPTY ())
 	{
 	  re_char *str, *pat;
 	  /* A restart point is known.  Restore to that state.  */
 	  DEBUG_PRINT ("\nFAIL:\n");
 	  POP_FAILURE_POINT (str, pat);
+	  if (memoize)
+	    memo_fail_above (memo, fail_stack.avail);
 	  switch (*pat++)
 	    {
 	    case on_failure_keep_string_jump:
@@ -5028,10 +7162,523 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
   if (best_regs_set)
     goto restore_best_regs;
 
+  if (memoize)
+    memo_fail_above (memo, -1);
+  memo->steps = steps;
   SAFE_FREE ();
 
   return -1;				/* Failure to match.  */
 }
+
+/* Searching for several patterns at once.
+
+   re_search_set looks for the earliest position where any pattern of
+   a set matches, in one pass over the text.  Many patterns start with
+   a literal string, such as a keyword; an Aho-Corasick automaton
+   built from those literals finds every place where one of them
+   occurs.  Patterns that do not start with a literal are looked for
+   with the union of their fastmaps.  The matcher then tries only the
+   patterns that can match at each such place, in order of priority.
+
+   The automaton reads symbols rather than bytes.  Without a translate
+   table a symbol is a byte; with one, it is a character after
+   translation.  Only the ASCII part of each literal is used, so
+   symbols that are not ASCII characters all fall into one class that
+   no literal contains.  */
+
+/* The longest literal prefix used for each pattern, in symbols, and
+   the largest number of transitions of one automaton.  */
+enum { SET_MAX_LITERAL = 32, SET_MAX_TRANSITIONS = 1 << 22 };
+
+struct re_set_filter
+{
+  /* The translate table and target multibyteness this was built for.  */
+  Lisp_Object translate;
+  bool target_multibyte;
+
+  /* True if some pattern without a literal prefix can match the empty
+     string, so that it must be tried everywhere.  */
+  bool try_all;
+
+  /* The union of the fastmaps of the patterns without a literal.  */
+  char fastmap[0400];
+
+  /* The indices of those patterns.  */
+  ptrdiff_t *others;
+  ptrdiff_t nothers;
+
+  /* The class of each ASCII symbol in the literals, or 0.  */
+  unsigned char class[0200];
+  int nclasses;
+
+  /* The automaton: DELTA[S * NCLASSES + C] is the state after reading
+     a symbol of class C in state S.  DEPTH[S] is the length of the
+     longest literal prefix S stands for; a transition from S leads to
+     a child in the trie if it leads to a state of depth DEPTH[S] + 1.
+     If some literals end at S, FIRST[S] is the first of the patterns
+     that start with them, and NEXT chains those patterns in order;
+     otherwise FIRST[S] is -1.  DICT[S] is the nearest state along
+     the failure links where some literal ends, or -1.  */
+  int *delta, *depth, *dict;
+  ptrdiff_t *first, *next;
+  int nstates;
+
+  /* The length of the longest literal, at least 1.  */
+  int maxlen;
+
+  /* For each ASCII byte of the text, the class of its symbol and the
+     byte that its character looks up in the fastmaps.  */
+  unsigned char ascii_class[0200], ascii_fastmap_byte[0200];
+
+  /* True for the bytes that can be skipped when no literal has been
+     partly read and no position is left to try.  */
+  bool skip[0400];
+};
+
+void
+re_free_set_filter (struct re_pattern_set *set)
+{
+  struct re_set_filter *filter = set->filter;
+
+  if (filter)
+    {
+      xfree (filter->others);
+      xfree (filter->delta);
+      xfree (filter->depth);
+      xfree (filter->dict);
+      xfree (filter->first);
+      xfree (filter->next);
+      xfree (filter);
+      set->filter = NULL;
+    }
+}
+
+/* Store in *LEN the length of the ASCII literal that every match of
+   BUFP starts with, and return its address in the pattern.  */
+static re_char *
+set_literal_prefix (struct re_pattern_buffer *bufp, int *len)
+{
+  re_char *p = bufp->buffer, *pend = p + bufp->used;
+  int n = 0;
+
+  while (p < pend && (re_opcode_t) *p == start_memory)
+    p += 2;
+  if (p < pend && (re_opcode_t) *p == exactn)
+    while (n < p[1] && n < SET_MAX_LITERAL && ASCII_CHAR_P (p[2 + n]))
+      n++;
+  *len = n;
+  return p + 2;
+}
+
+/* Build the prefilter of SET for searching with TRANSLATE in a text
+   that is multibyte if TARGET_MULTIBYTE.  */
+static struct re_set_filter *
+set_build_filter (struct re_pattern_set *set, Lisp_Object translate,
+		  bool target_multibyte)
+{
+  struct re_set_filter *filter = xzalloc (sizeof *filter);
+  ptrdiff_t n = set->npatterns, i;
+  int *litlen = xnmalloc (n, sizeof *litlen);
+  re_char **lit = xnmalloc (n, sizeof *lit);
+  ptrdiff_t total = 1;
+  int c;
+
+  filter->translate = translate;
+  filter->target_multibyte = target_multibyte;
+  filter->others = xnmalloc (n, sizeof *filter->others);
+  filter->maxlen = 1;
+
+  for (i = 0; i < n; i++)
+    {
+      struct re_pattern_buffer *bufp = &set->patterns[i];
+
+      lit[i] = set_literal_prefix (bufp, &litlen[i]);
+      total += litlen[i];
+      for (int j = 0; j < litlen[i]; j++)
+	if (!filter->class[lit[i][j]])
+	  filter->class[lit[i][j]] = ++filter->nclasses;
+    }
+  filter->nclasses++;
+
+  /* Don't let the automaton grow too large; fall back on the fastmaps
+     of all the patterns instead.  */
+  if (SET_MAX_TRANSITIONS / filter->nclasses < total)
+    {
+      for (i = 0; i < n; i++)
+	litlen[i] = 0;
+      total = 1;
+    }
+
+  /* Build the trie.  */
+  filter->delta = xnmalloc (total * filter->nclasses, sizeof (int));
+  filter->depth = xnmalloc (total, sizeof (int));
+  filter->dict = xnmalloc (total, sizeof (int));
+  filter->first = xnmalloc (total, sizeof (ptrdiff_t));
+  filter->next = xnmalloc (n, sizeof (ptrdiff_t));
+  ptrdiff_t *last = xnmalloc (total, sizeof *last);
+  for (i = 0; i < total * filter->nclasses; i++)
+    filter->delta[i] = -1;
+  filter->nstates = 1;
+  filter->depth[0] = 0;
+  filter->first[0] = -1;
+  for (i = 0; i < n; i++)
+    {
+      struct re_pattern_buffer *bufp = &set->patterns[i];
+      int s = 0;
+
+      filter->next[i] = -1;
+      if (litlen[i] == 0)
+	{
+	  filter->others[filter->nothers++] = i;
+	  if (!bufp->fastmap_accurate)
+	    re_compile_fastmap (bufp);
+	  if (bufp->can_be_null)
+	    filter->try_all = true;
+	  for (c = 0; c < 0400; c++)
+	    filter->fastmap[c] |= bufp->fastmap[c];
+	  continue;
+	}
+      for (int j = 0; j < litlen[i]; j++)
+	{
+	  int *t = &filter->delta[s * filter->nclasses
+				  + filter->class[lit[i][j]]];
+	  if (*t < 0)
+	    {
+	      *t = filter->nstates++;
+	      filter->depth[*t] = j + 1;
+	      filter->first[*t] = -1;
+	    }
+	  s = *t;
+	}
+      if (filter->first[s] < 0)
+	filter->first[s] = i;
+      else
+	filter->next[last[s]] = i;
+      last[s] = i;
+      filter->maxlen = max (filter->maxlen, litlen[i]);
+    }
+
+  /* Turn the trie into an automaton, breadth first, so that the
+     failure link of each state is complete before its children's.  */
+  int *fail = xnmalloc (filter->nstates, sizeof *fail);
+  int *queue = xnmalloc (filter->nstates, sizeof *queue);
+  int head = 0, tail = 0;
+  fail[0] = 0;
+  filter->dict[0] = -1;
+  for (c = 0; c < filter->nclasses; c++)
+    {
+      int *t = &filter->delta[c];
+      if (*t < 0)
+	*t = 0;
+      else
+	{
+	  fail[*t] = 0;
+	  queue[tail++] = *t;
+	}
+    }
+  while (head < tail)
+    {
+      int s = queue[head++];
+      int f = fail[s];
+
+      filter->dict[s] = filter->first[f] >= 0 ? f : filter->dict[f];
+      for (c = 0; c < filter->nclasses; c++)
+	{
+	  int *t = &filter->delta[s * filter->nclasses + c];
+	  int ft = filter->delta[f * filter->nclasses + c];
+	  if (*t < 0)
+	    *t = ft;
+	  else
+	    {
+	      fail[*t] = ft;
+	      queue[tail++] = *t;
+	    }
+	}
+    }
+
+  /* Work out what set_read_symbol does for ASCII bytes in advance.  */
+  for (c = 0; c < 0200; c++)
+    {
+      int t = NILP (translate) ? c : RE_TRANSLATE (translate, c);
+      int fb = c;
+
+      if (target_multibyte)
+	fb = CHAR_LEADING_CODE (t);
+      else if (t != c)
+	{
+	  int b = RE_CHAR_TO_UNIBYTE (t);
+	  if (b >= 0)
+	    fb = b;
+	}
+      /* A unibyte text keeps the untranslated byte if the translation
+	 is not a byte; see the exactn case of re_match_2_internal.  */
+      if (!ASCII_CHAR_P (t))
+	t = target_multibyte ? -1 : c;
+      filter->ascii_class[c] = t < 0 ? 0 : filter->class[t];
+      filter->ascii_fastmap_byte[c] = fb;
+      filter->skip[c] = (!filter->try_all && !filter->ascii_class[c]
+			 && !filter->fastmap[fb]);
+    }
+  for (; c < 0400; c++)
+    filter->skip[c] = (!filter->try_all && NILP (translate)
+		       && !filter->fastmap[c]);
+
+  xfree (queue);
+  xfree (fail);
+  xfree (last);
+  xfree (lit);
+  xfree (litlen);
+  return filter;
+}
+
+/* Read the symbol at *POS in the text described by the other
+   arguments, and advance *POS past it.  Store in *FASTMAP_BYTE the
+   byte that 're_search_2' would look up in the fastmap, or -1 if the
+   symbol does not start a character.  */
+static int
+set_read_symbol (struct re_set_filter *filter,
+		 re_char *string1, ptrdiff_t size1,
+		 re_char *string2, ptrdiff_t size2,
+		 ptrdiff_t *pos, int *fastmap_byte)
+{
+  Lisp_Object translate = filter->translate;
+  re_char *d = POS_ADDR_VSTRING (*pos);
+  int c = *d, len = 1;
+
+  if (ASCII_CHAR_P (c))
+    {
+      *fastmap_byte = filter->ascii_fastmap_byte[c];
+      *pos += 1;
+      return filter->ascii_class[c];
+    }
+  else if (NILP (translate))
+    {
+      *fastmap_byte = (!filter->target_multibyte || CHAR_HEAD_P (c)
+		       ? c : -1);
+      c = -1;
+    }
+  else if (filter->target_multibyte)
+    {
+      c = STRING_CHAR_AND_LENGTH (d, len);
+      c = RE_TRANSLATE (translate, c);
+      *fastmap_byte = CHAR_LEADING_CODE (c);
+      if (!ASCII_CHAR_P (c))
+	c = -1;
+    }
+  else
+    {
+      int ch = RE_CHAR_TO_MULTIBYTE (c);
+      int translated = RE_TRANSLATE (translate, ch);
+      int b = c;
+
+      if (translated != ch && (ch = RE_CHAR_TO_UNIBYTE (translated)) >= 0)
+	b = ch;
+      *fastmap_byte = b;
+      c = -1;
+    }
+  *pos += len;
+  return c < 0 ? 0 : filter->class[c];
+}
+
+/* Add the patterns that can match at POS, where the previous pass
+   over the text found a literal or a fastmap hit, to CANDIDATES, and
+   return how many there are.  FASTMAP_BYTE is as for
+   set_read_symbol.  AT_END means POS is the end of the text.  */
+static ptrdiff_t
+set_candidates (struct re_pattern_set *set, struct re_set_filter *filter,
+		re_char *string1, ptrdiff_t size1,
+		re_char *string2, ptrdiff_t size2,
+		ptrdiff_t pos, ptrdiff_t stop, int fastmap_byte, bool at_end,
+		ptrdiff_t *candidates)
+{
+  ptrdiff_t ncandidates = 0, i, j;
+  int s = 0;
+
+  /* Walk down the trie to find the literals that occur here.  */
+  while (pos < stop && filter->depth[s] < filter->maxlen)
+    {
+      int fb;
+      int c = set_read_symbol (filter, string1, size1, string2, size2,
+			       &pos, &fb);
+      int t = filter->delta[s * filter->nclasses + c];
+      if (filter->depth[t] != filter->depth[s] + 1)
+	break;
+      s = t;
+      for (i = filter->first[s]; i >= 0; i = filter->next[i])
+	candidates[ncandidates++] = i;
+    }
+
+  for (j = 0; j < filter->nothers; j++)
+    {
+      struct re_pattern_buffer *bufp = &set->patterns[filter->others[j]];
+      if (at_end || bufp->can_be_null
+	  || (fastmap_byte >= 0 && bufp->fastmap[fastmap_byte]))
+	candidates[ncandidates++] = filter->others[j];
+    }
+
+  /* Sort the candidates by priority.  There are few of them.  */
+  for (i = 1; i < ncandidates; i++)
+    {
+      ptrdiff_t x = candidates[i];
+      for (j = i; 0 < j && x < candidates[j - 1]; j--)
+	candidates[j] = candidates[j - 1];
+      candidates[j] = x;
+    }
+  return ncandidates;
+}
+
+ptrdiff_t
+re_search_set (struct re_pattern_set *set,
+	       const char *str1, ptrdiff_t size1,
+	       const char *str2, ptrdiff_t size2,
+	       ptrdiff_t startpos, ptrdiff_t range,
+	       struct re_registers *regs, ptrdiff_t stop, ptrdiff_t *which)
+{
+  re_char *string1 = (re_char *) str1;
+  re_char *string2 = (re_char *) str2;
+  ptrdiff_t total_size = size1 + size2;
+  ptrdiff_t endpos, pos, val = -1;
+  struct re_set_filter *filter;
+  unsigned short quit_count = 0;
+
+  if (startpos < 0 || startpos > total_size || set->npatterns == 0)
+    return -1;
+  eassert (range >= 0);
+  endpos = min (startpos + range, total_size);
+  stop = min (stop, total_size);
+
+  Lisp_Object translate = set->patterns[0].translate;
+  bool target_multibyte = RE_TARGET_MULTIBYTE_P (&set->patterns[0]);
+  filter = set->filter;
+  if (filter && (!EQ (filter->translate, translate)
+		 || filter->target_multibyte != target_multibyte))
+    re_free_set_filter (set);
+  if (!set->filter)
+    set->filter = set_build_filter (set, translate, target_multibyte);
+  filter = set->filter;
+
+  struct re_memo memo;
+  ptrdiff_t count = memo_begin (&memo);
+
+  /* FLAG and BYTEPOS hold, for each of the last MAXLEN symbols read,
+     whether a match may start there and where it is in the text.  A
+     position is settled once MAXLEN symbols have been read from it,
+     as no literal that starts there can end later.  */
+  int ring = 1;
+  while (ring < filter->maxlen)
+    ring <<= 1;
+  USE_SAFE_ALLOCA;
+  bool *flag;
+  ptrdiff_t *bytepos, *candidates;
+  int *fastmap_byte;
+  SAFE_NALLOCA (flag, 1, ring);
+  SAFE_NALLOCA (bytepos, 1, ring);
+  SAFE_NALLOCA (fastmap_byte, 1, ring);
+  SAFE_NALLOCA (candidates, 1, set->npatterns);
+
+  ptrdiff_t nread = 0, nsettled = 0;
+  int s = 0;
+  bool done = false;
+  pos = startpos;
+
+  while (!done)
+    {
+      bool at_end = stop <= pos;
+
+      /* Skip quickly over text where nothing can start.  */
+      if (!at_end && s == 0 && nsettled == nread)
+	{
+	  ptrdiff_t lim = min (pos < size1 ? min (size1, stop) : stop, endpos);
+	  re_char *d = POS_ADDR_VSTRING (pos);
+	  ptrdiff_t skipped = 0;
+	  while (skipped < lim - pos && filter->skip[d[skipped]])
+	    skipped++;
+	  pos += skipped;
+	  nread += skipped;
+	  nsettled = nread;
+	}
+
+      if (!at_end)
+	{
+	  /* Read another symbol and note the literals that end there.  */
+	  int slot = nread & (ring - 1);
+	  int fb;
+	  bytepos[slot] = pos;
+	  int c = set_read_symbol (filter, string1, size1, string2, size2,
+				   &pos, &fb);
+	  fastmap_byte[slot] = fb;
+	  flag[slot] = fb >= 0 && (filter->try_all || filter->fastmap[fb]);
+	  s = filter->delta[s * filter->nclasses + c];
+	  for (int t = filter->first[s] >= 0 ? s : filter->dict[s];
+	       0 <= t; t = filter->dict[t])
+	    flag[(nread - filter->depth[t] + 1) & (ring - 1)] = true;
+	  nread++;
+	  rarely_quit (++quit_count);
+	}
+
+      /* Try the positions that are now settled.  */
+      for (; (nsettled < nread
+	      && (at_end || nread - nsettled >= filter->maxlen));
+	   nsettled++)
+	{
+	  int slot = nsettled & (ring - 1);
+	  if (endpos < bytepos[slot])
+	    {
+	      done = true;
+	      break;
+	    }
+	  if (!flag[slot])
+	    continue;
+	  ptrdiff_t n = set_candidates (set, filter, string1, size1,
+					string2, size2, bytepos[slot], stop,
+					fastmap_byte[slot], false, candidates);
+	  for (ptrdiff_t i = 0; i < n; i++)
+	    {
+	      val = re_match_2_1 (&memo, &set->patterns[candidates[i]],
+				  str1, size1, str2, size2, bytepos[slot],
+				  regs, stop);
+	      if (val != -1)
+		{
+		  *which = candidates[i];
+		  val = val < 0 ? val : bytepos[slot];
+		  goto out;
+		}
+	    }
+	}
+
+      /* Only the patterns that don't start with a literal can match
+	 at the end of the text.  */
+      if (at_end && !done)
+	{
+	  done = true;
+	  if (pos <= endpos)
+	    {
+	      ptrdiff_t n = set_candidates (set, filter, string1, size1,
+					    string2, size2, pos, stop, -1,
+					    true, candidates);
+	      for (ptrdiff_t i = 0; i < n; i++)
+		{
+		  val = re_match_2_1 (&memo, &set->patterns[candidates[i]],
+				      str1, size1, str2, size2, pos,
+				      regs, stop);
+		  if (val != -1)
+		    {
+		      *which = candidates[i];
+		      val = val < 0 ? val : pos;
+		      goto out;
+		    }
+		}
+	    }
+	}
+    }
+  val = -1;
+
+ out:
+  SAFE_FREE ();
+  memo_end (&memo, count);
+  return val;
+}
+
 
 /* Subroutine definitions for re_match_2.  */
 
@@ -5083,6 +7730,7 @@ re_compile_pattern (const char *pattern, ptrdiff_t length,
 		    struct re_pattern_buffer *bufp)
 {
   bufp->regs_allocated = REGS_UNALLOCATED;
+  re_free_dfa (bufp);
 
   reg_errcode_t ret
       = regex_compile ((re_char *) pattern, length,
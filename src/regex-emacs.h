@@ -91,6 +91,10 @@ struct re_pattern_buffer
 	/* Number of subexpressions found by the compiler.  */
   ptrdiff_t re_nsub;
 
+	/* The automaton built lazily from the compiled pattern by
+	   're_search_2', or null if there is none yet.  */
+  struct re_dfa *dfa;
+
         /* True if and only if this pattern can match the empty string.
            Well, in truth it's used only in 're_search_2', to see
            whether or not we should use the fastmap, so we don't set
@@ -118,6 +122,11 @@ struct re_pattern_buffer
   /* If true, multi-byte form in the target of match should be
      recognized as a multibyte character.  */
   bool_bf target_multibyte : 1;
+
+  /* If true, matching this pattern once took so many steps that
+     're_match_2' now remembers where it failed; see
+     'regexp-memoize'.  */
+  bool_bf memoize : 1;
 };
 
 /* Declarations for routines.  */
@@ -178,6 +187,52 @@ extern void re_set_registers (struct re_pattern_buffer *buffer,
 			      ptrdiff_t num_regs,
 			      ptrdiff_t *starts, ptrdiff_t *ends);
 
+/* Free the automaton that 're_search_2' built for BUFFER, if any.  */
+extern void re_free_dfa (struct re_pattern_buffer *buffer);
+
+/* Free that automaton if it takes much memory.  */
+extern void re_shrink_dfa (struct re_pattern_buffer *buffer);
+
+/* Forget the transitions cached in all automata.  Call this when a
+   syntax or category table may have changed.  */
+extern void re_flush_dfa_caches (void);
+
+/* Return the number of characters of a literal string that every
+   match for BUFFER contains, as 're_search_2' would look for it, or 0
+   if there is none.  Store the characters in *CHARS, and in
+   *MAX_BEFORE the most characters that a match can have before them,
+   or -1 if there is no limit.  */
+extern ptrdiff_t re_required_literal (struct re_pattern_buffer *buffer,
+				      int const **chars,
+				      ptrdiff_t *max_before);
+
+/* A set of patterns that 're_search_set' searches for at once.  */
+struct re_pattern_set
+{
+  /* The compiled patterns, from the highest priority to the lowest.  */
+  struct re_pattern_buffer *patterns;
+  ptrdiff_t npatterns;
+
+  /* The prefilter built lazily by 're_search_set', or null.  */
+  struct re_set_filter *filter;
+};
+
+/* Search forward for the patterns in SET, like 're_search_2' with a
+   nonnegative RANGE.  Return the first position where any of them
+   matches, -1 for no match, or -2 for an internal error.  Store the
+   index of the pattern that matched in *WHICH; if several match at
+   that position, take the first one.  */
+extern ptrdiff_t re_search_set (struct re_pattern_set *set,
+				const char *string1, ptrdiff_t length1,
+				const char *string2, ptrdiff_t length2,
+				ptrdiff_t start, ptrdiff_t range,
+				struct re_registers *regs, ptrdiff_t stop,
+				ptrdiff_t *which);
+
+/* Free the prefilter of SET.  Call this after recompiling its
+   patterns.  */
+extern void re_free_set_filter (struct re_pattern_set *set);
+
 /* Character classes.  */
 typedef enum { RECC_ERROR = 0,
 	       RECC_ALNUM, RECC_ALPHA, RECC_WORD,
@@ -21,6 +21,16 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 
 #include <config.h>
 
+#include <count-leading-zeros.h>
+#include <count-one-bits.h>
+#include <count-trailing-zeros.h>
+
+#ifdef __AVX2__
+# include <immintrin.h>
+#elif defined __SSE2__
+# include <emmintrin.h>
+#endif
+
 #include "lisp.h"
 #include "character.h"
 #include "buffer.h"
@@ -30,16 +40,24 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "blockinput.h"
 #include "intervals.h"
 #include "pdumper.h"
+#include "systime.h"
 
 #include "regex-emacs.h"
 
-#define REGEXP_CACHE_SIZE 20
+/* The default value of 'regexp-cache-size'.  */
+#define REGEXP_CACHE_SIZE 100
 
 /* If the regexp is non-nil, then the buffer contains the compiled form
    of that regexp, suitable for searching.  */
 struct regexp_cache
 {
-  struct regexp_cache *next;
+  /* The neighbors of this entry in the list of all entries, which is
+     kept in order of use, most recent first.  */
+  struct regexp_cache *prev, *next;
+  /* The next entry in the same bucket of the hash table.  */
+  struct regexp_cache *hash_next;
+  /* The hash code computed by regexp_cache_hash for this entry.  */
+  EMACS_UINT hash;
   Lisp_Object regexp, f_whitespace_regexp;
   /* Syntax table for which the regexp applies.  We need this because
      of character classes.  If this is t, then the compiled pattern is valid
@@ -53,11 +71,25 @@ struct regexp_cache
   bool busy;
 };
 
-/* The instances of that struct.  */
-static struct regexp_cache searchbufs[REGEXP_CACHE_SIZE];
+/* The head and tail of the list of entries; the head is the most
+   recently used one.  */
+static struct regexp_cache *searchbuf_head, *searchbuf_tail;
+
+/* The number of entries in that list.  */
+static ptrdiff_t searchbuf_count;
+
+/* A hash table of the entries whose regexp is non-nil, chained through
+   their hash_next fields.  Its size is a power of 2.  */
+static struct regexp_cache **searchbuf_table;
+static ptrdiff_t searchbuf_table_size;
 
-/* The head of the linked list; points to the most recently used buffer.  */
-static struct regexp_cache *searchbuf_head;
+/* Incremented by clear_regexp_cache, so that regexp sets compiled
+   for a syntax table know to recompile themselves.  */
+static unsigned int regexp_cache_generation;
+
+/* Statistics reported by 'regexp-cache-statistics'.  */
+static intmax_t regexp_cache_hits, regexp_cache_misses;
+static struct timespec regexp_cache_compile_time;
 
 static void set_search_regs (ptrdiff_t, ptrdiff_t);
 static void save_search_regs (void);
@@ -120,8 +152,12 @@ compile_pattern_1 (struct regexp_cache *cp, Lisp_Object pattern,
   whitespace_regexp = STRINGP (Vsearch_spaces_regexp) ?
     SSDATA (Vsearch_spaces_regexp) : NULL;
 
+  struct timespec start = current_timespec ();
   val = (char *) re_compile_pattern (SSDATA (pattern), SBYTES (pattern),
 				     posix, whitespace_regexp, &cp->buf);
+  regexp_cache_compile_time
+    = timespec_add (regexp_cache_compile_time,
+		    timespec_sub (current_timespec (), start));
 
   /* If the compiled pattern hard codes some of the contents of the
      syntax-table, it can only be reused with *this* syntax table.  */
@@ -147,7 +183,184 @@ shrink_regexp_cache (void)
       {
         cp->buf.allocated = cp->buf.used;
         cp->buf.buffer = xrealloc (cp->buf.buffer, cp->buf.used);
+        /* Large automata are rebuilt when needed.  */
+        re_shrink_dfa (&cp->buf);
       }
+  /* Automata, including those of regexp sets, may refer to tables
+     that are about to be collected.  */
+  re_flush_dfa_caches ();
+}
+
+/* Mark the Lisp objects in the regexp cache.
+   This is called from garbage collection.  */
+
+void
+mark_regexp_cache (void)
+{
+  struct regexp_cache *cp;
+
+  for (cp = searchbuf_head; cp != 0; cp = cp->next)
+    {
+      mark_object (cp->regexp);
+      mark_object (cp->f_whitespace_regexp);
+      mark_object (cp->syntax_table);
+      mark_object (cp->buf.translate);
+    }
+}
+
+/* Return the hash code for looking up PATTERN, compiled with TRANSLATE
+   and POSIX, in the regexp cache.  The syntax table, whitespace regexp
+   and unibyte charset are left out; compile_pattern compares them
+   when it finds an entry with the same hash code.  */
+
+static EMACS_UINT
+regexp_cache_hash (Lisp_Object pattern, Lisp_Object translate, bool posix)
+{
+  EMACS_UINT hash = hash_string (SSDATA (pattern), SBYTES (pattern));
+  hash = sxhash_combine (hash, XHASH (translate));
+  return sxhash_combine (hash, (STRING_MULTIBYTE (pattern) << 1) | posix);
+}
+
+/* Remove CP from the hash table of the regexp cache, if it is there.  */
+
+static void
+regexp_cache_unhash (struct regexp_cache *cp)
+{
+  struct regexp_cache **cpp;
+
+  if (NILP (cp->regexp))
+    return;
+  for (cpp = &searchbuf_table[cp->hash & (searchbuf_table_size - 1)];
+       *cpp; cpp = &(*cpp)->hash_next)
+    if (*cpp == cp)
+      {
+	*cpp = cp->hash_next;
+	break;
+      }
+  cp->regexp = Qnil;
+}
+
+/* Add CP, whose regexp is non-nil, to the hash table.  */
+
+static void
+regexp_cache_rehash (struct regexp_cache *cp)
+{
+  struct regexp_cache **bucket
+    = &searchbuf_table[cp->hash & (searchbuf_table_size - 1)];
+  cp->hash_next = *bucket;
+  *bucket = cp;
+}
+
+/* Move CP to the front of the list of entries.  */
+
+static void
+regexp_cache_use (struct regexp_cache *cp)
+{
+  if (cp == searchbuf_head)
+    return;
+  if (cp->prev)
+    cp->prev->next = cp->next;
+  if (cp->next)
+    cp->next->prev = cp->prev;
+  else if (cp == searchbuf_tail)
+    searchbuf_tail = cp->prev;
+  cp->prev = NULL;
+  cp->next = searchbuf_head;
+  if (searchbuf_head)
+    searchbuf_head->prev = cp;
+  searchbuf_head = cp;
+  if (!searchbuf_tail)
+    searchbuf_tail = cp;
+}
+
+/* Return the least recently used entry that is not busy, or null if
+   all entries are.  */
+
+static struct regexp_cache *
+regexp_cache_lru (void)
+{
+  struct regexp_cache *cp;
+
+  for (cp = searchbuf_tail; cp && cp->busy; cp = cp->prev)
+    continue;
+  return cp;
+}
+
+/* Remove CP, which must not be busy, from the cache and free it.  */
+
+static void
+regexp_cache_free (struct regexp_cache *cp)
+{
+  eassert (!cp->busy);
+  regexp_cache_unhash (cp);
+  if (cp->prev)
+    cp->prev->next = cp->next;
+  else
+    searchbuf_head = cp->next;
+  if (cp->next)
+    cp->next->prev = cp->prev;
+  else
+    searchbuf_tail = cp->prev;
+  re_free_dfa (&cp->buf);
+  xfree (cp->buf.buffer);
+  xfree (cp);
+  searchbuf_count--;
+}
+
+/* Return an entry of the regexp cache that can be compiled into.
+   Take a new one while there are fewer than 'regexp-cache-size', and
+   otherwise reuse the least recently used one.  If every entry is
+   busy, add one anyway; it is freed again once the cache is full.  */
+
+static struct regexp_cache *
+regexp_cache_entry (void)
+{
+  struct regexp_cache *cp;
+  ptrdiff_t limit = clip_to_bounds (1, regexp_cache_size,
+				    min (PTRDIFF_MAX, SIZE_MAX) / 2
+				    / sizeof *searchbuf_table);
+
+  /* Shrink the cache if its size limit was lowered.  */
+  while (limit < searchbuf_count && (cp = regexp_cache_lru ()))
+    regexp_cache_free (cp);
+
+  if (searchbuf_count < limit || ! (cp = regexp_cache_lru ()))
+    {
+      cp = xzalloc (sizeof *cp);
+      cp->buf.allocated = 100;
+      cp->buf.buffer = xmalloc (100);
+      cp->buf.fastmap = cp->fastmap;
+      cp->regexp = Qnil;
+      cp->f_whitespace_regexp = Qnil;
+      cp->syntax_table = Qnil;
+      cp->buf.translate = Qnil;
+      cp->prev = searchbuf_tail;
+      if (searchbuf_tail)
+	searchbuf_tail->next = cp;
+      else
+	searchbuf_head = cp;
+      searchbuf_tail = cp;
+      searchbuf_count++;
+
+      /* Keep the hash table at most half full.  */
+      if (searchbuf_table_size < 2 * searchbuf_count)
+	{
+	  struct regexp_cache *p;
+	  ptrdiff_t size = max (64, searchbuf_table_size);
+	  while (size < 2 * searchbuf_count)
+	    size *= 2;
+	  xfree (searchbuf_table);
+	  searchbuf_table = xzalloc (size * sizeof *searchbuf_table);
+	  searchbuf_table_size = size;
+	  for (p = searchbuf_head; p; p = p->next)
+	    if (!NILP (p->regexp))
+	      regexp_cache_rehash (p);
+	}
+    }
+  else
+    regexp_cache_unhash (cp);
+
+  return cp;
 }
 
 /* Clear the regexp cache w.r.t. a particular syntax table,
@@ -158,14 +371,16 @@ shrink_regexp_cache (void)
 void
 clear_regexp_cache (void)
 {
-  int i;
+  struct regexp_cache *cp;
 
-  for (i = 0; i < REGEXP_CACHE_SIZE; ++i)
+  for (cp = searchbuf_head; cp != 0; cp = cp->next)
     /* It's tempting to compare with the syntax-table we've actually changed,
        but it's not sufficient because char-table inheritance means that
        modifying one syntax-table can change others at the same time.  */
-    if (!searchbufs[i].busy && !EQ (searchbufs[i].syntax_table, Qt))
-      searchbufs[i].regexp = Qnil;
+    if (!cp->busy && !EQ (cp->syntax_table, Qt))
+      regexp_cache_unhash (cp);
+  regexp_cache_generation++;
+  re_flush_dfa_caches ();
 }
 
 static void
@@ -198,53 +413,42 @@ static struct regexp_cache *
 compile_pattern (Lisp_Object pattern, struct re_registers *regp,
 		 Lisp_Object translate, bool posix, bool multibyte)
 {
-  struct regexp_cache *cp, **cpp, **lru_nonbusy;
-
-  for (cpp = &searchbuf_head, lru_nonbusy = NULL; ; cpp = &cp->next)
-    {
-      cp = *cpp;
-      if (!cp->busy)
-        lru_nonbusy = cpp;
-      /* Entries are initialized to nil, and may be set to nil by
-	 compile_pattern_1 if the pattern isn't valid.  Don't apply
-	 string accessors in those cases.  However, compile_pattern_1
-	 is only applied to the cache entry we pick here to reuse.  So
-	 nil should never appear before a non-nil entry.  */
-      if (NILP (cp->regexp))
-	goto compile_it;
-      if (SCHARS (cp->regexp) == SCHARS (pattern)
-          && !cp->busy
-	  && STRING_MULTIBYTE (cp->regexp) == STRING_MULTIBYTE (pattern)
-	  && !NILP (Fstring_equal (cp->regexp, pattern))
-	  && EQ (cp->buf.translate, translate)
-	  && cp->posix == posix
-	  && (EQ (cp->syntax_table, Qt)
-	      || EQ (cp->syntax_table, BVAR (current_buffer, syntax_table)))
-	  && !NILP (Fequal (cp->f_whitespace_regexp, Vsearch_spaces_regexp))
-	  && cp->buf.charset_unibyte == charset_unibyte)
-	break;
-
-      /* If we're at the end of the cache, compile into the last
-	 (least recently used) non-busy cell in the cache.  */
-      if (cp->next == 0)
-	{
-          if (!lru_nonbusy)
-            error ("Too much matching reentrancy");
-          cpp = lru_nonbusy;
-          cp = *cpp;
-	compile_it:
-          eassert (!cp->busy);
-	  compile_pattern_1 (cp, pattern, translate, posix);
-	  break;
-	}
+  struct regexp_cache *cp;
+  EMACS_UINT hash = regexp_cache_hash (pattern, translate, posix);
+
+  for (cp = (searchbuf_table
+	     ? searchbuf_table[hash & (searchbuf_table_size - 1)]
+	     : NULL);
+       cp; cp = cp->hash_next)
+    if (cp->hash == hash
+	&& !cp->busy
+	&& SCHARS (cp->regexp) == SCHARS (pattern)
+	&& STRING_MULTIBYTE (cp->regexp) == STRING_MULTIBYTE (pattern)
+	&& !NILP (Fstring_equal (cp->regexp, pattern))
+	&& EQ (cp->buf.translate, translate)
+	&& cp->posix == posix
+	&& (EQ (cp->syntax_table, Qt)
+	    || EQ (cp->syntax_table, BVAR (current_buffer, syntax_table)))
+	&& !NILP (Fequal (cp->f_whitespace_regexp, Vsearch_spaces_regexp))
+	&& cp->buf.charset_unibyte == charset_unibyte)
+      break;
+
+  if (cp)
+    regexp_cache_hits++;
+  else
+    {
+      regexp_cache_misses++;
+      cp = regexp_cache_entry ();
+      eassert (!cp->busy);
+      compile_pattern_1 (cp, pattern, translate, posix);
+      cp->hash = hash;
+      regexp_cache_rehash (cp);
     }
 
-  /* When we get here, cp (aka *cpp) contains the compiled pattern,
-     either because we found it in the cache or because we just compiled it.
-     Move it to the front of the queue to mark it as most recently used.  */
-  *cpp = cp->next;
-  cp->next = searchbuf_head;
-  searchbuf_head = cp;
+  /* When we get here, cp contains the compiled pattern, either because
+     we found it in the cache or because we just compiled it.  Move it
+     to the front of the list to mark it as most recently used.  */
+  regexp_cache_use (cp);
 
   /* Advise the searching functions about the space we have allocated
      for register data.  */
@@ -620,6 +824,179 @@ newline_cache_on_off (struct buffer *buf)
 }
 
 
+/* Newline-free stretches of text shorter than this many bytes are not
+   recorded in the newline cache.  Looking such a stretch up in the
+   cache costs more than rescanning it, and caching every short line
+   of a large buffer makes the cache grow without bound.  */
+enum { NEWLINE_CACHE_MIN_RUN = 1024 };
+
+/* Block-at-a-time newline detection.  NEWLINE_BLOCK_BYTES is the
+   number of bytes examined at once, and newline_block_bits returns a
+   mask whose bit I is set if P[I] is a newline.  */
+#ifdef __AVX2__
+enum { NEWLINE_BLOCK_BYTES = 32 };
+static unsigned int
+newline_block_bits (unsigned char const *p)
+{
+  __m256i block = _mm256_loadu_si256 ((__m256i const *) p);
+  return _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (block,
+						  _mm256_set1_epi8 ('\n')));
+}
+#elif defined __SSE2__
+enum { NEWLINE_BLOCK_BYTES = 16 };
+static unsigned int
+newline_block_bits (unsigned char const *p)
+{
+  __m128i block = _mm_loadu_si128 ((__m128i const *) p);
+  return _mm_movemask_epi8 (_mm_cmpeq_epi8 (block, _mm_set1_epi8 ('\n')));
+}
+#else
+enum { NEWLINE_BLOCK_BYTES = 0 };
+static unsigned int
+newline_block_bits (unsigned char const *p)
+{
+  emacs_abort ();
+}
+#endif
+
+/* Index of the last newline in a block whose newline mask is BITS.  */
+static int
+last_newline_in_block (unsigned int bits)
+{
+  return UINT_WIDTH - 1 - count_leading_zeros (bits);
+}
+
+/* Scan forward through the LEN contiguous bytes at P, passing over at
+   most *COUNT newlines, and decrement *COUNT by the number passed.
+   If MIN_RUN is positive, also stop before any stretch of MIN_RUN or
+   more bytes that contains no newline, so that the caller can record
+   it in the newline cache.  Return a pointer just after the last
+   newline passed, or P if none was.  */
+
+unsigned char *
+skip_newlines_forward (unsigned char *p, ptrdiff_t len, ptrdiff_t *count,
+		       ptrdiff_t min_run)
+{
+  unsigned char *lim = p + len, *after = p;
+  ptrdiff_t n = *count;
+
+  if (NEWLINE_BLOCK_BYTES)
+    for (; 0 < n && NEWLINE_BLOCK_BYTES <= lim - p; p += NEWLINE_BLOCK_BYTES)
+      {
+	unsigned int bits = newline_block_bits (p);
+	int nls;
+
+	if (!bits)
+	  {
+	    if (0 < min_run && min_run <= p + NEWLINE_BLOCK_BYTES - after)
+	      goto done;
+	    continue;
+	  }
+	if (0 < min_run && min_run <= p + count_trailing_zeros (bits) - after)
+	  goto done;
+
+	nls = count_one_bits (bits);
+	if (nls < n)
+	  {
+	    n -= nls;
+	    after = p + last_newline_in_block (bits) + 1;
+	  }
+	else
+	  {
+	    while (--n)
+	      bits &= bits - 1;
+	    after = p + count_trailing_zeros (bits) + 1;
+	    goto done;
+	  }
+      }
+
+  /* Whatever is left is shorter than a block, or there is no
+     block-at-a-time support; go a line at a time.  */
+  while (0 < n)
+    {
+      ptrdiff_t span = lim - p;
+      unsigned char *nl;
+
+      if (0 < min_run)
+	span = min (span, after + min_run - p);
+      nl = memchr (p, '\n', span);
+      if (!nl)
+	break;
+      n--;
+      p = after = nl + 1;
+    }
+
+ done:
+  *count = n;
+  return after;
+}
+
+/* Like skip_newlines_forward, but scan backward from the end of the
+   LEN bytes at P.  Return a pointer to the last newline passed, or
+   P + LEN if none was.  */
+
+unsigned char *
+skip_newlines_backward (unsigned char *p, ptrdiff_t len, ptrdiff_t *count,
+			ptrdiff_t min_run)
+{
+  unsigned char *q = p + len, *at = q;
+  ptrdiff_t n = *count;
+
+  if (NEWLINE_BLOCK_BYTES)
+    while (0 < n && NEWLINE_BLOCK_BYTES <= q - p)
+      {
+	unsigned int bits;
+	int nls, last;
+
+	q -= NEWLINE_BLOCK_BYTES;
+	bits = newline_block_bits (q);
+	if (!bits)
+	  {
+	    if (0 < min_run && min_run <= at - q)
+	      goto done;
+	    continue;
+	  }
+	last = last_newline_in_block (bits);
+	if (0 < min_run && min_run <= at - (q + last + 1))
+	  goto done;
+
+	nls = count_one_bits (bits);
+	if (nls < n)
+	  {
+	    n -= nls;
+	    at = q + count_trailing_zeros (bits);
+	  }
+	else
+	  {
+	    while (--n)
+	      {
+		bits ^= 1u << last;
+		last = last_newline_in_block (bits);
+	      }
+	    at = q + last;
+	    goto done;
+	  }
+      }
+
+  while (0 < n)
+    {
+      ptrdiff_t span = q - p;
+      unsigned char *nl;
+
+      if (0 < min_run)
+	span = min (span, q - at + min_run);
+      nl = memrchr (q - span, '\n', span);
+      if (!nl)
+	break;
+      n--;
+      q = at = nl;
+    }
+
+ done:
+  *count = n;
+  return at;
+}
+
 /* Search for COUNT newlines between START/START_BYTE and END/END_BYTE.
 
    If COUNT is positive, search forwards; END must be >= START.
@@ -778,7 +1155,7 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
 
               /* If we're using the newline cache, cache the fact that
                  the region we just traversed is free of newlines. */
-              if (newline_cache && cursor != next)
+              if (newline_cache && NEWLINE_CACHE_MIN_RUN <= next - cursor)
 		{
 		  know_region_cache (cache_buffer, newline_cache,
 				     BYTE_TO_CHAR (lim_byte + cursor),
@@ -790,8 +1167,16 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
               if (! nl)
 		break;
 	      next++;
+	      count--;
 
-	      if (--count == 0)
+	      /* Pass over any short lines that follow in bulk,
+		 stopping before a line long enough to be cached.  */
+	      nl = skip_newlines_forward (lim_addr + next, - next, &count,
+					  (newline_cache
+					   ? NEWLINE_CACHE_MIN_RUN : 0));
+	      next = nl - lim_addr;
+
+	      if (count == 0)
 		{
 		  if (bytepos)
 		    *bytepos = lim_byte + next;
@@ -881,12 +1266,13 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
 
 	  for (cursor = base; 0 < cursor; cursor = prev)
             {
+	      ptrdiff_t left;
 	      unsigned char *nl = memrchr (ceiling_addr, '\n', cursor);
 	      prev = nl ? nl - ceiling_addr : -1;
 
               /* If we're looking for newlines, cache the fact that
                  this line's region is free of them. */
-              if (newline_cache && cursor != prev + 1)
+              if (newline_cache && NEWLINE_CACHE_MIN_RUN <= cursor - (prev + 1))
 		{
 		  know_region_cache (cache_buffer, newline_cache,
 				     BYTE_TO_CHAR (ceiling_byte + prev + 1),
@@ -898,7 +1284,19 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
               if (! nl)
 		break;
 
-	      if (++count >= 0)
+	      /* Pass over any short lines that precede in bulk, as in
+		 the forward case.  */
+	      left = - ++count;
+	      if (0 < left)
+		{
+		  nl = skip_newlines_backward (ceiling_addr, prev, &left,
+					       (newline_cache
+						? NEWLINE_CACHE_MIN_RUN : 0));
+		  prev = nl - ceiling_addr;
+		  count = - left;
+		}
+
+	      if (count >= 0)
 		{
 		  if (bytepos)
 		    *bytepos = ceiling_byte + prev + 1;
@@ -1283,6 +1681,405 @@ search_buffer_re (Lisp_Object string, ptrdiff_t pos, ptrdiff_t pos_byte,
   return (pos);
 }
 
+/* Searching for literal strings a block at a time.
+
+   Most literal searches are for ASCII or UTF-8 strings, either
+   verbatim or with case folding in which each letter has a single
+   case equivalent that differs from it in one bit of one byte.  Such
+   a pattern can be matched byte by byte: a text byte B matches byte I
+   of the pattern if (B | MASK[I]) == PAT[I].  Instead of the strides
+   of boyer_moore, literal_search looks for the positions where two
+   rarely used bytes of the pattern both match, examining a whole
+   block of positions at once, and verifies only those.  */
+
+/* The length in bytes beyond which a pattern that boyer_moore can
+   handle is left to it, since its strides then beat scanning every
+   position.  */
+enum { LITERAL_SEARCH_MAX_LENGTH = 24 };
+
+/* Approximate ranks of the bytes by how often they occur in typical
+   text, from 0 for the rarest to 255 for the most common, as measured
+   over the Emacs sources and documentation.  */
+static unsigned char const byte_frequency_rank[0400] =
+  {
+    0,   0,   0,   0,   0,   0,   0,   0,   0, 232, 245,   0,  94,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  76,   0,   0,   0,   0,
+  255, 163, 231, 179, 156, 167, 174, 221, 240, 239, 214, 176, 225, 244, 226, 199,
+  220, 206, 198, 188, 175, 177, 171, 168, 170, 172, 211, 229, 165, 202, 189, 180,
+  217, 213, 185, 210, 196, 218, 200, 190, 181, 215, 130, 160, 203, 197, 205, 201,
+  195, 158, 209, 212, 219, 191, 166, 183, 173, 169, 129, 184, 216, 182, 153, 222,
+  192, 250, 233, 243, 242, 254, 241, 234, 236, 252, 187, 223, 246, 238, 251, 249,
+  235, 204, 248, 247, 253, 237, 227, 228, 224, 230, 186, 208, 164, 207,  93,   0,
+  154, 148, 150, 111, 149,  87,  81, 125, 147, 120,  99, 117, 131,  97,  71,  91,
+  114,  86,  73,  79, 128, 145,  85, 107, 119, 141, 106, 101, 133, 136, 110,  77,
+  135, 134,  95, 126, 115, 124,  90, 127, 113, 108, 121,  80, 103, 137,  74,  75,
+  152, 116, 144,  98, 142, 143,  92,  89, 193, 159, 112, 105, 140, 132, 139,  82,
+    0,   0,  72, 151, 104, 109,  57,  61,  55,  64,  63,  59,  62,  50,  69,  65,
+  178, 155,  58,  54,  43,  49,  66, 161,  68,  67,  56,  60,   0,   0,  52,   0,
+  194,  88, 102,  83,  96, 146, 138, 123, 100,  84, 122, 157, 162, 118,  53,  78,
+   51,   0,   0,  46,   0,  48,  70,   0,  47,  44,   0,   0,   0,  45,   0,   0,
+  };
+
+/* Store in PAT the bytes of the character C of a pattern, as they
+   appear in text that is MULTIBYTE, and in MASK the bits to ignore in
+   each of them.  C has already been translated by a case table whose
+   table of equivalences is INVERSE_TRT, or nil if the search does not
+   fold case.  Return the number of bytes stored, or 0 if C cannot be
+   matched byte by byte, because it has more than one case equivalent,
+   or one that is too different from it.  */
+
+int
+literal_char_bytes (int c, bool multibyte, Lisp_Object inverse_trt,
+		    unsigned char *pat, unsigned char *mask)
+{
+  int len = multibyte ? CHAR_STRING (c, pat) : (pat[0] = c, 1);
+  int inverse, other;
+
+  memset (mask, 0, len);
+  if (NILP (inverse_trt))
+    return len;
+  TRANSLATE (inverse, inverse_trt, c);
+  if (inverse == c)
+    return len;
+
+  unsigned char str[MAX_MULTIBYTE_LENGTH];
+  bool differs = false;
+
+  TRANSLATE (other, inverse_trt, inverse);
+  if (other != c)
+    return 0;
+  if (multibyte)
+    {
+      if (CHAR_BYTE8_P (inverse) || CHAR_STRING (inverse, str) != len)
+	return 0;
+    }
+  else if (c < 0200 && inverse < 0200)
+    str[0] = inverse;
+  else
+    return 0;
+
+  for (int j = 0; j < len; j++)
+    if (str[j] != pat[j])
+      {
+	int bit = str[j] ^ pat[j];
+	if (differs || (bit & (bit - 1)) != 0)
+	  return 0;
+	differs = true;
+	mask[j] = bit;
+	pat[j] |= bit;
+      }
+  return len;
+}
+
+/* Fill in *LP for the LEN bytes of pattern in PAT and their MASK, as
+   set up by literal_char_bytes.  */
+
+void
+literal_pattern_finish (struct literal_pattern *lp, unsigned char *pat,
+			unsigned char *mask, ptrdiff_t len)
+{
+  /* Pick the two bytes that are least likely to match by chance.  A
+     byte with a mask is as likely as the more common of the two bytes
+     that it matches.  */
+  int best1 = INT_MAX, best2 = INT_MAX;
+  lp->rare1 = lp->rare2 = 0;
+  for (ptrdiff_t i = 0; i < len; i++)
+    {
+      int rank = max (byte_frequency_rank[pat[i]],
+		      byte_frequency_rank[pat[i] & ~mask[i]]);
+      if (rank < best1)
+	{
+	  best2 = best1;
+	  lp->rare2 = lp->rare1;
+	  best1 = rank;
+	  lp->rare1 = i;
+	}
+      else if (rank < best2)
+	{
+	  best2 = rank;
+	  lp->rare2 = i;
+	}
+    }
+  if (len == 1)
+    lp->rare2 = lp->rare1;
+
+  lp->pat = pat;
+  lp->mask = mask;
+  lp->len = len;
+}
+
+/* Fill in *LP for the LEN_BYTE bytes of PAT, which have already been
+   translated by TRT, and return true.  Store the pattern and its mask
+   in PATBUF and MASKBUF, which must be LEN_BYTE bytes long.  Return
+   false if some character in PAT cannot be matched byte by byte.  */
+
+static bool
+literal_pattern_init (struct literal_pattern *lp,
+		      unsigned char const *pat, ptrdiff_t len_byte,
+		      bool multibyte, Lisp_Object trt,
+		      Lisp_Object inverse_trt,
+		      unsigned char *patbuf, unsigned char *maskbuf)
+{
+  if (NILP (trt))
+    {
+      memcpy (patbuf, pat, len_byte);
+      memset (maskbuf, 0, len_byte);
+    }
+  else
+    for (ptrdiff_t i = 0; i < len_byte; )
+      {
+	int charlen = 1;
+	int c = multibyte ? STRING_CHAR_AND_LENGTH (pat + i, charlen) : pat[i];
+
+	if (literal_char_bytes (c, multibyte, inverse_trt,
+				patbuf + i, maskbuf + i)
+	    != charlen)
+	  return false;
+	i += charlen;
+      }
+
+  literal_pattern_finish (lp, patbuf, maskbuf, len_byte);
+  return true;
+}
+
+/* Return true if LP matches the contiguous text at P.  */
+
+static bool
+literal_match_p (struct literal_pattern const *lp, unsigned char const *p)
+{
+  ptrdiff_t i = 0, len = lp->len;
+
+  for (; sizeof (size_t) <= len - i; i += sizeof (size_t))
+    {
+      size_t text, pat, mask;
+      memcpy (&text, p + i, sizeof text);
+      memcpy (&pat, lp->pat + i, sizeof pat);
+      memcpy (&mask, lp->mask + i, sizeof mask);
+      if ((text | mask) != pat)
+	return false;
+    }
+  for (; i < len; i++)
+    if ((p[i] | lp->mask[i]) != lp->pat[i])
+      return false;
+  return true;
+}
+
+/* Return true if LP matches the text at byte position POS_BYTE, which
+   may span the gap.  */
+
+static bool
+literal_match_at (struct literal_pattern const *lp, ptrdiff_t pos_byte)
+{
+  for (ptrdiff_t i = 0; i < lp->len; i++)
+    if ((FETCH_BYTE (pos_byte + i) | lp->mask[i]) != lp->pat[i])
+      return false;
+  return true;
+}
+
+/* Return true if the rare bytes of LP match the text at P.  */
+
+static bool
+literal_rare_match_p (struct literal_pattern const *lp, unsigned char const *p)
+{
+  return ((p[lp->rare1] | lp->mask[lp->rare1]) == lp->pat[lp->rare1]
+	  && (p[lp->rare2] | lp->mask[lp->rare2]) == lp->pat[lp->rare2]);
+}
+
+/* Block-at-a-time candidate detection, on blocks of the same size as
+   newline_block_bits.  literal_block_bits returns a mask whose bit I
+   is set if both rare bytes of LP match the text at P + I.  */
+#ifdef __AVX2__
+static inline unsigned int
+literal_block_bits (struct literal_pattern const *lp, unsigned char const *p)
+{
+  __m256i b1 = _mm256_loadu_si256 ((__m256i const *) (p + lp->rare1));
+  __m256i b2 = _mm256_loadu_si256 ((__m256i const *) (p + lp->rare2));
+  b1 = _mm256_or_si256 (b1, _mm256_set1_epi8 (lp->mask[lp->rare1]));
+  b2 = _mm256_or_si256 (b2, _mm256_set1_epi8 (lp->mask[lp->rare2]));
+  return _mm256_movemask_epi8
+    (_mm256_and_si256 (_mm256_cmpeq_epi8 (b1, _mm256_set1_epi8
+					      (lp->pat[lp->rare1])),
+		       _mm256_cmpeq_epi8 (b2, _mm256_set1_epi8
+					      (lp->pat[lp->rare2]))));
+}
+#elif defined __SSE2__
+static inline unsigned int
+literal_block_bits (struct literal_pattern const *lp, unsigned char const *p)
+{
+  __m128i b1 = _mm_loadu_si128 ((__m128i const *) (p + lp->rare1));
+  __m128i b2 = _mm_loadu_si128 ((__m128i const *) (p + lp->rare2));
+  b1 = _mm_or_si128 (b1, _mm_set1_epi8 (lp->mask[lp->rare1]));
+  b2 = _mm_or_si128 (b2, _mm_set1_epi8 (lp->mask[lp->rare2]));
+  return _mm_movemask_epi8
+    (_mm_and_si128 (_mm_cmpeq_epi8 (b1, _mm_set1_epi8 (lp->pat[lp->rare1])),
+		    _mm_cmpeq_epi8 (b2, _mm_set1_epi8 (lp->pat[lp->rare2]))));
+}
+#else
+static inline unsigned int
+literal_block_bits (struct literal_pattern const *lp, unsigned char const *p)
+{
+  emacs_abort ();
+}
+#endif
+
+/* Return the first (if FORWARD) or last of the positions from P up to
+   but not including LIM where LP matches, or NULL if there is none.
+   The text from P up to LIM + LP->len - 1 must be contiguous.  */
+
+unsigned char const *
+literal_scan (struct literal_pattern const *lp, unsigned char const *p,
+	      unsigned char const *lim, bool forward)
+{
+  unsigned char rare = lp->pat[lp->rare1];
+  bool exact = !lp->mask[lp->rare1];
+
+  if (forward)
+    {
+      if (NEWLINE_BLOCK_BYTES)
+	for (; NEWLINE_BLOCK_BYTES <= lim - p; p += NEWLINE_BLOCK_BYTES)
+	  for (unsigned int bits = literal_block_bits (lp, p);
+	       bits; bits &= bits - 1)
+	    {
+	      unsigned char const *q = p + count_trailing_zeros (bits);
+	      if (literal_match_p (lp, q))
+		return q;
+	    }
+
+      /* Without block-at-a-time support, at least let memchr look
+	 for the rarest byte.  */
+      for (; p < lim; p++)
+	{
+	  if (exact)
+	    {
+	      unsigned char const *q = memchr (p + lp->rare1, rare, lim - p);
+	      if (!q)
+		break;
+	      p = q - lp->rare1;
+	    }
+	  if (literal_rare_match_p (lp, p) && literal_match_p (lp, p))
+	    return p;
+	}
+    }
+  else
+    {
+      if (NEWLINE_BLOCK_BYTES)
+	for (; NEWLINE_BLOCK_BYTES <= lim - p; lim -= NEWLINE_BLOCK_BYTES)
+	  {
+	    unsigned char const *q = lim - NEWLINE_BLOCK_BYTES;
+	    for (unsigned int bits = literal_block_bits (lp, q); bits; )
+	      {
+		int last = last_newline_in_block (bits);
+		if (literal_match_p (lp, q + last))
+		  return q + last;
+		bits ^= 1u << last;
+	      }
+	  }
+
+      while (p < lim)
+	{
+	  lim--;
+	  if (exact)
+	    {
+	      unsigned char const *q = memrchr (p + lp->rare1, rare,
+						lim + 1 - p);
+	      if (!q)
+		break;
+	      lim = q - lp->rare1;
+	    }
+	  if (literal_rare_match_p (lp, lim) && literal_match_p (lp, lim))
+	    return lim;
+	}
+    }
+  return NULL;
+}
+
+/* Return the byte position of the first (if FORWARD) or last match of
+   LP that starts at or after FROM and before TO, or -1 if there is
+   none.  The match must end by TO - 1 + LP->len.  */
+
+static ptrdiff_t
+literal_search_range (struct literal_pattern const *lp,
+		      ptrdiff_t from, ptrdiff_t to, bool forward)
+{
+  /* Matches that start before GPT_BYTE - LEN + 1 lie before the gap,
+     those that start from GPT_BYTE on lie after it, and the few in
+     between span it.  */
+  ptrdiff_t straddle = max (GPT_BYTE - lp->len + 1, BEG_BYTE);
+  ptrdiff_t bounds[4] = { from, clip_to_bounds (from, straddle, to),
+			  clip_to_bounds (from, GPT_BYTE, to), to };
+  /* Bytes scanned at a time between checks for quitting.  */
+  enum { CHUNK = 1 << 20 };
+
+  for (int k = 0; k < 3; k++)
+    {
+      int part = forward ? k : 2 - k;
+      ptrdiff_t beg = bounds[part], end = bounds[part + 1];
+
+      if (part == 1)
+	{
+	  /* The matches that span the gap.  */
+	  for (ptrdiff_t i = 0; i < end - beg; i++)
+	    {
+	      ptrdiff_t pos = forward ? beg + i : end - 1 - i;
+	      if (literal_match_at (lp, pos))
+		return pos;
+	    }
+	  continue;
+	}
+
+      while (beg < end)
+	{
+	  ptrdiff_t chunk_beg = forward ? beg : max (beg, end - CHUNK);
+	  ptrdiff_t chunk_end = forward ? min (end, beg + CHUNK) : end;
+	  unsigned char const *start = BYTE_POS_ADDR (chunk_beg);
+	  unsigned char const *found
+	    = literal_scan (lp, start, start + (chunk_end - chunk_beg),
+			    forward);
+
+	  if (found)
+	    return chunk_beg + (found - start);
+	  if (forward)
+	    beg = chunk_end;
+	  else
+	    end = chunk_beg;
+	  maybe_quit ();
+	}
+    }
+  return -1;
+}
+
+/* Search N times for LP from byte position POS_BYTE to LIM_BYTE,
+   like boyer_moore, and return the same values.  */
+
+static EMACS_INT
+literal_search (EMACS_INT n, struct literal_pattern const *lp,
+		ptrdiff_t pos_byte, ptrdiff_t lim_byte)
+{
+  ptrdiff_t match = -1;
+
+  for (; 0 < n; n--)
+    {
+      match = (lim_byte - pos_byte < lp->len ? -1
+	       : literal_search_range (lp, pos_byte,
+				       lim_byte - lp->len + 1, true));
+      if (match < 0)
+	return -n;
+      pos_byte = match + lp->len;
+    }
+  for (; n < 0; n++)
+    {
+      match = (pos_byte - lim_byte < lp->len ? -1
+	       : literal_search_range (lp, lim_byte,
+				       pos_byte - lp->len + 1, false));
+      if (match < 0)
+	return n;
+      pos_byte = match;
+    }
+
+  set_search_regs (match, lp->len);
+  return BYTE_TO_CHAR (pos_byte);
+}
+
 static EMACS_INT
 search_buffer_non_re (Lisp_Object string, ptrdiff_t pos,
                       ptrdiff_t pos_byte, ptrdiff_t lim, ptrdiff_t lim_byte,
@@ -1474,8 +2271,18 @@ search_buffer_non_re (Lisp_Object string, ptrdiff_t pos,
   len_byte = pat - patbuf;
   pat = base_pat = patbuf;
 
+  /* Search a block at a time when the pattern permits, except that
+     boyer_moore's strides win for long patterns.  */
+  struct literal_pattern lp;
+  unsigned char *litbuf;
+  SAFE_NALLOCA (litbuf, 2, len_byte);
+
   EMACS_INT result
-    = (boyer_moore_ok
+    = (! (boyer_moore_ok && LITERAL_SEARCH_MAX_LENGTH < len_byte)
+       && literal_pattern_init (&lp, pat, len_byte, multibyte, trt,
+                                inverse_trt, litbuf, litbuf + len_byte)
+       ? literal_search (n, &lp, pos_byte, lim_byte)
+       : boyer_moore_ok
        ? boyer_moore (n, pat, len_byte, trt, inverse_trt,
                       pos_byte, lim_byte,
                       char_base)
@@ -2332,6 +3139,258 @@ and `replace-match'.  */)
   return search_command (regexp, bound, noerror, count, 1, 1, 1);
 }
 
+/* Regexp sets.  */
+
+/* Free the compiled regexps of SET.  */
+
+void
+free_regexp_set (struct Lisp_Regexp_Set *set)
+{
+  struct re_pattern_set *patterns = set->patterns;
+
+  if (patterns)
+    {
+      for (ptrdiff_t i = 0; i < patterns->npatterns; i++)
+	{
+	  re_free_dfa (&patterns->patterns[i]);
+	  xfree (patterns->patterns[i].buffer);
+	  xfree (patterns->patterns[i].fastmap);
+	}
+      re_free_set_filter (patterns);
+      xfree (patterns->patterns);
+      xfree (patterns);
+      set->patterns = NULL;
+    }
+}
+
+/* Return the regexps of SET compiled for searching with TRANSLATE in
+   the current buffer, compiling them if necessary.  */
+
+static struct re_pattern_set *
+compile_regexp_set (struct Lisp_Regexp_Set *set, Lisp_Object translate)
+{
+  struct re_pattern_set *patterns = set->patterns;
+  ptrdiff_t n = ASIZE (set->regexps);
+  bool used_syntax = false;
+
+  if (patterns
+      && EQ (set->translate, translate)
+      && (EQ (set->syntax_table, Qt)
+	  || (EQ (set->syntax_table, BVAR (current_buffer, syntax_table))
+	      && set->generation == regexp_cache_generation))
+      && !NILP (Fequal (set->whitespace_regexp, Vsearch_spaces_regexp))
+      && set->charset_unibyte == charset_unibyte)
+    return patterns;
+
+  if (set->busy)
+    error ("Too much matching reentrancy");
+  free_regexp_set (set);
+  patterns = xzalloc (sizeof *patterns);
+  patterns->patterns = xnmalloc (n, sizeof *patterns->patterns);
+  set->patterns = patterns;
+
+  const char *whitespace_regexp
+    = STRINGP (Vsearch_spaces_regexp) ? SSDATA (Vsearch_spaces_regexp) : NULL;
+  for (ptrdiff_t i = 0; i < n; i++)
+    {
+      Lisp_Object regexp = AREF (set->regexps, i);
+      struct re_pattern_buffer *bufp = &patterns->patterns[i];
+
+      memset (bufp, 0, sizeof *bufp);
+      bufp->fastmap = xmalloc (0400);
+      bufp->translate = translate;
+      bufp->multibyte = STRING_MULTIBYTE (regexp);
+      bufp->charset_unibyte = charset_unibyte;
+      patterns->npatterns = i + 1;
+
+      const char *val = re_compile_pattern (SSDATA (regexp), SBYTES (regexp),
+					    false, whitespace_regexp, bufp);
+      if (val)
+	{
+	  free_regexp_set (set);
+	  xsignal1 (Qinvalid_regexp, build_string (val));
+	}
+      used_syntax |= bufp->used_syntax;
+    }
+
+  set->translate = translate;
+  set->syntax_table = used_syntax ? BVAR (current_buffer, syntax_table) : Qt;
+  set->generation = regexp_cache_generation;
+  set->whitespace_regexp
+    = STRINGP (Vsearch_spaces_regexp) ? Vsearch_spaces_regexp : Qnil;
+  set->charset_unibyte = charset_unibyte;
+  return patterns;
+}
+
+static void
+unfreeze_regexp_set (void *arg)
+{
+  struct Lisp_Regexp_Set *set = arg;
+  set->busy = false;
+}
+
+DEFUN ("make-regexp-set", Fmake_regexp_set, Smake_regexp_set, 1, 1, 0,
+       doc: /* Return a regexp set made of the regexps in REGEXPS.
+REGEXPS is a list or vector of regexps.  `re-search-forward-set'
+searches for all the regexps of a set at once.
+
+Signal an `invalid-regexp' error if one of REGEXPS is invalid.  */)
+  (Lisp_Object regexps)
+{
+  Lisp_Object val;
+
+  regexps = Fvconcat (1, &regexps);
+  for (ptrdiff_t i = 0; i < ASIZE (regexps); i++)
+    {
+      CHECK_STRING (AREF (regexps, i));
+      ASET (regexps, i, Fcopy_sequence (AREF (regexps, i)));
+    }
+
+  struct Lisp_Regexp_Set *set
+    = ALLOCATE_ZEROED_PSEUDOVECTOR (struct Lisp_Regexp_Set, whitespace_regexp,
+				    PVEC_REGEXP_SET);
+  set->regexps = regexps;
+  XSETPSEUDOVECTOR (val, set, PVEC_REGEXP_SET);
+
+  /* Report invalid regexps now rather than at the first search.  */
+  compile_regexp_set (set, Qnil);
+  return val;
+}
+
+DEFUN ("regexp-set-p", Fregexp_set_p, Sregexp_set_p, 1, 1, 0,
+       doc: /* Return t if OBJECT is a regexp set.  */)
+  (Lisp_Object object)
+{
+  return REGEXP_SET_P (object) ? Qt : Qnil;
+}
+
+DEFUN ("regexp-set-regexps", Fregexp_set_regexps, Sregexp_set_regexps,
+       1, 1, 0,
+       doc: /* Return a list of the regexps in regexp set SET.  */)
+  (Lisp_Object set)
+{
+  CHECK_REGEXP_SET (set);
+  return CALLN (Fappend, XREGEXP_SET (set)->regexps, Qnil);
+}
+
+DEFUN ("re-search-forward-set", Fre_search_forward_set,
+       Sre_search_forward_set, 1, 3, 0,
+       doc: /* Search forward from point for any of the regexps in SET.
+SET is a regexp set made by `make-regexp-set'.  Find the first position
+where one of its regexps matches; if several of them match there, take
+the one that comes first in SET, as an alternation of the regexps
+would.  Set point to the end of the match found, and return the index
+of the regexp that matched in SET.  The match data describe the match
+of that regexp.
+
+The optional arguments BOUND and NOERROR are as for
+`re-search-forward', which see.
+
+This is faster than looking for each regexp in turn, or for a single
+regexp that combines them.  The text is scanned once for the literal
+strings that the regexps start with, and each regexp is only tried
+where it might match.  */)
+  (Lisp_Object set, Lisp_Object bound, Lisp_Object noerror)
+{
+  ptrdiff_t lim, lim_byte, which;
+  unsigned char *p1, *p2;
+  ptrdiff_t s1, s2, val;
+
+  CHECK_REGEXP_SET (set);
+  if (NILP (bound))
+    lim = ZV, lim_byte = ZV_BYTE;
+  else
+    {
+      lim = fix_position (bound);
+      if (lim < PT)
+	error ("Invalid search bound (wrong side of point)");
+      if (lim > ZV)
+	lim = ZV, lim_byte = ZV_BYTE;
+      else
+	lim_byte = CHAR_TO_BYTE (lim);
+    }
+
+  /* This is so set_image_of_range_1 in regex-emacs.c can find the EQV
+     table.  */
+  set_char_table_extras (BVAR (current_buffer, case_canon_table), 2,
+			 BVAR (current_buffer, case_eqv_table));
+
+  struct Lisp_Regexp_Set *rset = XREGEXP_SET (set);
+  struct re_pattern_set *patterns
+    = compile_regexp_set (rset,
+			  (!NILP (BVAR (current_buffer, case_fold_search))
+			   ? BVAR (current_buffer, case_canon_table) : Qnil));
+
+  /* Snapshot in case Lisp changes the value.  */
+  bool preserve_match_data = NILP (Vinhibit_changing_match_data);
+  struct re_registers *regs
+    = preserve_match_data ? &search_regs : &search_regs_1;
+  bool multibyte = !NILP (BVAR (current_buffer, enable_multibyte_characters));
+  for (ptrdiff_t i = 0; i < patterns->npatterns; i++)
+    {
+      re_set_registers (&patterns->patterns[i], regs, regs->num_regs,
+			regs->start, regs->end);
+      patterns->patterns[i].target_multibyte = multibyte;
+    }
+
+  maybe_quit ();
+
+  p1 = BEGV_ADDR;
+  s1 = GPT_BYTE - BEGV_BYTE;
+  p2 = GAP_END_ADDR;
+  s2 = ZV_BYTE - GPT_BYTE;
+  if (s1 < 0)
+    {
+      p2 = p1;
+      s2 = ZV_BYTE - BEGV_BYTE;
+      s1 = 0;
+    }
+  if (s2 < 0)
+    {
+      s1 = ZV_BYTE - BEGV_BYTE;
+      s2 = 0;
+    }
+
+  ptrdiff_t count = SPECPDL_INDEX ();
+  freeze_buffer_relocation ();
+  record_unwind_protect_ptr (unfreeze_regexp_set, rset);
+  rset->busy = true;
+  re_match_object = Qnil;
+  val = re_search_set (patterns, (char *) p1, s1, (char *) p2, s2,
+		       PT_BYTE - BEGV_BYTE, lim_byte - PT_BYTE, regs,
+		       lim_byte - BEGV_BYTE, &which);
+  unbind_to (count, Qnil);
+
+  if (val == -2)
+    matcher_overflow ();
+  if (val < 0)
+    {
+      if (NILP (noerror))
+	xsignal1 (Qsearch_failed, set);
+      if (!EQ (noerror, Qt))
+	SET_PT_BOTH (lim, lim_byte);
+      return Qnil;
+    }
+
+  if (preserve_match_data)
+    {
+      for (ptrdiff_t i = 0; i < search_regs.num_regs; i++)
+	if (search_regs.start[i] >= 0)
+	  {
+	    search_regs.start[i]
+	      = BYTE_TO_CHAR (search_regs.start[i] + BEGV_BYTE);
+	    search_regs.end[i]
+	      = BYTE_TO_CHAR (search_regs.end[i] + BEGV_BYTE);
+	  }
+      XSETBUFFER (last_thing_searched, current_buffer);
+      SET_PT (search_regs.end[0]);
+    }
+  else
+    SET_PT (BYTE_TO_CHAR (search_regs_1.end[0] + BEGV_BYTE));
+
+  return make_fixnum (which);
+}
+
 DEFUN ("replace-match", Freplace_match, Sreplace_match, 1, 5, 0,
        doc: /* Replace text matched by last search with NEWTEXT.
 Leave point at the end of the replacement text.
@@ -3324,19 +4383,83 @@ the buffer.  If the buffer doesn't have a cache, the value is nil.  */)
   return val;
 }
 
+DEFUN ("regexp-cache-statistics", Fregexp_cache_statistics,
+       Sregexp_cache_statistics, 0, 1, 0,
+       doc: /* Return statistics about the cache of compiled regexps.
+The value is a list (HITS MISSES COMPILE-TIME ENTRIES).  HITS is the
+number of searches that found their regexp already compiled in the
+cache, and MISSES the number of those that had to compile it.
+COMPILE-TIME is the total time, in seconds, spent compiling regexps.
+ENTRIES is the number of compiled regexps currently in the cache; see
+`regexp-cache-size'.
+
+If the optional argument RESET is non-nil, reset HITS, MISSES and
+COMPILE-TIME to zero after computing the value.  */)
+  (Lisp_Object reset)
+{
+  Lisp_Object val = list4 (make_int (regexp_cache_hits),
+			   make_int (regexp_cache_misses),
+			   make_float (timespectod (regexp_cache_compile_time)),
+			   make_int (searchbuf_count));
+  if (!NILP (reset))
+    {
+      regexp_cache_hits = regexp_cache_misses = 0;
+      regexp_cache_compile_time = make_timespec (0, 0);
+    }
+  return val;
+}
+
+DEFUN ("regexp-prefilter", Fregexp_prefilter, Sregexp_prefilter, 1, 1, 0,
+       doc: /* Return the literal string that every match for REGEXP contains.
+Searches for REGEXP look for this string first, and try to match only
+where it occurs.  The value is a cons (STRING . BEFORE), where BEFORE
+is the most characters that a match can have before STRING, or nil if
+there is no limit.  The value is nil if there is no such string that
+searches can use, in which case they try to match everywhere.
+
+Like a search, this depends on `case-fold-search' and on whether the
+current buffer is multibyte.  When case is folded, STRING is in the
+canonical case, usually lower case.  */)
+  (Lisp_Object regexp)
+{
+  CHECK_STRING (regexp);
+
+  /* This is so set_image_of_range_1 in regex-emacs.c can find the EQV
+     table.  */
+  set_char_table_extras (BVAR (current_buffer, case_canon_table), 2,
+			 BVAR (current_buffer, case_eqv_table));
+
+  struct re_pattern_buffer *bufp
+    = &compile_pattern (regexp, NULL,
+			(!NILP (BVAR (current_buffer, case_fold_search))
+			 ? BVAR (current_buffer, case_canon_table) : Qnil),
+			false,
+			!NILP (BVAR (current_buffer,
+				     enable_multibyte_characters)))->buf;
+  int const *chars;
+  ptrdiff_t before;
+  ptrdiff_t nchars = re_required_literal (bufp, &chars, &before);
+  if (!nchars)
+    return Qnil;
+
+  USE_SAFE_ALLOCA;
+  unsigned char *str, *p;
+  SAFE_NALLOCA (str, MAX_MULTIBYTE_LENGTH, nchars);
+  p = str;
+  for (ptrdiff_t i = 0; i < nchars; i++)
+    p += CHAR_STRING (chars[i], p);
+  Lisp_Object val = Fcons (make_multibyte_string ((char *) str, nchars,
+						  p - str),
+			   before < 0 ? Qnil : make_fixnum (before));
+  SAFE_FREE ();
+  return val;
+}
 
 static void syms_of_search_for_pdumper (void);
 
 void
 syms_of_search (void)
 {
-  for (int i = 0; i < REGEXP_CACHE_SIZE; ++i)
-    {
-      staticpro (&searchbufs[i].regexp);
-      staticpro (&searchbufs[i].f_whitespace_regexp);
-      staticpro (&searchbufs[i].syntax_table);
-    }
-
   /* Error condition used for failing searches.  */
   DEFSYM (Qsearch_failed, "search-failed");
 
@@ -3347,6 +4470,8 @@ syms_of_search (void)
   /* Error condition signaled when regexp compile_pattern fails.  */
   DEFSYM (Qinvalid_regexp, "invalid-regexp");
 
+  DEFSYM (Qregexp_set_p, "regexp-set-p");
+
   Fput (Qsearch_failed, Qerror_conditions,
 	pure_list (Qsearch_failed, Qerror));
   Fput (Qsearch_failed, Qerror_message,
@@ -3362,6 +4487,12 @@ syms_of_search (void)
   Fput (Qinvalid_regexp, Qerror_message,
 	build_pure_c_string ("Invalid regexp"));
 
+  DEFSYM (Qregexp_step_limit_exceeded, "regexp-step-limit-exceeded");
+  Fput (Qregexp_step_limit_exceeded, Qerror_conditions,
+	pure_list (Qregexp_step_limit_exceeded, Qerror));
+  Fput (Qregexp_step_limit_exceeded, Qerror_message,
+	build_pure_c_string ("Too many steps in regexp matcher"));
+
   re_match_object = Qnil;
   staticpro (&re_match_object);
 
@@ -3384,6 +4515,59 @@ do not set the match data.  The proper way to use this variable
 is to bind it with `let' around a small expression.  */);
   Vinhibit_changing_match_data = Qnil;
 
+  DEFVAR_BOOL ("regexp-use-dfa", regexp_use_dfa,
+      doc: /* Non-nil means regexp searches can use a deterministic automaton.
+Regexps without back references, counted repetitions or tests for
+point are then also compiled, lazily, into an automaton that finds out
+where matches can start without backtracking, and the backtracking
+matcher only runs where a match is known to succeed.  This avoids exponential
+backtracking in searches that fail.  The results are the same either
+way; this variable exists to compare the two.  */);
+  regexp_use_dfa = true;
+
+  DEFVAR_BOOL ("regexp-use-prefilter", regexp_use_prefilter,
+      doc: /* Non-nil means regexp searches can look for a literal string first.
+When every match for a regexp contains some literal string, searches
+for the regexp look for the string, which is fast, and try to match
+only where it occurs.  See `regexp-prefilter'.  The results are the
+same either way; this variable exists to compare the two.  */);
+  regexp_use_prefilter = true;
+
+  DEFVAR_INT ("regexp-search-steps", regexp_search_steps,
+      doc: /* Number of steps the backtracking matcher took in the last search.
+This counts the instructions of compiled regexps that the last regexp
+search or match executed, including the ones executed again after
+backtracking.  It is a measure of how much work the search was, and
+can help find regexps that backtrack too much.  Searches that an
+automaton answers on its own, as described for `regexp-use-dfa', take
+no steps.  */);
+  regexp_search_steps = 0;
+
+  DEFVAR_LISP ("regexp-step-limit", Vregexp_step_limit,
+      doc: /* Maximum number of steps a regexp search or match can take, or nil.
+If a search takes more steps of the backtracking matcher than this, as
+counted by `regexp-search-steps', it signals a
+`regexp-step-limit-exceeded' error instead of going on.  Binding this
+around searches with regexps that come from elsewhere protects against
+regexps that would take too long.  nil means no limit.  */);
+  Vregexp_step_limit = Qnil;
+
+  DEFSYM (Qalways, "always");
+  DEFVAR_LISP ("regexp-memoize", Vregexp_memoize,
+      doc: /* Whether regexp matching remembers where it failed.
+When matching a regexp takes many steps, because it backtracks a lot,
+the matcher can remember the places in the regexp and the positions
+in the text where matching failed, and fail at once when it gets back
+to them.  This makes the matching time linear in the length of the
+text for regexps like "\\(x+x+\\)+y", at the cost of some memory.
+It can only be done for regexps without back references or counted
+repetitions, and not for POSIX searches.
+
+If the value is nil, never do this.  If it is `always', do this for
+all the regexps that allow it.  Any other value means do it for
+regexps that once took many steps to match.  */);
+  Vregexp_memoize = Qt;
+
   defsubr (&Slooking_at);
   defsubr (&Sposix_looking_at);
   defsubr (&Sstring_match);
@@ -3399,7 +4583,23 @@ is to bind it with `let' around a small expression.  */);
   defsubr (&Smatch_end);
   defsubr (&Smatch_data);
   defsubr (&Sset_match_data);
+  DEFVAR_INT ("regexp-cache-size", regexp_cache_size,
+    doc: /* Maximum number of compiled regexps to keep.
+Searching for a regexp compiles it, and the compiled form is kept for
+reuse by later searches.  When this many regexps are already kept, the
+one used least recently is discarded to make room.  Compiling a regexp
+anew can be much slower than the search itself, so code that uses
+many different regexps repeatedly, such as font-lock, benefits from a
+larger value.  See also `regexp-cache-statistics'.  */);
+  regexp_cache_size = REGEXP_CACHE_SIZE;
+
   defsubr (&Sregexp_quote);
+  defsubr (&Sregexp_cache_statistics);
+  defsubr (&Sregexp_prefilter);
+  defsubr (&Smake_regexp_set);
+  defsubr (&Sregexp_set_p);
+  defsubr (&Sregexp_set_regexps);
+  defsubr (&Sre_search_forward_set);
   defsubr (&Snewline_cache_check);
 
   pdumper_do_now_and_after_load (syms_of_search_for_pdumper);
@@ -3408,16 +4608,9 @@ is to bind it with `let' around a small expression.  */);
 static void
 syms_of_search_for_pdumper (void)
 {
-  for (int i = 0; i < REGEXP_CACHE_SIZE; ++i)
-    {
-      searchbufs[i].buf.allocated = 100;
-      searchbufs[i].buf.buffer = xmalloc (100);
-      searchbufs[i].buf.fastmap = searchbufs[i].fastmap;
-      searchbufs[i].regexp = Qnil;
-      searchbufs[i].f_whitespace_regexp = Qnil;
-      searchbufs[i].busy = false;
-      searchbufs[i].syntax_table = Qnil;
-      searchbufs[i].next = (i == REGEXP_CACHE_SIZE-1 ? 0 : &searchbufs[i+1]);
-    }
-  searchbuf_head = &searchbufs[0];
+  /* The cache is not dumped; start with an empty one.  */
+  searchbuf_head = searchbuf_tail = NULL;
+  searchbuf_count = 0;
+  searchbuf_table = NULL;
+  searchbuf_table_size = 0;
 }
@@ -177,6 +177,10 @@ static struct buffer *find_start_buffer;
 static ptrdiff_t find_start_begv;
 static modiff_count find_start_modiff;
 
+/* Incremented when an entry of a syntax table changes, so that the
+   parse states cached for 'syntax-ppss' are recomputed.  */
+static EMACS_INT syntax_table_generation;
+
 
 static Lisp_Object skip_chars (bool, Lisp_Object, Lisp_Object, bool);
 static Lisp_Object skip_syntaxes (bool, Lisp_Object, Lisp_Object);
@@ -185,6 +189,7 @@ static void scan_sexps_forward (struct lisp_parse_state *,
                                 ptrdiff_t, ptrdiff_t, ptrdiff_t, EMACS_INT,
                                 bool, int);
 static void internalize_parse_state (Lisp_Object, struct lisp_parse_state *);
+static void syntax_ppss (struct lisp_parse_state *, ptrdiff_t);
 static bool in_classes (int, Lisp_Object);
 static void parse_sexp_propertize (ptrdiff_t charpos);
 
@@ -308,6 +313,184 @@ SETUP_SYNTAX_TABLE_FOR_OBJECT (Lisp_Object object,
 			 count, 1, gl_state.object);
 }
 
+/* The runs of equal 'syntax-table' properties in the text of a
+   buffer, from its beginning, so that 'update_syntax_table' need not
+   walk the interval tree, which is slow when the text has many
+   intervals.  The cache belongs to the base buffer; it is truncated
+   by 'invalidate_buffer_caches' when the text changes and by textprop.c
+   when a 'syntax-table' property changes.  */
+
+struct syntax_run_cache
+{
+  /* Run I starts at STARTS[I] and its property is VALUES[I].  It ends
+     where run I + 1 starts; the last run ends at END, or after it.
+     Adjacent runs have different properties.  */
+  ptrdiff_t *starts;
+  Lisp_Object *values;
+  ptrdiff_t nruns, size;
+  ptrdiff_t end;
+
+  /* The run found last, where the next lookup starts.  */
+  ptrdiff_t hint;
+};
+
+/* Minimum number of intervals to add to a cache at a time.  */
+enum { SYNTAX_RUNS_AT_ONCE = 64 };
+
+/* Return the 'syntax-table' property of the text of buffer B at
+   CHARPOS, which must be in B, and store in *START and *END the
+   bounds of the run of text with that property.  */
+
+static Lisp_Object
+syntax_property_run (struct buffer *b, ptrdiff_t charpos,
+		     ptrdiff_t *start, ptrdiff_t *end)
+{
+  struct buffer *base = b->base_buffer ? b->base_buffer : b;
+  struct syntax_run_cache *c = base->syntax_run_cache;
+
+  if (!c)
+    {
+      c = base->syntax_run_cache = xzalloc (sizeof *c);
+      c->end = BUF_BEG (b);
+    }
+
+  /* Add runs until CHARPOS is in one, and SYNTAX_RUNS_AT_ONCE
+     intervals more, so that scanning forward does not come back
+     here at every run.  */
+  if (c->end <= charpos)
+    {
+      INTERVAL i = (buffer_intervals (b)
+		    ? find_interval (buffer_intervals (b), c->end)
+		    : NULL);
+      for (int n = 0;
+	   c->end < BUF_Z (b) && (c->end <= charpos || n < SYNTAX_RUNS_AT_ONCE);
+	   n++)
+	{
+	  Lisp_Object value = i ? textget (i->plist, Qsyntax_table) : Qnil;
+	  if (c->nruns == 0 || !EQ (c->values[c->nruns - 1], value))
+	    {
+	      if (c->nruns == c->size)
+		{
+		  c->starts = xpalloc (c->starts, &c->size, 1, -1,
+				       sizeof *c->starts);
+		  c->values = xrealloc (c->values,
+					c->size * sizeof *c->values);
+		}
+	      c->starts[c->nruns] = c->end;
+	      c->values[c->nruns++] = value;
+	    }
+	  c->end = i ? INTERVAL_LAST_POS (i) : BUF_Z (b);
+	  if (i)
+	    i = next_interval (i);
+	}
+    }
+
+  /* Look for the run, starting with the one found last.  */
+  ptrdiff_t lo = 0, hi = c->nruns, k = c->hint;
+  if (! (k < c->nruns && c->starts[k] <= charpos
+	 && (k + 1 == c->nruns || charpos < c->starts[k + 1])))
+    {
+      if (k + 1 < c->nruns && c->starts[k + 1] <= charpos
+	  && (k + 2 == c->nruns || charpos < c->starts[k + 2]))
+	k++;
+      else
+	{
+	  while (hi - lo > 1)
+	    {
+	      ptrdiff_t mid = lo + (hi - lo) / 2;
+	      if (c->starts[mid] <= charpos)
+		lo = mid;
+	      else
+		hi = mid;
+	    }
+	  k = lo;
+	}
+    }
+
+  if (c->nruns == 0)
+    {
+      /* B is empty.  */
+      *start = *end = BUF_BEG (b);
+      return Qnil;
+    }
+  c->hint = k;
+  *start = c->starts[k];
+  *end = k + 1 < c->nruns ? c->starts[k + 1] : c->end;
+  return c->values[k];
+}
+
+/* Forget the runs that the cache of buffer B has from POS on, because
+   the text or its 'syntax-table' properties from POS on are about to
+   change.  */
+
+void
+invalidate_syntax_run_cache (struct buffer *b, ptrdiff_t pos)
+{
+  struct syntax_run_cache *c = (b->base_buffer
+				? b->base_buffer->syntax_run_cache
+				: b->syntax_run_cache);
+
+  if (c && pos < c->end)
+    {
+      while (0 < c->nruns && pos <= c->starts[c->nruns - 1])
+	c->nruns--;
+      c->end = c->nruns ? pos : BUF_BEG (b);
+    }
+}
+
+/* Mark the Lisp objects in the cache of buffer B.  */
+
+void
+mark_syntax_run_cache (struct buffer *b)
+{
+  struct syntax_run_cache *c = b->syntax_run_cache;
+
+  if (c)
+    for (ptrdiff_t i = 0; i < c->nruns; i++)
+      mark_object (c->values[i]);
+}
+
+/* Free the cache of buffer B.  */
+
+void
+free_syntax_run_cache (struct buffer *b)
+{
+  if (b->syntax_run_cache)
+    {
+      xfree (b->syntax_run_cache->starts);
+      xfree (b->syntax_run_cache->values);
+      xfree (b->syntax_run_cache);
+      b->syntax_run_cache = NULL;
+    }
+}
+
+/* Make TABLE, the 'syntax-table' property at the current position,
+   the one that gl_state uses.  */
+
+static void
+use_syntax_property (Lisp_Object table)
+{
+  if (!EQ (table, gl_state.old_prop))
+    {
+      gl_state.current_syntax_table = table;
+      gl_state.old_prop = table;
+      if (EQ (Fsyntax_table_p (table), Qt))
+	{
+	  gl_state.use_global = 0;
+	}
+      else if (CONSP (table))
+	{
+	  gl_state.use_global = 1;
+	  gl_state.global_code = table;
+	}
+      else
+	{
+	  gl_state.use_global = 0;
+	  gl_state.current_syntax_table = BVAR (current_buffer, syntax_table);
+	}
+    }
+}
+
 /* Update gl_state to an appropriate interval which contains CHARPOS.  The
    sign of COUNT gives the relative position of CHARPOS wrt the previously
    valid interval.  If INIT, only [be]_property fields of gl_state are
@@ -335,6 +518,26 @@ update_syntax_table (ptrdiff_t charpos, EMACS_INT count, bool init,
       gl_state.old_prop = Qnil;
       gl_state.start = gl_state.b_property;
       gl_state.stop = gl_state.e_property;
+    }
+
+  if (parse_sexp_cache_properties
+      && (NILP (object) || BUFFERP (object)))
+    {
+      struct buffer *b = NILP (object) ? current_buffer : XBUFFER (object);
+      ptrdiff_t start, end;
+
+      tmp_table = syntax_property_run (b, charpos, &start, &end);
+      gl_state.forward_i = gl_state.backward_i = NULL;
+      gl_state.b_property = (start <= BUF_BEG (b) ? gl_state.start
+			     : start - gl_state.offset);
+      gl_state.e_property = (BUF_Z (b) <= end ? gl_state.stop
+			     : end - gl_state.offset);
+      use_syntax_property (tmp_table);
+      return;
+    }
+
+  if (init)
+    {
       i = interval_of (charpos, object);
       gl_state.backward_i = gl_state.forward_i = i;
       invalidate = false;
@@ -400,25 +603,7 @@ update_syntax_table (ptrdiff_t charpos, EMACS_INT count, bool init,
 	}
     }
 
-  if (!EQ (tmp_table, gl_state.old_prop))
-    {
-      gl_state.current_syntax_table = tmp_table;
-      gl_state.old_prop = tmp_table;
-      if (EQ (Fsyntax_table_p (tmp_table), Qt))
-	{
-	  gl_state.use_global = 0;
-	}
-      else if (CONSP (tmp_table))
-	{
-	  gl_state.use_global = 1;
-	  gl_state.global_code = tmp_table;
-	}
-      else
-	{
-	  gl_state.use_global = 0;
-	  gl_state.current_syntax_table = BVAR (current_buffer, syntax_table);
-	}
-    }
+  use_syntax_property (tmp_table);
 
   while (i)
     {
@@ -502,6 +687,41 @@ parse_sexp_propertize (ptrdiff_t charpos)
     }
 }
 
+/* Move 'syntax-propertize--done' back to POS in the buffers that
+   share the text of buffer B, because the text from POS on is about
+   to change.  This is done here and not only by the functions in
+   'before-change-functions', so that changes made while those are
+   not run are not taken for propertized text.  */
+
+void
+invalidate_syntax_propertize (struct buffer *b, ptrdiff_t pos)
+{
+  Lisp_Object tail, buffer;
+
+  if (b->base_buffer)
+    b = b->base_buffer;
+  if (b->indirections == 0 && b == current_buffer)
+    {
+      /* The usual case.  The variable holds the value for the
+	 current buffer, or the default of -1, which stays put.  */
+      if (pos < syntax_propertize__done)
+	syntax_propertize__done = pos;
+      return;
+    }
+  FOR_EACH_LIVE_BUFFER (tail, buffer)
+    {
+      struct buffer *other = XBUFFER (buffer);
+      if (other == b || other->base_buffer == b)
+	{
+	  Lisp_Object done
+	    = buffer_local_value (Qsyntax_propertize__done, buffer);
+	  if (FIXNUMP (done) && pos < XFIXNUM (done))
+	    set_internal (Qsyntax_propertize__done, make_fixnum (pos),
+			  buffer, SET_INTERNAL_SET);
+	}
+    }
+}
+
 void
 update_syntax_table_forward (ptrdiff_t charpos, bool init,
 			     Lisp_Object object)
@@ -593,6 +813,33 @@ find_defun_start (ptrdiff_t pos, ptrdiff_t pos_byte)
       && MODIFF == find_start_modiff)
     return find_start_value;
 
+  if (!NILP (Vcomment_use_syntax_ppss)
+      && syntax_ppss_use_native_cache
+      && NILP (find_symbol_value (Qsyntax_ppss_table))
+      && NILP (find_symbol_value (Qsyntax_begin_function)))
+    {
+      /* Do what 'syntax-ppss' would do, without calling Lisp unless
+	 syntax-table properties must be computed first.  */
+      struct lisp_parse_state state;
+      modiff_count modiffs = CHARS_MODIFF;
+      if (syntax_propertize__done < pos)
+	call1 (Qsyntax_propertize, make_fixnum (pos));
+      if (modiffs != CHARS_MODIFF)
+	error ("syntax-ppss modified the buffer!");
+      TEMP_SET_PT_BOTH (opoint, opoint_byte);
+      syntax_ppss (&state, pos);
+      if (state.incomment || state.instring >= 0)
+	{
+	  find_start_value = state.comstr_start;
+	  find_start_value_byte = CHAR_TO_BYTE (find_start_value);
+	}
+      else
+	{
+	  find_start_value = pos;
+	  find_start_value_byte = pos_byte;
+	}
+      goto found;
+    }
   if (!NILP (Vcomment_use_syntax_ppss))
     {
       modiff_count modiffs = CHARS_MODIFF;
@@ -1270,6 +1517,8 @@ usage: (modify-syntax-entry CHAR NEWENTRY &optional SYNTAX-TABLE)  */)
   /* We clear the regexp cache, since character classes can now have
      different values from those in the compiled regexps.*/
   clear_regexp_cache ();
+  /* Likewise for the parse states cached by 'syntax-ppss'.  */
+  syntax_table_generation++;
 
   return Qnil;
 }
@@ -3523,6 +3772,244 @@ internalize_parse_state (Lisp_Object external, struct lisp_parse_state *state)
     }
 }
 
+/* Convert the internal parse state STATE to the list that
+   'parse-partial-sexp' returns.  */
+static Lisp_Object
+externalize_parse_state (struct lisp_parse_state *state)
+{
+  return
+    Fcons (make_fixnum (state->depth),
+	   Fcons (state->prevlevelstart < 0
+		  ? Qnil : make_fixnum (state->prevlevelstart),
+	     Fcons (state->thislevelstart < 0
+		    ? Qnil : make_fixnum (state->thislevelstart),
+	       Fcons (state->instring >= 0
+		      ? (state->instring == ST_STRING_STYLE
+			 ? Qt : make_fixnum (state->instring)) : Qnil,
+		 Fcons (state->incomment < 0 ? Qt :
+			(state->incomment == 0 ? Qnil :
+			 make_fixnum (state->incomment)),
+		   Fcons (state->quoted ? Qt : Qnil,
+		     Fcons (make_fixnum (state->mindepth),
+		       Fcons ((state->comstyle
+			       ? (state->comstyle == ST_COMMENT_STYLE
+				  ? Qsyntax_table
+				  : make_fixnum (state->comstyle))
+			       : Qnil),
+		         Fcons (((state->incomment
+                                  || (state->instring >= 0))
+                                 ? make_fixnum (state->comstr_start)
+                                 : Qnil),
+			   Fcons (state->levelstarts,
+                             Fcons (state->prev_syntax == Smax
+                                    ? Qnil
+                                    : make_fixnum (state->prev_syntax),
+                                Qnil)))))))))));
+}
+
+/* The parse states from the start of the accessible portion of a
+   buffer that 'syntax-ppss' computed.  The cache belongs to the base
+   buffer, and 'invalidate_buffer_caches' flushes it from where the
+   text changes, whether or not change hooks run.  The states are
+   kept at every PPSS_SPACING characters from the start, so the state
+   at any position is at most that many characters of parsing away
+   once the cache is filled.  Like 'syntax-ppss-wide' and
+   'syntax-ppss-narrow', there is one set of states for the whole
+   buffer and one for the last narrowing, so that code that narrows
+   temporarily does not throw away the states of the whole buffer.  */
+
+enum { PPSS_SPACING = 4096 };
+
+struct ppss_states
+{
+  /* Where the parses start, the syntax table they used, and the value
+     of 'syntax_table_generation' then.  The states are forgotten when
+     any of these changes.  */
+  ptrdiff_t start;
+  Lisp_Object syntax_table;
+  EMACS_INT generation;
+
+  /* STATES[I] is the state at START + (I + 1) * PPSS_SPACING.  */
+  struct lisp_parse_state *states;
+  ptrdiff_t nstates, states_size;
+
+  /* Incremented whenever states are forgotten.  */
+  EMACS_INT ticks;
+
+  /* The state at the position asked for last, if LAST.location is
+     not negative.  */
+  struct lisp_parse_state last;
+};
+
+struct syntax_ppss_cache
+{
+  /* The states from BEG, and those from the start of the last
+     narrowing that did not start at BEG.  */
+  struct ppss_states wide, narrow;
+};
+
+/* Store in STATE the state of the parse from BEGV to POS, using and
+   filling the cache of the current buffer.  POS must be in the
+   accessible portion of the buffer.  */
+static void
+syntax_ppss (struct lisp_parse_state *state, ptrdiff_t pos)
+{
+  struct buffer *b = (current_buffer->base_buffer
+		      ? current_buffer->base_buffer : current_buffer);
+  Lisp_Object table = BVAR (current_buffer, syntax_table);
+
+  if (!b->ppss_cache)
+    {
+      b->ppss_cache = xzalloc (sizeof *b->ppss_cache);
+      b->ppss_cache->wide.syntax_table = Qnil;
+      b->ppss_cache->wide.last.location = -1;
+      b->ppss_cache->narrow.syntax_table = Qnil;
+      b->ppss_cache->narrow.last.location = -1;
+    }
+
+  struct ppss_states *c = (BEGV == BEG
+			   ? &b->ppss_cache->wide : &b->ppss_cache->narrow);
+  if (c->start != BEGV || !EQ (c->syntax_table, table)
+      || c->generation != syntax_table_generation)
+    {
+      c->start = BEGV;
+      c->syntax_table = table;
+      c->generation = syntax_table_generation;
+      c->nstates = 0;
+      c->last.location = -1;
+      c->ticks++;
+    }
+
+  /* Start from the closest state before POS.  The last state asked
+     for is used only if no state is missing before it, so that going
+     forward fills the cache.  */
+  ptrdiff_t i = min ((pos - c->start) / PPSS_SPACING, c->nstates);
+  if (0 < i)
+    *state = c->states[i - 1];
+  else
+    {
+      internalize_parse_state (Qnil, state);
+      state->location = BEGV;
+      state->location_byte = BEGV_BYTE;
+    }
+  if (state->location <= c->last.location && c->last.location <= pos
+      && (c->last.location - c->start) / PPSS_SPACING == i)
+    *state = c->last;
+
+  /* Parsing can call Lisp to set syntax-table properties, which
+     forgets states, maybe even the one being computed, or to call
+     this function recursively.  Stop storing states then.  */
+  ptrdiff_t start = c->start;
+  EMACS_INT ticks = c->ticks;
+  for (; i == c->nstates && start + (i + 1) * PPSS_SPACING <= pos; i++)
+    {
+      scan_sexps_forward (state, state->location, state->location_byte,
+			  start + (i + 1) * PPSS_SPACING,
+			  TYPE_MINIMUM (EMACS_INT), false, 0);
+      if (! (c->ticks == ticks && c->nstates == i))
+	break;
+      if (c->nstates == c->states_size)
+	c->states = xpalloc (c->states, &c->states_size, 1, -1,
+			     sizeof *c->states);
+      c->states[c->nstates++] = *state;
+    }
+  scan_sexps_forward (state, state->location, state->location_byte, pos,
+		      TYPE_MINIMUM (EMACS_INT), false, 0);
+  if (c->ticks == ticks)
+    c->last = *state;
+}
+
+/* Forget the states in C for positions after POS.  */
+static void
+invalidate_ppss_states (struct ppss_states *c, ptrdiff_t pos)
+{
+  while (0 < c->nstates && pos < c->states[c->nstates - 1].location)
+    c->nstates--;
+  if (pos < c->last.location)
+    c->last.location = -1;
+  c->ticks++;
+}
+
+/* Forget the states that the cache of buffer B holds for positions
+   after POS, because the text or its syntax-table properties from POS
+   on are about to change.  */
+void
+invalidate_syntax_ppss_cache (struct buffer *b, ptrdiff_t pos)
+{
+  struct syntax_ppss_cache *c = (b->base_buffer
+				 ? b->base_buffer->ppss_cache
+				 : b->ppss_cache);
+
+  if (c)
+    {
+      invalidate_ppss_states (&c->wide, pos);
+      invalidate_ppss_states (&c->narrow, pos);
+    }
+}
+
+/* Mark the Lisp objects in C.  */
+static void
+mark_ppss_states (struct ppss_states *c)
+{
+  mark_object (c->syntax_table);
+  for (ptrdiff_t i = 0; i < c->nstates; i++)
+    mark_object (c->states[i].levelstarts);
+  if (0 <= c->last.location)
+    mark_object (c->last.levelstarts);
+}
+
+/* Mark the Lisp objects in the cache of buffer B.  */
+void
+mark_syntax_ppss_cache (struct buffer *b)
+{
+  if (b->ppss_cache)
+    {
+      mark_ppss_states (&b->ppss_cache->wide);
+      mark_ppss_states (&b->ppss_cache->narrow);
+    }
+}
+
+/* Free the cache of buffer B.  */
+void
+free_syntax_ppss_cache (struct buffer *b)
+{
+  if (b->ppss_cache)
+    {
+      xfree (b->ppss_cache->wide.states);
+      xfree (b->ppss_cache->narrow.states);
+      xfree (b->ppss_cache);
+      b->ppss_cache = NULL;
+    }
+}
+
+DEFUN ("internal--syntax-ppss", Finternal__syntax_ppss,
+       Sinternal__syntax_ppss, 1, 1, 0,
+       doc: /* Return the parse state at POS, and move point there.
+This is like `(parse-partial-sexp (point-min) POS)', but uses a cache
+of states that the buffer keeps; elements 2 and 6 of the value are not
+meaningful.  It is the part of `syntax-ppss' written in C.  */)
+  (Lisp_Object pos)
+{
+  struct lisp_parse_state state;
+
+  CHECK_FIXNUM_COERCE_MARKER (pos);
+  if (! (BEGV <= XFIXNUM (pos) && XFIXNUM (pos) <= ZV))
+    args_out_of_range (pos, Fcurrent_buffer ());
+  syntax_ppss (&state, XFIXNUM (pos));
+  SET_PT_BOTH (state.location, state.location_byte);
+  return externalize_parse_state (&state);
+}
+
+DEFUN ("internal--syntax-ppss-flush-cache", Finternal__syntax_ppss_flush_cache,
+       Sinternal__syntax_ppss_flush_cache, 1, 1, 0,
+       doc: /* Forget the parse states that `syntax-ppss' cached after BEG.  */)
+  (Lisp_Object beg)
+{
+  CHECK_FIXNUM_COERCE_MARKER (beg);
+  invalidate_syntax_ppss_cache (current_buffer, XFIXNUM (beg));
+  return Qnil;
+}
+
 DEFUN ("parse-partial-sexp", Fparse_partial_sexp, Sparse_partial_sexp, 2, 6, 0,
        doc: /* Parse Lisp syntax starting at FROM until TO; return status of parse at TO.
 Parsing stops at TO or when certain criteria are met;
@@ -3584,34 +4071,7 @@ Sixth arg COMMENTSTOP non-nil means stop after the start of a comment.
 
   SET_PT_BOTH (state.location, state.location_byte);
 
-  return
-    Fcons (make_fixnum (state.depth),
-	   Fcons (state.prevlevelstart < 0
-		  ? Qnil : make_fixnum (state.prevlevelstart),
-	     Fcons (state.thislevelstart < 0
-		    ? Qnil : make_fixnum (state.thislevelstart),
-	       Fcons (state.instring >= 0
-		      ? (state.instring == ST_STRING_STYLE
-			 ? Qt : make_fixnum (state.instring)) : Qnil,
-		 Fcons (state.incomment < 0 ? Qt :
-			(state.incomment == 0 ? Qnil :
-			 make_fixnum (state.incomment)),
-		   Fcons (state.quoted ? Qt : Qnil,
-		     Fcons (make_fixnum (state.mindepth),
-		       Fcons ((state.comstyle
-			       ? (state.comstyle == ST_COMMENT_STYLE
-				  ? Qsyntax_table
-				  : make_fixnum (state.comstyle))
-			       : Qnil),
-		         Fcons (((state.incomment
-                                  || (state.instring >= 0))
-                                 ? make_fixnum (state.comstr_start)
-                                 : Qnil),
-			   Fcons (state.levelstarts,
-                             Fcons (state.prev_syntax == Smax
-                                    ? Qnil
-                                    : make_fixnum (state.prev_syntax),
-                                Qnil)))))))))));
+  return externalize_parse_state (&state);
 }
 
 void
@@ -3702,11 +4162,21 @@ syms_of_syntax (void)
 {
   DEFSYM (Qsyntax_table_p, "syntax-table-p");
   DEFSYM (Qsyntax_ppss, "syntax-ppss");
+  DEFSYM (Qsyntax_ppss_table, "syntax-ppss-table");
+  DEFSYM (Qsyntax_begin_function, "syntax-begin-function");
+  DEFSYM (Qsyntax_propertize, "syntax-propertize");
   DEFVAR_LISP ("comment-use-syntax-ppss",
 	       Vcomment_use_syntax_ppss,
 	       doc: /* Non-nil means `forward-comment' can use `syntax-ppss' internally.  */);
   Vcomment_use_syntax_ppss = Qt;
 
+  DEFVAR_BOOL ("syntax-ppss-use-native-cache", syntax_ppss_use_native_cache,
+	       doc: /* Non-nil means `syntax-ppss' keeps its cache in C.
+The cache holds parse states at regular intervals, and is flushed
+directly when the buffer text changes, even if change hooks do not
+run.  It is not used when `syntax-begin-function' is non-nil.  */);
+  syntax_ppss_use_native_cache = true;
+
   staticpro (&Vsyntax_code_object);
 
   staticpro (&gl_state.object);
@@ -3729,11 +4199,20 @@ Otherwise, that text property is simply ignored.
 See the info node `(elisp)Syntax Properties' for a description of the
 `syntax-table' property.  */);
 
+  DEFVAR_BOOL ("parse-sexp-cache-properties", parse_sexp_cache_properties,
+	       doc: /* Non-nil means cache where the `syntax-table' property changes.
+When `parse-sexp-lookup-properties' is non-nil, the functions that scan
+the text of a buffer then look the property up in a table of the runs
+of text that have the same value, which each buffer keeps, rather than
+in the text properties themselves.  */);
+  parse_sexp_cache_properties = true;
+
   DEFVAR_INT ("syntax-propertize--done", syntax_propertize__done,
 	      doc: /* Position up to which syntax-table properties have been set.  */);
   syntax_propertize__done = -1;
   DEFSYM (Qinternal__syntax_propertize, "internal--syntax-propertize");
-  Fmake_variable_buffer_local (intern ("syntax-propertize--done"));
+  DEFSYM (Qsyntax_propertize__done, "syntax-propertize--done");
+  Fmake_variable_buffer_local (Qsyntax_propertize__done);
 
   words_include_escapes = 0;
   DEFVAR_BOOL ("words-include-escapes", words_include_escapes,
@@ -3796,4 +4275,6 @@ In both cases, LIMIT bounds the search. */);
   defsubr (&Sscan_sexps);
   defsubr (&Sbackward_prefix_chars);
   defsubr (&Sparse_partial_sexp);
+  defsubr (&Sinternal__syntax_ppss);
+  defsubr (&Sinternal__syntax_ppss_flush_cache);
 }
@@ -95,6 +95,22 @@ modify_text_properties (Lisp_Object buffer, Lisp_Object start, Lisp_Object end)
   set_buffer_internal (old);
 }
 
+/* Record in the undo list of buffer OBJECT that property SYM of the
+   text in interval I had the value VALUE before a change, and forget
+   what was computed from the text properties there.  */
+
+static void
+note_property_change (INTERVAL i, Lisp_Object sym, Lisp_Object value,
+		      Lisp_Object object)
+{
+  record_property_change (i->position, LENGTH (i), sym, value, object);
+  if (EQ (sym, Qsyntax_table))
+    {
+      invalidate_syntax_ppss_cache (XBUFFER (object), i->position);
+      invalidate_syntax_run_cache (XBUFFER (object), i->position);
+    }
+}
+
 /* Complain if object is not string or buffer type.  */
 
 static void
@@ -331,9 +347,7 @@ set_properties (Lisp_Object properties, INTERVAL interval, Lisp_Object object)
 	if (! EQ (property_value (properties, XCAR (sym)),
 		  XCAR (value)))
 	  {
-	    record_property_change (interval->position, LENGTH (interval),
-				    XCAR (sym), XCAR (value),
-				    object);
+	    note_property_change (interval, XCAR (sym), XCAR (value), object);
 	  }
 
       /* For each new property that has no value at all in the old plist,
@@ -343,9 +357,7 @@ set_properties (Lisp_Object properties, INTERVAL interval, Lisp_Object object)
 	   sym = XCDR (value))
 	if (EQ (property_value (interval->plist, XCAR (sym)), Qunbound))
 	  {
-	    record_property_change (interval->position, LENGTH (interval),
-				    XCAR (sym), Qnil,
-				    object);
+	    note_property_change (interval, XCAR (sym), Qnil, object);
 	  }
     }
 
@@ -401,8 +413,7 @@ add_properties (Lisp_Object plist, INTERVAL i, Lisp_Object object,
 	    /* Record this change in the buffer, for undo purposes.  */
 	    if (BUFFERP (object))
 	      {
-		record_property_change (i->position, LENGTH (i),
-					sym1, Fcar (this_cdr), object);
+		note_property_change (i, sym1, Fcar (this_cdr), object);
 	      }
 
 	    /* I's property has a different value -- change it */
@@ -445,8 +456,7 @@ add_properties (Lisp_Object plist, INTERVAL i, Lisp_Object object,
 	  /* Record this change in the buffer, for undo purposes.  */
 	  if (BUFFERP (object))
 	    {
-	      record_property_change (i->position, LENGTH (i),
-				      sym1, Qnil, object);
+	      note_property_change (i, sym1, Qnil, object);
 	    }
 	  set_interval_plist (i, Fcons (sym1, Fcons (val1, i->plist)));
 	  changed = true;
@@ -481,9 +491,7 @@ remove_properties (Lisp_Object plist, Lisp_Object list, INTERVAL i, Lisp_Object
       while (CONSP (current_plist) && EQ (sym, XCAR (current_plist)))
 	{
 	  if (BUFFERP (object))
-	    record_property_change (i->position, LENGTH (i),
-				    sym, XCAR (XCDR (current_plist)),
-				    object);
+	    note_property_change (i, sym, XCAR (XCDR (current_plist)), object);
 
 	  current_plist = XCDR (XCDR (current_plist));
 	  changed = true;
@@ -497,8 +505,7 @@ remove_properties (Lisp_Object plist, Lisp_Object list, INTERVAL i, Lisp_Object
 	  if (CONSP (this) && EQ (sym, XCAR (this)))
 	    {
 	      if (BUFFERP (object))
-		record_property_change (i->position, LENGTH (i),
-					sym, XCAR (XCDR (this)), object);
+		note_property_change (i, sym, XCAR (XCDR (this)), object);
 
 	      Fsetcdr (XCDR (tail2), XCDR (XCDR (this)));
 	      changed = true;
@@ -1359,6 +1366,177 @@ into it.  */)
   return Qnil;
 }
 
+/* Callers note, this can GC when OBJECT is a buffer (or nil).  */
+
+DEFUN ("add-text-property-runs", Fadd_text_property_runs,
+       Sadd_text_property_runs, 1, 2, 0,
+       doc: /* Add properties to several runs of text at once.
+RUNS is a vector whose elements have the form (START END PROPERTIES).
+Each element says to add the property list PROPERTIES to the text from
+START to END, as `add-text-properties' would.  The runs must be sorted
+by position and must not overlap.
+
+The effect is the same as calling `add-text-properties' once for each
+run, but the text properties of the whole region are updated in a
+single pass, and the modification hooks and `after-change-functions'
+run only once, for the text from the start of the first run to the end
+of the last one.
+
+If the optional second argument OBJECT is a buffer (or nil, which means
+the current buffer), START and END are buffer positions (integers or
+markers).  If OBJECT is a string, START and END are 0-based indices
+into it.  Return t if any property value actually changed, nil
+otherwise.  */)
+  (Lisp_Object runs, Lisp_Object object)
+{
+  /* Switch to the right buffer, as in add_text_properties_1.  */
+  if (BUFFERP (object) && XBUFFER (object) != current_buffer)
+    {
+      ptrdiff_t count = SPECPDL_INDEX ();
+      record_unwind_current_buffer ();
+      set_buffer_internal (XBUFFER (object));
+      return unbind_to (count, Fadd_text_property_runs (runs, object));
+    }
+
+  INTERVAL i;
+  ptrdiff_t n, nruns, first, last, prev_end;
+  Lisp_Object start, end, val = Qnil;
+  bool modified = false;
+
+  CHECK_VECTOR (runs);
+  if (NILP (object))
+    XSETBUFFER (object, current_buffer);
+  nruns = ASIZE (runs);
+
+  /* Check all the runs before changing anything.  RUN_START, RUN_END
+     and RUN_PLIST hold the validated contents of each run.  */
+  USE_SAFE_ALLOCA;
+  ptrdiff_t *run_start, *run_end;
+  Lisp_Object *run_plist;
+  SAFE_NALLOCA (run_start, 2, nruns);
+  run_end = run_start + nruns;
+  SAFE_ALLOCA_LISP (run_plist, nruns);
+  prev_end = PTRDIFF_MIN;
+  for (n = 0; n < nruns; n++)
+    {
+      Lisp_Object elt = AREF (runs, n);
+      Lisp_Object b = Fcar (elt), e = Fcar (Fcdr (elt));
+
+      CHECK_FIXNUM_COERCE_MARKER (b);
+      CHECK_FIXNUM_COERCE_MARKER (e);
+      run_start[n] = XFIXNUM (b);
+      run_end[n] = XFIXNUM (e);
+      if (run_end[n] < run_start[n] || run_start[n] < prev_end)
+	error ("Text property runs must be sorted and must not overlap");
+      prev_end = run_end[n];
+      run_plist[n] = validate_plist (Fcar (Fcdr (Fcdr (elt))));
+    }
+
+  /* Ignore runs at either end that would not change anything.  */
+  for (first = 0;
+       first < nruns
+	 && (NILP (run_plist[first]) || run_start[first] == run_end[first]);
+       first++)
+    continue;
+  for (last = nruns;
+       first < last
+	 && (NILP (run_plist[last - 1])
+	     || run_start[last - 1] == run_end[last - 1]);
+       last--)
+    continue;
+  if (first == last)
+    goto done;
+
+  start = make_fixnum (run_start[first]);
+  end = make_fixnum (run_end[last - 1]);
+  i = validate_interval_range (object, &start, &end, hard);
+  if (!i)
+    goto done;
+
+  /* If the text already has all of its properties, don't report it
+     as modified.  */
+  for (n = first; n < last; n++)
+    {
+      ptrdiff_t pos = run_start[n];
+
+      if (NILP (run_plist[n]))
+	continue;
+      while (i->position + LENGTH (i) <= pos)
+	i = next_interval (i);
+      while (pos < run_end[n]
+	     && interval_has_all_properties (run_plist[n], i))
+	{
+	  pos = i->position + LENGTH (i);
+	  if (pos < run_end[n])
+	    i = next_interval (i);
+	}
+      if (pos < run_end[n])
+	break;
+    }
+  if (n == last)
+    goto done;
+
+  /* modify_text_properties can run Lisp code that changes the
+     intervals behind our back, so look up the first one again.  */
+  if (BUFFERP (object))
+    {
+      modify_text_properties (object, start, end);
+      i = validate_interval_range (object, &start, &end, hard);
+    }
+  else
+    i = find_interval (string_intervals (object), run_start[first]);
+
+  for (n = first; n < last; n++)
+    {
+      ptrdiff_t pos = run_start[n], lim = run_end[n];
+      Lisp_Object plist = run_plist[n];
+
+      if (NILP (plist))
+	continue;
+
+      /* The runs are sorted, so walking forward through the intervals
+	 is cheaper than looking each run up in the tree.  */
+      while (i->position + LENGTH (i) <= pos)
+	i = next_interval (i);
+
+      while (pos < lim)
+	{
+	  INTERVAL unchanged;
+
+	  if (!interval_has_all_properties (plist, i))
+	    {
+	      if (i->position < pos)
+		{
+		  unchanged = i;
+		  i = split_interval_right (unchanged,
+					    pos - unchanged->position);
+		  copy_properties (unchanged, i);
+		}
+	      if (lim < i->position + LENGTH (i))
+		{
+		  unchanged = i;
+		  i = split_interval_left (unchanged, lim - pos);
+		  copy_properties (unchanged, i);
+		}
+	      modified |= add_properties (plist, i, object,
+					  TEXT_PROPERTY_REPLACE, true);
+	    }
+	  pos = i->position + LENGTH (i);
+	  if (pos < lim)
+	    i = next_interval (i);
+	}
+    }
+
+  if (BUFFERP (object))
+    signal_after_change (XFIXNUM (start), XFIXNUM (end) - XFIXNUM (start),
+			 XFIXNUM (end) - XFIXNUM (start));
+  val = modified ? Qt : Qnil;
+
+ done:
+  SAFE_FREE ();
+  return val;
+}
+
 /* Replace properties of text from START to END with new list of
    properties PROPERTIES.  OBJECT is the buffer or string containing
    the text.  OBJECT nil means use the current buffer.
@@ -2443,6 +2621,7 @@ inherits it if NONSTICKINESS is nil.  The `front-sticky' and
   defsubr (&Sput_text_property);
   defsubr (&Sset_text_properties);
   defsubr (&Sadd_face_text_property);
+  defsubr (&Sadd_text_property_runs);
   defsubr (&Sremove_text_properties);
   defsubr (&Sremove_list_of_text_properties);
   defsubr (&Stext_property_any);
@@ -24,6 +24,167 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "buffer.h"
 #include "keyboard.h"
 
+/* When `undo-compact-log' is non-nil, changes that refer to no Lisp
+   objects other than integers and plain text are appended to a
+   per-buffer byte log instead of being consed onto buffer-undo-list.
+   The log is turned into ordinary list elements, oldest first, as
+   soon as anything wants to look at the list (see buffer_undo_list),
+   so that Lisp never sees the difference.  Until then, the deleted
+   text it holds costs neither string headers nor cons cells, and
+   does not have to be traced by the garbage collector.
+
+   Each record is a byte holding its type, followed by the fields
+   listed below, each stored in native byte order.  */
+
+enum undo_log_type
+  {
+    /* nil.  No fields.  */
+    UNDO_LOG_BOUNDARY,
+    /* POSITION.  A ptrdiff_t position.  */
+    UNDO_LOG_POINT,
+    /* (BEG . END).  Two ptrdiff_t positions.  */
+    UNDO_LOG_INSERT,
+    /* (TEXT . POSITION).  A byte saying whether TEXT is multibyte,
+       then ptrdiff_t POSITION, number of characters and number of
+       bytes, then the bytes of TEXT.  */
+    UNDO_LOG_DELETE
+  };
+
+struct undo_log
+{
+  /* The records, oldest first.  */
+  unsigned char *data;
+
+  /* Bytes used and allocated in DATA.  */
+  ptrdiff_t used, size;
+
+  /* Offset in DATA of the most recent record.  */
+  ptrdiff_t last;
+};
+
+static void
+put_log_position (unsigned char *p, ptrdiff_t pos)
+{
+  memcpy (p, &pos, sizeof pos);
+}
+
+static ptrdiff_t
+get_log_position (unsigned char const *p)
+{
+  ptrdiff_t pos;
+  memcpy (&pos, p, sizeof pos);
+  return pos;
+}
+
+/* Return the most recent record in the current buffer's undo log.
+   The log must not be empty.  */
+static unsigned char *
+last_log_record (void)
+{
+  struct undo_log *log = current_buffer->undo_log;
+  return log->data + log->last;
+}
+
+/* Append a record of type TYPE with NBYTES bytes of fields to the
+   current buffer's undo log, and return a pointer to the fields.  */
+static unsigned char *
+append_log_record (enum undo_log_type type, ptrdiff_t nbytes)
+{
+  struct undo_log *log = current_buffer->undo_log;
+
+  if (!log)
+    log = current_buffer->undo_log = xzalloc (sizeof *log);
+  if (log->size - log->used <= nbytes)
+    log->data = xpalloc (log->data, &log->size,
+			 nbytes + 1 - (log->size - log->used), -1, 1);
+  log->last = log->used;
+  log->used += nbytes + 1;
+  log->data[log->last] = type;
+  return log->data + log->last + 1;
+}
+
+/* Append a deletion record for NCHARS characters, NBYTES bytes of
+   text that was at SBEG, as in the (TEXT . POSITION) undo list element,
+   to the current buffer's undo log.  Return where to put the bytes.  */
+static unsigned char *
+append_delete_record (ptrdiff_t sbeg, bool multibyte,
+		      ptrdiff_t nchars, ptrdiff_t nbytes)
+{
+  const int w = sizeof (ptrdiff_t);
+  unsigned char *p = append_log_record (UNDO_LOG_DELETE,
+					1 + 3 * w + nbytes);
+  *p++ = multibyte;
+  put_log_position (p, sbeg);
+  put_log_position (p + w, nchars);
+  put_log_position (p + 2 * w, nbytes);
+  return p + 3 * w;
+}
+
+/* Move the records in B's undo log onto B's undo list, and free the
+   log.  */
+void
+flush_undo_log (struct buffer *b)
+{
+  struct undo_log *log = b->undo_log;
+  Lisp_Object list = BVAR (b, undo_list);
+  unsigned char *p = log->data, *lim = p + log->used;
+  const int w = sizeof (ptrdiff_t);
+
+  while (p < lim)
+    {
+      Lisp_Object elt;
+
+      switch (*p++)
+	{
+	case UNDO_LOG_BOUNDARY:
+	  elt = Qnil;
+	  break;
+
+	case UNDO_LOG_POINT:
+	  elt = make_fixnum (get_log_position (p));
+	  p += w;
+	  break;
+
+	case UNDO_LOG_INSERT:
+	  elt = Fcons (make_fixnum (get_log_position (p)),
+		       make_fixnum (get_log_position (p + w)));
+	  p += 2 * w;
+	  break;
+
+	case UNDO_LOG_DELETE:
+	  {
+	    bool multibyte = *p++;
+	    ptrdiff_t pos = get_log_position (p);
+	    ptrdiff_t nchars = get_log_position (p + w);
+	    ptrdiff_t nbytes = get_log_position (p + 2 * w);
+	    p += 3 * w;
+	    elt = Fcons (make_specified_string ((char *) p, nchars, nbytes,
+						multibyte),
+			 make_fixnum (pos));
+	    p += nbytes;
+	  }
+	  break;
+
+	default:
+	  emacs_abort ();
+	}
+      list = Fcons (elt, list);
+    }
+
+  discard_undo_log (b);
+  bset_undo_list (b, list);
+}
+
+/* Forget the records in B's undo log, and free the log.  */
+void
+discard_undo_log (struct buffer *b)
+{
+  struct undo_log *log = b->undo_log;
+  b->undo_log = NULL;
+  xfree (log->data);
+  xfree (log);
+}
+
 /* The first time a command records something for undo.
    it also allocates the undo-boundary object
    which will be added to the list at the end of the command.
@@ -57,8 +218,11 @@ record_point (ptrdiff_t beg)
   first change. FIXME: This check is currently dependent on being
   called before record_first_change, but could be made not to by
   ignoring timestamp undo entries */
-  at_boundary = ! CONSP (BVAR (current_buffer, undo_list))
-                || NILP (XCAR (BVAR (current_buffer, undo_list)));
+  if (current_buffer->undo_log)
+    at_boundary = *last_log_record () == UNDO_LOG_BOUNDARY;
+  else
+    at_boundary = ! CONSP (BVAR (current_buffer, undo_list))
+                  || NILP (XCAR (BVAR (current_buffer, undo_list)));
 
   /* If this is the first change since save, then record this.*/
   if (MODIFF <= SAVE_MODIFF)
@@ -73,9 +237,16 @@ record_point (ptrdiff_t beg)
   if (at_boundary
       && point_before_last_command_or_undo != beg
       && buffer_before_last_command_or_undo == current_buffer )
-    bset_undo_list (current_buffer,
-		    Fcons (make_fixnum (point_before_last_command_or_undo),
-			   BVAR (current_buffer, undo_list)));
+    {
+      if (undo_compact_log)
+	put_log_position (append_log_record (UNDO_LOG_POINT,
+					     sizeof (ptrdiff_t)),
+			  point_before_last_command_or_undo);
+      else
+	bset_undo_list (current_buffer,
+			Fcons (make_fixnum (point_before_last_command_or_undo),
+			       buffer_undo_list (current_buffer)));
+    }
 }
 
 /* Record an insertion that just happened or is about to happen,
@@ -97,7 +268,17 @@ record_insert (ptrdiff_t beg, ptrdiff_t length)
 
   /* If this is following another insertion and consecutive with it
      in the buffer, combine the two.  */
-  if (CONSP (BVAR (current_buffer, undo_list)))
+  if (current_buffer->undo_log)
+    {
+      unsigned char *last = last_log_record ();
+      unsigned char *end = last + 1 + sizeof (ptrdiff_t);
+      if (*last == UNDO_LOG_INSERT && get_log_position (end) == beg)
+	{
+	  put_log_position (end, beg + length);
+	  return;
+	}
+    }
+  else if (CONSP (BVAR (current_buffer, undo_list)))
     {
       Lisp_Object elt;
       elt = XCAR (BVAR (current_buffer, undo_list));
@@ -111,10 +292,32 @@ record_insert (ptrdiff_t beg, ptrdiff_t length)
 	}
     }
 
+  if (undo_compact_log)
+    {
+      unsigned char *p = append_log_record (UNDO_LOG_INSERT,
+					    2 * sizeof (ptrdiff_t));
+      put_log_position (p, beg);
+      put_log_position (p + sizeof (ptrdiff_t), beg + length);
+      return;
+    }
+
   XSETFASTINT (lbeg, beg);
   XSETINT (lend, beg + length);
   bset_undo_list (current_buffer,
-		  Fcons (Fcons (lbeg, lend), BVAR (current_buffer, undo_list)));
+		  Fcons (Fcons (lbeg, lend), buffer_undo_list (current_buffer)));
+}
+
+/* Return true if any marker would need an adjustment recorded by
+   record_marker_adjustments (FROM, TO).  */
+
+static bool
+markers_need_adjustment (ptrdiff_t from, ptrdiff_t to)
+{
+  for (struct Lisp_Marker *m = BUF_MARKERS (current_buffer); m; m = m->next)
+    if (from <= m->charpos && m->charpos <= to
+	&& (m->insertion_type ? to : from) != m->charpos)
+      return true;
+  return false;
 }
 
 /* Record the fact that markers in the region of FROM, TO are about to
@@ -150,7 +353,7 @@ record_marker_adjustments (ptrdiff_t from, ptrdiff_t to)
               bset_undo_list
                 (current_buffer,
                  Fcons (Fcons (marker, make_fixnum (adjustment)),
-                        BVAR (current_buffer, undo_list)));
+                        buffer_undo_list (current_buffer)));
             }
         }
     }
@@ -180,6 +383,18 @@ record_delete (ptrdiff_t beg, Lisp_Object string, bool record_markers)
       XSETFASTINT (sbeg, beg);
     }
 
+  /* Text properties and marker adjustments need Lisp objects, so
+     only plain deletions can go into the compact undo log.  */
+  if (undo_compact_log && !string_intervals (string)
+      && !(record_markers
+	   && markers_need_adjustment (beg, beg + SCHARS (string))))
+    {
+      memcpy (append_delete_record (XFIXNUM (sbeg), STRING_MULTIBYTE (string),
+				    SCHARS (string), SBYTES (string)),
+	      SDATA (string), SBYTES (string));
+      return;
+    }
+
   /* primitive-undo assumes marker adjustments are recorded
      immediately before the deletion is recorded.  See bug 16818
      discussion.  */
@@ -188,7 +403,62 @@ record_delete (ptrdiff_t beg, Lisp_Object string, bool record_markers)
 
   bset_undo_list
     (current_buffer,
-     Fcons (Fcons (string, sbeg), BVAR (current_buffer, undo_list)));
+     Fcons (Fcons (string, sbeg), buffer_undo_list (current_buffer)));
+}
+
+/* Return true if any of the text from FROM to TO in the current
+   buffer has text properties.  */
+
+static bool
+region_has_properties (ptrdiff_t from, ptrdiff_t to)
+{
+  return (XFIXNUM (Fnext_property_change (make_fixnum (from), Qnil,
+					  make_fixnum (to))) != to
+	  || !NILP (Ftext_properties_at (make_fixnum (from), Qnil)));
+}
+
+/* Record that the text from FROM to TO (FROM_BYTE to TO_BYTE) in the
+   current buffer is about to be deleted, as record_delete does for a
+   string of that text.  When the text can go into the compact undo
+   log, copy it there straight from the buffer, without making a
+   string of it first.  */
+void
+record_delete_text (ptrdiff_t from, ptrdiff_t from_byte,
+		    ptrdiff_t to, ptrdiff_t to_byte, bool record_markers)
+{
+  if (EQ (BVAR (current_buffer, undo_list), Qt))
+    return;
+
+  /* make_buffer_string runs buffer-access-fontify-functions, which
+     may add text properties.  */
+  if (!undo_compact_log
+      || !NILP (Vbuffer_access_fontify_functions)
+      || region_has_properties (from, to)
+      || (record_markers && markers_need_adjustment (from, to)))
+    {
+      record_delete (from,
+		     make_buffer_string_both (from, from_byte, to, to_byte,
+					      true),
+		     record_markers);
+      return;
+    }
+
+  prepare_record ();
+
+  record_point (from);
+
+  unsigned char *p
+    = append_delete_record (PT == to ? -from : from,
+			    !NILP (BVAR (current_buffer,
+					 enable_multibyte_characters)),
+			    to - from, to_byte - from_byte);
+  if (from_byte < GPT_BYTE && GPT_BYTE < to_byte)
+    {
+      memcpy (p, BYTE_POS_ADDR (from_byte), GPT_BYTE - from_byte);
+      memcpy (p + (GPT_BYTE - from_byte), GAP_END_ADDR, to_byte - GPT_BYTE);
+    }
+  else
+    memcpy (p, BYTE_POS_ADDR (from_byte), to_byte - from_byte);
 }
 
 /* Record that a replacement is about to take place,
@@ -198,7 +468,8 @@ record_delete (ptrdiff_t beg, Lisp_Object string, bool record_markers)
 void
 record_change (ptrdiff_t beg, ptrdiff_t length)
 {
-  record_delete (beg, make_buffer_string (beg, beg + length, true), false);
+  record_delete_text (beg, CHAR_TO_BYTE (beg),
+		      beg + length, CHAR_TO_BYTE (beg + length), false);
   record_insert (beg, length);
 }
 
@@ -219,7 +490,7 @@ record_first_change (void)
 
   bset_undo_list (current_buffer,
 		  Fcons (Fcons (Qt, Fvisited_file_modtime ()),
-			 BVAR (current_buffer, undo_list)));
+			 buffer_undo_list (current_buffer)));
 }
 
 /* Record a change in property PROP (whose old value was VAL)
@@ -245,7 +516,7 @@ record_property_change (ptrdiff_t beg, ptrdiff_t length,
   XSETINT (lend, beg + length);
   entry = Fcons (Qnil, Fcons (prop, Fcons (value, Fcons (lbeg, lend))));
   bset_undo_list (current_buffer,
-		  Fcons (entry, BVAR (current_buffer, undo_list)));
+		  Fcons (entry, buffer_undo_list (current_buffer)));
 }
 
 DEFUN ("undo-boundary", Fundo_boundary, Sundo_boundary, 0, 0, 0,
@@ -257,7 +528,14 @@ but another undo command will undo to the previous boundary.  */)
   Lisp_Object tem;
   if (EQ (BVAR (current_buffer, undo_list), Qt))
     return Qnil;
-  tem = Fcar (BVAR (current_buffer, undo_list));
+  if (current_buffer->undo_log)
+    {
+      if (*last_log_record () != UNDO_LOG_BOUNDARY)
+	append_log_record (UNDO_LOG_BOUNDARY, 0);
+      tem = Qnil;
+    }
+  else
+    tem = Fcar (BVAR (current_buffer, undo_list));
   if (!NILP (tem))
     {
       /* One way or another, cons nil onto the front of the undo list.  */
@@ -281,6 +559,129 @@ but another undo command will undo to the previous boundary.  */)
   return Qnil;
 }
 
+/* Return true if SIZE bytes of undo information for the most recent
+   command exceed undo-outer-limit, and undo-outer-limit-function
+   should be called about them.  */
+
+static bool
+undo_outer_limit_exceeded (intmax_t size)
+{
+  intmax_t undo_outer_limit;
+
+  return ((INTEGERP (Vundo_outer_limit)
+	   && (integer_to_intmax (Vundo_outer_limit, &undo_outer_limit)
+	       ? undo_outer_limit < size
+	       : NILP (Fnatnump (Vundo_outer_limit))))
+	  && !NILP (Vundo_outer_limit_function));
+}
+
+/* Truncate B's undo log, which is larger than undo-limit, at a
+   boundary, as truncate_undo_list would truncate the list it stands
+   for, but without turning the records that are kept into list
+   elements.  Everything on B's undo list is older than the log, so
+   the list is discarded or truncated after the log.
+
+   If the log holds a single change group, or its most recent one is
+   larger than undo-outer-limit, move it onto the list instead and
+   return false; truncate_undo_list must then do the work.  Return
+   true otherwise.  */
+
+static bool
+compact_undo_log (struct buffer *b)
+{
+  struct undo_log *log = b->undo_log;
+  unsigned char *p = log->data, *lim = p + log->used;
+  const int w = sizeof (ptrdiff_t);
+  ptrdiff_t *bounds = NULL, nbounds = 0, bounds_size = 0, i, keep;
+
+  /* Find the boundaries, oldest first.  */
+  while (p < lim)
+    switch (*p++)
+      {
+      case UNDO_LOG_BOUNDARY:
+	if (nbounds == bounds_size)
+	  bounds = xpalloc (bounds, &bounds_size, 1, -1, sizeof *bounds);
+	bounds[nbounds++] = p - 1 - log->data;
+	break;
+      case UNDO_LOG_POINT:
+	p += w;
+	break;
+      case UNDO_LOG_INSERT:
+	p += 2 * w;
+	break;
+      case UNDO_LOG_DELETE:
+	p += 1 + 3 * w + get_log_position (p + 1 + 2 * w);
+	break;
+      default:
+	emacs_abort ();
+      }
+
+  /* A boundary at the very end does not end a change group.  */
+  if (nbounds > 0 && bounds[nbounds - 1] == log->last)
+    nbounds--;
+
+  /* Always keep the most recent change group, unless it is so big that
+     undo-outer-limit-function should be asked about it.  */
+  if (nbounds == 0
+      || undo_outer_limit_exceeded (log->used - bounds[nbounds - 1]))
+    {
+      xfree (bounds);
+      flush_undo_log (b);
+      return false;
+    }
+
+  /* Keep more change groups while they fit in the limits.  */
+  keep = nbounds - 1;
+  for (i = nbounds - 1; 0 <= i; i--)
+    {
+      ptrdiff_t size = log->used - bounds[i];
+      if (size > undo_strong_limit)
+	break;
+      keep = i;
+      if (size > undo_limit)
+	break;
+    }
+
+  /* Don't use bset_undo_list below, as that would discard the log.  */
+  if (i < 0 && log->used <= undo_strong_limit)
+    {
+      /* The oldest records in the log belong to the same change group
+	 as the first elements of the list.  Keep that group, and
+	 nothing older.  */
+      Lisp_Object list = BVAR (b, undo_list), prev = Qnil;
+      while (CONSP (list) && !NILP (XCAR (list)))
+	{
+	  prev = list;
+	  list = XCDR (list);
+	}
+      if (CONSP (list))
+	{
+	  if (NILP (prev))
+	    b->undo_list_ = Qnil;
+	  else
+	    XSETCDR (prev, Qnil);
+	}
+    }
+  else
+    {
+      /* Drop the records up to and including the boundary where the
+	 kept groups start, and the whole list.  */
+      ptrdiff_t drop = bounds[keep] + 1;
+      memmove (log->data, log->data + drop, log->used - drop);
+      log->used -= drop;
+      log->last -= drop;
+      if (log->size / 2 > log->used)
+	{
+	  log->size = log->used + 1;
+	  log->data = xrealloc (log->data, log->size);
+	}
+      b->undo_list_ = Qnil;
+    }
+
+  xfree (bounds);
+  return true;
+}
+
 /* At garbage collection time, make an undo list shorter at the end,
    returning the truncated list.  How this is done depends on the
    variables undo-limit, undo-strong-limit and undo-outer-limit.
@@ -303,6 +704,21 @@ truncate_undo_list (struct buffer *b)
   record_unwind_current_buffer ();
   set_buffer_internal (b);
 
+  /* The changes in the compact undo log are the most recent ones.
+     Keep them all if they fit within undo-limit by themselves, and
+     count them as part of the size; otherwise, truncate the log
+     itself.  */
+  if (b->undo_log)
+    {
+      if (b->undo_log->used <= undo_limit)
+	size_so_far = b->undo_log->used;
+      else if (compact_undo_log (b))
+	{
+	  unbind_to (count, Qnil);
+	  return;
+	}
+    }
+
   list = BVAR (b, undo_list);
 
   prev = Qnil;
@@ -348,12 +764,7 @@ truncate_undo_list (struct buffer *b)
 
   /* If by the first boundary we have already passed undo_outer_limit,
      we're heading for memory full, so offer to clear out the list.  */
-  intmax_t undo_outer_limit;
-  if ((INTEGERP (Vundo_outer_limit)
-       && (integer_to_intmax (Vundo_outer_limit, &undo_outer_limit)
-	   ? undo_outer_limit < size_so_far
-	   : NILP (Fnatnump (Vundo_outer_limit))))
-      && !NILP (Vundo_outer_limit_function))
+  if (undo_outer_limit_exceeded (size_so_far))
     {
       Lisp_Object tem;
 
@@ -484,6 +895,18 @@ Garbage collection is inhibited around the call to this function,
 so it must make sure not to do a lot of consing.  */);
   Vundo_outer_limit_function = Qnil;
 
+  DEFVAR_BOOL ("undo-compact-log", undo_compact_log,
+	       doc: /* Non-nil means record simple changes in a compact undo log.
+Insertions, deletions of text without text properties, undo boundaries
+and positions of point are then kept in a compact form that does not
+use cons cells or strings, and are only added to `buffer-undo-list'
+when something examines that variable.  This makes large programmatic
+edits cheaper, and reduces the work of garbage collection, which
+truncates the log itself according to `undo-limit' and
+`undo-strong-limit'.  The contents of `buffer-undo-list' are the same
+either way.  */);
+  undo_compact_log = false;
+
   DEFVAR_BOOL ("undo-inhibit-record-point", undo_inhibit_record_point,
 	       doc: /* Non-nil means do not record `point' in `buffer-undo-list'.  */);
   undo_inhibit_record_point = false;
@@ -998,7 +998,7 @@ WINDOW must be a valid window and defaults to the selected one.  */)
 /* Return the number of lines/pixels of W's body.  Don't count any mode
    or header line or horizontal divider of W.  Rounds down to nearest
    integer when not working pixelwise. */
-static int
+int
 window_body_height (struct window *w, bool pixelwise)
 {
   int height = (w->pixel_height
@@ -1891,6 +1891,7 @@ POS, ROWH is the visible height of that row, and VPOS is the row number
   w = decode_live_window (window);
   buf = XBUFFER (w->contents);
   SET_TEXT_POS_FROM_MARKER (top, w->start);
+  forget_merged_faces ();
 
   if (EQ (pos, Qt))
     posint = -1;
@@ -721,6 +721,9 @@ This function may be passed to `add-variable-watcher'.  */)
 {
   bset_update_mode_line (current_buffer);
   current_buffer->prevent_redisplay_optimizations_p = true;
+  /* A change of the default value can affect any buffer.  */
+  if (NILP (where))
+    clear_glyph_row_cache (NULL, NULL);
   return Qnil;
 }
 
@@ -930,6 +933,7 @@ static void block_buffer_flips (void);
 static void unblock_buffer_flips (void);
 static void redisplay_windows (Lisp_Object);
 static void redisplay_window (Lisp_Object, bool);
+static void note_redisplay_time (struct window *, struct timespec, bool);
 static Lisp_Object redisplay_window_error (Lisp_Object);
 static Lisp_Object redisplay_window_0 (Lisp_Object);
 static Lisp_Object redisplay_window_1 (Lisp_Object);
@@ -960,6 +964,8 @@ static void pint2str (register char *, register int, register ptrdiff_t);
 static int display_string (const char *, Lisp_Object, Lisp_Object,
                            ptrdiff_t, ptrdiff_t, struct it *, int, int, int, int);
 static void compute_line_metrics (struct it *);
+static void compute_row_visible_height (struct window *, struct glyph_row *);
+static void maybe_set_cursor_in_row (struct it *, struct glyph_row *);
 static void run_redisplay_end_trigger_hook (struct it *);
 static bool get_overlay_strings (struct it *, ptrdiff_t);
 static bool get_overlay_strings_1 (struct it *, ptrdiff_t, bool);
@@ -2992,7 +2998,10 @@ init_iterator (struct it *it, struct window *w,
 	  XFRAME (w->frame)->face_change = 0;
 	  free_all_realized_faces (w->frame);
 	}
+      else if (XFRAME (w->frame)->named_face_change)
+	free_changed_realized_faces (XFRAME (w->frame));
     }
+  forget_looked_up_named_faces ();
 
   /* Perhaps remap BASE_FACE_ID to a user-specified alternative.  */
   if (! NILP (Vface_remapping_alist))
@@ -4117,6 +4126,7 @@ handle_fontified_prop (struct it *it)
       struct buffer *obuf = current_buffer;
       ptrdiff_t begv = BEGV, zv = ZV;
       bool old_clip_changed = current_buffer->clip_changed;
+      struct timespec start = current_timespec ();
 
       val = Vfontification_functions;
       specbind (Qfontification_functions, Qnil);
@@ -4157,6 +4167,8 @@ handle_fontified_prop (struct it *it)
 	}
 
       unbind_to (count, Qnil);
+      if (it->w)
+	note_redisplay_time (it->w, start, true);
 
       /* Fontification functions routinely call `save-restriction'.
 	 Normally, this tags clip_changed, which can confuse redisplay
@@ -6567,6 +6579,88 @@ pop_it (struct it *it)
 			  Moving over lines
  ***********************************************************************/
 
+/* Return how far back from a position redisplay looks for the start
+   of its line in window W, if the buffer has long lines: a few times
+   as many characters as W can show.  This is a whole number of screen
+   lines of characters as wide as the default font.  */
+
+static ptrdiff_t
+long_line_window_size (struct window *w)
+{
+  /* Text terminals use only one font size, so they need less.  */
+  int fact = FRAME_WINDOW_P (XFRAME (w->frame)) ? 3 : 2;
+  int width = window_body_width (w, false);
+  int height = window_body_height (w, false);
+
+  /* Without a right fringe, the continuation glyph takes a column;
+     see init_iterator.  */
+  if (WINDOW_RIGHT_FRINGE_WIDTH (w) == 0)
+    width--;
+  return (ptrdiff_t) fact * max (1, width) * max (1, height);
+}
+
+/* Return the start of the line that contains position POS (whose byte
+   position is POS_BYTE) of the current buffer, like
+   find_newline_no_quit (POS, POS_BYTE, -1, BYTEPOS).  But if the buffer
+   has long lines and that line starts more than a few windows' worth
+   of text before POS in window W, pretend that the line starts closer
+   to POS, and don't iterate over the text before that.  These pretend
+   line starts lie on a grid that begins at the real line start, so
+   that the iterator finds the same one from anywhere near POS; its
+   spacing is a whole number of screen lines, so that where all
+   characters have the same width, the pretend line starts are also
+   where continuation lines start.  W may be null.  */
+
+ptrdiff_t
+find_display_line_start (struct window *w, ptrdiff_t pos, ptrdiff_t pos_byte,
+			 ptrdiff_t *bytepos)
+{
+  ptrdiff_t start_byte;
+  /* This uses the newline cache, so it is cheap even on long lines
+     after the first time.  */
+  ptrdiff_t start = find_newline_no_quit (pos, pos_byte, -1, &start_byte);
+
+  if (w && current_buffer->long_line_optimizations_p)
+    {
+      ptrdiff_t len = long_line_window_size (w);
+      ptrdiff_t lines = (pos - start) / len - 1;
+
+      if (lines > 0)
+	{
+	  start += lines * len;
+	  start_byte = CHAR_TO_BYTE (start);
+	}
+    }
+  if (bytepos)
+    *bytepos = start_byte;
+  return start;
+}
+
+/* Turn on the long-line optimizations in the current buffer if the
+   line that contains POS is longer than `long-line-threshold'.  This
+   looks at no more than twice that many characters.  */
+
+static void
+check_long_line (ptrdiff_t pos)
+{
+  if (current_buffer->long_line_optimizations_p
+      || !FIXNATP (Vlong_line_threshold)
+      || ZV - BEGV <= XFIXNAT (Vlong_line_threshold))
+    return;
+
+  ptrdiff_t threshold = XFIXNAT (Vlong_line_threshold);
+  ptrdiff_t from = max (BEGV, pos - threshold);
+  ptrdiff_t to = min (ZV, pos + threshold);
+  ptrdiff_t found_back, found_forward;
+  ptrdiff_t bol = find_newline (pos, -1, from, -1, -1, &found_back,
+				NULL, false);
+  ptrdiff_t eol = find_newline (pos, -1, to, -1, 1, &found_forward,
+				NULL, false);
+
+  if ((found_forward ? eol - 1 : to) - bol > threshold)
+    current_buffer->long_line_optimizations_p = true;
+}
+
 /* Set IT's current position to the previous line start.  */
 
 static void
@@ -6575,7 +6669,8 @@ back_to_previous_line_start (struct it *it)
   ptrdiff_t cp = IT_CHARPOS (*it), bp = IT_BYTEPOS (*it);
 
   DEC_BOTH (cp, bp);
-  IT_CHARPOS (*it) = find_newline_no_quit (cp, bp, -1, &IT_BYTEPOS (*it));
+  IT_CHARPOS (*it) = find_display_line_start (it->w, cp, bp,
+					      &IT_BYTEPOS (*it));
 }
 
 
@@ -8227,9 +8322,10 @@ get_visually_first_element (struct it *it)
       if (string_p)
 	it->bidi_it.charpos = it->bidi_it.bytepos = 0;
       else
-	it->bidi_it.charpos = find_newline_no_quit (IT_CHARPOS (*it),
-						    IT_BYTEPOS (*it), -1,
-						    &it->bidi_it.bytepos);
+	it->bidi_it.charpos = find_display_line_start (it->w,
+						       IT_CHARPOS (*it),
+						       IT_BYTEPOS (*it),
+						       &it->bidi_it.bytepos);
       bidi_paragraph_init (it->paragraph_embedding, &it->bidi_it, true);
       do
 	{
@@ -10057,7 +10153,7 @@ move_it_vertically_backward (struct it *it, int dy)
 	  ptrdiff_t cp = IT_CHARPOS (*it), bp = IT_BYTEPOS (*it);
 
 	  DEC_BOTH (cp, bp);
-	  cp = find_newline_no_quit (cp, bp, -1, NULL);
+	  cp = find_display_line_start (it->w, cp, bp, NULL);
 	  move_it_to (it, cp, -1, -1, -1, MOVE_TO_POS);
 	}
       bidi_unshelve_cache (it3data, true);
@@ -10394,6 +10490,7 @@ include the height of both, if present, in the return value.  */)
 
   CHECK_BUFFER (buffer);
   b = XBUFFER (buffer);
+  forget_merged_faces ();
 
   if (b != current_buffer)
     {
@@ -14796,6 +14893,232 @@ debug_method_add (struct window *w, char const *fmt, ...)
 #endif /* GLYPH_DEBUG */
 
 
+/***********************************************************************
+			 Redisplay statistics
+ ***********************************************************************/
+
+/* What `redisplay-statistics' reports for all frames.  Each window
+   and frame keeps its own in its redisplay_stats member.  */
+
+static struct redisplay_stats redisplay_stats;
+
+/* Count a redisplay of window W by METHOD.  */
+
+static void
+note_redisplay_method (struct window *w, enum redisplay_method method)
+{
+  w->redisplay_stats.methods[method]++;
+  XFRAME (w->frame)->redisplay_stats.methods[method]++;
+  redisplay_stats.methods[method]++;
+}
+
+/* Count a glyph row produced for window W.  REUSED means it was
+   copied from the glyph row cache.  */
+
+static void
+note_glyph_row (struct window *w, bool reused)
+{
+  w->redisplay_stats.rows++;
+  XFRAME (w->frame)->redisplay_stats.rows++;
+  redisplay_stats.rows++;
+  if (reused)
+    {
+      w->redisplay_stats.reused_rows++;
+      XFRAME (w->frame)->redisplay_stats.reused_rows++;
+      redisplay_stats.reused_rows++;
+    }
+}
+
+/* Count a face property merged into a realized face for window W.
+   REUSED means the face was found in the cache of merged faces.  */
+
+void
+note_face_merge (struct window *w, bool reused)
+{
+  struct redisplay_stats *stats[] = { &w->redisplay_stats,
+				      &XFRAME (w->frame)->redisplay_stats,
+				      &redisplay_stats };
+
+  for (int i = 0; i < ARRAYELTS (stats); i++)
+    {
+      stats[i]->face_merges++;
+      if (reused)
+	stats[i]->reused_face_merges++;
+    }
+}
+
+/* Count a glyph code or glyph metrics that a font backend had to ask
+   a font for.  */
+
+void
+note_font_glyph_miss (void)
+{
+  redisplay_stats.font_glyph_misses++;
+}
+
+/* Count a lookup in the cache of glyph-strings for automatic
+   composition.  REUSED means the glyph-string was found.  */
+
+void
+note_gstring_lookup (bool reused)
+{
+  redisplay_stats.gstring_lookups++;
+  if (reused)
+    redisplay_stats.reused_gstrings++;
+}
+
+/* Count N glyph-strings evicted from that cache.  */
+
+void
+note_gstring_evictions (ptrdiff_t n)
+{
+  redisplay_stats.evicted_gstrings += n;
+}
+
+/* Add the time since START to the time W spent in redisplay_window,
+   or, if FONTIFICATION, to the time spent fontifying its text.  */
+
+static void
+note_redisplay_time (struct window *w, struct timespec start,
+		     bool fontification)
+{
+  struct timespec elapsed = timespec_sub (current_timespec (), start);
+  struct redisplay_stats *stats[] = { &w->redisplay_stats,
+				      &XFRAME (w->frame)->redisplay_stats,
+				      &redisplay_stats };
+
+  for (int i = 0; i < ARRAYELTS (stats); i++)
+    if (fontification)
+      {
+	stats[i]->fontifications++;
+	stats[i]->fontification_time
+	  = timespec_add (stats[i]->fontification_time, elapsed);
+      }
+    else
+      stats[i]->window_time = timespec_add (stats[i]->window_time, elapsed);
+}
+
+/* Count a call to update_frame for frame F that started at START.  */
+
+void
+note_frame_update (struct frame *f, struct timespec start)
+{
+  struct timespec elapsed = timespec_sub (current_timespec (), start);
+
+  f->redisplay_stats.updates++;
+  f->redisplay_stats.update_time
+    = timespec_add (f->redisplay_stats.update_time, elapsed);
+  redisplay_stats.updates++;
+  redisplay_stats.update_time
+    = timespec_add (redisplay_stats.update_time, elapsed);
+}
+
+DEFUN ("redisplay-statistics", Fredisplay_statistics,
+       Sredisplay_statistics, 0, 2, 0,
+       doc: /* Return statistics about the redisplay of WHERE.
+WHERE can be a live window, a live frame, or nil, which means all of
+redisplay since Emacs started.  The value is an alist with these
+elements, counted since the window or frame was made or since the
+statistics were last reset:
+
+  (METHOD . COUNT)   for each METHOD by which windows were redisplayed,
+                     one of `current-line', `cursor-movement',
+                     `forced-start', `window-id', `reuse-matrix',
+                     `same-start', `scrolling' and `recenter', in the
+                     order in which redisplay tries them
+  (rows . COUNT)     the number of glyph rows that were produced
+  (reused-rows . COUNT)
+                     how many of those rows were copied from the cache
+                     of rows displayed earlier
+  (face-merges . COUNT)
+                     the number of times a face property of text was
+                     merged into a realized face
+  (reused-face-merges . COUNT)
+                     how many of those merges were found in the cache
+                     of faces merged earlier
+  (font-glyph-misses . COUNT)
+                     the number of glyph codes of characters and glyph
+                     metrics that were not found in the caches of fonts
+                     and had to be asked of the fonts; this is zero
+                     for windows and frames
+  (gstring-lookups . COUNT)
+  (reused-gstrings . COUNT)
+  (evicted-gstrings . COUNT)
+  (cached-gstrings . COUNT)
+                     the number of times text was looked up in the
+                     cache of shaped text for automatic composition,
+                     how many times it was found there, how many
+                     shaped texts were evicted from the cache, and how
+                     many it holds now; these are zero for windows and
+                     frames
+  (window-time . SECONDS)
+                     the time spent redisplaying windows, including
+                     the time spent fontifying
+  (fontifications . COUNT)
+  (fontification-time . SECONDS)
+                     the number of times `fontification-functions' were
+                     run, and the time they took
+  (updates . COUNT)
+  (update-time . SECONDS)
+                     the number of times frames were updated on the
+                     display, and the time it took; these are zero for
+                     windows
+
+If the optional argument RESET is non-nil, reset the statistics of
+WHERE to zero after computing the value.  */)
+  (Lisp_Object where, Lisp_Object reset)
+{
+  static char const *const method_names[REDISPLAY_METHODS] =
+    { "current-line", "cursor-movement", "forced-start", "window-id",
+      "reuse-matrix", "same-start", "scrolling", "recenter" };
+  struct redisplay_stats *stats;
+
+  if (NILP (where))
+    stats = &redisplay_stats;
+  else if (WINDOWP (where))
+    stats = &decode_live_window (where)->redisplay_stats;
+  else
+    stats = &decode_live_frame (where)->redisplay_stats;
+
+  Lisp_Object val
+    = list (Fcons (intern_c_string ("rows"), make_int (stats->rows)),
+	    Fcons (intern_c_string ("reused-rows"),
+		   make_int (stats->reused_rows)),
+	    Fcons (intern_c_string ("face-merges"),
+		   make_int (stats->face_merges)),
+	    Fcons (intern_c_string ("reused-face-merges"),
+		   make_int (stats->reused_face_merges)),
+	    Fcons (intern_c_string ("font-glyph-misses"),
+		   make_int (stats->font_glyph_misses)),
+	    Fcons (intern_c_string ("gstring-lookups"),
+		   make_int (stats->gstring_lookups)),
+	    Fcons (intern_c_string ("reused-gstrings"),
+		   make_int (stats->reused_gstrings)),
+	    Fcons (intern_c_string ("evicted-gstrings"),
+		   make_int (stats->evicted_gstrings)),
+	    Fcons (intern_c_string ("cached-gstrings"),
+		   make_int (NILP (where)
+			     ? composition_cached_gstrings () : 0)),
+	    Fcons (intern_c_string ("window-time"),
+		   make_float (timespectod (stats->window_time))),
+	    Fcons (intern_c_string ("fontifications"),
+		   make_int (stats->fontifications)),
+	    Fcons (intern_c_string ("fontification-time"),
+		   make_float (timespectod (stats->fontification_time))),
+	    Fcons (intern_c_string ("updates"), make_int (stats->updates)),
+	    Fcons (intern_c_string ("update-time"),
+		   make_float (timespectod (stats->update_time))));
+  for (int i = REDISPLAY_METHODS - 1; 0 <= i; i--)
+    val = Fcons (Fcons (intern_c_string (method_names[i]),
+			make_int (stats->methods[i])),
+		 val);
+
+  if (!NILP (reset))
+    memset (stats, 0, sizeof *stats);
+  return val;
+}
+
+
 /* Value is true if all changes in window W, which displays
    current_buffer, are in the text between START and END.  START is a
    buffer position, END is given as a distance from Z.  Used in
@@ -15223,6 +15546,23 @@ redisplay_internal (void)
 
   pending = false;
   forget_escape_and_glyphless_faces ();
+  forget_merged_faces ();
+
+  /* Glyphs in current matrices and in the glyph row cache refer to
+     glyph-strings by their IDs, which become invalid when they are
+     evicted from the composition cache.  */
+  if (composition_evict_gstrings ())
+    FOR_EACH_FRAME (tail, frame)
+      {
+	struct frame *f = XFRAME (frame);
+
+	if (WINDOWP (f->root_window))
+	  {
+	    clear_current_matrices (f);
+	    fset_redisplay (f);
+	  }
+	clear_glyph_row_cache (f, NULL);
+      }
 
   inhibit_free_realized_faces = false;
 
@@ -15400,6 +15740,7 @@ redisplay_internal (void)
       && !FRAME_OBSCURED_P (XFRAME (w->frame))
       && !XFRAME (w->frame)->cursor_type_changed
       && !XFRAME (w->frame)->face_change
+      && !XFRAME (w->frame)->named_face_change
       /* Make sure recorded data applies to current buffer, etc.  */
       && this_line_buffer == current_buffer
       && match_p
@@ -15513,6 +15854,7 @@ redisplay_internal (void)
 	      *w->desired_matrix->method = 0;
 	      debug_method_add (w, "optimization 1");
 #endif
+	      note_redisplay_method (w, REDISPLAY_CURRENT_LINE);
 #ifdef HAVE_WINDOW_SYSTEM
 	      update_window_fringes (w, false);
 #endif
@@ -15579,6 +15921,7 @@ redisplay_internal (void)
 		  *w->desired_matrix->method = 0;
 		  debug_method_add (w, "optimization 3");
 #endif
+		  note_redisplay_method (w, REDISPLAY_CURSOR_MOVEMENT);
 		  goto update;
 		}
 	      else
@@ -17954,6 +18297,9 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
   int frame_line_height, margin;
   bool use_desired_matrix;
   void *itdata = NULL;
+  /* How W was redisplayed, if it gets to `done'.  */
+  enum redisplay_method method = REDISPLAY_RECENTER;
+  struct timespec start_time;
 
   SET_TEXT_POS (lpoint, PT, PT_BYTE);
   opoint = lpoint;
@@ -17967,11 +18313,14 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
       && !w->redisplay
       && !w->update_mode_line
       && !f->face_change
+      && !f->named_face_change
       && !f->redisplay
       && !buffer->text->redisplay
       && BUF_PT (buffer) == w->last_point)
     return;
 
+  start_time = current_timespec ();
+
   /* Make sure that both W's markers are valid.  */
   eassert (XMARKER (w->start)->buffer == buffer);
   eassert (XMARKER (w->pointm)->buffer == buffer);
@@ -17980,6 +18329,11 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
   frame_line_height = default_line_pixel_height (w);
   margin = window_scroll_margin (w, MARGIN_IN_LINES);
 
+  /* Whatever made this flag be set might have changed how the rows
+     cached for this buffer look.  */
+  if (buffer->prevent_redisplay_optimizations_p)
+    clear_glyph_row_cache (NULL, buffer);
+
 
   /* Has the mode line to be updated?  */
   update_mode_line = (w->update_mode_line
@@ -18035,6 +18389,12 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
      variables.  */
   set_buffer_internal_1 (XBUFFER (w->contents));
 
+  /* Stop looking at whole lines if the ones displayed here are too
+     long for that.  */
+  check_long_line (PT);
+  if (XMARKER (w->start)->buffer == current_buffer)
+    check_long_line (marker_position (w->start));
+
   current_matrix_up_to_date_p
     = (w->window_end_valid
        && !current_buffer->clip_changed
@@ -18361,6 +18721,7 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
 #ifdef GLYPH_DEBUG
       debug_method_add (w, "forced window start");
 #endif
+      method = REDISPLAY_FORCED_START;
       goto done;
     }
 
@@ -18375,6 +18736,7 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
 	{
 	case CURSOR_MOVEMENT_SUCCESS:
 	  used_current_matrix_p = true;
+	  method = REDISPLAY_CURSOR_MOVEMENT;
 	  goto done;
 
 	case CURSOR_MOVEMENT_MUST_SCROLL:
@@ -18408,7 +18770,10 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
       if (f->fonts_changed)
 	goto need_larger_matrices;
       if (tem > 0)
-	goto done;
+	{
+	  method = REDISPLAY_WINDOW_ID;
+	  goto done;
+	}
 
       /* Otherwise try_window_id has returned -1 which means that we
 	 don't want the alternative below this comment to execute.  */
@@ -18506,7 +18871,11 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
 	    }
 	    /* Drop through and scroll.  */
 	  else
-	    goto done;
+	    {
+	      method = (used_current_matrix_p ? REDISPLAY_REUSE_MATRIX
+			: REDISPLAY_SAME_START);
+	      goto done;
+	    }
 	}
       else
 	clear_glyph_matrix (w->desired_matrix);
@@ -18539,6 +18908,7 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
       switch (ss)
 	{
 	case SCROLLING_SUCCESS:
+	  method = REDISPLAY_SCROLLING;
 	  goto done;
 
 	case SCROLLING_NEED_LARGER_MATRICES:
@@ -18838,6 +19208,7 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
 
  done:
 
+  note_redisplay_method (w, method);
   SET_TEXT_POS_FROM_MARKER (startp, w->start);
   w->start_at_line_beg = (CHARPOS (startp) == BEGV
 			  || FETCH_BYTE (BYTEPOS (startp) - 1) == '\n');
@@ -19027,6 +19398,7 @@ redisplay_window (Lisp_Object window, bool just_this_one_p)
     TEMP_SET_PT_BOTH (CHARPOS (lpoint), BYTEPOS (lpoint));
 
   unbind_to (count, Qnil);
+  note_redisplay_time (w, start_time, false);
 }
 
 
@@ -21099,6 +21471,351 @@ usage: (trace-to-stderr STRING &rest OBJECTS)  */)
 
 
 
+/***********************************************************************
+			     Glyph Row Cache
+ ***********************************************************************/
+
+/* display_line keeps the rows it produces from buffer text in a
+   cache, so that text displayed again, as when a window is scrolled
+   back to where it was, can be copied to the desired matrix instead
+   of being iterated over and having its faces and glyphs produced
+   anew.
+
+   A row is found by the window, the position where it starts, the
+   modification ticks of the buffer, and those settings of the
+   iterator that affect the layout and the faces of the glyphs; see
+   struct glyph_row_cache_key.  Lists that Lisp can change in place,
+   like 'face-remapping-alist', are part of the key by a hash of their
+   contents, and display tables by display_char_table_tick.  Other
+   changes that affect the display set the buffer's
+   prevent_redisplay_optimizations_p flag, which makes redisplay_window
+   flush the buffer's rows, or free the frame's realized faces, which
+   flushes the frame's rows.  Changing the default value of a variable
+   watched by set-buffer-redisplay flushes all rows.
+
+   Only rows that start at the beginning of a line and end in a
+   newline, with glyphs for characters and stretches from the buffer,
+   are cached.  After copying such a row, reseating the iterator at
+   its end puts it where display_line would have left it.  */
+
+/* Number of entries in the cache.  */
+
+enum { GLYPH_ROW_CACHE_SIZE = 512 };
+
+/* What a cached row depends on.  Keys are compared with memcmp, so
+   they must be cleared before they are filled in.  The Lisp objects
+   are marked by mark_glyph_row_cache, which keeps them from being
+   reused for different values while the row is in the cache.  */
+
+struct glyph_row_cache_key
+{
+  /* Sequence number of the window; unlike its address, this is never
+     reused.  */
+  EMACS_INT window;
+
+  /* The buffer, the position where the row starts, and the buffer's
+     modification ticks.  BUFFER is null in unused entries.  */
+  struct buffer *buffer;
+  ptrdiff_t charpos, bytepos;
+  modiff_count modiff, overlay_modiff;
+
+  /* Values that the row was produced with, the hashes of the contents
+     of the lists, and display_char_table_tick.  */
+  Lisp_Object display_table, invisibility_spec, face_remapping_alist;
+  Lisp_Object nobreak_char_display, glyphless_char_display;
+  Lisp_Object auto_composition_mode, line_prefix, wrap_prefix;
+  EMACS_UINT invisibility_spec_hash, face_remapping_hash;
+  EMACS_INT char_table_tick;
+  int last_visible_x, left_margin_glyphs, right_margin_glyphs;
+  int base_face_id, tab_width, extra_line_spacing;
+  ptrdiff_t selective;
+  enum line_wrap_method line_wrap;
+  bidi_dir_t paragraph_embedding;
+  bool_bf ctl_arrow_p : 1;
+  bool_bf multibyte_p : 1;
+  bool_bf bidi_p : 1;
+
+  /* Whether the row is the first text row of the window, whose
+     height compute_line_metrics adjusts.  */
+  bool_bf first_row_p : 1;
+};
+
+struct glyph_row_cache_entry
+{
+  struct glyph_row_cache_key key;
+
+  /* The frame of the window, for clear_glyph_row_cache.  */
+  struct frame *f;
+
+  /* The row, with its glyph pointers pointing into GLYPHS, which has
+     room for NGLYPHS glyphs.  */
+  struct glyph_row row;
+  struct glyph *glyphs;
+  ptrdiff_t nglyphs;
+};
+
+/* The cache, allocated when first used.  A row can only be in the
+   entry selected by its window and its start position.  */
+
+static struct glyph_row_cache_entry *glyph_row_cache;
+
+/* Return the entry of the cache where the row described by KEY
+   belongs.  */
+
+static struct glyph_row_cache_entry *
+glyph_row_cache_entry (struct glyph_row_cache_key const *key)
+{
+  if (!glyph_row_cache)
+    glyph_row_cache = xzalloc (GLYPH_ROW_CACHE_SIZE * sizeof *glyph_row_cache);
+  return &glyph_row_cache[sxhash_combine (key->window, key->charpos)
+			  % GLYPH_ROW_CACHE_SIZE];
+}
+
+/* Add to *HASH a hash of the contents of LIST, whose elements can be
+   lists themselves, for glyph_row_cache_key.  Value is false if LIST
+   is too large or too deep to be hashed, or circular.  */
+
+static bool
+glyph_row_cache_hash_list (Lisp_Object list, int depth, EMACS_UINT *hash,
+			   ptrdiff_t *budget)
+{
+  for (; CONSP (list); list = XCDR (list))
+    {
+      if (--*budget < 0 || depth > 8)
+	return false;
+      if (CONSP (XCAR (list)))
+	{
+	  if (!glyph_row_cache_hash_list (XCAR (list), depth + 1, hash, budget))
+	    return false;
+	}
+      else
+	*hash = sxhash_combine (*hash, sxhash (XCAR (list)));
+      /* Distinguish (A B) from ((A) B).  */
+      *hash = sxhash_combine (*hash, depth);
+    }
+  *hash = sxhash_combine (*hash, sxhash (list));
+  return true;
+}
+
+/* Fill KEY with what ROW would depend on if display_line produced it
+   from the current state of IT.  Value is false if such a row cannot
+   be cached.  */
+
+static bool
+glyph_row_cache_key (struct it *it, struct glyph_row *row,
+		     struct glyph_row_cache_key *key)
+{
+  struct window *w = it->w;
+
+  if (!redisplay_cache_glyph_rows
+      || MINI_WINDOW_P (w)
+      || w->pseudo_window_p
+      || it->method != GET_FROM_BUFFER
+      || it->sp != 0
+      || it->area != TEXT_AREA
+      || it->first_visible_x != 0
+      || it->continuation_lines_width != 0
+      || it->starts_in_middle_of_char_p
+      || it->redisplay_end_trigger_charpos > 0
+      || CHARPOS (it->start.pos) != IT_CHARPOS (*it)
+      || (IT_CHARPOS (*it) > BEGV
+	  && FETCH_BYTE (IT_BYTEPOS (*it) - 1) != '\n')
+      || !NILP (Vshow_trailing_whitespace)
+      || !NILP (Vdisplay_line_numbers)
+      || Vdisplay_fill_column_indicator)
+    return false;
+
+  memset (key, 0, sizeof *key);
+  ptrdiff_t budget = 1000;
+  if (!glyph_row_cache_hash_list (BVAR (current_buffer, invisibility_spec),
+				  0, &key->invisibility_spec_hash, &budget)
+      || !glyph_row_cache_hash_list (Vface_remapping_alist, 0,
+				     &key->face_remapping_hash, &budget))
+    return false;
+  key->window = w->sequence_number;
+  key->buffer = current_buffer;
+  key->charpos = IT_CHARPOS (*it);
+  key->bytepos = IT_BYTEPOS (*it);
+  key->modiff = MODIFF;
+  key->overlay_modiff = OVERLAY_MODIFF;
+  key->display_table = (it->dp
+			? make_lisp_ptr (it->dp, Lisp_Vectorlike) : Qnil);
+  key->invisibility_spec = BVAR (current_buffer, invisibility_spec);
+  key->face_remapping_alist = Vface_remapping_alist;
+  key->nobreak_char_display = Vnobreak_char_display;
+  key->glyphless_char_display = Vglyphless_char_display;
+  key->auto_composition_mode = Vauto_composition_mode;
+  key->line_prefix = Vline_prefix;
+  key->wrap_prefix = Vwrap_prefix;
+  key->char_table_tick = display_char_table_tick;
+  key->last_visible_x = it->last_visible_x;
+  key->left_margin_glyphs = w->desired_matrix->left_margin_glyphs;
+  key->right_margin_glyphs = w->desired_matrix->right_margin_glyphs;
+  key->base_face_id = it->base_face_id;
+  key->tab_width = it->tab_width;
+  key->extra_line_spacing = it->extra_line_spacing;
+  key->selective = it->selective;
+  key->line_wrap = it->line_wrap;
+  key->paragraph_embedding = it->paragraph_embedding;
+  key->ctl_arrow_p = it->ctl_arrow_p;
+  key->multibyte_p = it->multibyte_p;
+  key->bidi_p = it->bidi_p;
+  key->first_row_p = row == MATRIX_FIRST_TEXT_ROW (w->desired_matrix);
+  return true;
+}
+
+/* If the cache has the row described by KEY, copy it to IT's glyph
+   row, leave IT where display_line would have left it after producing
+   the row, and return true.  Otherwise, return false.  */
+
+static bool
+reuse_cached_glyph_row (struct it *it, struct glyph_row_cache_key const *key)
+{
+  struct glyph_row *row = it->glyph_row;
+  struct glyph_row_cache_entry *e = glyph_row_cache_entry (key);
+  struct glyph *glyphs[1 + LAST_AREA];
+  int area;
+
+  if (memcmp (&e->key, key, sizeof *key) != 0
+      || CHARPOS (e->row.end.pos) > ZV
+      || !NILP (overlay_arrow_at_row (it, &e->row)))
+    return false;
+  for (area = LEFT_MARGIN_AREA; area < LAST_AREA; area++)
+    if (row->glyphs[area + 1] - row->glyphs[area] < e->row.used[area])
+      return false;
+
+  memcpy (glyphs, row->glyphs, sizeof glyphs);
+  *row = e->row;
+  memcpy (row->glyphs, glyphs, sizeof glyphs);
+  for (area = LEFT_MARGIN_AREA; area < LAST_AREA; area++)
+    memcpy (row->glyphs[area], e->row.glyphs[area],
+	    row->used[area] * sizeof *row->glyphs[area]);
+  row->y = it->current_y;
+  if (FRAME_WINDOW_P (it->f))
+    compute_row_visible_height (it->w, row);
+
+  maybe_set_cursor_in_row (it, row);
+
+  reseat (it, row->end.pos, false);
+  it->current_y += row->height;
+  SET_TEXT_POS (it->eol_pos, 0, 0);
+  ++it->vpos;
+  ++it->glyph_row;
+  if (it->glyph_row < MATRIX_BOTTOM_TEXT_ROW (it->w->desired_matrix, it->w))
+    it->glyph_row->reversed_p = row->reversed_p;
+  it->start = row->end;
+  return true;
+}
+
+/* Put ROW, which display_line just produced from the state of IT
+   described by KEY, in the cache, if the row can be cached.  IT is at
+   the end of ROW.  */
+
+static void
+cache_glyph_row (struct it *it, struct glyph_row *row,
+		 struct glyph_row_cache_key const *key)
+{
+  struct glyph_row_cache_entry *e;
+  struct glyph *g;
+  ptrdiff_t nglyphs = 0;
+  int area;
+
+  /* Don't cache the row if fontification changed the text or a
+     display table while it was being produced, or if it doesn't end
+     in a newline.  */
+  if (key->modiff != MODIFF
+      || key->overlay_modiff != OVERLAY_MODIFF
+      || key->char_table_tick != display_char_table_tick
+      || !row->displays_text_p
+      || row->continued_p
+      || row->truncated_on_left_p
+      || row->ends_at_zv_p
+      || row->ends_in_ellipsis_p
+      || row->used[TEXT_AREA] == 0
+      || it->method != GET_FROM_BUFFER
+      || it->sp != 0
+      || row->end.overlay_string_index >= 0
+      || CHARPOS (row->end.string_pos) >= 0
+      || row->end.dpvec_index >= 0
+      || FETCH_BYTE (BYTEPOS (row->end.pos) - 1) != '\n')
+    return;
+
+  /* Images and compositions are referred to by IDs that can be
+     reused, and glyphs from strings don't keep their strings alive.  */
+  for (area = LEFT_MARGIN_AREA; area < LAST_AREA; area++)
+    {
+      for (g = row->glyphs[area]; g < row->glyphs[area] + row->used[area]; g++)
+	if ((g->type != CHAR_GLYPH
+	     && g->type != STRETCH_GLYPH
+	     && g->type != GLYPHLESS_GLYPH)
+	    || STRINGP (g->object))
+	  return;
+      nglyphs += row->used[area];
+    }
+
+  e = glyph_row_cache_entry (key);
+  if (e->nglyphs < nglyphs)
+    {
+      xfree (e->glyphs);
+      e->glyphs = xnmalloc (nglyphs, sizeof *e->glyphs);
+      e->nglyphs = nglyphs;
+    }
+  e->key = *key;
+  e->f = it->f;
+  e->row = *row;
+  g = e->glyphs;
+  for (area = LEFT_MARGIN_AREA; area < LAST_AREA; area++)
+    {
+      e->row.glyphs[area] = g;
+      memcpy (g, row->glyphs[area], row->used[area] * sizeof *g);
+      g += row->used[area];
+    }
+  e->row.glyphs[LAST_AREA] = g;
+}
+
+/* Remove the rows of frame F, or of all frames if F is null, that
+   display buffer B, or any buffer if B is null, from the cache.  */
+
+void
+clear_glyph_row_cache (struct frame *f, struct buffer *b)
+{
+  if (glyph_row_cache)
+    for (int i = 0; i < GLYPH_ROW_CACHE_SIZE; i++)
+      {
+	struct glyph_row_cache_entry *e = &glyph_row_cache[i];
+
+	if (e->key.buffer
+	    && (!f || e->f == f)
+	    && (!b || e->key.buffer == b))
+	  e->key.buffer = NULL;
+      }
+}
+
+/* Mark the Lisp objects in the keys of the cache.  */
+
+void
+mark_glyph_row_cache (void)
+{
+  if (glyph_row_cache)
+    for (int i = 0; i < GLYPH_ROW_CACHE_SIZE; i++)
+      {
+	struct glyph_row_cache_key *key = &glyph_row_cache[i].key;
+
+	if (key->buffer)
+	  {
+	    mark_object (key->display_table);
+	    mark_object (key->invisibility_spec);
+	    mark_object (key->face_remapping_alist);
+	    mark_object (key->nobreak_char_display);
+	    mark_object (key->glyphless_char_display);
+	    mark_object (key->auto_composition_mode);
+	    mark_object (key->line_prefix);
+	    mark_object (key->wrap_prefix);
+	  }
+      }
+}
+
+
 /***********************************************************************
 		     Building Desired Matrix Rows
  ***********************************************************************/
@@ -21340,6 +22057,22 @@ row_hash (struct glyph_row *row)
   return hashval;
 }
 
+/* Compute how much of ROW, a row of window W on a window-system
+   frame, is visible.  */
+
+static void
+compute_row_visible_height (struct window *w, struct glyph_row *row)
+{
+  int min_y = WINDOW_TAB_LINE_HEIGHT (w) + WINDOW_HEADER_LINE_HEIGHT (w);
+  int max_y = WINDOW_BOX_HEIGHT_NO_MODE_LINE (w);
+
+  row->visible_height = row->height;
+  if (row->y < min_y)
+    row->visible_height -= min_y - row->y;
+  if (row->y + row->height > max_y)
+    row->visible_height -= row->y + row->height - max_y;
+}
+
 /* Compute the pixel height and width of IT->glyph_row.
 
    Most of the time, ascent and height of a display line will be equal
@@ -21364,7 +22097,7 @@ compute_line_metrics (struct it *it)
 
   if (FRAME_WINDOW_P (it->f))
     {
-      int i, min_y, max_y;
+      int i;
 
       /* The line may consist of one space only, that was added to
 	 place the cursor on it.  If so, the row's height hasn't been
@@ -21401,16 +22134,7 @@ compute_line_metrics (struct it *it)
 	  row->ascent = row->phys_ascent;
 	}
 
-      /* Compute how much of the line is visible.  */
-      row->visible_height = row->height;
-
-      min_y = WINDOW_TAB_LINE_HEIGHT (it->w) + WINDOW_HEADER_LINE_HEIGHT (it->w);
-      max_y = WINDOW_BOX_HEIGHT_NO_MODE_LINE (it->w);
-
-      if (row->y < min_y)
-	row->visible_height -= min_y - row->y;
-      if (row->y + row->height > max_y)
-	row->visible_height -= row->y + row->height - max_y;
+      compute_row_visible_height (it->w, row);
     }
   else
     {
@@ -22925,6 +23649,31 @@ row_text_area_empty (struct glyph_row *row)
   return true;
 }
 
+/* Set the cursor of IT's window in ROW, a row of its desired matrix
+   that display_line just produced, if ROW displays point.  */
+
+static void
+maybe_set_cursor_in_row (struct it *it, struct glyph_row *row)
+{
+  int cvpos = it->w->cursor.vpos;
+
+  if ((cvpos < 0
+       /* In bidi-reordered rows, keep checking for proper cursor
+	  position even if one has been found already, because buffer
+	  positions in such rows change non-linearly with ROW->VPOS,
+	  when a line is continued.  One exception: when we are at ZV,
+	  display cursor on the first suitable glyph row, since all
+	  the empty rows after that also have their position set to ZV.  */
+       /* FIXME: Revisit this when glyph ``spilling'' in continuation
+	  lines' rows is implemented for bidi-reordered rows.  */
+       || (it->bidi_p
+	   && !MATRIX_ROW (it->w->desired_matrix, cvpos)->ends_at_zv_p))
+      && PT >= MATRIX_ROW_START_CHARPOS (row)
+      && PT <= MATRIX_ROW_END_CHARPOS (row)
+      && cursor_row_p (row))
+    set_cursor_from_row (it->w, row, it->w->desired_matrix, 0, 0, 0, 0);
+}
+
 /* Construct the glyph row IT->glyph_row in the desired matrix of
    IT->w from text at the current position of IT.  See dispextern.h
    for an overview of struct it.  Value is true if
@@ -22947,7 +23696,6 @@ display_line (struct it *it, int cursor_vpos)
   int wrap_row_extra_line_spacing UNINIT;
   ptrdiff_t wrap_row_min_pos UNINIT, wrap_row_min_bpos UNINIT;
   ptrdiff_t wrap_row_max_pos UNINIT, wrap_row_max_bpos UNINIT;
-  int cvpos;
   ptrdiff_t min_pos = ZV + 1, max_pos = 0;
   ptrdiff_t min_bpos UNINIT, max_bpos UNINIT;
   bool pending_handle_line_prefix = false;
@@ -22959,6 +23707,8 @@ display_line (struct it *it, int cursor_vpos)
   int first_visible_x = it->first_visible_x;
   int last_visible_x = it->last_visible_x;
   int x_incr = 0;
+  struct glyph_row_cache_key cache_key;
+  bool cache_row_p;
 
   /* We always start displaying at hpos zero even if hscrolled.  */
   eassert (it->hpos == 0 && it->current_x == 0);
@@ -22974,6 +23724,16 @@ display_line (struct it *it, int cursor_vpos)
   /* Clear the result glyph row and enable it.  */
   prepare_desired_row (it->w, row, false);
 
+  /* Copy the row from the glyph row cache if it is there.  */
+  cache_row_p = (!hscroll_this_line
+		 && glyph_row_cache_key (it, row, &cache_key));
+  if (cache_row_p && reuse_cached_glyph_row (it, &cache_key))
+    {
+      note_glyph_row (it->w, true);
+      return true;
+    }
+  note_glyph_row (it->w, false);
+
   row->y = it->current_y;
   row->start = it->start;
   row->continuation_lines_width = it->continuation_lines_width;
@@ -23781,6 +24541,7 @@ display_line (struct it *it, int cursor_vpos)
 	  row->overlay_arrow_bitmap = XFIXNUM (overlay_arrow_string);
 	}
       overlay_arrow_seen = true;
+      cache_row_p = false;
     }
 
   /* Highlight trailing whitespace.  */
@@ -23820,23 +24581,10 @@ display_line (struct it *it, int cursor_vpos)
       && FRAME_WINDOW_P (it->f) && !cursor_in_echo_area)
     row->redraw_fringe_bitmaps_p = true;
 
-  /* Maybe set the cursor.  */
-  cvpos = it->w->cursor.vpos;
-  if ((cvpos < 0
-       /* In bidi-reordered rows, keep checking for proper cursor
-	  position even if one has been found already, because buffer
-	  positions in such rows change non-linearly with ROW->VPOS,
-	  when a line is continued.  One exception: when we are at ZV,
-	  display cursor on the first suitable glyph row, since all
-	  the empty rows after that also have their position set to ZV.  */
-       /* FIXME: Revisit this when glyph ``spilling'' in continuation
-	  lines' rows is implemented for bidi-reordered rows.  */
-       || (it->bidi_p
-	   && !MATRIX_ROW (it->w->desired_matrix, cvpos)->ends_at_zv_p))
-      && PT >= MATRIX_ROW_START_CHARPOS (row)
-      && PT <= MATRIX_ROW_END_CHARPOS (row)
-      && cursor_row_p (row))
-    set_cursor_from_row (it->w, row, it->w->desired_matrix, 0, 0, 0, 0);
+  maybe_set_cursor_in_row (it, row);
+
+  if (cache_row_p)
+    cache_glyph_row (it, row, &cache_key);
 
   /* Prepare for the next line.  This line starts horizontally at (X
      HPOS) = (0 0).  Vertical positions are incremented.  As a
@@ -26548,22 +27296,27 @@ display_count_lines (ptrdiff_t start_byte,
 	  ceiling_addr = BYTE_POS_ADDR (ceiling) + 1;
 	  base = (cursor = BYTE_POS_ADDR (start_byte));
 
-	  do
+	  if (!selective_display)
 	    {
-	      if (selective_display)
+	      cursor = skip_newlines_forward (base, ceiling_addr - base,
+					      &count, 0);
+	      if (count == 0)
 		{
-		  while (*cursor != '\n' && *cursor != 015
-			 && ++cursor != ceiling_addr)
-		    continue;
-		  if (cursor == ceiling_addr)
-		    break;
-		}
-	      else
-		{
-		  cursor = memchr (cursor, '\n', ceiling_addr - cursor);
-		  if (! cursor)
-		    break;
+		  start_byte += cursor - base;
+		  *byte_pos_ptr = start_byte;
+		  return orig_count;
 		}
+	      start_byte += ceiling_addr - base;
+	      continue;
+	    }
+
+	  do
+	    {
+	      while (*cursor != '\n' && *cursor != 015
+		     && ++cursor != ceiling_addr)
+		continue;
+	      if (cursor == ceiling_addr)
+		break;
 
 	      cursor++;
 
@@ -26587,22 +27340,31 @@ display_count_lines (ptrdiff_t start_byte,
 	  ceiling = max (limit_byte, ceiling);
 	  ceiling_addr = BYTE_POS_ADDR (ceiling);
 	  base = (cursor = BYTE_POS_ADDR (start_byte - 1) + 1);
-	  while (true)
+
+	  if (!selective_display)
 	    {
-	      if (selective_display)
-		{
-		  while (--cursor >= ceiling_addr
-			 && *cursor != '\n' && *cursor != 015)
-		    continue;
-		  if (cursor < ceiling_addr)
-		    break;
-		}
-	      else
+	      ptrdiff_t left = - count;
+
+	      cursor = skip_newlines_backward (ceiling_addr,
+					       base - ceiling_addr, &left, 0);
+	      count = - left;
+	      if (count == 0)
 		{
-		  cursor = memrchr (ceiling_addr, '\n', cursor - ceiling_addr);
-		  if (! cursor)
-		    break;
+		  start_byte += cursor - base + 1;
+		  *byte_pos_ptr = start_byte;
+		  return - orig_count - 1;
 		}
+	      start_byte += ceiling_addr - base;
+	      continue;
+	    }
+
+	  while (true)
+	    {
+	      while (--cursor >= ceiling_addr
+		     && *cursor != '\n' && *cursor != 015)
+		continue;
+	      if (cursor < ceiling_addr)
+		break;
 
 	      if (++count == 0)
 		{
@@ -34188,6 +34950,7 @@ be let-bound around code that needs to disable messages temporarily. */);
   staticpro (&message_dolog_marker3);
 
   defsubr (&Sset_buffer_redisplay);
+  defsubr (&Sredisplay_statistics);
 #ifdef GLYPH_DEBUG
   defsubr (&Sdump_frame_glyph_matrix);
   defsubr (&Sdump_glyph_matrix);
@@ -34769,6 +35532,21 @@ Note that the lower bound for automatic hscrolling specified by `scroll-left'
 and `scroll-right' overrides this variable's effect.  */);
   Vhscroll_step = make_fixnum (0);
 
+  DEFVAR_LISP ("long-line-threshold", Vlong_line_threshold,
+    doc: /* Line length above which redisplay stops looking at whole lines.
+When redisplay finds that the line with point, or the line where a
+window starts, is longer than this many characters, it turns on the
+long-line optimizations in that buffer; see `long-line-optimizations-p'.
+From then on, whenever redisplay or `vertical-motion' would move back
+to the start of a line, they move back no further than a few windows'
+worth of text and pretend that the line starts there.  Faces and
+display properties are still handled correctly within that text, but
+continuation lines may wrap at different places than they would if the
+whole line was displayed.
+
+If nil, never turn on the long-line optimizations.  */);
+  Vlong_line_threshold = make_fixnum (50000);
+
   DEFVAR_BOOL ("message-truncate-lines", message_truncate_lines,
     doc: /* If non-nil, messages are truncated instead of resizing the echo area.
 Bind this around calls to `message' to let it take effect.  */);
@@ -35077,6 +35855,16 @@ When nil, mouse-movement events will not be generated as long as the
 mouse stays within the extent of a single glyph (except for images).  */);
   mouse_fine_grained_tracking = false;
 
+  DEFVAR_BOOL ("redisplay-cache-glyph-rows", redisplay_cache_glyph_rows,
+    doc: /* Non-nil means redisplay reuses glyph rows it produced before.
+Redisplay then keeps the screen lines it produces from buffer text in a
+cache, and copies a line from the cache instead of producing it again
+when the same text is displayed at the same width with the same faces,
+for example after a window is scrolled back to where it was.  This
+variable is for debugging redisplay; there should be no reason to set it
+to nil.  */);
+  redisplay_cache_glyph_rows = true;
+
 }
 
 
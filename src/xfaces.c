@@ -365,6 +365,7 @@ static bool realize_default_face (struct frame *);
 static void realize_named_face (struct frame *, Lisp_Object, int);
 static struct face_cache *make_face_cache (struct frame *);
 static void free_face_cache (struct face_cache *);
+static void uncache_face (struct face_cache *, struct face *);
 static bool merge_face_ref (struct window *w,
                             struct frame *, Lisp_Object, Lisp_Object *,
                             bool, struct named_merge_point *,
@@ -1854,6 +1855,106 @@ resolve_face_name (Lisp_Object face_name, bool signal_p)
 }
 
 
+/* Each realized face records which named faces it was made from, so
+   that changing a named face frees only the realized faces that
+   depend on it, and leaves frames without such faces alone.  Every
+   lookup of a named face's definition adds the face to
+   looked_up_named_faces, and the realized face that a merge ends up
+   with takes them over.  Merges that start from the attributes of a
+   realized face add that face's named faces first.  Lookups that are
+   not followed by a merge, like those of the Lisp functions that make
+   faces or get and set their attributes, are forgotten when an
+   iterator is initialized, because no merge is in progress then.
+   Until then they only make the sets larger than needed.  */
+
+static bits_word looked_up_named_faces[NAMED_FACE_WORDS];
+
+/* Return the bit for the named face FACE_NAME in sets of named
+   faces.  */
+
+static int
+named_face_bit (Lisp_Object face_name)
+{
+  return ((EMACS_UINT) XHASH (face_name) / sizeof (struct Lisp_Symbol)
+	  % NAMED_FACE_BITS);
+}
+
+/* Add the named face FACE_NAME to the set SET.  */
+
+static void
+add_named_face (bits_word *set, Lisp_Object face_name)
+{
+  int bit = named_face_bit (face_name);
+  set[bit / BITS_PER_BITS_WORD] |= (bits_word) 1 << bit % BITS_PER_BITS_WORD;
+}
+
+/* Return true if the sets of named faces A and B intersect.  */
+
+static bool
+named_faces_intersect_p (bits_word const *a, bits_word const *b)
+{
+  for (int i = 0; i < NAMED_FACE_WORDS; i++)
+    if (a[i] & b[i])
+      return true;
+  return false;
+}
+
+/* Forget the named faces looked up since the last merge.  This must
+   not be called while a merge is in progress.  */
+
+void
+forget_looked_up_named_faces (void)
+{
+  memset (looked_up_named_faces, 0, sizeof looked_up_named_faces);
+}
+
+/* Note that the next merge starts from the attributes of the realized
+   face FACE, and so depends on the named faces FACE depends on.  */
+
+static void
+merge_from_face (struct face *face)
+{
+  for (int i = 0; i < NAMED_FACE_WORDS; i++)
+    looked_up_named_faces[i] |= face->named_faces[i];
+}
+
+/* Make the realized face FACE in face cache C, which a merge ended up
+   with, depend on the named faces looked up since the last merge.  */
+
+static void
+take_named_faces (struct face_cache *c, struct face *face)
+{
+  for (int i = 0; i < NAMED_FACE_WORDS; i++)
+    {
+      face->named_faces[i] |= looked_up_named_faces[i];
+      c->named_faces[i] |= looked_up_named_faces[i];
+      looked_up_named_faces[i] = 0;
+    }
+}
+
+/* Note that the definition of the named face FACE on frame F has
+   changed.  If realized faces of F depend on FACE, arrange for them
+   to be freed before the next redisplay of F.  */
+
+static void
+note_named_face_change (struct frame *f, Lisp_Object face)
+{
+  struct face_cache *c = FRAME_FACE_CACHE (f);
+
+  if (!c)
+    return;
+
+  bits_word changed[NAMED_FACE_WORDS] = { 0 };
+  add_named_face (changed, face);
+  if (named_faces_intersect_p (changed, c->named_faces))
+    {
+      add_named_face (c->changed_named_faces, face);
+      f->named_face_change = true;
+      fset_redisplay (f);
+    }
+}
+
+
 /* Return the face definition of FACE_NAME on frame F.  F null means
    return the definition for new frames.  FACE_NAME may be a string or
    a symbol (apparently Emacs 20.2 allowed strings as face names in
@@ -1866,6 +1967,8 @@ lface_from_face_name_no_resolve (struct frame *f, Lisp_Object face_name,
 {
   Lisp_Object lface;
 
+  add_named_face (looked_up_named_faces, face_name);
+
   if (f)
     lface = assq_no_quit (face_name, f->face_alist);
   else
@@ -2797,17 +2900,14 @@ Value is a vector of face attributes.  */)
     lface = global_lface;
 
   /* Changing a named face means that all realized faces depending on
-     that face are invalid.  Since we cannot tell which realized faces
-     depend on the face, make sure they are all removed.  This is done
-     by setting face_change.  The next call to init_iterator will then
-     free realized faces.  */
+     that face are invalid.  On a frame, note_named_face_change arranges
+     for the next call to init_iterator to free the realized faces that
+     depend on it.  Changing the definition for new frames sets
+     face_change, so that all realized faces are freed.  */
   if (NILP (Fget (face, Qface_no_inherit)))
     {
       if (f)
-	{
-	  f->face_change = true;
-	  fset_redisplay (f);
-	}
+	note_named_face_change (f, face);
       else
 	{
 	  face_change = true;
@@ -2887,17 +2987,14 @@ The value is TO.  */)
   vcopy (copy, 0, XVECTOR (lface)->contents, LFACE_VECTOR_SIZE);
 
   /* Changing a named face means that all realized faces depending on
-     that face are invalid.  Since we cannot tell which realized faces
-     depend on the face, make sure they are all removed.  This is done
-     by setting face_change.  The next call to init_iterator will then
-     free realized faces.  */
+     that face are invalid.  On a frame, note_named_face_change arranges
+     for the next call to init_iterator to free the realized faces that
+     depend on it.  Changing the definition for new frames sets
+     face_change, so that all realized faces are freed.  */
   if (NILP (Fget (to, Qface_no_inherit)))
     {
       if (f)
-	{
-	  f->face_change = true;
-	  fset_redisplay (f);
-	}
+	note_named_face_change (f, to);
       else
 	{
 	  face_change = true;
@@ -3413,17 +3510,14 @@ FRAME 0 means change the face on all frames, and change the default
     }
 
   /* Changing a named face means that all realized faces depending on
-     that face are invalid.  Since we cannot tell which realized faces
-     depend on the face, make sure they are all removed.  This is done
-     by setting face_change.  The next call to init_iterator will then
-     free realized faces.  */
+     that face are invalid.  note_named_face_change arranges for the
+     next call to init_iterator to free them.  */
   if (!EQ (frame, Qt)
       && NILP (Fget (face, Qface_no_inherit))
       && NILP (Fequal (old_value, value)))
-    {
-      f->face_change = true;
-      fset_redisplay (f);
-    }
+    note_named_face_change (f, face);
+  if (NILP (Fequal (old_value, value)))
+    forget_merged_faces ();
 
   if (!UNSPECIFIEDP (value) && !IGNORE_DEFFACE_P (value)
       && NILP (Fequal (old_value, value)))
@@ -4446,6 +4540,9 @@ make_face_cache (struct frame *f)
   c->size = 50;
   c->used = 0;
   c->faces_by_id = xmalloc (c->size * sizeof *c->faces_by_id);
+  c->merged_faces = NULL;
+  memset (c->named_faces, 0, sizeof c->named_faces);
+  memset (c->changed_named_faces, 0, sizeof c->changed_named_faces);
   c->f = f;
   c->menu_face_changed_p = menu_face_changed_default;
   return c;
@@ -4510,6 +4607,12 @@ free_realized_faces (struct face_cache *c)
       c->used = 0;
       size = FACE_CACHE_BUCKETS_SIZE * sizeof *c->buckets;
       memset (c->buckets, 0, size);
+      if (c->merged_faces)
+	memset (c->merged_faces, 0,
+		MERGED_FACES_SIZE * sizeof *c->merged_faces);
+      memset (c->named_faces, 0, sizeof c->named_faces);
+      memset (c->changed_named_faces, 0, sizeof c->changed_named_faces);
+      f->named_face_change = false;
 
       /* Must do a thorough redisplay the next time.  Mark current
 	 matrices as invalid because they will reference faces freed
@@ -4520,6 +4623,7 @@ free_realized_faces (struct face_cache *c)
 	  clear_current_matrices (f);
 	  fset_redisplay (f);
 	}
+      clear_glyph_row_cache (f, NULL);
 
       unblock_input ();
     }
@@ -4545,6 +4649,87 @@ free_all_realized_faces (Lisp_Object frame)
 }
 
 
+/* Free the realized faces on frame F that depend on named faces
+   whose definitions changed since faces were last freed.  If basic
+   faces depend on them, free all realized faces on F, like
+   free_realized_faces, because basic faces must keep their IDs.  */
+
+void
+free_changed_realized_faces (struct frame *f)
+{
+  struct face_cache *c = FRAME_FACE_CACHE (f);
+  int i, n;
+  int *ids;
+  USE_SAFE_ALLOCA;
+
+  f->named_face_change = false;
+  if (!c)
+    return;
+
+  for (i = 0; i < BASIC_FACE_ID_SENTINEL && i < c->used; i++)
+    if (c->faces_by_id[i]
+	&& named_faces_intersect_p (c->faces_by_id[i]->named_faces,
+				    c->changed_named_faces))
+      {
+	free_realized_faces (c);
+	return;
+      }
+
+  /* Non-ASCII faces depend on what their ASCII face depends on.  Find
+     all faces to free before freeing any, because non-ASCII faces
+     refer to their ASCII face.  */
+  SAFE_NALLOCA (ids, 1, c->used);
+  for (i = n = 0; i < c->used; i++)
+    {
+      struct face *face = c->faces_by_id[i];
+      if (face
+	  && named_faces_intersect_p (face->ascii_face->named_faces,
+				      c->changed_named_faces))
+	ids[n++] = i;
+    }
+  memset (c->changed_named_faces, 0, sizeof c->changed_named_faces);
+
+  if (n > 0)
+    {
+      /* We must block input here because we can't process X events
+	 safely while the frame's current matrix still references
+	 freed faces.  */
+      block_input ();
+
+      for (i = 0; i < n; i++)
+	{
+	  struct face *face = c->faces_by_id[ids[i]];
+	  uncache_face (c, face);
+	  free_realized_face (f, face);
+	}
+
+      /* The remaining faces may depend on fewer named faces.  */
+      memset (c->named_faces, 0, sizeof c->named_faces);
+      for (i = 0; i < c->used; i++)
+	if (c->faces_by_id[i])
+	  for (int j = 0; j < NAMED_FACE_WORDS; j++)
+	    c->named_faces[j] |= c->faces_by_id[i]->named_faces[j];
+
+      forget_escape_and_glyphless_faces ();
+      if (c->merged_faces)
+	memset (c->merged_faces, 0,
+		MERGED_FACES_SIZE * sizeof *c->merged_faces);
+
+      /* The current matrices reference the faces freed above.  */
+      if (WINDOWP (f->root_window))
+	{
+	  clear_current_matrices (f);
+	  fset_redisplay (f);
+	}
+      clear_glyph_row_cache (f, NULL);
+
+      unblock_input ();
+    }
+
+  SAFE_FREE ();
+}
+
+
 /* Free face cache C and faces in it, including their X resources.  */
 
 static void
@@ -4555,6 +4740,7 @@ free_face_cache (struct face_cache *c)
       free_realized_faces (c);
       xfree (c->buckets);
       xfree (c->faces_by_id);
+      xfree (c->merged_faces);
       xfree (c);
     }
 }
@@ -4690,6 +4876,8 @@ lookup_face (struct frame *f, Lisp_Object *attr)
   /* If not found, realize a new face.  */
   if (face == NULL)
     face = realize_face (cache, attr, -1);
+  else
+    take_named_faces (cache, face);
 
 #ifdef GLYPH_DEBUG
   eassert (face == FACE_FROM_ID_OR_NULL (f, face->id));
@@ -4761,6 +4949,7 @@ lookup_named_face (struct window *w, struct frame *f,
     return -1;
 
   memcpy (attrs, default_face->lface, sizeof attrs);
+  merge_from_face (default_face);
   merge_face_vectors (w, f, symbol_attrs, attrs, 0);
 
   return lookup_face (f, attrs);
@@ -4849,6 +5038,7 @@ smaller_face (struct frame *f, int face_id, int steps)
 
   face = FACE_FROM_ID (f, face_id);
   memcpy (attrs, face->lface, sizeof attrs);
+  merge_from_face (face);
   pt = last_pt = XFIXNAT (attrs[LFACE_HEIGHT_INDEX]);
   new_face_id = face_id;
   last_height = FONT_HEIGHT (face->font);
@@ -4900,6 +5090,7 @@ face_with_height (struct frame *f, int face_id, int height)
 
   face = FACE_FROM_ID (f, face_id);
   memcpy (attrs, face->lface, sizeof attrs);
+  merge_from_face (face);
   attrs[LFACE_HEIGHT_INDEX] = make_fixnum (height);
   font_clear_prop (attrs, FONT_SIZE_INDEX);
   face_id = lookup_face (f, attrs);
@@ -4930,6 +5121,7 @@ lookup_derived_face (struct window *w,
 
   default_face = FACE_FROM_ID (f, face_id);
   memcpy (attrs, default_face->lface, sizeof attrs);
+  merge_from_face (default_face);
   merge_face_vectors (w, f, symbol_attrs, attrs, 0);
   return lookup_face (f, attrs);
 }
@@ -5481,6 +5673,9 @@ realize_basic_faces (struct frame *f)
      event, for instance, without having the faces set up.  */
   block_input ();
 
+  /* The basic faces depend only on the named faces they are made
+     from.  */
+  forget_looked_up_named_faces ();
   if (realize_default_face (f))
     {
       realize_named_face (f, Qmode_line, MODE_LINE_FACE_ID);
@@ -5718,6 +5913,7 @@ realize_face (struct face_cache *cache, Lisp_Object attrs[LFACE_VECTOR_SIZE],
 
   /* Insert the new face.  */
   cache_face (cache, face, lface_hash (attrs));
+  take_named_faces (cache, face);
   return face;
 }
 
@@ -5747,6 +5943,8 @@ realize_non_ascii_face (struct frame *f, Lisp_Object font_object,
   face->colors_copied_bitwise_p = true;
   face->font = NILP (font_object) ? NULL : XFONT_OBJECT (font_object);
   face->gc = 0;
+  face->char_faces = NULL;
+  face->char_faces_nblocks = 0;
 
   cache_face (cache, face, face->hash);
 
@@ -6201,6 +6399,7 @@ compute_char_face (struct frame *f, int ch, Lisp_Object prop)
       Lisp_Object attrs[LFACE_VECTOR_SIZE];
       struct face *default_face = FACE_FROM_ID (f, DEFAULT_FACE_ID);
       memcpy (attrs, default_face->lface, sizeof attrs);
+      merge_from_face (default_face);
       merge_face_ref (NULL, f, prop, attrs, true, NULL, 0);
       face_id = lookup_face (f, attrs);
     }
@@ -6208,6 +6407,158 @@ compute_char_face (struct frame *f, int ch, Lisp_Object prop)
   return face_id;
 }
 
+/* Merging a face property into a realized face and looking up the
+   resulting face is done for every run of text with a `face'
+   property, and the same few properties are merged over and over.
+   The face cache of each frame therefore remembers the faces merges
+   gave in a small direct-mapped table of struct merged_face.  The
+   entries are valid for one generation: a new one is started for each
+   redisplay and each call from Lisp of a function that moves an
+   iterator, like `window-text-pixel-size', because
+   `face-remapping-alist' and the window parameters that face filters
+   test can be changed in place between them.  A new generation is
+   also started when a face attribute or `face-remapping-alist' is
+   set, and the table is cleared when the realized faces are freed.  */
+
+/* Longest list of faces in a face property whose merge is cached.  */
+
+enum { MERGED_FACE_MAX_LENGTH = 8 };
+
+/* The current generation of merged faces.  Never zero, so that
+   cleared entries are never valid.  */
+
+static unsigned merged_faces_generation = 1;
+
+/* Start a new generation of merged faces, forgetting the faces merges
+   gave before.  This is called before redisplaying windows and before
+   moving iterators for Lisp.  */
+
+void
+forget_merged_faces (void)
+{
+  if (++merged_faces_generation == 0)
+    merged_faces_generation = 1;
+}
+
+/* Watch changes to face-remapping-alist.  */
+static Lisp_Object
+watch_face_remapping_alist (Lisp_Object symbol, Lisp_Object newval,
+			    Lisp_Object operation, Lisp_Object where)
+{
+  forget_merged_faces ();
+  return Qnil;
+}
+
+/* If merging face property PROP can be cached, store its hash code in
+   *HASH and return true.  That's the case for face names, and short
+   lists of face names and keywords, which can be compared quickly.
+   Other properties can contain strings or other lists, which can be
+   modified in place without our noticing.  */
+
+static bool
+merged_face_hash (Lisp_Object prop, EMACS_UINT *hash)
+{
+  if (SYMBOLP (prop))
+    {
+      *hash = XHASH (prop);
+      return !NILP (prop);
+    }
+
+  EMACS_UINT h = 0;
+  int n = 0;
+  for (; CONSP (prop); prop = XCDR (prop))
+    {
+      if (!SYMBOLP (XCAR (prop)) || ++n > MERGED_FACE_MAX_LENGTH)
+	return false;
+      h = sxhash_combine (h, XHASH (XCAR (prop)));
+    }
+  *hash = h;
+  return n > 0 && NILP (prop);
+}
+
+/* Return true if face property PROP is the same as CACHED, a face
+   property stored in a struct merged_face.  PROP must be one for which
+   merged_face_hash returned true.  */
+
+static bool
+merged_face_prop_equal (Lisp_Object cached, Lisp_Object prop)
+{
+  if (!CONSP (prop))
+    return EQ (cached, prop);
+
+  for (; CONSP (prop); prop = XCDR (prop), cached = XCDR (cached))
+    if (!CONSP (cached) || !EQ (XCAR (cached), XCAR (prop)))
+      return false;
+  return NILP (cached);
+}
+
+/* Return the ID of the face that merging face property PROP into the
+   realized face BASE_FACE gives, for window W on frame F.  PROP may be
+   nil, to look up the face for ASCII characters of BASE_FACE.
+   ATTR_FILTER is passed to merge_face_ref.  */
+
+static int
+merge_face_prop (struct window *w, struct frame *f, Lisp_Object prop,
+		 struct face *base_face,
+		 enum lface_attribute_index attr_filter)
+{
+  struct face_cache *c = FRAME_FACE_CACHE (f);
+  struct merged_face *m = NULL;
+  Lisp_Object attrs[LFACE_VECTOR_SIZE];
+  EMACS_UINT hash;
+  int face_id;
+
+  /* Don't use the cache if faces are going to be freed, because the
+     faces it found could then be different from what merging gives.  */
+  if (!face_change && !f->face_change && !f->named_face_change
+      && merged_face_hash (prop, &hash))
+    {
+      hash = sxhash_combine (hash, base_face->id);
+      hash = sxhash_combine (hash, attr_filter);
+      hash = sxhash_combine (hash, XHASH (Vface_remapping_alist));
+      hash = sxhash_combine (hash, w->sequence_number);
+
+      if (!c->merged_faces)
+	c->merged_faces = xzalloc (MERGED_FACES_SIZE
+				   * sizeof *c->merged_faces);
+      m = &c->merged_faces[hash % MERGED_FACES_SIZE];
+
+      if (m->generation == merged_faces_generation
+	  && m->base_face_id == base_face->id
+	  && m->attr_filter == attr_filter
+	  && m->window == w->sequence_number
+	  && EQ (m->remapping, Vface_remapping_alist)
+	  && merged_face_prop_equal (m->prop, prop)
+	  && FACE_FROM_ID_OR_NULL (f, m->face_id))
+	{
+	  note_face_merge (w, true);
+	  return m->face_id;
+	}
+    }
+
+  memcpy (attrs, base_face->lface, sizeof attrs);
+  merge_from_face (base_face);
+  if (!NILP (prop))
+    merge_face_ref (w, f, prop, attrs, true, NULL, attr_filter);
+  face_id = lookup_face (f, attrs);
+  note_face_merge (w, false);
+
+  if (m)
+    {
+      /* Lists are copied, so that changing them in place doesn't
+	 change the key of the entry.  */
+      m->prop = CONSP (prop) ? Fcopy_sequence (prop) : prop;
+      m->remapping = Vface_remapping_alist;
+      m->window = w->sequence_number;
+      m->generation = merged_faces_generation;
+      m->base_face_id = base_face->id;
+      m->attr_filter = attr_filter;
+      m->face_id = face_id;
+    }
+
+  return face_id;
+}
+
 /* Return the face ID associated with buffer position POS for
    displaying ASCII characters.  Return in *ENDPTR the position at
    which a different face is needed, as far as text properties and
@@ -6295,16 +6646,19 @@ face_at_buffer_position (struct window *w, ptrdiff_t pos,
     default_face = FACE_FROM_ID (f, face_id);
   }
 
-  /* Optimize common cases where we can use the default face.  */
-  if (noverlays == 0
-      && NILP (prop))
+  /* Optimize common cases where we can use the default face, or
+     merge only a text property.  */
+  if (noverlays == 0)
     {
       SAFE_FREE ();
-      return default_face->id;
+      if (NILP (prop))
+	return default_face->id;
+      return merge_face_prop (w, f, prop, default_face, attr_filter);
     }
 
   /* Begin with attributes from the default face.  */
   memcpy (attrs, default_face->lface, sizeof(attrs));
+  merge_from_face (default_face);
 
   /* Merge in attributes specified via text properties.  */
   if (!NILP (prop))
@@ -6328,6 +6682,7 @@ face_at_buffer_position (struct window *w, ptrdiff_t pos,
 		 so discard the mouse-face text property, if any, and
 		 use the overlay property instead.  */
 	      memcpy (attrs, default_face->lface, sizeof attrs);
+	      merge_from_face (default_face);
 	      merge_face_ref (w, f, prop, attrs, true, NULL, attr_filter);
 	    }
 
@@ -6410,6 +6765,7 @@ face_for_overlay_string (struct window *w, ptrdiff_t pos,
   /* Begin with attributes from the default face.  */
   default_face = FACE_FROM_ID (f, lookup_basic_face (w, f, DEFAULT_FACE_ID));
   memcpy (attrs, default_face->lface, sizeof attrs);
+  merge_from_face (default_face);
 
   /* Merge in attributes specified via text properties.  */
   if (!NILP (prop))
@@ -6453,7 +6809,6 @@ face_at_string_position (struct window *w, Lisp_Object string,
 {
   Lisp_Object prop, position, end, limit;
   struct frame *f = XFRAME (WINDOW_FRAME (w));
-  Lisp_Object attrs[LFACE_VECTOR_SIZE];
   struct face *base_face;
   bool multibyte_p = STRING_MULTIBYTE (string);
   Lisp_Object prop_name = mouse_p ? Qmouse_face : Qface;
@@ -6488,16 +6843,10 @@ face_at_string_position (struct window *w, Lisp_Object string,
 	  || FACE_SUITABLE_FOR_ASCII_CHAR_P (base_face)))
     return base_face->id;
 
-  /* Begin with attributes from the base face.  */
-  memcpy (attrs, base_face->lface, sizeof attrs);
-
-  /* Merge in attributes specified via text properties.  */
-  if (!NILP (prop))
-    merge_face_ref (w, f, prop, attrs, true, NULL, attr_filter);
-
-  /* Look up a realized face with the given face attributes,
-     or realize a new one for ASCII characters.  */
-  return lookup_face (f, attrs);
+  /* Merge in attributes specified via text properties, and look up a
+     realized face with the resulting attributes, or realize a new one
+     for ASCII characters.  */
+  return merge_face_prop (w, f, prop, base_face, attr_filter);
 }
 
 
@@ -6540,6 +6889,7 @@ merge_faces (struct window *w, Lisp_Object face_name, int face_id,
 
   /* Begin with attributes from the base face.  */
   memcpy (attrs, base_face->lface, sizeof attrs);
+  merge_from_face (base_face);
 
   if (!NILP (face_name))
     {
@@ -6556,6 +6906,7 @@ merge_faces (struct window *w, Lisp_Object face_name, int face_id,
       if (!face)
 	return base_face_id;
 
+      merge_from_face (face);
       merge_face_vectors (w, f, face->lface, attrs, 0);
     }
 
@@ -7011,6 +7362,14 @@ changing this variable for it to take effect.  */);
   Vface_remapping_alist = Qnil;
   DEFSYM (Qface_remapping_alist,"face-remapping-alist");
 
+  static union Aligned_Lisp_Subr Swatch_face_remapping_alist =
+     {{{ PSEUDOVECTOR_FLAG | (PVEC_SUBR << PSEUDOVECTOR_AREA_BITS) },
+       { .a4 = watch_face_remapping_alist },
+       4, 4, "watch_face_remapping_alist", 0, 0}};
+  Lisp_Object watcher;
+  XSETSUBR (watcher, &Swatch_face_remapping_alist.s);
+  Fadd_variable_watcher (Qface_remapping_alist, watcher);
+
   DEFVAR_LISP ("face-font-rescale-alist", Vface_font_rescale_alist,
 	       doc: /* Alist of fonts vs the rescaling factors.
 Each element is a cons (FONT-PATTERN . RESCALE-RATIO), where
@@ -1265,6 +1265,68 @@ renaming only, rather than modified in-place."
       (ignore-errors (advice-remove #'write-region advice))
       (ignore-errors (delete-file temp-file-name)))))
 
+;; Visit a file in chunks of several lines, and check that each chunk
+;; is cut after a newline and that forward isearch reads on.
+(ert-deftest files-tests-lazy-visit ()
+  "Test visiting a file lazily, as per `large-file-lazy-threshold'."
+  (files-tests--with-temp-file temp-file-name
+    (let ((large-file-lazy-threshold 1000)
+          (large-file-lazy-chunk-size 400)
+          (coding-system-for-write 'utf-8-unix)
+          contents)
+      (with-temp-buffer
+        (dotimes (i 200)
+          (insert (format "%d %s\n" i (make-string (% i 30) ?ä))))
+        (setq contents (buffer-string))
+        (write-region nil nil temp-file-name nil 'nomessage))
+      (let ((buf (find-file-noselect temp-file-name)))
+        (unwind-protect
+            (with-current-buffer buf
+              (should (natnump buffer-file-lazy))
+              (should buffer-read-only)
+              (should (< (buffer-size) (length contents)))
+              (should (string-prefix-p (buffer-string) contents))
+              (should (eq (char-before (point-max)) ?\n))
+              (should (eq (coding-system-base buffer-file-coding-system)
+                          'utf-8))
+              ;; Searching forward reads on until the text is found.
+              (let ((isearch-forward t)
+                    (isearch-regexp nil))
+                (should (funcall (isearch-search-fun) "151 ä" nil t))
+                (should (looking-back "^151 ä" (line-beginning-position))))
+              (should buffer-file-lazy)
+              (find-file-lazy-load-rest)
+              (should-not buffer-file-lazy)
+              (should-not buffer-read-only)
+              (should-not (buffer-modified-p))
+              (should (equal (buffer-string) contents))
+              (should-not (memq #'files--lazy-load-for-window
+                                pre-redisplay-functions)))
+          (kill-buffer buf))))))
+
+;; A chunk without a newline must not end in the middle of a
+;; multibyte sequence.
+(ert-deftest files-tests-lazy-visit-long-line ()
+  "Test visiting lazily a file whose lines are longer than a chunk."
+  (files-tests--with-temp-file temp-file-name
+    (let ((large-file-lazy-threshold 1000)
+          (large-file-lazy-chunk-size 400)
+          (coding-system-for-write 'utf-8-unix)
+          (contents (concat "x" (make-string 1000 ?ä) "\n")))
+      (write-region contents nil temp-file-name nil 'nomessage)
+      (let ((buf (find-file-noselect temp-file-name)))
+        (unwind-protect
+            (with-current-buffer buf
+              (should (= buffer-file-lazy 399))
+              (should (equal (buffer-string) (substring contents 0 200)))
+              (should (memq #'files--lazy-load-for-window
+                            pre-redisplay-functions))
+              (find-file-lazy-load-rest)
+              (should (equal (buffer-string) contents)))
+          (kill-buffer buf))
+        (should-not (memq #'files--lazy-load-for-window
+                          pre-redisplay-functions))))))
+
 (ert-deftest files-test-file-size-human-readable ()
   (should (equal (file-size-human-readable 13) "13"))
   (should (equal (file-size-human-readable 13 'si) "13"))
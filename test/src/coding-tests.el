@@ -234,6 +234,54 @@
     (coding-tests-remove-files)))
 
 
+;;; Check that what `insert-file-contents' finds out about the text
+;;; while reading it agrees with what decoding finds out afterwards.
+
+(defun coding-tests-prescan-texts ()
+  "Return unibyte texts to check `insert-file-contents' with.
+Each has something of interest near the 16 KiB boundary where a
+block read by `insert-file-contents' ends."
+  (let ((line (lambda (n eol)
+                (apply #'concat
+                       (mapcar (lambda (_) (concat (make-string 39 ?a) eol))
+                               (number-sequence 1 n)))))
+        (at (lambda (text pos str)
+              (concat (substring text 0 pos) str (substring text pos)))))
+    (let ((lf (funcall line 1000 "\n"))
+          (crlf (funcall line 1000 "\r\n")))
+      (list lf crlf
+            (funcall at lf 16383 "\r")
+            (funcall at lf 16383 "\r\n")
+            (concat lf "\r")
+            (funcall at lf 20000 (encode-coding-string "é" 'utf-8))
+            (funcall at lf 16383 (encode-coding-string "é" 'utf-8))
+            (funcall at crlf 30000 "\xe9")
+            (funcall at lf 17000 "\0")
+            (funcall at lf 16380 (encode-coding-string "日本" 'iso-2022-jp))
+            (funcall at (funcall at lf 4000 (encode-coding-string "ü" 'utf-8))
+                     20000 "\r\n")))))
+
+(ert-deftest ert-test-coding-insert-file-contents-prescan ()
+  (let ((file (make-temp-file "coding-tests")))
+    (unwind-protect
+        (dolist (text (coding-tests-prescan-texts))
+          (let ((coding-system-for-write 'no-conversion))
+            (write-region text nil file nil 'nomessage))
+          (dolist (coding '(undecided utf-8 prefer-utf-8))
+            (let ((coding-system-for-read coding)
+                  decoded)
+              (setq decoded (decode-coding-string text coding))
+              (let ((expected (list decoded last-coding-system-used)))
+                (with-temp-buffer
+                  (insert-file-contents file)
+                  (should (equal (list (buffer-string)
+                                       last-coding-system-used)
+                                 expected))
+                  (should (= (car insert-file-contents-timing)
+                             (length text))))))))
+      (delete-file file))))
+
+
 ;;; Check the coding system `prefer-utf-8'.
 
 ;; Read FILE.  Check if the encoding was detected as DETECT.  If
@@ -281,6 +281,45 @@
   (should (equal (buffer-substring-no-properties (point-min) (point-max))
                  (concat (string (char-from-name "SMILE")) "1234"))))
 
+;; Lines that only one buffer has, and changes within lines, both
+;; before, between and after unchanged lines.
+(ert-deftest replace-buffer-contents-lines ()
+  (dolist (case '(("a\nb\nc\n" "a\nB\nc\n")
+                  ("a\nb\nc" "a\nb\nc\nd")
+                  ("a\nb\nc\n" "b\nc\n")
+                  ("one\ntwo\nthree\n" "one\nzwei\nthree\nfour\n")
+                  ("x\n\ny\n" "\n\nx\ny")
+                  ("äb\nc\n" "ab\nc\nä\n")))
+    (with-temp-buffer
+      (insert (cadr case))
+      (let ((source (current-buffer)))
+        (with-temp-buffer
+          (insert (car case))
+          (goto-char (point-max))
+          (let ((marker (copy-marker (point-min))))
+            (should (replace-buffer-contents source))
+            (should (equal (buffer-string) (cadr case)))
+            (should (= marker (point-min)))
+            (should (= (length replace-buffer-contents-timing) 4))))))))
+
+(ert-deftest replace-buffer-contents-keeps-markers ()
+  "Check that unchanged lines keep their markers."
+  (with-temp-buffer
+    (dotimes (i 2000)
+      (insert (format "line %d\n" i)))
+    (let ((source (current-buffer)))
+      (with-temp-buffer
+        (dotimes (i 2000)
+          (insert (format (if (zerop (% i 100)) "LINE %d\n" "line %d\n") i)))
+        (goto-char (point-min))
+        (search-forward "line 1550\n")
+        (let ((marker (point-marker)))
+          (should (replace-buffer-contents source 1))
+          (should (equal (buffer-string)
+                         (with-current-buffer source (buffer-string))))
+          (should (looking-at "line 1551$"))
+          (should (= marker (point))))))))
+
 (ert-deftest delete-region-undo-markers-1 ()
   "Make sure we don't end up with freed markers reachable from Lisp."
   ;; https://debbugs.gnu.org/cgi/bugreport.cgi?bug=30931#40
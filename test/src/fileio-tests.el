@@ -156,3 +156,67 @@ Also check that an encoding error can appear in a symlink."
     (write-region "hello\n" nil f nil 'silent)
     (should-error (insert-file-contents f) :type 'circular-list)
     (delete-file f)))
+
+(ert-deftest fileio-tests--write-region-async ()
+  "Test writing a visited file in the background."
+  (skip-unless (not (memq system-type '(windows-nt ms-dos))))
+  (let* ((f (make-temp-file "fileio"))
+         (write-region-async t)
+         (finished nil)
+         (write-region-async-functions
+          (list (lambda (file err) (push (list file err) finished))))
+         (text (mapconcat #'number-to-string (number-sequence 1 20000) "ä\n")))
+    (unwind-protect
+        (with-temp-buffer
+          (insert text)
+          (write-region nil nil f nil t)
+          (should-not (buffer-modified-p))
+          ;; Changes after the write started don't end up in the file.
+          (insert "more")
+          (write-region-async-wait f)
+          (while (not finished)
+            (accept-process-output nil 0.01))
+          (should (equal finished (list (list f nil))))
+          (should (verify-visited-file-modtime))
+          (should (buffer-modified-p))
+          (should (equal (with-temp-buffer
+                           (insert-file-contents f)
+                           (buffer-string))
+                         text)))
+      (delete-file f))))
+
+(ert-deftest fileio-tests--write-region-async-precious ()
+  "Test saving in the background with `file-precious-flag'."
+  (skip-unless (not (memq system-type '(windows-nt ms-dos))))
+  (let* ((f (make-temp-file "fileio"))
+         (write-region-async t)
+         (file-precious-flag t)
+         (text (make-string 5000000 ?x)))
+    (unwind-protect
+        (with-current-buffer (find-file-noselect f)
+          (insert text)
+          (save-buffer)
+          ;; The temporary file is renamed only once it is complete.
+          (should (= (file-attribute-size (file-attributes f))
+                     (length text)))
+          (set-buffer-modified-p nil)
+          (kill-buffer))
+      (delete-file f))))
+
+(ert-deftest fileio-tests--write-region-async-error ()
+  "Test a background write that fails."
+  (skip-unless (file-writable-p "/dev/full"))
+  (let* ((write-region-async t)
+         (finished nil)
+         (write-region-async-functions
+          (list (lambda (file err) (push (list file err) finished)))))
+    (with-temp-buffer
+      (insert "text")
+      (write-region nil nil "/dev/full" nil t)
+      (should-not (buffer-modified-p))
+      (write-region-async-wait "/dev/full")
+      (while (not finished)
+        (accept-process-output nil 0.01))
+      (should (equal (caar finished) "/dev/full"))
+      (should (eq (car (cadar finished)) 'file-error))
+      (should (buffer-modified-p)))))
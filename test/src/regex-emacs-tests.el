@@ -803,4 +803,309 @@ This evaluates the TESTS test cases from glibc."
   (should-not (string-match "å" "\xe5"))
   (should-not (string-match "[å]" "\xe5")))
 
+;; Patterns and subjects for comparing the lazy DFA with the
+;; backtracking matcher.
+(defconst regex-tests--dfa-patterns
+  '("a" "ab*c" "\\(a\\|b\\)*c" "\\(x+x+\\)+y" "^foo" "bar$" "^$"
+    "\\`a" "z\\'" "\\bfoo\\b" "\\Bo" "\\<\\w+\\>" "\\_<[a-z-]+\\_>"
+    "\\sw+\\s-*=" "[[:upper:]][[:lower:]]+" "[^ \n]+@[^ \n]+" "\\cg"
+    "[0-9]\\{2\\}" "\\(a\\)\\1" "a*?b" "\\(?:ab\\|a\\)c" "é+" "."
+    "[[:space:]]+" "\\s.\\|\\s(")
+  "Regexps used by `regex-tests-dfa-same-results'.")
+
+(defconst regex-tests--dfa-strings
+  '("" "a" "abbbc" "ababc" "xxxxxxxxxxxxy" "foo\nbar" "\n\n" "zaz"
+    "foo-bar baz_quux" "Hello, World" "x = y" "user@example.org"
+    "αβγ" "12345" "aac" "été" "(a) [b]" "foo\n bar \nbaz")
+  "Strings used by `regex-tests-dfa-same-results'.")
+
+(defun regex-tests--dfa-results (regexp string)
+  "Return what several search functions find for REGEXP in STRING."
+  (let ((case-fold-search nil))
+    (list
+     (and (string-match regexp string) (match-data))
+     (string-match-p regexp string)
+     (and (> (length string) 0)
+          (string-match regexp string 1)
+          (match-data))
+     (with-temp-buffer
+       (insert string)
+       (let (found)
+         (goto-char (point-min))
+         (while (and (not (eobp)) (re-search-forward regexp nil t))
+           (push (match-data) found)
+           (when (and (= (match-beginning 0) (match-end 0)) (not (eobp)))
+             (forward-char 1)))
+         (goto-char (point-max))
+         (push (and (re-search-backward regexp nil t) (match-data)) found)
+         (goto-char (point-min))
+         (push (looking-at regexp) found)
+         found)))))
+
+(ert-deftest regex-tests-dfa-same-results ()
+  "Check that `regexp-use-dfa' does not change what regexps match."
+  (dolist (regexp regex-tests--dfa-patterns)
+    (dolist (string regex-tests--dfa-strings)
+      (should (equal (list regexp string
+                           (let ((regexp-use-dfa t))
+                             (regex-tests--dfa-results regexp string)))
+                     (list regexp string
+                           (let ((regexp-use-dfa nil))
+                             (regex-tests--dfa-results regexp string))))))))
+
+(ert-deftest regex-tests-dfa-no-exponential-backtracking ()
+  "Check that the DFA rejects a pathological regexp quickly."
+  (let ((regexp-use-dfa t)
+        (string (make-string 40 ?x))
+        (start (float-time)))
+    (should-not (string-match "\\(x+x+\\)+y" string))
+    (with-temp-buffer
+      (insert string)
+      (goto-char (point-min))
+      (should-not (re-search-forward "\\(x+x+\\)+y" nil t)))
+    ;; The backtracking matcher needs hours for this.
+    (should (< (- (float-time) start) 10))))
+
+;; Searching used to run the automaton from every position it tried,
+;; which took time quadratic in the length of the text.
+(ert-deftest regex-tests-dfa-linear-search ()
+  "Check that the DFA finds where a match starts in linear time."
+  (let ((regexp-use-dfa t)
+        (start (float-time)))
+    (with-temp-buffer
+      (insert (make-string 200000 ?x))
+      (goto-char (point-min))
+      (should-not (re-search-forward "x[^y]*y" nil t))
+      (goto-char (point-max))
+      (should-not (re-search-backward "x[^y]*y" nil t))
+      (insert "y")
+      (goto-char (point-min))
+      (should (equal (re-search-forward "xy" nil t) (point-max)))
+      (should (equal (match-beginning 0) (- (point-max) 2)))
+      (goto-char (point-max))
+      (should (equal (re-search-backward "x[^y]*y" nil t) (- (point-max) 2))))
+    (should (< (- (float-time) start) 10))))
+
+(ert-deftest regex-tests-dfa-search-start ()
+  "Check that the DFA finds the same matches as backtracking alone."
+  (with-temp-buffer
+    (insert "éx\nxé yx\nééxxy\nxyé\nx\n")
+    (dolist (regexp '("x[^y\n]*y" "^é*x" "é?x+\\b" "y$" "\\<x" "é\\|y"))
+      (dolist (from (number-sequence (point-min) (point-max)))
+        (dolist (search '(re-search-forward re-search-backward))
+          (should
+           (equal (let ((regexp-use-dfa nil))
+                    (goto-char from)
+                    (and (funcall search regexp nil t) (match-data t)))
+                  (let ((regexp-use-dfa t))
+                    (goto-char from)
+                    (and (funcall search regexp nil t) (match-data t))))))))))
+
+;; The DFA hands the start of a match to the backtracking matcher,
+;; whose check of that start against the fastmap once translated
+;; unibyte characters twice.
+(ert-deftest regex-tests-dfa-case-fold-unibyte ()
+  "Check that the DFA finds case-folded matches in unibyte text."
+  (let ((case-fold-search t))
+    (dolist (use '(t nil))
+      (let ((regexp-use-dfa use))
+        (should (equal (string-match "\316" "\316a") 0))
+        (should (equal (string-match "[\316]" "b\316a") 1))
+        (with-temp-buffer
+          (set-buffer-multibyte nil)
+          (insert "ab\316c\316")
+          (goto-char (point-min))
+          (should (equal (re-search-forward "[\316]" nil t) 4))
+          (should (equal (re-search-backward "\316" nil t) 3))
+          (goto-char (point-max))
+          (should (equal (re-search-backward "[\316]" nil t) 5)))))
+    (dolist (regexp '("\316" "[\316]" "a\316" "[\300-\336]+" "\356"))
+      (dolist (string '("\316a" "b\316a" "a\356" "\300\336x"))
+        (should (equal (let ((regexp-use-dfa nil))
+                         (string-match regexp string))
+                       (let ((regexp-use-dfa t))
+                         (string-match regexp string))))))))
+
+(ert-deftest regex-tests-dfa-font-lock-benchmark ()
+  "Time searching for Emacs Lisp font-lock regexps with and without the DFA."
+  :tags '(:expensive-test)
+  (require 'find-func)
+  (require 'lisp-mode)
+  (let ((file (find-library-name "subr"))
+        (regexps (cons "\\(\\w+\\)\\s-*=\\s-*\\(\\w+\\)"
+                       (delq nil (mapcar (lambda (k)
+                                           (if (stringp k) k
+                                             (and (stringp (car-safe k))
+                                                  (car k))))
+                                         lisp-el-font-lock-keywords-2)))))
+    (with-temp-buffer
+      (insert-file-contents file)
+      (with-syntax-table emacs-lisp-mode-syntax-table
+        (let (counts)
+          (dolist (use '(nil t))
+            (let ((regexp-use-dfa use)
+                  (count 0))
+              (message "regexp-use-dfa %s: %s" use
+                       (benchmark-run 3
+                         (setq count 0)
+                         (dolist (regexp regexps)
+                           (goto-char (point-min))
+                           (while (re-search-forward regexp nil t)
+                             (setq count (1+ count))))))
+              (push count counts)))
+          (should (= (car counts) (cadr counts))))))))
+
+;; Patterns for comparing searches with and without the prefilter.
+(defconst regex-tests--prefilter-patterns
+  '("foo" "foo.*bar" "^\\s-*(defun \\(\\sw+\\)" "\\(?:xy\\|zy\\)w"
+    "\\_<bar\\_>" "b\\(ar\\)+" "a\\|b" "K\\(?:elvin\\)" "é+t" "o\n "
+    "[a-z]*az" "\\bba" "\\(?:\\)*zz" "x\\(?:\\)y" "ar$")
+  "Regexps used by `regex-tests-prefilter-same-results'.")
+
+(ert-deftest regex-tests-prefilter ()
+  "Check the literals that `regexp-prefilter' finds."
+  (with-temp-buffer
+    (let ((case-fold-search nil))
+      (should (equal (regexp-prefilter "foobar") '("foobar" . 0)))
+      (should (equal (regexp-prefilter "foo.*bar") '("foo" . 0)))
+      (should (equal (regexp-prefilter "foo.*quux") '("quux")))
+      (should (equal (regexp-prefilter "\\(?:xy\\|zy\\)w") '("w" . 2)))
+      (should (equal (regexp-prefilter "^\\s-*(defun \\(\\sw+\\)")
+                     '("(defun ")))
+      (should (equal (regexp-prefilter "\\bdef\\(un\\|var\\)\\b")
+                     '("def" . 0)))
+      (should (equal (regexp-prefilter "K\\(?:elvin\\)") '("Kelvin" . 0)))
+      (should-not (regexp-prefilter "a\\|b"))
+      (should-not (regexp-prefilter "[a-z]+"))
+      ;; Patterns with counted repetitions are not analyzed.
+      (should-not (regexp-prefilter "a\\{3\\}")))
+    (let ((case-fold-search t))
+      (should (equal (regexp-prefilter "K\\(?:elvin\\)") '("kelvin" . 0)))
+      ;; Sigma has more than one lower-case form.
+      (should-not (regexp-prefilter "σ")))))
+
+(ert-deftest regex-tests-prefilter-same-results ()
+  "Check that `regexp-use-prefilter' does not change what regexps match."
+  (dolist (regexp regex-tests--prefilter-patterns)
+    (dolist (string (append '("foo bar baz_quux\nfoo barbar zz ar"
+                              "Kelvin KELVIN kelvin\n été ét"
+                              "xyw zyw yw xzw  \n barar")
+                            regex-tests--dfa-strings))
+      (should (equal (list regexp string
+                           (let ((regexp-use-prefilter t))
+                             (regex-tests--dfa-results regexp string)))
+                     (list regexp string
+                           (let ((regexp-use-prefilter nil))
+                             (regex-tests--dfa-results regexp string))))))))
+
+(ert-deftest regex-tests-prefilter-benchmark ()
+  "Time failing regexp searches with and without the prefilter."
+  :tags '(:expensive-test)
+  (require 'find-func)
+  (with-temp-buffer
+    (insert-file-contents (find-library-name "subr"))
+    (dotimes (_ 3)
+      (insert-buffer-substring (current-buffer)))
+    (with-syntax-table emacs-lisp-mode-syntax-table
+      (dolist (regexp '("^\\s-*(defun \\(\\sw+\\)" "(frobnicate-[a-z]+"
+                        "\\_<no-such-symbol-here\\_>"))
+        (let (counts)
+          (dolist (use '(nil t))
+            (let ((regexp-use-prefilter use)
+                  (count 0))
+              (message "%S regexp-use-prefilter %s: %s" regexp use
+                       (benchmark-run 10
+                         (setq count 0)
+                         (goto-char (point-min))
+                         (while (re-search-forward regexp nil t)
+                           (setq count (1+ count)))))
+              (push count counts)))
+          (should (= (car counts) (cadr counts))))))))
+
+;; Memoizing failures in the backtracking matcher.
+
+(ert-deftest regex-tests-memoize-same-results ()
+  "Check that `regexp-memoize' does not change what regexps match."
+  (let ((regexp-use-dfa nil))
+    (dolist (regexp (append '("\\(a*\\)*b" "\\(?:a\\|ab\\)*c" "x*?y+?z")
+                            regex-tests--dfa-patterns))
+      (dolist (string regex-tests--dfa-strings)
+        (should (equal (list regexp string
+                             (let ((regexp-memoize 'always))
+                               (regex-tests--dfa-results regexp string)))
+                       (list regexp string
+                             (let ((regexp-memoize nil))
+                               (regex-tests--dfa-results regexp string)))))))))
+
+(ert-deftest regex-tests-memoize-no-exponential-backtracking ()
+  "Check that the backtracking matcher rejects a pathological regexp quickly."
+  (let ((regexp-use-dfa nil)
+        (string (make-string 40 ?x))
+        (start (float-time)))
+    (should-not (string-match "\\(x+x+\\)+y" string))
+    (should (< regexp-search-steps 100000))
+    (with-temp-buffer
+      (insert string)
+      (goto-char (point-min))
+      (should-not (re-search-forward "\\(x+x+\\)+y" nil t)))
+    (should (< (- (float-time) start) 10))
+    (let ((regexp-memoize 'always))
+      (should-not (string-match "\\(x+x+\\)+y" string))
+      (should (< regexp-search-steps 10000)))))
+
+(ert-deftest regex-tests-step-limit ()
+  "Check `regexp-step-limit' and `regexp-search-steps'."
+  (let ((regexp-use-dfa nil)
+        (regexp-memoize nil)
+        (string (make-string 24 ?x)))
+    (should (string-match "x+y*" string))
+    (should (< 0 regexp-search-steps 100))
+    (let ((regexp-step-limit 1000))
+      (should (string-match "x+y*" string))
+      (should (< 1000 (cadr (should-error
+                             (string-match "\\(x+x+\\)+y" string)
+                             :type 'regexp-step-limit-exceeded))))
+      (with-temp-buffer
+        (insert string)
+        (goto-char (point-min))
+        (should-error (re-search-forward "\\(x+x+\\)+y" nil t)
+                      :type 'regexp-step-limit-exceeded)))))
+
+(defun regex-tests--nested-search (nested)
+  "Search text whose `syntax-table' properties need propertizing.
+If NESTED, let the search propertize the text, by searching it with
+another regexp, as it goes; otherwise, propertize it beforehand.
+Return where the search ended relative to the end of the buffer, and
+the steps it took."
+  (with-temp-buffer
+    ;; The properties make the matcher look for property changes, and
+    ;; so propertize the text.
+    (dotimes (_ 2000)
+      (insert (propertize "foo" 'syntax-table '(2)) " bar baz qux quux\n"))
+    (insert "foo bar .\n")
+    (setq-local parse-sexp-lookup-properties t)
+    (let ((propertize (lambda (start end)
+                        (goto-char start)
+                        (while (re-search-forward "[ab]+" end t)
+                          (put-text-property (match-beginning 0) (point)
+                                             'syntax-table '(2))))))
+      (if nested
+          (setq-local syntax-propertize-function propertize)
+        (funcall propertize (point-min) (point-max))))
+    (goto-char (point-min))
+    (list (- (re-search-forward "\\(?:\\sw+ \\)+\\s." nil t) (point-max))
+          regexp-search-steps)))
+
+(ert-deftest regex-tests-memoize-nested-search ()
+  "Check a memoized search during which `syntax-propertize' searches."
+  (let ((regexp-use-dfa nil)
+        (regexp-memoize 'always))
+    ;; The first search with a regexp can take a step more, so make
+    ;; one before comparing.
+    (regex-tests--nested-search nil)
+    ;; The searches made while matching must not disturb what the
+    ;; matcher remembers, nor its count of steps.
+    (should (equal (regex-tests--nested-search t)
+                   (regex-tests--nested-search nil)))))
+
 ;;; regex-emacs-tests.el ends here
@@ -0,0 +1,317 @@
+;;; search-tests.el --- tests for search.c functions -*- lexical-binding: t -*-
+
+;; Copyright (C) 2020 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defun search-tests--insert-lines (lengths)
+  "Insert one line for each element of LENGTHS, of that many chars.
+Lines alternate between ASCII and multibyte text."
+  (let ((i 0))
+    (dolist (len lengths)
+      (insert (make-string len (if (zerop (% i 2)) ?x ?ä)) "\n")
+      (setq i (1+ i)))))
+
+(defun search-tests--line-starts ()
+  "Return the positions following each newline, found the slow way."
+  (let (starts)
+    (save-excursion
+      (goto-char (point-min))
+      (while (< (point) (point-max))
+        (when (eq (char-after) ?\n)
+          (push (1+ (point)) starts))
+        (forward-char 1)))
+    (nreverse starts)))
+
+(defun search-tests--check-newlines ()
+  "Check `forward-line' against a naive scan of the current buffer."
+  (let* ((starts (search-tests--line-starts))
+         (nlines (length starts)))
+    ;; Count everything in one go, in both directions.
+    (goto-char (point-min))
+    (should (= (forward-line (* 2 nlines)) (- (* 2 nlines) nlines)))
+    (goto-char (point-max))
+    (should (= (forward-line (- (* 2 nlines)))
+               (- (- (* 2 nlines)) (- nlines))))
+    (should (= (count-lines (point-min) (point-max)) nlines))
+    ;; Land on each line start from the beginning and from the end.
+    (let ((n 1))
+      (dolist (pos starts)
+        (goto-char (point-min))
+        (forward-line n)
+        (should (= (point) pos))
+        (setq n (1+ n))))
+    (let ((n 1))
+      (dolist (pos (cdr (reverse (cons (point-min) starts))))
+        (goto-char (point-max))
+        (forward-line (- n))
+        (should (= (point) pos))
+        (setq n (1+ n))))))
+
+(ert-deftest search-tests-find-newline ()
+  "Test `forward-line' over short and long lines, with and without cache."
+  (let ((lengths '(0 1 15 16 17 31 32 33 0 0 63 64 65 2000 3 5000 0 7
+                  100 1023 1024 1025 4 0)))
+    (dolist (cache '(nil t))
+      (with-temp-buffer
+        (setq cache-long-scans cache)
+        (search-tests--insert-lines lengths)
+        (search-tests--check-newlines)
+        ;; Again, with the gap in the middle of the text.
+        (goto-char (/ (point-max) 2))
+        (insert "y")
+        (delete-char -1)
+        (search-tests--check-newlines)
+        (when cache
+          (let ((check (newline-cache-check)))
+            (should (equal (aref check 0) (aref check 1)))))))))
+
+(ert-deftest search-tests-find-newline-benchmark ()
+  "Time `forward-line', `count-lines' and `line-number-at-pos'."
+  :tags '(:expensive-test)
+  (dolist (cache '(nil t))
+    (with-temp-buffer
+      (setq cache-long-scans cache)
+      (dotimes (i 1000000)
+        (insert (make-string (% i 80) ?x) "\n"))
+      (goto-char (/ (point-max) 2))
+      (insert "y")
+      (let ((nlines (count-lines (point-min) (point-max))))
+        (message "cache-long-scans %s, forward-line: %s" cache
+                 (benchmark-run 10
+                   (goto-char (point-min))
+                   (forward-line nlines)))
+        (message "cache-long-scans %s, forward-line -N: %s" cache
+                 (benchmark-run 10
+                   (goto-char (point-max))
+                   (forward-line (- nlines))))
+        (message "cache-long-scans %s, count-lines: %s" cache
+                 (benchmark-run 10
+                   (count-lines (point-min) (point-max))))
+        (message "cache-long-scans %s, line-number-at-pos: %s" cache
+                 (benchmark-run 10
+                   (line-number-at-pos (point-max))))
+        (should (= (count-lines (point-min) (point-max)) nlines))))))
+
+;; A straightforward implementation of `search-forward' and
+;; `search-backward'.
+(defun search-tests--search-literal (string bound count)
+  (let ((len (length string))
+        (pat (generate-new-buffer " *pattern*"))
+        (buf (current-buffer))
+        (pos (point))
+        (found nil))
+    (with-current-buffer pat
+      (set-buffer-multibyte (buffer-local-value 'enable-multibyte-characters
+                                                buf))
+      (insert string))
+    (while (and (/= count 0) (not found)
+                (if (> count 0) (<= (+ pos len) bound) (>= (- pos len) bound)))
+      (let ((beg (if (> count 0) pos (- pos len))))
+        (if (eq 0 (compare-buffer-substrings nil beg (+ beg len)
+                                             pat 1 (1+ len)))
+            (progn
+              (setq pos (if (> count 0) (+ pos len) (- pos len)))
+              (setq count (if (> count 0) (1- count) (1+ count)))
+              (when (= count 0)
+                (setq found (list beg (+ beg len)))))
+          (setq pos (if (> count 0) (1+ pos) (1- pos))))))
+    (kill-buffer pat)
+    (when found
+      (goto-char pos)
+      found)))
+
+(ert-deftest search-tests-search-literal ()
+  "Test `search-forward' and `search-backward' against a naive search."
+  (let ((patterns '("a" "q" "ab" "Ab" "ä" "Ä" "xÄa" "σ" "Σ" "ς"
+                    "abcabd" "ABCABD" "bd\ne" "\n" "€" "k€A"
+                    "the quick brown fox" "THE QUICK BROWN FOX!"
+                    "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz"))
+        (text (concat "xäa abcabcabd ABCABd\ne Σσς\n€€ k€a "
+                      (make-string 40 ?a) " xÄA the quick brown fox! "
+                      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                      (string #x3fff80 #x3fffe4))))
+    (dolist (multibyte '(t nil))
+      (dolist (gap '(1 10 20 30 55 80 0.5))
+        (with-temp-buffer
+          (set-buffer-multibyte multibyte)
+          (insert text text)
+          (goto-char (if (floatp gap) (/ (point-max) 2) gap))
+          (insert "y")
+          (delete-char -1)
+          (dolist (case-fold-search '(nil t))
+            (dolist (pattern patterns)
+              (dolist (count '(1 2 -1 -2))
+                (dolist (start (list (point-min) 5 (point-max)))
+                  (dolist (bound (list (point-min) 50 (point-max)))
+                    ;; In unibyte buffers, `search-forward' folds the
+                    ;; case of bytes as if they were Latin-1 characters
+                    ;; and `compare-buffer-substrings' does not.
+                    (when (and (if (> count 0) (<= start bound)
+                                 (>= start bound))
+                               (or multibyte (not case-fold-search)
+                                   (string-match-p "\\`[[:ascii:]]*\\'"
+                                                   pattern)))
+                      (let ((expected
+                             (progn (goto-char start)
+                                    (list (search-tests--search-literal
+                                           pattern bound count)
+                                          (point))))
+                            (actual
+                             (progn (goto-char start)
+                                    (list (and (search-forward
+                                                pattern bound t count)
+                                               (list (match-beginning 0)
+                                                     (match-end 0)))
+                                          (point)))))
+                        (should (equal (list pattern count start bound
+                                             actual)
+                                       (list pattern count start bound
+                                             expected)))))))))))))))
+
+(ert-deftest search-tests-search-literal-benchmark ()
+  "Time `search-forward' for patterns of different lengths."
+  :tags '(:expensive-test)
+  (with-temp-buffer
+    (let ((words ["the" "of" "defun" "buffer" "point" "Überprüfung"
+                  "(let" "window" "Emacs" "string" "nil" "é" "–"])
+          (seed 1))
+      (dotimes (_ 2000000)
+        (setq seed (% (+ (* seed 1103515245) 12345) 2147483648))
+        (insert (aref words (% (/ seed 65536) (length words)))
+                (if (zerop (% seed 7)) "
+" " "))))
+    (dolist (pattern '("e" "zq" "Emacs" "buffer point" "überprüfung"
+                       "window string nil the"
+                       "the of defun buffer point window emacs string"
+                       "not to be found in this text, at all"))
+      (dolist (case-fold-search '(nil t))
+        (let ((matches 0))
+          (message "%S, case-fold %s: %s" pattern case-fold-search
+                   (benchmark-run 1
+                     (goto-char (point-min))
+                     (while (search-forward pattern nil t)
+                       (setq matches (1+ matches)))))
+          (message "  %d matches" matches))))))
+
+(ert-deftest search-tests-regexp-cache ()
+  "Test the cache of compiled regexps and its statistics."
+  (let ((regexp-cache-size 4)
+        (string (concat (make-string 10 ?x) "y")))
+    (regexp-cache-statistics t)
+    (dotimes (i 10)
+      (should (eql (string-match (format "x\\{%d\\}y" (1+ i)) string)
+                   (- 9 i))))
+    (let ((stats (regexp-cache-statistics t)))
+      (should (>= (nth 1 stats) 10))
+      (should (>= (nth 2 stats) 0.0))
+      (should (<= (nth 3 stats) 4)))
+    ;; The same regexp is compiled once and then found in the cache.
+    (dotimes (_ 5)
+      (should (string-match "foo\\(bar\\)?" "foobar")))
+    (let ((stats (regexp-cache-statistics)))
+      (should (<= (nth 1 stats) 1))
+      (should (>= (nth 0 stats) 4)))
+    ;; Regexps that displace each other still match correctly.
+    (let ((regexp-cache-size 1))
+      (dotimes (_ 3)
+        (should (eql (string-match "b+" "aabbb") 2))
+        (should (equal (match-data) '(2 5)))
+        (should (eql (string-match "a\\(b\\)" "aabbb") 1))
+        (should (equal (match-data) '(1 3 2 3)))))))
+
+;; A straightforward implementation of `re-search-forward-set'.
+(defun search-tests--search-set (regexps bound)
+  (let (best best-data best-index (i 0))
+    (dolist (regexp regexps)
+      (save-excursion
+        (when (and (re-search-forward regexp bound t)
+                   (or (null best) (< (match-beginning 0) best)))
+          (setq best (match-beginning 0)
+                best-data (match-data)
+                best-index i)))
+      (setq i (1+ i)))
+    (when best
+      (set-match-data best-data)
+      (goto-char (match-end 0))
+      best-index)))
+
+(defun search-tests--all-set-matches (search)
+  "Return all the matches that SEARCH finds from the start of the buffer."
+  (let (matches index done)
+    (goto-char (point-min))
+    (while (and (not done) (setq index (funcall search)))
+      (push (list index (point) (match-data)) matches)
+      (when (= (match-beginning 0) (match-end 0))
+        (if (eobp)
+            (setq done t)
+          (forward-char 1))))
+    (nreverse matches)))
+
+(ert-deftest search-tests-regexp-set ()
+  "Test `re-search-forward-set' against separate searches."
+  (let* ((regexps '("defun" "def\\(var\\|const\\)" "(\\(let\\*?\\)\\_>"
+                    "[0-9]+" "\\<\\(?:if\\|when\\)\\>" "^;+" "Ärger"
+                    "\\(?:foo\\)?bar" "\"[^\"]*\"" "x*$" "le"))
+         (set (make-regexp-set regexps))
+         (texts '("(defun f (x) (let* ((y 1)) (when x \"str\" 42)))\n"
+                  ";; comment\n(defvar foo-bar 10) (defconst z 2)\n"
+                  "Ärger ärger bar foobar IF when if\n\nxxx\n"
+                  "")))
+    (should (regexp-set-p set))
+    (should-not (regexp-set-p regexps))
+    (should (equal (regexp-set-regexps set) regexps))
+    (dolist (case-fold-search '(nil t))
+      (dolist (text texts)
+        (with-temp-buffer
+          (insert text text)
+          ;; Move the gap into the middle of the text.
+          (goto-char (/ (point-max) 2))
+          (insert "q")
+          (delete-char -1)
+          (should (equal (search-tests--all-set-matches
+                          (lambda () (re-search-forward-set set nil t)))
+                         (search-tests--all-set-matches
+                          (lambda ()
+                            (search-tests--search-set regexps nil))))))))))
+
+(ert-deftest search-tests-regexp-set-errors ()
+  "Test the error handling of regexp sets."
+  (should-error (make-regexp-set '("a" "\\(")) :type 'invalid-regexp)
+  (should-error (make-regexp-set '("a" 1)) :type 'wrong-type-argument)
+  (should-error (re-search-forward-set '("a")) :type 'wrong-type-argument)
+  (let ((set (make-regexp-set ["b+" "a"])))
+    (with-temp-buffer
+      (insert "xxaxbbb")
+      (goto-char (point-min))
+      (should (eql (re-search-forward-set set) 1))
+      (should (= (point) 4))
+      (should (eql (re-search-forward-set set) 0))
+      (should (equal (list (match-beginning 0) (match-end 0)) '(5 8)))
+      (should-error (re-search-forward-set set) :type 'search-failed)
+      (goto-char (point-min))
+      (should-not (re-search-forward-set set 3 t))
+      (should (= (point) (point-min)))
+      (should-not (re-search-forward-set set 3 'move))
+      (should (= (point) 3))
+      (should-error (re-search-forward-set set 1)))))
+
+(provide 'search-tests)
+;;; search-tests.el ends here
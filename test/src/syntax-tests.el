@@ -82,4 +82,153 @@ also has open paren syntax (see Bug#24870)."
       (should (equal (parse-partial-sexp pointC pointX nil nil ppsC)
                      ppsX)))))
 
+;; Elements 2 and 6 of the states that `syntax-ppss' returns are not
+;; meaningful.
+(defun syntax-tests--ppss-mismatches ()
+  "Return the positions where `syntax-ppss' and `parse-partial-sexp' differ."
+  (let ((mismatches nil))
+    (dolist (pos (number-sequence (point-min) (point-max) 37))
+      (let ((cached (syntax-ppss pos))
+            (parsed (parse-partial-sexp (point-min) pos)))
+        (dolist (n '(0 1 3 4 5 7 8 9))
+          (unless (equal (nth n cached) (nth n parsed))
+            (push pos mismatches)))))
+    (delete-dups mismatches)))
+
+(defmacro syntax-tests--with-lisp-buffer (&rest body)
+  "Evaluate BODY in a buffer of Lisp text several pages long."
+  (declare (indent 0) (debug t))
+  `(with-temp-buffer
+     (emacs-lisp-mode)
+     (dotimes (i 300)
+       (insert (format "(defun f%d () \"doc (%d\" ; x\n  '(a \"b\"))\n" i i)))
+     ,@body))
+
+(ert-deftest syntax-ppss-native-cache-inhibited-hooks ()
+  "The native cache sees edits made without running change hooks."
+  (syntax-tests--with-lisp-buffer
+    (should syntax-ppss-use-native-cache)
+    (syntax-ppss (point-max))
+    (let ((inhibit-modification-hooks t))
+      (goto-char 100)
+      (insert "\"(((")
+      (goto-char 6000)
+      (delete-char 3))
+    (should-not (syntax-tests--ppss-mismatches))))
+
+(ert-deftest syntax-ppss-native-cache-narrowing ()
+  "The native cache follows the accessible portion of the buffer."
+  (syntax-tests--with-lisp-buffer
+    (syntax-ppss (point-max))
+    (narrow-to-region 5000 (point-max))
+    (should-not (syntax-tests--ppss-mismatches))
+    (widen)
+    (should-not (syntax-tests--ppss-mismatches))))
+
+(ert-deftest syntax-ppss-native-cache-wide-and-narrow ()
+  "The states of the whole buffer and of a narrowing are kept apart."
+  (syntax-tests--with-lisp-buffer
+    (syntax-ppss (point-max))
+    (dolist (beg '(5000 7000 5000))
+      (save-restriction
+        (narrow-to-region beg (point-max))
+        (should-not (syntax-tests--ppss-mismatches))
+        ;; An edit while narrowed must reach the wide states too.
+        (let ((inhibit-modification-hooks t))
+          (goto-char (+ beg 10))
+          (insert "\"(")))
+      (should-not (syntax-tests--ppss-mismatches))
+      (let ((inhibit-modification-hooks t))
+        (goto-char 300)
+        (insert "("))
+      (save-restriction
+        (narrow-to-region beg (point-max))
+        (should-not (syntax-tests--ppss-mismatches))))))
+
+(ert-deftest syntax-ppss-native-cache-syntax-changes ()
+  "The native cache is flushed when syntax tables or properties change."
+  (syntax-tests--with-lisp-buffer
+    (set-syntax-table (make-syntax-table (syntax-table)))
+    (syntax-ppss (point-max))
+    (modify-syntax-entry ?\" "." (syntax-table))
+    (should-not (syntax-tests--ppss-mismatches))
+    (let ((inhibit-modification-hooks t))
+      (put-text-property 200 201 'syntax-table (string-to-syntax "\"")))
+    (setq-local parse-sexp-lookup-properties t)
+    (should-not (syntax-tests--ppss-mismatches))))
+
+(ert-deftest syntax-cache-properties ()
+  "Scanning gives the same results whether properties are cached or not."
+  (with-temp-buffer
+    (dotimes (i 200)
+      (insert (format "(a%d /b c/ \"d\" e) ; f\n" i)))
+    (setq-local parse-sexp-lookup-properties t)
+    (let ((slash (string-to-syntax "\""))
+          (scan (lambda ()
+                  (mapcar (lambda (pos)
+                            (list (ignore-errors (scan-lists pos 1 0))
+                                  (ignore-errors (scan-lists pos -1 1))
+                                  (nth 3 (parse-partial-sexp (point-min) pos))))
+                          (number-sequence (point-min) (point-max) 7)))))
+      (goto-char (point-min))
+      (while (search-forward "/" nil t)
+        (put-text-property (1- (point)) (point) 'syntax-table slash))
+      (should (equal (funcall scan)
+                     (let ((parse-sexp-cache-properties nil))
+                       (funcall scan))))
+      ;; Change the text and the properties behind the cache's back.
+      (let ((inhibit-modification-hooks t))
+        (goto-char 1000)
+        (insert "/(/")
+        (put-text-property 1000 1001 'syntax-table slash)
+        (remove-text-properties 2000 3000 '(syntax-table nil))
+        (put-text-property 3500 3501 'face 'bold))
+      (should (equal (funcall scan)
+                     (let ((parse-sexp-cache-properties nil))
+                       (funcall scan)))))))
+
+(ert-deftest syntax-propertize-done-after-changes ()
+  "Changes move `syntax-propertize--done' back even without hooks."
+  (with-temp-buffer
+    (setq-local syntax-propertize-function #'ignore)
+    (dotimes (_ 100)
+      (insert "abc\n"))
+    (syntax-propertize (point-max))
+    (should (= syntax-propertize--done (point-max)))
+    (let ((inhibit-modification-hooks t))
+      (goto-char 50)
+      (insert "x"))
+    (should (= syntax-propertize--done 50))
+    (syntax-propertize (point-max))
+    (let ((base (current-buffer))
+          (indirect (make-indirect-buffer (current-buffer) " *indirect*")))
+      (unwind-protect
+          (with-current-buffer indirect
+            (goto-char 70)
+            (delete-char 1)
+            (should (= (buffer-local-value 'syntax-propertize--done base)
+                       70)))
+        (kill-buffer indirect)))))
+
+(ert-deftest syntax-propertize-interrupted ()
+  "A throw out of `syntax-propertize' keeps the chunks done so far."
+  (with-temp-buffer
+    (dotimes (_ 1000)
+      (insert "abc\n"))
+    (let* ((syntax-propertize-max-chunk-size 1000)
+           (chunks nil)
+           (syntax-propertize-function
+            (lambda (start end)
+              (push (cons start end) chunks)
+              (when (= (length chunks) 3)
+                (throw 'stop nil)))))
+      (catch 'stop
+        (syntax-propertize (point-max)))
+      (should (= (length chunks) 3))
+      ;; The third chunk was not finished.
+      (should (= syntax-propertize--done (car (car chunks))))
+      (should (= syntax-propertize--done (cdr (cadr chunks))))
+      (syntax-propertize (point-max))
+      (should (= syntax-propertize--done (point-max))))))
+
 ;;; syntax-tests.el ends here
@@ -68,5 +68,58 @@
     (should (and (equal-including-properties (pop stack) string)
 		 (null stack)))))
 
+;; Apply RUNS one at a time with `add-text-properties'.
+(defun textprop-tests--add-runs-slowly (runs &optional object)
+  (let (changed)
+    (dolist (run (append runs nil) changed)
+      (when (apply #'add-text-properties (append run (list object)))
+        (setq changed t)))))
+
+(ert-deftest textprop-tests-add-text-property-runs ()
+  "Test that `add-text-property-runs' matches `add-text-properties'."
+  (let ((runs (vector '(1 3 (face bold))
+                      '(3 3 (face italic))
+                      '(4 9 (face italic x 1))
+                      '(9 10 nil)
+                      '(12 20 (face bold))
+                      '(20 21 (y 2)))))
+    (with-temp-buffer
+      (insert "foo bar baz quux spam eggs")
+      (put-text-property 2 14 'face 'underline)
+      (put-text-property 6 7 'x 1)
+      (let ((expected (let ((text (buffer-string)))
+                        (with-temp-buffer
+                          (insert text)
+                          (textprop-tests--add-runs-slowly runs)
+                          (buffer-string))))
+            changes)
+        (add-hook 'after-change-functions
+                  (lambda (beg end _len) (push (cons beg end) changes))
+                  nil t)
+        (should (eq (add-text-property-runs runs) t))
+        (should (equal-including-properties (buffer-string) expected))
+        ;; One notification for the whole region.
+        (should (equal changes '((1 . 21))))
+        ;; Nothing changes the second time around.
+        (setq changes nil)
+        (should-not (add-text-property-runs runs))
+        (should-not changes)))
+    ;; Strings too.
+    (let ((string (copy-sequence "abcdefghijklmnopqrstuvwxyz"))
+          (expected (copy-sequence "abcdefghijklmnopqrstuvwxyz")))
+      (textprop-tests--add-runs-slowly
+       (vector '(0 2 (face bold)) '(5 6 (face bold))) expected)
+      (should (add-text-property-runs
+               (vector '(0 2 (face bold)) '(5 6 (face bold))) string))
+      (should (equal-including-properties string expected)))
+    ;; Unsorted or overlapping runs are rejected.
+    (with-temp-buffer
+      (insert "foo bar")
+      (should-error (add-text-property-runs
+                     (vector '(3 5 (face bold)) '(1 2 (face bold)))))
+      (should-error (add-text-property-runs
+                     (vector '(1 5 (face bold)) '(4 6 (face bold)))))
+      (should (equal-including-properties (buffer-string) "foo bar")))))
+
 (provide 'textprop-tests)
 ;; textprop-tests.el ends here.
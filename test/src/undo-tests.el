@@ -466,5 +466,87 @@ Demonstrates bug 25599."
     (undo-boundary)
     (undo)))
 
+(defun undo-test--edits ()
+  "Make a series of undoable changes in a fresh buffer.
+Return the buffer's text and undo list afterwards."
+  (with-temp-buffer
+    (buffer-enable-undo)
+    (let ((marker (make-marker)))
+      (insert "hello")
+      (insert " world")
+      (undo-boundary)
+      (insert (propertize " with props" 'face 'bold))
+      (undo-boundary)
+      (goto-char 3)
+      (insert "äö")
+      (delete-char 2)
+      (undo-boundary)
+      (set-marker marker 8)
+      (delete-region 6 10)
+      (undo-boundary)
+      (goto-char (point-max))
+      (delete-char -4)
+      (subst-char-in-region (point-min) (point-max) ?o ?0)
+      (undo-boundary)
+      (upcase-region 1 4)
+      (goto-char 1)
+      (when (re-search-forward "w0r" nil t)
+        (replace-match "W0R"))
+      (undo-boundary)
+      (put-text-property 1 3 'face 'italic)
+      (undo-boundary)
+      (goto-char 2)
+      (dotimes (_ 3) (delete-char 1))
+      (garbage-collect)
+      (list (buffer-string) buffer-undo-list))))
+
+(ert-deftest undo-test-compact-log ()
+  "Test that `undo-compact-log' doesn't change `buffer-undo-list'."
+  (let ((undo-compact-log nil))
+    (should (equal (undo-test--edits)
+                   (let ((undo-compact-log t))
+                     (undo-test--edits))))))
+
+(ert-deftest undo-test-compact-log-undo ()
+  "Test undoing changes recorded in the compact undo log."
+  (let ((undo-compact-log t))
+    (with-temp-buffer
+      (buffer-enable-undo)
+      (insert "foo bar baz")
+      (undo-boundary)
+      (goto-char 5)
+      (delete-char 4)
+      (insert "quux ")
+      (undo-boundary)
+      (should (equal (buffer-string) "foo quux baz"))
+      (let ((last-command nil))
+        (undo))
+      (should (equal (buffer-string) "foo bar baz"))
+      (let ((last-command 'undo))
+        (undo))
+      (should (equal (buffer-string) "")))))
+
+(ert-deftest undo-test-compact-log-truncate ()
+  "Test that garbage collection truncates the compact undo log."
+  (let ((undo-compact-log t)
+        (undo-limit 2000)
+        (undo-strong-limit 3000)
+        groups)
+    (with-temp-buffer
+      (buffer-enable-undo)
+      (dotimes (_ 100)
+        (insert (make-string 40 ?a))
+        (delete-region (- (point) 20) (point))
+        (undo-boundary))
+      (garbage-collect)
+      (setq groups (- (length buffer-undo-list)
+                      (length (remq nil buffer-undo-list))))
+      (should (< 0 groups 100))
+      ;; Undoing the changes that were kept leaves those that weren't.
+      (let ((list buffer-undo-list))
+        (while list
+          (setq list (primitive-undo 1 list))))
+      (should (= (buffer-size) (* 20 (- 100 groups)))))))
+
 (provide 'undo-tests)
 ;;; undo-tests.el ends here
@@ -0,0 +1,231 @@
+;;; xdisp-tests.el --- tests for xdisp.c functions  -*- lexical-binding: t -*-
+
+;; Copyright (C) 2020 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defmacro xdisp-tests--in-window (&rest body)
+  "Evaluate BODY in the selected window, showing a buffer of short lines."
+  (declare (indent 0) (debug t))
+  `(save-window-excursion
+     (with-temp-buffer
+       (switch-to-buffer (current-buffer))
+       (delete-other-windows)
+       (dotimes (i 500)
+         (insert (format "abc %d\n" i)))
+       (goto-char (point-min))
+       (redisplay t)
+       ,@body)))
+
+(defun xdisp-tests--scroll-away-and-back ()
+  "Redisplay the selected window at the end of its buffer and back.
+Return the number of rows that the second redisplay took from the
+cache of glyph rows."
+  (let ((start (window-start)))
+    (goto-char (point-max))
+    (set-window-start nil (line-beginning-position -5))
+    (redisplay t)
+    (goto-char start)
+    (set-window-start nil start)
+    (redisplay-statistics (selected-window) t)
+    (redisplay t)
+    (alist-get 'reused-rows (redisplay-statistics (selected-window)))))
+
+(ert-deftest xdisp-tests-glyph-row-cache-display-table ()
+  "Rows from the cache show changes made to a display table in place."
+  (skip-unless (not noninteractive))
+  (xdisp-tests--in-window
+    (setq-local buffer-display-table (make-display-table))
+    (xdisp-tests--scroll-away-and-back)
+    (should (< 0 (xdisp-tests--scroll-away-and-back)))
+    (let ((end (window-end)))
+      ;; Make each line longer than the window is wide.
+      (aset buffer-display-table ?a (make-vector (window-width) ?x))
+      (xdisp-tests--scroll-away-and-back)
+      (should (< (window-end) end))
+      (let ((end (window-end))
+            (redisplay-cache-glyph-rows nil))
+        (xdisp-tests--scroll-away-and-back)
+        (should (= (window-end) end))))))
+
+(ert-deftest xdisp-tests-glyph-row-cache-face-remapping ()
+  "Rows from the cache are not reused after face remapping changes in place."
+  (skip-unless (not noninteractive))
+  (xdisp-tests--in-window
+    (put-text-property (point-min) (point-max) 'face 'bold)
+    (setq-local face-remapping-alist (list (list 'bold 'bold)))
+    (xdisp-tests--scroll-away-and-back)
+    (should (< 0 (xdisp-tests--scroll-away-and-back)))
+    (setcar (cdar face-remapping-alist) '(:inverse-video t))
+    (should (= 0 (xdisp-tests--scroll-away-and-back)))
+    (should (< 0 (xdisp-tests--scroll-away-and-back)))))
+
+(ert-deftest xdisp-tests-glyph-row-cache-line-prefix ()
+  "Rows from the cache show changes to the default `line-prefix'."
+  (skip-unless (not noninteractive))
+  (unwind-protect
+      (xdisp-tests--in-window
+        (xdisp-tests--scroll-away-and-back)
+        (should (< 0 (xdisp-tests--scroll-away-and-back)))
+        (let ((end (window-end)))
+          ;; Make each line longer than the window is wide, from a
+          ;; buffer that isn't displayed.
+          (with-temp-buffer
+            (setq-default line-prefix (make-string (- (window-width) 2) ?>)))
+          (xdisp-tests--scroll-away-and-back)
+          (should (< (window-end) end)))
+        (let ((end (window-end))
+              (redisplay-cache-glyph-rows nil))
+          (xdisp-tests--scroll-away-and-back)
+          (should (= (window-end) end))))
+    (setq-default line-prefix nil)))
+
+(ert-deftest xdisp-tests-named-face-change ()
+  "Changing a named face frees only the realized faces made from it."
+  (skip-unless (not noninteractive))
+  (let ((unused (mapcar (lambda (i)
+                          (make-face (intern (format "xdisp-tests--unused-%d"
+                                                     i))))
+                        (number-sequence 1 8)))
+        (kept 0))
+    (make-face 'xdisp-tests--used)
+    (xdisp-tests--in-window
+      (put-text-property (point-min) (point-max) 'face 'xdisp-tests--used)
+      (xdisp-tests--scroll-away-and-back)
+      (should (< 0 (xdisp-tests--scroll-away-and-back)))
+      ;; Freeing realized faces flushes the cache of glyph rows, so rows
+      ;; are reused only if the faces of the text were kept.  Realized
+      ;; faces record the named faces they depend on in a hashed set,
+      ;; so an unrelated face can collide with one they depend on.
+      (dolist (face unused)
+        (set-face-attribute face (selected-frame) :inverse-video t)
+        (when (< 0 (xdisp-tests--scroll-away-and-back))
+          (setq kept (1+ kept))))
+      (should (< 4 kept))
+      (set-face-attribute 'xdisp-tests--used (selected-frame)
+                          :inverse-video t)
+      (should (= 0 (xdisp-tests--scroll-away-and-back)))
+      (should (< 0 (xdisp-tests--scroll-away-and-back))))))
+
+(ert-deftest xdisp-tests-composition-cache-limit ()
+  "Redisplay keeps the cache of glyph-strings within its limit."
+  (skip-unless (not noninteractive))
+  (let ((composition-cache-limit 40)
+        (most 0))
+    (save-window-excursion
+      (with-temp-buffer
+        (switch-to-buffer (current-buffer))
+        (delete-other-windows)
+        ;; 200 distinct compositions, one per window-full of text.
+        (dotimes (i 200)
+          (insert (+ ?a (% i 26)) (+ #x300 (/ i 26))
+                  (make-string (window-height) ?\n)))
+        (clear-composition-cache)
+        (redisplay-statistics nil t)
+        (goto-char (point-min))
+        (while (not (eobp))
+          (set-window-start nil (point))
+          (redisplay t)
+          (setq most (max most (alist-get 'cached-gstrings
+                                          (redisplay-statistics nil))))
+          (forward-line (1+ (window-height))))
+        (should (< 0 (alist-get 'evicted-gstrings
+                                (redisplay-statistics nil))))
+        ;; The cache is trimmed before each redisplay, which then adds
+        ;; the one composition it shows.
+        (should (<= most (1+ composition-cache-limit)))
+        ;; The first composition was evicted; displaying it again
+        ;; caches it under an ID that may have been reused.
+        (should-not (aref (composition-get-gstring 1 3 nil nil) 1))
+        (set-window-start nil (point-min))
+        (redisplay t)
+        (let ((gstring (composition-get-gstring 1 3 nil nil)))
+          (should (natnump (aref gstring 1)))
+          (should (equal (cdr (append (aref gstring 0) nil))
+                         '(?a #x300)))
+          (should (equal (nth 2 (find-composition 1 nil nil t))
+                         gstring)))))))
+
+(ert-deftest xdisp-tests-merged-faces-remapping ()
+  "Functions that move an iterator don't use merged faces made before."
+  (with-temp-buffer
+    (switch-to-buffer (current-buffer))
+    (insert (propertize "abc\n" 'face 'bold) "def\n"
+            (propertize "abc\n" 'face 'bold))
+    (setq-local face-remapping-alist (list (list 'bold 'bold)))
+    (redisplay-statistics nil t)
+    (window-text-pixel-size)
+    ;; The second run of bold text reuses the face merged for the first.
+    (let ((stats (redisplay-statistics nil t)))
+      (should (= (alist-get 'face-merges stats) 2))
+      (should (= (alist-get 'reused-face-merges stats) 1)))
+    (setcar (cdar face-remapping-alist) '(:inverse-video t))
+    (dolist (fn (cons #'window-text-pixel-size
+                      ;; These don't move an iterator in batch mode.
+                      (unless noninteractive
+                        (list (lambda () (posn-at-point (point-max)))
+                              (lambda ()
+                                (goto-char (point-min))
+                                (vertical-motion 3))))))
+      (funcall fn)
+      (let ((stats (redisplay-statistics nil t)))
+        (should (< (alist-get 'reused-face-merges stats)
+                   (alist-get 'face-merges stats)))))))
+
+(defun xdisp-tests--long-line-motion (threshold)
+  "Return what redisplay shows near positions on a long line.
+Show a buffer with a very long line in the selected window, with
+`long-line-threshold' bound to THRESHOLD, and return a list of
+whether the long-line optimizations are on, followed by the
+screen column and row of several positions and where
+`vertical-motion' moves from them."
+  (let ((long-line-threshold threshold))
+    (save-window-excursion
+      (with-temp-buffer
+        (switch-to-buffer (current-buffer))
+        (delete-other-windows)
+        (insert "first\nsecond\n")
+        (dotimes (_ 30000)
+          (insert "abcdefghi "))
+        (insert "\nlast\n")
+        (let ((motion
+               (mapcar (lambda (pos)
+                         (set-window-start nil (- pos 500))
+                         (goto-char pos)
+                         (redisplay t)
+                         (list (posn-col-row (posn-at-point pos))
+                               (progn (goto-char pos) (vertical-motion 3))
+                               (point)
+                               (progn (goto-char pos) (vertical-motion -3))
+                               (point)))
+                       '(1000 150000 150001 150037 200000 250011))))
+          ;; Redisplay turns the optimizations on.
+          (cons (long-line-optimizations-p) motion))))))
+
+(ert-deftest xdisp-tests-long-line-motion ()
+  "Long-line optimizations don't change where text on a long line shows."
+  (skip-unless (not noninteractive))
+  (let ((optimized (xdisp-tests--long-line-motion 50000))
+        (plain (xdisp-tests--long-line-motion nil)))
+    (should (car optimized))
+    (should-not (car plain))
+    (should (equal (cdr optimized) (cdr plain)))))
+
+;;; xdisp-tests.el ends here